@@ -1,15 +1,25 @@
 import os
 import gzip
-import shutil
-
-import sys
+import hashlib
+import re
+import struct
 
+# noinspection PyUnresolvedReferences
+Import("env")
 
 """
-This script compresses specific files from the frontend directory into the data directory.
-Files listed in FILES_TO_COMPRESS will be compressed using gzip and saved with a .gz extension.
-Other files will be copied as-is to the data directory.
-TODO: Handle the files which are templated.
+This script packs the web interface from the frontend directory into a read-only asset bundle (assets.bin in the build
+directory), which is flashed into the "assets" partition and served directly from memory-mapped flash.
+Files listed in FILES_TO_COMPRESS are stored gzip compressed.
+HTML pages are prerendered: %NAME% placeholders are replaced with the fragment html_fragments/name.html and %% is
+unescaped to %, then the result is compressed. This way the webserver can serve all pages as static data.
+Other files are stored as-is.
+
+Bundle layout (little endian), see src/utils/AssetBundle.h:
+  header:  "CCAB" | version (u16) | entry count (u16) | total size (u32) | reserved (u32)
+  index:   one 64 byte entry per file, sorted by path:
+           path (44 bytes, zero padded) | offset (u32) | length (u32) | hash (8 bytes) | flags (u8) | 3 reserved bytes
+  data:    file contents, each aligned to 4 bytes
 """
 
 FILES_TO_COMPRESS = [
@@ -28,6 +38,19 @@ FILES_TO_COMPRESS = [
 
 FRONTEND_DIR = "frontend"
 DATA_DIR = "data"
+HTML_DIR = "html"
+FRAGMENTS_DIR = "html_fragments"
+PARTITION_TABLE = "partitions_4M.csv"
+ASSET_PARTITION = "assets"
+
+BUNDLE_MAGIC = b"CCAB"
+BUNDLE_VERSION = 1
+HEADER_SIZE = 16
+ENTRY_SIZE = 64
+PATH_SIZE = 44
+FLAG_GZIP = 0x01
+
+PLACEHOLDER = re.compile(r"%%|%([A-Z0-9_]+)%")
 
 def ensure_dir_exists(path):
     try:
@@ -35,33 +58,36 @@ def ensure_dir_exists(path):
     except OSError as e:
         print(f"Error creating directory {path}: {e}")
 
-def compress_file(src_path, dest_path):
-    try:
-        with open(src_path, "rb") as f_in, gzip.open(dest_path, "wb") as f_out:
-            shutil.copyfileobj(f_in, f_out)
-    except (IOError, OSError) as e:
-        print(f"Error compressing {src_path}: {e}")
-
-        # Clean up partial file
-        if os.path.exists(dest_path):
-            try:
-                os.remove(dest_path)
-            except OSError:
-                pass
-        return False
-    return True
-
-def copy_file(src_path, dest_path):
-    try:
-        shutil.copy2(src_path, dest_path)
-    except (IOError, OSError) as e:
-        print(f"Error copying {src_path}: {e}")
-        return False
-    return True
+def compress(data):
+    # fixed mtime so that unchanged assets produce an identical bundle
+    return gzip.compress(data, compresslevel=9, mtime=0)
 
-def main():
+def render_html(src_path, included=()):
+    """Resolve fragment includes the same way the former runtime template processor did"""
+    with open(src_path, "r", encoding="utf-8") as f:
+        content = f.read()
+
+    def replace(match):
+        name = match.group(1)
+
+        if name is None:
+            return "%"
+
+        fragment_path = os.path.join(FRONTEND_DIR, FRAGMENTS_DIR, name.lower() + ".html")
+
+        if name in included or not os.path.exists(fragment_path):
+            print(f"Warning: {src_path} uses unknown or recursive placeholder %{name}%, replacing it with nothing")
+            return ""
+
+        return render_html(fragment_path, included + (name,))
+
+    return PLACEHOLDER.sub(replace, content)
+
+def collect_assets():
+    """Return a dict of URL path -> (content, gzip flag)"""
     compress_set = set(FILES_TO_COMPRESS)
     found_files = set()
+    assets = {}
 
     for root, dirs, files in os.walk(FRONTEND_DIR):
         for file in files:
@@ -72,17 +98,20 @@ def main():
 
             src_path = os.path.join(root, file)
 
-            if rel_file in compress_set:
-                dest_file = rel_file + ".gz"
-                dest_path = os.path.join(DATA_DIR, dest_file)
-                print(f"Compressing {rel_file} -> {dest_file}")
-                ensure_dir_exists(os.path.dirname(dest_path))
-                compress_file(src_path, dest_path)
+            if rel_file.startswith(FRAGMENTS_DIR + "/"):
+                # only needed at build time, included into the pages below
+                continue
+
+            if rel_file.startswith(HTML_DIR + "/") and rel_file.endswith(".html"):
+                # pages are served from the root of the webserver
+                path = rel_file[len(HTML_DIR):]
+                assets[path] = (compress(render_html(src_path).encode("utf-8")), True)
+            elif rel_file in compress_set:
+                with open(src_path, "rb") as f:
+                    assets["/" + rel_file] = (compress(f.read()), True)
             else:
-                dest_path = os.path.join(DATA_DIR, rel_file)
-                print(f"Copying {rel_file}")
-                ensure_dir_exists(os.path.dirname(dest_path))
-                copy_file(src_path, dest_path)
+                with open(src_path, "rb") as f:
+                    assets["/" + rel_file] = (f.read(), False)
 
     # Check for missing files
     missing_files = compress_set - found_files
@@ -90,9 +119,62 @@ def main():
     if missing_files:
         print(f"Warning: The following files were not found: {missing_files}")
 
-if "buildfs" in sys.argv:
-    main()
+    return assets
+
+def build_bundle(assets):
+    paths = sorted(assets)
+    offset = HEADER_SIZE + ENTRY_SIZE * len(paths)
+    index = bytearray()
+    data = bytearray()
+
+    for path in paths:
+        content, gzipped = assets[path]
+        encoded = path.encode("utf-8")
+
+        if len(encoded) >= PATH_SIZE:
+            raise ValueError(f"Asset path too long for the bundle index: {path}")
+
+        index += struct.pack(f"<{PATH_SIZE}sII8sB3x", encoded, offset + len(data), len(content), hashlib.sha256(content).digest()[:8], FLAG_GZIP if gzipped else 0)
+        data += content
+        data += b"\0" * (-len(data) % 4)
+
+    total_size = offset + len(data)
+    header = BUNDLE_MAGIC + struct.pack("<HHII", BUNDLE_VERSION, len(paths), total_size, 0)
+
+    return bytes(header + index + data)
+
+def get_partition(name):
+    """Return (offset, size) of a partition from the partition table"""
+    with open(PARTITION_TABLE) as f:
+        for line in f:
+            fields = [field.strip() for field in line.split("#")[0].split(",")]
+
+            if fields[0] == name:
+                return fields[3], int(fields[4], 0)
+
+    raise ValueError(f"Partition {name} not found in {PARTITION_TABLE}")
+
+def main():
+    bundle = build_bundle(collect_assets())
+    offset, size = get_partition(ASSET_PARTITION)
+
+    if len(bundle) > size:
+        print(f"Error: Asset bundle ({len(bundle)} bytes) does not fit into the {ASSET_PARTITION} partition ({size} bytes)")
+        env.Exit(1)
+
+    build_dir = env.subst("$BUILD_DIR")
+    ensure_dir_exists(build_dir)
+    bundle_path = os.path.join(build_dir, "assets.bin")
+
+    with open(bundle_path, "wb") as f:
+        f.write(bundle)
+
+    print(f"Asset bundle: {len(bundle)} of {size} bytes -> {bundle_path}")
+
+    # flashed together with the firmware on upload
+    env.Append(FLASH_EXTRA_IMAGES=[(offset, bundle_path)])
 
-if os.environ.get("PROJECT_TASK") == "buildfs":
-    main()
+    # the file system only holds the configuration now, but buildfs requires the directory to exist
+    ensure_dir_exists(DATA_DIR)
 
+main()
@@ -0,0 +1,137 @@
+import re
+import subprocess
+
+# noinspection PyUnresolvedReferences
+Import("env")
+
+"""
+This script runs after linking and verifies that the heater timer interrupt only executes code from IRAM or ROM.
+The interrupt is registered with ESP_INTR_FLAG_IRAM so that it keeps switching the heater while the flash cache is
+disabled, e.g. during LittleFS writes. A single call into flash from that path stalls or crashes the firmware, but
+only when the timing is unlucky, so it is checked here instead of waiting for it to happen on a machine.
+
+Starting from ISR_ROOTS, every function reachable through direct calls and literal (l32r + callx) calls is
+disassembled and checked. Calls whose target can't be resolved statically fail the check as well.
+
+Data is checked through the literal pool: every l32r literal that points into flash mapped read only data (DROM,
+e.g. const tables or string literals) fails the check, since reading it with the cache disabled crashes as well.
+Pointers that are only computed at runtime or read from RAM aren't visible here and are not covered.
+"""
+
+ISR_ROOTS = ["onTimer()"]
+
+# ESP32 address ranges, everything below IRAM_END is internal ROM or IRAM
+IRAM_END = 0x400C2000
+FLASH_START = 0x400C2000
+FLASH_END = 0x40C00000
+DROM_START = 0x3F400000
+DROM_END = 0x3F800000
+
+CALL = re.compile(r"^\s*([0-9a-f]+):\s+[0-9a-f]+\s+call(?:0|4|8|12)\s+([0-9a-f]+)")
+CALLX = re.compile(r"^\s*([0-9a-f]+):\s+[0-9a-f]+\s+callx(?:0|4|8|12)\s+a(\d+)")
+L32R = re.compile(r"^\s*([0-9a-f]+):\s+[0-9a-f]+\s+l32r\s+a(\d+),\s*([0-9a-f]+)")
+
+def tool(name):
+    # the toolchain prefix is the same for all binutils, e.g. xtensa-esp32-elf-objcopy
+    return env.subst("$OBJCOPY").replace("objcopy", name)
+
+def read_symbols(elf):
+    symbols = {}
+    output = subprocess.check_output([tool("nm"), "-C", "-S", "--defined-only", elf], text=True)
+
+    for line in output.splitlines():
+        parts = line.split(" ", 3)
+
+        if len(parts) == 4 and parts[2].lower() in ("t", "w"):
+            symbols[parts[3]] = (int(parts[0], 16), int(parts[1], 16))
+
+    return symbols
+
+def read_word(elf, address):
+    output = subprocess.check_output([tool("objdump"), "-s", f"--start-address={address:#x}", f"--stop-address={address + 4:#x}", elf], text=True)
+
+    for line in output.splitlines():
+        parts = line.split()
+
+        if len(parts) >= 2 and parts[0] == f"{address:x}":
+            return int.from_bytes(bytes.fromhex(parts[1]), "little")
+
+    return None
+
+def scan_function(elf, start, size):
+    """Return the call targets of a function, None for calls that can't be resolved, and its literal values"""
+    output = subprocess.check_output([tool("objdump"), "-d", f"--start-address={start:#x}", f"--stop-address={start + size:#x}", elf], text=True)
+    literals = {}
+    values = {}
+    targets = []
+
+    for line in output.splitlines():
+        if match := L32R.match(line):
+            literal = int(match.group(3), 16)
+            literals[match.group(2)] = literal
+
+            if literal not in values:
+                values[literal] = read_word(elf, literal)
+        elif match := CALL.match(line):
+            targets.append(int(match.group(2), 16))
+        elif match := CALLX.match(line):
+            literal = literals.get(match.group(2))
+            targets.append(values.get(literal) if literal is not None else None)
+
+    return targets, [value for value in values.values() if value is not None]
+
+def check_iram(source, target, env):
+    elf = str(target[0])
+    symbols = read_symbols(elf)
+    names = {address: name for name, (address, _) in symbols.items()}
+    pending = list(ISR_ROOTS)
+    checked = set()
+    errors = []
+
+    while pending:
+        name = pending.pop()
+
+        if name in checked:
+            continue
+
+        checked.add(name)
+
+        if name not in symbols:
+            errors.append(f"{name} not found")
+            continue
+
+        address, size = symbols[name]
+
+        if FLASH_START <= address < FLASH_END:
+            errors.append(f"{name} is in flash")
+            continue
+
+        targets, values = scan_function(elf, address, size)
+
+        for value in values:
+            if DROM_START <= value < DROM_END:
+                errors.append(f"{name} loads {value:#x} from flash data (DROM)")
+
+        for call in targets:
+            if call is None:
+                errors.append(f"{name} makes an indirect call")
+            elif call >= IRAM_END:
+                errors.append(f"{name} calls {names.get(call, hex(call))} outside of IRAM")
+            elif call in names:
+                pending.append(names[call])
+
+    if errors:
+        print("IRAM check failed, the heater interrupt reaches code that is not safe while the flash cache is disabled:")
+
+        for error in errors:
+            print(f"  {error}")
+
+        return 1
+
+    print(f"IRAM check passed for {len(checked)} functions reachable from {', '.join(ISR_ROOTS)}")
+
+    return 0
+
+# test builds don't contain the heater interrupt
+if "test" not in env.GetBuildType():
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check_iram)
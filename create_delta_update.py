@@ -0,0 +1,159 @@
+# create_delta_update.py
+import argparse
+import hashlib
+import struct
+import sys
+from pathlib import Path
+
+"""
+Creates a delta update between two firmware images (firmware.bin) for the /update/delta endpoint.
+The patch format is documented in lib/DeltaPatch/DeltaPatch.h. The created patch is applied again
+after creation and compared against the new image before it is written.
+
+Usage: python create_delta_update.py old_firmware.bin new_firmware.bin firmware.delta
+"""
+
+MAGIC = b"CCDP"
+VERSION = 1
+
+OP_END = 0x00
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+BLOCK_SIZE = 16     # granularity of the source index
+MIN_MATCH = 24      # shorter matches are cheaper as literal data (a COPY op costs 9 bytes)
+
+
+def build_index(source):
+    """Index the source image by block content, first occurrence wins"""
+    index = {}
+
+    for offset in range(0, len(source) - BLOCK_SIZE + 1, BLOCK_SIZE):
+        index.setdefault(source[offset:offset + BLOCK_SIZE], offset)
+
+    return index
+
+
+def create_patch(source, target):
+    index = build_index(source)
+    ops = []
+    literal_start = 0
+    pos = 0
+
+    def flush_literal(end):
+        if end > literal_start:
+            ops.append((OP_INSERT, target[literal_start:end]))
+
+    while pos + BLOCK_SIZE <= len(target):
+        src = index.get(target[pos:pos + BLOCK_SIZE])
+
+        if src is None:
+            pos += 1
+            continue
+
+        # extend the match backwards into pending literal data and forwards as far as possible
+        start = pos
+        src_start = src
+
+        while start > literal_start and src_start > 0 and target[start - 1] == source[src_start - 1]:
+            start -= 1
+            src_start -= 1
+
+        end = pos + BLOCK_SIZE
+        src_end = src + BLOCK_SIZE
+
+        while end < len(target) and src_end < len(source) and target[end] == source[src_end]:
+            end += 1
+            src_end += 1
+
+        if end - start < MIN_MATCH:
+            pos += 1
+            continue
+
+        flush_literal(start)
+        ops.append((OP_COPY, src_start, end - start))
+        literal_start = end
+        pos = end
+
+    flush_literal(len(target))
+
+    header = MAGIC + struct.pack("<B3xII", VERSION, len(source), len(target))
+    header += hashlib.sha256(source).digest() + hashlib.sha256(target).digest()
+
+    patch = bytearray(header)
+
+    for op in ops:
+        if op[0] == OP_COPY:
+            patch += struct.pack("<BII", OP_COPY, op[1], op[2])
+        else:
+            patch += struct.pack("<BI", OP_INSERT, len(op[1])) + op[1]
+
+    patch.append(OP_END)
+
+    return bytes(patch)
+
+
+def apply_patch(source, patch):
+    """Reference implementation of the on-device applier, used to verify created patches"""
+    if patch[:4] != MAGIC or patch[4] != VERSION:
+        raise ValueError("invalid patch header")
+
+    source_size, target_size = struct.unpack_from("<II", patch, 8)
+
+    if source_size != len(source) or patch[16:48] != hashlib.sha256(source).digest():
+        raise ValueError("patch does not match the source image")
+
+    target = bytearray()
+    pos = 80
+
+    while True:
+        op = patch[pos]
+        pos += 1
+
+        if op == OP_END:
+            break
+        elif op == OP_COPY:
+            offset, length = struct.unpack_from("<II", patch, pos)
+            pos += 8
+            target += source[offset:offset + length]
+        elif op == OP_INSERT:
+            (length,) = struct.unpack_from("<I", patch, pos)
+            pos += 4
+            target += patch[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError(f"invalid op {op:#x} at {pos - 1}")
+
+    if pos != len(patch) or len(target) != target_size or hashlib.sha256(target).digest() != patch[48:80]:
+        raise ValueError("reconstructed image does not match the target image")
+
+    return bytes(target)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Create a delta firmware update")
+    parser.add_argument("source", type=Path, help="firmware.bin currently running on the machine")
+    parser.add_argument("target", type=Path, help="new firmware.bin")
+    parser.add_argument("output", type=Path, help="patch file to create")
+    args = parser.parse_args()
+
+    source = args.source.read_bytes()
+    target = args.target.read_bytes()
+
+    patch = create_patch(source, target)
+
+    try:
+        apply_patch(source, patch)
+    except ValueError as e:
+        print(f"Patch verification failed: {e}")
+        sys.exit(1)
+
+    args.output.write_bytes(patch)
+
+    print(f"Source:  {len(source)} bytes")
+    print(f"Target:  {len(target)} bytes, sha256 {hashlib.sha256(target).hexdigest()}")
+    print(f"Patch:   {len(patch)} bytes ({len(patch) * 100 / len(target):.1f}% of the full image)")
+
+
+if __name__ == "__main__":
+    main()
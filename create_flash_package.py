@@ -24,7 +24,8 @@ def create_flash_package():
         "bootloader.bin": "0x1000",      # Standard ESP32 bootloader location
         "partitions.bin": "0x8000",      # Standard ESP32 partition table location
         "firmware.bin": "0x10000",       # app0 partition
-        "littlefs.bin": "0x350000"       # file system image partition
+        "assets.bin": "0x350000",        # web interface asset bundle partition
+        "littlefs.bin": "0x3C0000"       # file system image partition
     }
 
     # Copy files
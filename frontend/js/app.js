@@ -22,7 +22,18 @@ const vueApp = Vue.createApp({
 
             // Factory reset properties
             factoryResetMessage: '',
-            factoryResetSuccess: false
+            factoryResetSuccess: false,
+
+            // Firmware version, shown on the about page
+            version: '',
+
+            // Firmware update properties
+            firmwareFile: null,
+            firmwareSha256: '',
+            isUpdatingFirmware: false,
+            firmwareProgress: 0,
+            firmwareMessage: '',
+            firmwareSuccess: false
         }
     },
 
@@ -40,11 +51,28 @@ const vueApp = Vue.createApp({
 
         this.filter = filter;
 
-        // Fetch parameters with the determined filter
-        this.fetchParameters(this.filter);
+        if (window.location.pathname === '/about.html') {
+            this.fetchInfo();
+        }
+
+        // Exchange credentials for a session cookie (if authentication is enabled), then fetch parameters with the determined filter
+        fetch('/login', { method: 'POST' })
+            .catch(() => {})
+            .finally(() => this.fetchParameters(this.filter));
     },
 
     methods: {
+        async fetchInfo() {
+            try {
+                const response = await fetch('/info');
+                const info = await response.json();
+                this.version = info.version;
+            }
+            catch (err) {
+                console.error('Error fetching info:', err);
+            }
+        },
+
         async fetchParameters(filter = '') {
             this.parameters = [];
             this.originalValues = {}; // Reset original values
@@ -410,6 +438,85 @@ const vueApp = Vue.createApp({
             }
         },
 
+        // Firmware update methods
+        handleFirmwareSelect(event) {
+            const file = event.target.files[0];
+            this.firmwareFile = file;
+            this.firmwareMessage = '';
+
+            if (file) {
+                if (!file.name.toLowerCase().endsWith('.bin') && !file.name.toLowerCase().endsWith('.delta')) {
+                    this.firmwareMessage = 'Please select a firmware image (.bin) or delta update (.delta).';
+                    this.firmwareSuccess = false;
+                    this.firmwareFile = null;
+                    return;
+                }
+
+                this.firmwareMessage = `Selected: ${file.name} (${this.formatFileSize(file.size)})`;
+                this.firmwareSuccess = true;
+            }
+        },
+
+        async uploadFirmware() {
+            if (!this.firmwareFile || !window.confirm('Update the firmware now? The machine restarts after the update.')) {
+                return;
+            }
+
+            this.isUpdatingFirmware = true;
+            this.firmwareProgress = 0;
+            this.firmwareMessage = 'Uploading firmware...';
+            this.firmwareSuccess = true;
+
+            // the machine reports how much of the image has been written
+            const events = new EventSource('/events');
+            events.addEventListener('ota_progress', (e) => {
+                const progress = JSON.parse(e.data);
+                const total = progress.total || this.firmwareFile.size;
+                this.firmwareProgress = Math.min(100, Math.round(progress.written * 100 / total));
+            });
+
+            try {
+                const formData = new FormData();
+                formData.append('firmware', this.firmwareFile);
+
+                const headers = {};
+                const sha256 = this.firmwareSha256.trim().toLowerCase();
+
+                if (sha256) {
+                    headers['X-Update-SHA256'] = sha256;
+                }
+
+                // delta updates are reconstructed from the running firmware on the machine,
+                // asset bundles (assets.bin) are recognized by their magic bytes
+                const magic = new TextDecoder().decode(await this.firmwareFile.slice(0, 4).arrayBuffer());
+                let url = '/update';
+
+                if (this.firmwareFile.name.toLowerCase().endsWith('.delta')) {
+                    url = '/update/delta';
+                } else if (magic === 'CCAB') {
+                    url = '/update/assets';
+                }
+
+                const response = await fetch(url, {
+                    method: 'POST',
+                    headers: headers,
+                    body: formData
+                });
+
+                const result = await response.json();
+
+                this.firmwareSuccess = result.success;
+                this.firmwareMessage = result.success ? 'Firmware updated successfully, machine is restarting...' : `Firmware update failed: ${result.message}`;
+            } catch (error) {
+                console.error('Firmware update error:', error);
+                this.firmwareMessage = 'Firmware update failed: could not reach the machine.';
+                this.firmwareSuccess = false;
+            } finally {
+                events.close();
+                this.isUpdatingFirmware = false;
+            }
+        },
+
         formatFileSize(bytes) {
             if (bytes === 0) return '0 Bytes';
 
@@ -0,0 +1,197 @@
+#include "DeltaPatch.h"
+
+#include <string.h>
+#include <utility>
+
+namespace {
+    constexpr uint8_t OP_END = 0x00;
+    constexpr uint8_t OP_COPY = 0x01;
+    constexpr uint8_t OP_INSERT = 0x02;
+}
+
+DeltaPatch::DeltaPatch(SourceReader reader, TargetWriter writer, HeaderHandler onHeader) :
+    reader_(std::move(reader)), writer_(std::move(writer)), onHeader_(std::move(onHeader)), header_(), state_(HEADER), status_(OK), pending_(), pendingLen_(0), pendingNeeded_(HEADER_SIZE), opType_(OP_END),
+    insertRemaining_(0), written_(0), copyBuffer_() {
+}
+
+DeltaPatch::Status DeltaPatch::write(const uint8_t* data, size_t len) {
+    while (len > 0 && status_ == OK) {
+        switch (state_) {
+            case HEADER:
+            case OP_ARGS:
+                {
+                    const size_t n = pendingNeeded_ - pendingLen_ < len ? pendingNeeded_ - pendingLen_ : len;
+                    memcpy(pending_ + pendingLen_, data, n);
+                    pendingLen_ += n;
+                    data += n;
+                    len -= n;
+
+                    if (pendingLen_ == pendingNeeded_) {
+                        status_ = state_ == HEADER ? parseHeader() : executeOp();
+                    }
+
+                    break;
+                }
+
+            case OP_TYPE:
+                opType_ = *data++;
+                len--;
+
+                if (opType_ == OP_END) {
+                    state_ = DONE;
+                }
+                else if (opType_ == OP_COPY || opType_ == OP_INSERT) {
+                    state_ = OP_ARGS;
+                    pendingLen_ = 0;
+                    pendingNeeded_ = opType_ == OP_COPY ? 8 : 4;
+                }
+                else {
+                    status_ = INVALID_OP;
+                }
+
+                break;
+
+            case INSERT_DATA:
+                {
+                    const size_t n = insertRemaining_ < len ? insertRemaining_ : len;
+
+                    if (!writer_(data, n)) {
+                        status_ = TARGET_WRITE_FAILED;
+                        break;
+                    }
+
+                    written_ += n;
+                    insertRemaining_ -= n;
+                    data += n;
+                    len -= n;
+
+                    if (insertRemaining_ == 0) {
+                        state_ = OP_TYPE;
+                    }
+
+                    break;
+                }
+
+            case DONE:
+                status_ = TRAILING_DATA;
+                break;
+        }
+    }
+
+    return status_;
+}
+
+DeltaPatch::Status DeltaPatch::finish() {
+    if (status_ == OK && (state_ != DONE || written_ != header_.targetSize)) {
+        status_ = INCOMPLETE;
+    }
+
+    return status_;
+}
+
+const DeltaPatch::Header& DeltaPatch::getHeader() const {
+    return header_;
+}
+
+uint32_t DeltaPatch::getWritten() const {
+    return written_;
+}
+
+const char* DeltaPatch::statusString(const Status status) {
+    switch (status) {
+        case OK:
+            return "OK";
+        case INVALID_HEADER:
+            return "Invalid patch header";
+        case UNSUPPORTED_VERSION:
+            return "Unsupported patch version";
+        case REJECTED:
+            return "Patch does not match the running firmware";
+        case INVALID_OP:
+            return "Invalid patch operation";
+        case OUT_OF_BOUNDS:
+            return "Patch operation out of bounds";
+        case SOURCE_READ_FAILED:
+            return "Reading the running firmware failed";
+        case TARGET_WRITE_FAILED:
+            return "Writing the new firmware failed";
+        case TRAILING_DATA:
+            return "Unexpected data after end of patch";
+        case INCOMPLETE:
+            return "Patch incomplete";
+    }
+
+    return "Unknown error";
+}
+
+DeltaPatch::Status DeltaPatch::parseHeader() {
+    if (memcmp(pending_, "CCDP", 4) != 0) {
+        return INVALID_HEADER;
+    }
+
+    if (pending_[4] != VERSION) {
+        return UNSUPPORTED_VERSION;
+    }
+
+    header_.sourceSize = readUint32(pending_ + 8);
+    header_.targetSize = readUint32(pending_ + 12);
+    memcpy(header_.sourceHash, pending_ + 16, 32);
+    memcpy(header_.targetHash, pending_ + 48, 32);
+
+    if (onHeader_ && !onHeader_(header_)) {
+        return REJECTED;
+    }
+
+    state_ = OP_TYPE;
+
+    return OK;
+}
+
+DeltaPatch::Status DeltaPatch::executeOp() {
+    if (opType_ == OP_COPY) {
+        const uint32_t offset = readUint32(pending_);
+        const uint32_t length = readUint32(pending_ + 4);
+
+        state_ = OP_TYPE;
+
+        return copy(offset, length);
+    }
+
+    insertRemaining_ = readUint32(pending_);
+
+    if (insertRemaining_ > header_.targetSize - written_) {
+        return OUT_OF_BOUNDS;
+    }
+
+    state_ = insertRemaining_ > 0 ? INSERT_DATA : OP_TYPE;
+
+    return OK;
+}
+
+DeltaPatch::Status DeltaPatch::copy(uint32_t offset, uint32_t length) {
+    if (offset > header_.sourceSize || length > header_.sourceSize - offset || length > header_.targetSize - written_) {
+        return OUT_OF_BOUNDS;
+    }
+
+    while (length > 0) {
+        const size_t n = length < COPY_BUFFER_SIZE ? length : COPY_BUFFER_SIZE;
+
+        if (!reader_(offset, copyBuffer_, n)) {
+            return SOURCE_READ_FAILED;
+        }
+
+        if (!writer_(copyBuffer_, n)) {
+            return TARGET_WRITE_FAILED;
+        }
+
+        offset += n;
+        length -= n;
+        written_ += n;
+    }
+
+    return OK;
+}
+
+uint32_t DeltaPatch::readUint32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Streaming applier for delta firmware updates
+ * @details Reconstructs a target image from the currently running image (source) and a patch created with
+ * create_delta_update.py. The patch can be fed in arbitrary chunks as they arrive, RAM usage is bounded by the
+ * size of the copy buffer. The class has no Arduino dependencies so it can be built and run on a host as well.
+ *
+ * Patch format (all integers little endian):
+ *
+ *     header:  "CCDP" | version (u8) | 3 reserved bytes | source size (u32) | target size (u32)
+ *              | source SHA-256 (32 bytes) | target SHA-256 (32 bytes)
+ *     ops:     0x01 COPY   offset (u32) | length (u32)   copy bytes from the source image
+ *              0x02 INSERT length (u32) | data            write literal bytes
+ *              0x00 END
+ */
+class DeltaPatch {
+    public:
+        static constexpr uint8_t VERSION = 1;
+        static constexpr size_t HEADER_SIZE = 80;
+        static constexpr size_t COPY_BUFFER_SIZE = 1024;
+
+        enum Status {
+            OK,
+            INVALID_HEADER,
+            UNSUPPORTED_VERSION,
+            REJECTED,
+            INVALID_OP,
+            OUT_OF_BOUNDS,
+            SOURCE_READ_FAILED,
+            TARGET_WRITE_FAILED,
+            TRAILING_DATA,
+            INCOMPLETE
+        };
+
+        struct Header {
+                uint32_t sourceSize;
+                uint32_t targetSize;
+                uint8_t sourceHash[32];
+                uint8_t targetHash[32];
+        };
+
+        /** Read len bytes at offset from the source image */
+        using SourceReader = std::function<bool(uint32_t offset, uint8_t* buffer, size_t len)>;
+
+        /** Append len bytes to the target image */
+        using TargetWriter = std::function<bool(const uint8_t* data, size_t len)>;
+
+        /** Called once the header has been parsed, returning false rejects the patch (e.g. wrong source image) */
+        using HeaderHandler = std::function<bool(const Header& header)>;
+
+        /**
+         * @brief Constructor
+         *
+         * @param reader Callback reading from the source image
+         * @param writer Callback appending to the target image
+         * @param onHeader Optional callback to validate the header before any data is written
+         */
+        DeltaPatch(SourceReader reader, TargetWriter writer, HeaderHandler onHeader = nullptr);
+
+        /**
+         * @brief Feed the next chunk of the patch
+         *
+         * @param data Patch data
+         * @param len Length of the chunk
+         * @return OK or the first error that occurred, once an error occurred all further calls return it again
+         */
+        Status write(const uint8_t* data, size_t len);
+
+        /**
+         * @brief Check that the patch has been applied completely
+         * @return OK if the END op was received and the target has the announced size
+         */
+        Status finish();
+
+        /**
+         * @brief Get the parsed header, only valid once the header has been received
+         */
+        [[nodiscard]] const Header& getHeader() const;
+
+        /**
+         * @brief Number of target bytes written so far
+         */
+        [[nodiscard]] uint32_t getWritten() const;
+
+        /**
+         * @brief Get a human readable description of a status
+         */
+        static const char* statusString(Status status);
+
+    private:
+        enum State {
+            HEADER,
+            OP_TYPE,
+            OP_ARGS,
+            INSERT_DATA,
+            DONE
+        };
+
+        Status parseHeader();
+        Status executeOp();
+        Status copy(uint32_t offset, uint32_t length);
+
+        static uint32_t readUint32(const uint8_t* data);
+
+        SourceReader reader_;
+        TargetWriter writer_;
+        HeaderHandler onHeader_;
+
+        Header header_;
+        State state_;
+        Status status_;
+
+        // Accumulates the header and op arguments, which may be split across chunks
+        uint8_t pending_[HEADER_SIZE];
+        size_t pendingLen_;
+        size_t pendingNeeded_;
+
+        uint8_t opType_;
+        uint32_t insertRemaining_;
+        uint32_t written_;
+
+        uint8_t copyBuffer_[COPY_BUFFER_SIZE];
+};
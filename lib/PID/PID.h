@@ -0,0 +1,291 @@
+#pragma once
+
+#include <Arduino.h>
+#include <limits>
+
+#define MANUAL    0
+#define AUTOMATIC 1
+
+#define DIRECT  0
+#define REVERSE 1
+
+#define P_ON_M 0
+#define P_ON_E 1
+
+/**
+ * @brief PID controller for the boiler temperature
+ * @details Follows the interface and algorithm of the Arduino PID library it replaces: the gains are scaled to the sample time
+ *          once when they are set, the integral sum is clamped against windup and with proportional on measurement the
+ *          proportional part acts on the change of the input and is accumulated in the integral sum. On top of that the
+ *          integral sum has its own limits with proportional on error and the change of the input used by the derivative part can be smoothed with an
+ *          exponential moving average.
+ *
+ *          The value type is a template parameter. The firmware uses float since the ESP32 FPU only handles single precision
+ *          and every double operation is a software library call. The host tests check it against the pinned library it replaces.
+ */
+template <typename T>
+class BasicPID {
+    public:
+        /**
+         * @brief Constructor, the controller starts in manual mode with output limits 0-255 and a sample time of 100 ms
+         *
+         * @param input Measured value
+         * @param output Written by Compute()
+         * @param setpoint Value the controller tries to reach
+         * @param kp Proportional gain
+         * @param ki Integral gain per second
+         * @param kd Derivative gain in seconds
+         * @param pOn P_ON_E for proportional on error, P_ON_M for proportional on measurement
+         * @param direction DIRECT if a higher output increases the input, REVERSE otherwise
+         */
+        BasicPID(T* input, T* output, T* setpoint, const T kp, const T ki, const T kd, const int pOn, const int direction) :
+            input_(input), output_(output), setpoint_(setpoint) {
+            SetOutputLimits(0, 255);
+            SetControllerDirection(direction);
+            SetTunings(kp, ki, kd, pOn);
+            lastTime_ = millis() - sampleTime_;
+        }
+
+        /**
+         * @brief Compute a new output if the controller is in automatic mode and the sample time has passed
+         * @return true if the output has been updated
+         */
+        bool Compute() {
+            return Compute(millis());
+        }
+
+        /**
+         * @brief Same as Compute(), for a given time in ms
+         */
+        bool Compute(const unsigned long now) {
+            if (!inAuto_ || now - lastTime_ < sampleTime_) {
+                return false;
+            }
+
+            const T input = *input_;
+            const T error = *setpoint_ - input;
+            const T dInput = input - lastInput_;
+
+            smoothedDInput_ = smoothingFactor_ * smoothedDInput_ + (1 - smoothingFactor_) * dInput;
+
+            outputSum_ += ki_ * error;
+
+            if (!pOnE_) {
+                outputSum_ -= kp_ * dInput;
+            }
+
+            // with proportional on measurement the sum carries the proportional part as well, only the output limits apply then
+            outputSum_ = pOnE_ ? clamp(clamp(outputSum_, iMin_, iMax_), outMin_, outMax_) : clamp(outputSum_, outMin_, outMax_);
+
+            pPart_ = pOnE_ ? kp_ * error : 0;
+            dPart_ = -kd_ * smoothedDInput_;
+
+            *output_ = clamp(pPart_ + outputSum_ + dPart_, outMin_, outMax_);
+
+            inputError_ = error;
+            deltaInput_ = dInput;
+            lastInput_ = input;
+            lastTime_ = now;
+
+            return true;
+        }
+
+        /**
+         * @brief Switch between MANUAL and AUTOMATIC, switching to automatic continues bumpless from the current output
+         */
+        void SetMode(const int mode) {
+            const bool newAuto = mode == AUTOMATIC;
+
+            if (newAuto && !inAuto_) {
+                initialize();
+            }
+
+            inAuto_ = newAuto;
+        }
+
+        void SetOutputLimits(const T min, const T max) {
+            if (min >= max) {
+                return;
+            }
+
+            outMin_ = min;
+            outMax_ = max;
+
+            if (inAuto_) {
+                *output_ = clamp(*output_, outMin_, outMax_);
+                outputSum_ = clamp(outputSum_, outMin_, outMax_);
+            }
+        }
+
+        /**
+         * @brief Limit the integral sum with proportional on error, it is always kept within the output limits as well
+         */
+        void SetIntegratorLimits(const T min, const T max) {
+            if (min >= max) {
+                return;
+            }
+
+            iMin_ = min;
+            iMax_ = max;
+
+            if (inAuto_ && pOnE_) {
+                outputSum_ = clamp(outputSum_, iMin_, iMax_);
+            }
+        }
+
+        /**
+         * @brief Smoothing of the input change used by the derivative part, 0 means no filtering, values towards 1 smooth more
+         */
+        void SetSmoothingFactor(const T factor) {
+            if (factor < 0 || factor > 1) {
+                return;
+            }
+
+            smoothingFactor_ = factor;
+        }
+
+        void SetTunings(const T kp, const T ki, const T kd) {
+            SetTunings(kp, ki, kd, pOn_);
+        }
+
+        void SetTunings(const T kp, const T ki, const T kd, const int pOn) {
+            if (kp < 0 || ki < 0 || kd < 0) {
+                return;
+            }
+
+            pOn_ = pOn;
+            pOnE_ = pOn == P_ON_E;
+
+            dispKp_ = kp;
+            dispKi_ = ki;
+            dispKd_ = kd;
+
+            const T sampleTimeInSec = static_cast<T>(sampleTime_) / 1000;
+
+            kp_ = kp;
+            ki_ = ki * sampleTimeInSec;
+            kd_ = kd / sampleTimeInSec;
+
+            if (direction_ == REVERSE) {
+                kp_ = -kp_;
+                ki_ = -ki_;
+                kd_ = -kd_;
+            }
+        }
+
+        void SetControllerDirection(const int direction) {
+            if (inAuto_ && direction != direction_) {
+                kp_ = -kp_;
+                ki_ = -ki_;
+                kd_ = -kd_;
+            }
+
+            direction_ = direction;
+        }
+
+        /**
+         * @brief Set the interval between two computations in ms, the gains are rescaled accordingly
+         */
+        void SetSampleTime(const int sampleTime) {
+            if (sampleTime <= 0) {
+                return;
+            }
+
+            const T ratio = static_cast<T>(sampleTime) / static_cast<T>(sampleTime_);
+
+            ki_ *= ratio;
+            kd_ /= ratio;
+            sampleTime_ = sampleTime;
+        }
+
+        // the gains as they were set, not scaled to the sample time
+        T GetKp() const {
+            return dispKp_;
+        }
+
+        T GetKi() const {
+            return dispKi_;
+        }
+
+        T GetKd() const {
+            return dispKd_;
+        }
+
+        int GetMode() const {
+            return inAuto_ ? AUTOMATIC : MANUAL;
+        }
+
+        int GetDirection() const {
+            return direction_;
+        }
+
+        bool GetPonE() const {
+            return pOnE_;
+        }
+
+        // parts of the last computed output
+        T GetLastPPart() const {
+            return pPart_;
+        }
+
+        T GetLastIPart() const {
+            return outputSum_;
+        }
+
+        T GetLastDPart() const {
+            return dPart_;
+        }
+
+        T GetInputError() const {
+            return inputError_;
+        }
+
+        T GetDeltaInput() const {
+            return deltaInput_;
+        }
+
+    private:
+        static T clamp(const T value, const T min, const T max) {
+            return value > max ? max : value < min ? min : value;
+        }
+
+        void initialize() {
+            outputSum_ = pOnE_ ? clamp(clamp(*output_, iMin_, iMax_), outMin_, outMax_) : clamp(*output_, outMin_, outMax_);
+            lastInput_ = *input_;
+            smoothedDInput_ = 0;
+        }
+
+        T* input_;
+        T* output_;
+        T* setpoint_;
+
+        T dispKp_{};
+        T dispKi_{};
+        T dispKd_{};
+
+        T kp_{};
+        T ki_{};
+        T kd_{};
+
+        int direction_{DIRECT};
+        int pOn_{P_ON_E};
+        bool pOnE_{true};
+        bool inAuto_{false};
+
+        unsigned long lastTime_{};
+        unsigned long sampleTime_{100};
+
+        T outMin_{};
+        T outMax_{};
+        T iMin_{-std::numeric_limits<T>::infinity()};
+        T iMax_{std::numeric_limits<T>::infinity()};
+        T smoothingFactor_{};
+
+        T outputSum_{};
+        T lastInput_{};
+        T smoothedDInput_{};
+        T pPart_{};
+        T dPart_{};
+        T inputError_{};
+        T deltaInput_{};
+};
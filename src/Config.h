@@ -19,12 +19,18 @@
 
 class Config {
     public:
+        Config() :
+            _mutex(xSemaphoreCreateRecursiveMutex()) {
+        }
+
         /**
          * @brief Initialize the configuration system
          *
          * @return true if successful, false otherwise
          */
         bool begin() {
+            Lock lock(_mutex);
+
             if (!LittleFS.begin(true)) {
                 LOG(ERROR, "Failed to initialize LittleFS");
                 return false;
@@ -59,6 +65,8 @@ class Config {
          * @return true if successful, false otherwise
          */
         bool load() {
+            Lock lock(_mutex);
+
             if (!LittleFS.exists(CONFIG_FILE)) {
                 LOG(INFO, "Config file does not exist");
 
@@ -92,6 +100,14 @@ class Config {
          * @return true if successful, false otherwise
          */
         [[nodiscard]] bool save() const {
+            // serialize first so that readers in the control task are not held up by the file system
+            String json;
+
+            {
+                Lock lock(_mutex);
+                serializeJson(_doc, json);
+            }
+
             File file = LittleFS.open(CONFIG_FILE, "w");
 
             if (!file) {
@@ -99,7 +115,7 @@ class Config {
                 return false;
             }
 
-            if (serializeJson(_doc, file) == 0) {
+            if (file.print(json) != json.length()) {
                 LOG(ERROR, "Failed to write config to file");
                 file.close();
                 return false;
@@ -112,6 +128,7 @@ class Config {
         }
 
         bool validateAndApplyFromJson(const String& jsonString) {
+            Lock lock(_mutex);
             JsonDocument doc;
             const DeserializationError error = deserializeJson(doc, jsonString);
 
@@ -129,6 +146,8 @@ class Config {
 
         template <typename T>
         T get(const String& path) const {
+            Lock lock(_mutex);
+
             return navigatePath(path, [](JsonVariantConst parent, const String& leafKey) -> T {
                 if (leafKey.isEmpty() || parent.isNull()) {
                     return T{};
@@ -163,6 +182,8 @@ class Config {
 
         template <typename T>
         void set(const String& path, const T& value) {
+            Lock lock(_mutex);
+
             navigatePath(
                 path,
                 [&value](JsonVariant parent, const String& leafKey) {
@@ -174,6 +195,28 @@ class Config {
         }
 
     private:
+        /**
+         * @brief Holds the config mutex for the lifetime of the object, the config is accessed from the control task,
+         * the main loop, the web server and the MQTT task
+         */
+        class Lock {
+            public:
+                explicit Lock(const SemaphoreHandle_t mutex) :
+                    _mutex(mutex) {
+                    xSemaphoreTakeRecursive(_mutex, portMAX_DELAY);
+                }
+
+                ~Lock() {
+                    xSemaphoreGiveRecursive(_mutex);
+                }
+
+                Lock(const Lock&) = delete;
+                Lock& operator=(const Lock&) = delete;
+
+            private:
+                SemaphoreHandle_t _mutex;
+        };
+
         template <typename Func>
         static auto navigatePath(JsonVariantConst root, const String& path, Func&& leafHandler) {
             auto current = root;
@@ -229,6 +272,8 @@ class Config {
 
         JsonDocument _doc;
 
+        SemaphoreHandle_t _mutex;
+
         std::map<std::string, ConfigDef> _configDefs;
 
         void initializeConfigDefs() {
@@ -289,8 +334,20 @@ class Config {
             _configDefs.emplace("mqtt.username", ConfigDef::forString(MQTT_USERNAME, USERNAME_MAX_LENGTH));
             _configDefs.emplace("mqtt.password", ConfigDef::forString(MQTT_PASSWORD, PASSWORD_MAX_LENGTH));
             _configDefs.emplace("mqtt.topic", ConfigDef::forString(MQTT_TOPIC, MQTT_TOPIC_MAX_LENGTH));
+            _configDefs.emplace("mqtt.buffer.size", ConfigDef::forInt(MQTT_BUFFER_SIZE, 0, MQTT_BUFFER_SIZE_MAX));
+            _configDefs.emplace("mqtt.buffer.drop_policy", ConfigDef::forInt(0, 0, 1));
+            _configDefs.emplace("mqtt.publish_mode", ConfigDef::forInt(0, 0, 1));
+            _configDefs.emplace("mqtt.shot_telemetry.enabled", ConfigDef::forBool(false));
+            _configDefs.emplace("mqtt.shot_telemetry.rate", ConfigDef::forInt(MQTT_SHOT_TELEMETRY_RATE, MQTT_SHOT_TELEMETRY_RATE_MIN, MQTT_SHOT_TELEMETRY_RATE_MAX));
             _configDefs.emplace("mqtt.hassio.enabled", ConfigDef::forBool(false));
             _configDefs.emplace("mqtt.hassio.prefix", ConfigDef::forString(MQTT_HASSIO_PREFIX, MQTT_HASSIO_PREFIX_MAX_LENGTH));
+            _configDefs.emplace("mqtt.hassio.discovery_mode", ConfigDef::forInt(0, 0, 1));
+            _configDefs.emplace("mqtt.power.enabled", ConfigDef::forBool(false));
+            _configDefs.emplace("mqtt.power.topic", ConfigDef::forString(MQTT_POWER_TOPIC, MQTT_TOPIC_MAX_LENGTH));
+            _configDefs.emplace("mqtt.power.budget", ConfigDef::forInt(MQTT_POWER_BUDGET, MQTT_POWER_BUDGET_MIN, MQTT_POWER_BUDGET_MAX));
+            _configDefs.emplace("mqtt.power.heater_watts", ConfigDef::forInt(MQTT_POWER_HEATER_WATTS, MQTT_POWER_HEATER_WATTS_MIN, MQTT_POWER_HEATER_WATTS_MAX));
+            _configDefs.emplace("mqtt.power.priority", ConfigDef::forInt(MQTT_POWER_PRIORITY, MQTT_POWER_PRIORITY_MIN, MQTT_POWER_PRIORITY_MAX));
+            _configDefs.emplace("mqtt.power.fallback", ConfigDef::forInt(MQTT_POWER_FALLBACK, MQTT_POWER_FALLBACK_MIN, MQTT_POWER_FALLBACK_MAX));
 
             // System
             _configDefs.emplace("system.hostname", ConfigDef::forString(HOSTNAME, HOSTNAME_MAX_LENGTH));
@@ -304,6 +361,7 @@ class Config {
             // Debugging
             _configDefs.emplace("system.timing_debug.enabled", ConfigDef::forBool(false));
             _configDefs.emplace("system.showdisplay.enabled", ConfigDef::forBool(true));
+            _configDefs.emplace("system.route_stats.enabled", ConfigDef::forBool(false));
 
             // Display
             _configDefs.emplace("display.template", ConfigDef::forInt(0, 0, 4));
@@ -325,6 +383,7 @@ class Config {
 
             // Hardware - Relays
             _configDefs.emplace("hardware.relays.heater.trigger_type", ConfigDef::forInt(Relay::HIGH_TRIGGER, 0, 1));
+            _configDefs.emplace("hardware.relays.heater.modulation", ConfigDef::forInt(0, 0, 1));
             _configDefs.emplace("hardware.relays.valve.trigger_type", ConfigDef::forInt(Relay::HIGH_TRIGGER, 0, 1));
             _configDefs.emplace("hardware.relays.pump.trigger_type", ConfigDef::forInt(Relay::HIGH_TRIGGER, 0, 1));
 
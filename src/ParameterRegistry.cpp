@@ -9,42 +9,47 @@ ParameterRegistry ParameterRegistry::_singleton;
 // Global variables, needed for backwards compatibility
 extern bool pidON;
 extern bool usePonM;
-extern double aggKp;
-extern double aggTn;
-extern double aggTv;
-extern double aggIMax;
-extern double steamKp;
-extern double brewSetpoint;
-extern double brewTempOffset;
-extern double brewPidDelay;
+extern float aggKp;
+extern float aggTn;
+extern float aggTv;
+extern float aggIMax;
+extern float steamKp;
+extern float brewSetpoint;
+extern float brewTempOffset;
+extern float brewPidDelay;
 extern bool useBDPID;
-extern double aggbKp;
-extern double aggbTn;
-extern double aggbTv;
-extern double emaFactor;
-extern double steamSetpoint;
-extern double targetBrewTime;
-extern double preinfusion;
-extern double preinfusionPause;
+extern float aggbKp;
+extern float aggbTn;
+extern float aggbTv;
+extern float emaFactor;
+extern float steamSetpoint;
+extern float targetBrewTime;
+extern float preinfusion;
+extern float preinfusionPause;
 extern int backflushCycles;
-extern double backflushFillTime;
-extern double backflushFlushTime;
+extern float backflushFillTime;
+extern float backflushFlushTime;
 extern bool standbyModeOn;
 extern double standbyModeTime;
 extern bool featureFullscreenBrewTimer;
 extern bool featureFullscreenManualFlushTimer;
 extern bool featureFullscreenHotWaterTimer;
-extern double postBrewTimerDuration;
+extern float postBrewTimerDuration;
 extern bool featureHeatingLogo;
 extern bool steamON;
 extern bool backflushOn;
-extern double temperature;
+extern float temperature;
 extern bool scaleTareOn;
 extern bool scaleCalibrationOn;
 extern int logLevel;
+extern int heaterModulation;
 extern const char sysVersion[64];
 extern bool includeDisplayInLogs;
 extern bool timingDebugActive;
+extern bool authEnabled;
+extern bool routeStatsEnabled;
+extern String authUsername;
+extern String authPassword;
 
 const char* switchTypes[2] = {"Momentary", "Toggle"};
 const char* switchModes[2] = {"Normally Open", "Normally Closed"};
@@ -58,6 +63,10 @@ static constexpr const char* const logLevels[] = {"TRACE", "DEBUG", "INFO", "WAR
 static constexpr const char* const oledTypes[] = {"SH1106 (1.3\")", "SSD1306 (0.96\")"};
 static constexpr const char* const oledAddresses[] = {"0x3C", "0x3D"};
 static constexpr const char* const tempSensorTypes[] = {"TSIC306", "Dallas DS18B20"};
+static constexpr const char* const mqttDropPolicies[] = {"Drop oldest", "Drop newest"};
+static constexpr const char* const mqttPublishModes[] = {"Topic per value", "JSON state document"};
+static constexpr const char* const hassioDiscoveryModes[] = {"Config per entity", "Single device config"};
+static constexpr const char* const heaterModulations[] = {"Window", "Pulse density"};
 static constexpr const char* const scaleTypes[] = {"HX711 (2 load cell controllers)", "HX711 (1 load cell controller)", "Bluetooth"};
 
 void ParameterRegistry::initialize(Config& config) {
@@ -92,10 +101,10 @@ void ParameterRegistry::initialize(Config& config) {
         "Use PonM mode (<a href='http://brettbeauregard.com/blog/2017/06/introducing-proportional-on-measurement/' target='_blank'>details</a>)"
     );
 
-    addNumericConfigParam<double>(
+    addNumericConfigParam<float>(
         "pid.ema_factor",
         "PID EMA Factor",
-        kDouble,
+        kFloat,
         sPIDSection,
         111,
         &emaFactor,
@@ -104,10 +113,10 @@ void ParameterRegistry::initialize(Config& config) {
         "Smoothing of input that is used for Tv (derivative component of PID). Smaller means less smoothing but also less delay, 0 means no filtering"
     );
 
-    addNumericConfigParam<double>(
+    addNumericConfigParam<float>(
         "pid.regular.kp",
         "PID Kp",
-        kDouble,
+        kFloat,
         sPIDSection,
         112,
         &aggKp,
@@ -117,10 +126,10 @@ void ParameterRegistry::initialize(Config& config) {
         "output of the heater for a given temperature difference. E.g. 5°C difference will result in P*5 Watts of heater output."
     );
 
-    addNumericConfigParam<double>(
+    addNumericConfigParam<float>(
         "pid.regular.tn",
         "PID Tn (=Kp/Ki)",
-        kDouble,
+        kFloat,
         sPIDSection,
         113,
         &aggTn,
@@ -130,10 +139,10 @@ void ParameterRegistry::initialize(Config& config) {
         "integral part of the PID will increase (or decrease) if the process value remains above (or below) the setpoint in spite of proportional action. The smaller this value, the faster the integral term changes."
     );
 
-    addNumericConfigParam<double>(
+    addNumericConfigParam<float>(
         "pid.regular.tv",
         "PID Tv (=Kd/Kp)",
-        kDouble,
+        kFloat,
         sPIDSection,
         114,
         &aggTv,
@@ -143,10 +152,10 @@ void ParameterRegistry::initialize(Config& config) {
         "PID equation projects the current trend into the future. The higher the value, the greater the dampening. Select it carefully, it can cause oscillations if it is set too high or too low."
     );
 
-    addNumericConfigParam<double>(
+    addNumericConfigParam<float>(
         "pid.regular.i_max",
         "PID Integrator Max",
-        kDouble,
+        kFloat,
         sPIDSection,
         115,
         &aggIMax,
@@ -156,10 +165,10 @@ void ParameterRegistry::initialize(Config& config) {
         "setpoint has been reached and is depending on machine type and whether the boiler is insulated or not."
     );
 
-    addNumericConfigParam<double>(
+    addNumericConfigParam<float>(
         "pid.steam.kp",
         "Steam Kp",
-        kDouble,
+        kFloat,
         sPIDSection,
         116,
         &steamKp,
@@ -169,10 +178,10 @@ void ParameterRegistry::initialize(Config& config) {
     );
 
     // Temperature Section
-    addNumericConfigParam<double>(
+    addNumericConfigParam<float>(
         "TEMP",
         "Temperature",
-        kDouble,
+        kFloat,
         sTempSection,
         200,
         &temperature,
@@ -182,10 +191,10 @@ void ParameterRegistry::initialize(Config& config) {
         [] { return false; }
     );
 
-    addNumericConfigParam<double>(
+    addNumericConfigParam<float>(
         "brew.setpoint",
         "Setpoint (°C)",
-        kDouble,
+        kFloat,
         sTempSection,
         201,
         &brewSetpoint,
@@ -194,10 +203,10 @@ void ParameterRegistry::initialize(Config& config) {
         "The temperature that the PID will attempt to reach and hold"
     );
 
-    addNumericConfigParam<double>(
+    addNumericConfigParam<float>(
         "brew.temp_offset",
         "Offset (°C)",
-        kDouble,
+        kFloat,
         sTempSection,
         202,
         &brewTempOffset,
@@ -206,10 +215,10 @@ void ParameterRegistry::initialize(Config& config) {
         "Optional offset that is added to the user-visible setpoint. Can be used to compensate sensor offsets and the average temperature loss between boiler and group so that the setpoint represents the approximate brew temperature."
     );
 
-    addNumericConfigParam<double>(
+    addNumericConfigParam<float>(
         "steam.setpoint",
         "Steam Setpoint (°C)",
-        kDouble,
+        kFloat,
         sTempSection,
         203,
         &steamSetpoint,
@@ -241,10 +250,10 @@ void ParameterRegistry::initialize(Config& config) {
             [&config] { return config.get<int>("brew.mode") == 1; }
         );
 
-        addNumericConfigParam<double>(
+        addNumericConfigParam<float>(
             "brew.by_time.target_time",
             "Target Brew Time (s)",
-            kDouble,
+            kFloat,
             sBrewSection,
             312,
             &targetBrewTime,
@@ -298,10 +307,10 @@ void ParameterRegistry::initialize(Config& config) {
             "Enables pre-wetting of the coffee puck by turning on the pump for a configurable length of time."
         );
 
-        addNumericConfigParam<double>(
+        addNumericConfigParam<float>(
             "brew.pre_infusion.time",
             "Pre-infusion Time (s)",
-            kDouble,
+            kFloat,
             sBrewSection,
             332,
             &preinfusion,
@@ -310,10 +319,10 @@ void ParameterRegistry::initialize(Config& config) {
             "Time in seconds the pump is running during the pre-infusion"
         );
 
-        addNumericConfigParam<double>(
+        addNumericConfigParam<float>(
             "brew.pre_infusion.pause",
             "Pre-infusion Pause Time (s)",
-            kDouble,
+            kFloat,
             sBrewSection,
             333,
             &preinfusionPause,
@@ -335,10 +344,10 @@ void ParameterRegistry::initialize(Config& config) {
             "Number of cycles of filling and flushing during a backflush"
         );
 
-        addNumericConfigParam<double>(
+        addNumericConfigParam<float>(
             "backflush.fill_time",
             "Backflush Fill Time (s)",
-            kDouble,
+            kFloat,
             sMaintenanceSection,
             402,
             &backflushFillTime,
@@ -347,10 +356,10 @@ void ParameterRegistry::initialize(Config& config) {
             "Time in seconds the pump is running during one backflush cycle"
         );
 
-        addNumericConfigParam<double>(
+        addNumericConfigParam<float>(
             "backflush.flush_time",
             "Backflush Flush Time (s)",
-            kDouble,
+            kFloat,
             sMaintenanceSection,
             403,
             &backflushFlushTime,
@@ -409,10 +418,10 @@ void ParameterRegistry::initialize(Config& config) {
             "Use separate PID parameters while brew is running"
         );
 
-        addNumericConfigParam<double>(
+        addNumericConfigParam<float>(
             "brew.pid_delay",
             "Brew PID Delay (s)",
-            kDouble,
+            kFloat,
             sBrewPidSection,
             711,
             &brewPidDelay,
@@ -421,10 +430,10 @@ void ParameterRegistry::initialize(Config& config) {
             "Delay time in seconds during which the PID will be disabled once a brew is detected. This prevents too high brew temperatures with boiler machines like Rancilio Silvia. Set to 0 for thermoblock machines."
         );
 
-        addNumericConfigParam<double>(
+        addNumericConfigParam<float>(
             "pid.bd.kp",
             "BD Kp",
-            kDouble,
+            kFloat,
             sBrewPidSection,
             712,
             &aggbKp,
@@ -433,10 +442,10 @@ void ParameterRegistry::initialize(Config& config) {
             "Proportional gain (in Watts/°C) for the PID when brewing has been detected. Use this controller to either increase heating during the brew to counter temperature drop from fresh cold water in the boiler. Some machines, e.g. Rancilio Silvia, actually need to heat less or not at all during the brew because of high temperature stability (<a href='https://www.kaffee-netz.de/threads/installation-eines-temperatursensors-in-silvia-bruehgruppe.111093/#post-1453641' target='_blank'>Details<a>)"
         );
 
-        addNumericConfigParam<double>(
+        addNumericConfigParam<float>(
             "pid.bd.tn",
             "BD Tn (=Kp/Ki)",
-            kDouble,
+            kFloat,
             sBrewPidSection,
             713,
             &aggbTn,
@@ -445,10 +454,10 @@ void ParameterRegistry::initialize(Config& config) {
             "Integral time constant (in seconds) for the PID when brewing has been detected."
         );
 
-        addNumericConfigParam<double>(
+        addNumericConfigParam<float>(
             "pid.bd.tv",
             "BD Tv (=Kd/Kp)",
-            kDouble,
+            kFloat,
             sBrewPidSection,
             714,
             &aggbTv,
@@ -598,7 +607,7 @@ void ParameterRegistry::initialize(Config& config) {
     addNumericConfigParam(
         "display.post_brew_timer_duration",
         "Post Brew Timer Duration (s)",
-        kDouble,
+        kFloat,
         sDisplaySection,
         908,
         &postBrewTimerDuration,
@@ -713,6 +722,71 @@ void ParameterRegistry::initialize(Config& config) {
         true
     );
 
+    addNumericConfigParam<int>(
+        "mqtt.buffer.size",
+        "Offline Buffer Size",
+        kInteger,
+        sMqttSection,
+        1016,
+        nullptr,
+        0,
+        MQTT_BUFFER_SIZE_MAX,
+        "Bytes of messages kept while the broker is unreachable, sent once the connection is back. 0 disables the buffer",
+        [] { return true; },
+        true
+    );
+
+    addEnumConfigParam(
+        "mqtt.buffer.drop_policy",
+        "Offline Buffer Drop Policy",
+        sMqttSection,
+        1017,
+        nullptr,
+        mqttDropPolicies,
+        2,
+        "Which messages to give up when the offline buffer is full. Only the latest value of each topic is buffered either way",
+        [] { return true; },
+        true
+    );
+
+    addEnumConfigParam(
+        "mqtt.publish_mode",
+        "Publish Mode",
+        sMqttSection,
+        1018,
+        nullptr,
+        mqttPublishModes,
+        2,
+        "Publish each value to its own topic, or all values as one JSON document to the topic 'state'. Setting values through the '/set' topics works in both modes",
+        [] { return true; },
+        true
+    );
+
+    addBoolConfigParam(
+        "mqtt.shot_telemetry.enabled",
+        "Shot Telemetry",
+        sMqttSection,
+        1019,
+        nullptr,
+        "Record every shot at a high rate and publish the samples in batches to 'shot/samples', followed by a summary on 'shot/summary'",
+        [] { return true; },
+        true
+    );
+
+    addNumericConfigParam<int>(
+        "mqtt.shot_telemetry.rate",
+        "Shot Telemetry Rate (Hz)",
+        kInteger,
+        sMqttSection,
+        1020,
+        nullptr,
+        MQTT_SHOT_TELEMETRY_RATE_MIN,
+        MQTT_SHOT_TELEMETRY_RATE_MAX,
+        "Samples per second recorded during a shot",
+        [] { return true; },
+        true
+    );
+
     addBoolConfigParam(
         "mqtt.hassio.enabled",
         "Hass.io enabled",
@@ -736,6 +810,99 @@ void ParameterRegistry::initialize(Config& config) {
         true
     );
 
+    addEnumConfigParam(
+        "mqtt.hassio.discovery_mode",
+        "Hass.io Discovery Mode",
+        sMqttSection,
+        1023,
+        nullptr,
+        hassioDiscoveryModes,
+        2,
+        "Announce each entity separately, or the whole machine in one device message that is only sent when it changes (requires Home Assistant 2024.11 or newer)",
+        [] { return true; },
+        true
+    );
+
+    addBoolConfigParam(
+        "mqtt.power.enabled",
+        "Power Coordination",
+        sMqttSection,
+        1024,
+        nullptr,
+        "Share a power budget with other machines on the same circuit, so that heating up together doesn't trip the breaker. "
+        "All machines have to use the same broker, power topic and budget",
+        [] { return true; },
+        true
+    );
+
+    addStringConfigParam(
+        "mqtt.power.topic",
+        "Power Topic Prefix",
+        sMqttSection,
+        1025,
+        nullptr,
+        MQTT_TOPIC_MAX_LENGTH,
+        "Topic prefix shared by all coordinating machines, each one publishes its heater demand to '<prefix><hostname>'",
+        [] { return true; },
+        true
+    );
+
+    addNumericConfigParam<int>(
+        "mqtt.power.budget",
+        "Power Budget (W)",
+        kInteger,
+        sMqttSection,
+        1026,
+        nullptr,
+        MQTT_POWER_BUDGET_MIN,
+        MQTT_POWER_BUDGET_MAX,
+        "Heater power all coordinating machines may draw together",
+        [] { return true; },
+        true
+    );
+
+    addNumericConfigParam<int>(
+        "mqtt.power.heater_watts",
+        "Heater Power (W)",
+        kInteger,
+        sMqttSection,
+        1027,
+        nullptr,
+        MQTT_POWER_HEATER_WATTS_MIN,
+        MQTT_POWER_HEATER_WATTS_MAX,
+        "Rated power of this machine's heater",
+        [] { return true; },
+        true
+    );
+
+    addNumericConfigParam<int>(
+        "mqtt.power.priority",
+        "Power Priority",
+        kInteger,
+        sMqttSection,
+        1028,
+        nullptr,
+        MQTT_POWER_PRIORITY_MIN,
+        MQTT_POWER_PRIORITY_MAX,
+        "Machines with a higher priority get their heater power first, machines with the same priority share evenly",
+        [] { return true; },
+        true
+    );
+
+    addNumericConfigParam<int>(
+        "mqtt.power.fallback",
+        "Power Fallback (%)",
+        kInteger,
+        sMqttSection,
+        1029,
+        nullptr,
+        MQTT_POWER_FALLBACK_MIN,
+        MQTT_POWER_FALLBACK_MAX,
+        "Heater duty limit while the broker is unreachable or the other machines haven't been heard from yet",
+        [] { return true; },
+        true
+    );
+
     addStringConfigParam(
         "system.hostname",
         "Hostname",
@@ -776,7 +943,7 @@ void ParameterRegistry::initialize(Config& config) {
         "Enable Website Authentication",
         sSystemSection,
         1201,
-        nullptr,
+        &authEnabled,
         "Enables authentication for accessing certain parts of the website and for web requests in general. "
             "This setting secures the calls to sensitive url endpoints, e.g. for config parameters, hardware settings, factory reset, etc."
     );
@@ -786,7 +953,7 @@ void ParameterRegistry::initialize(Config& config) {
         "Website Username",
         sSystemSection,
         1202,
-        nullptr,
+        &authUsername,
         USERNAME_MAX_LENGTH,
         "Username for accessing the website and authenticating web requests"
     );
@@ -796,7 +963,7 @@ void ParameterRegistry::initialize(Config& config) {
         "Website Password",
         sSystemSection,
         1203,
-        nullptr,
+        &authPassword,
         PASSWORD_MAX_LENGTH,
         "Password for accessing the website and authenticating web requests"
     );
@@ -837,6 +1004,16 @@ void ParameterRegistry::initialize(Config& config) {
         [&config] { return config.get<int>("system.log_level") == static_cast<int>(Logger::Level::DEBUG); }
     );
 
+    addBoolConfigParam(
+        "system.route_stats.enabled",
+        "Record webserver route statistics",
+        sSystemSection,
+        1304,
+        &routeStatsEnabled,
+        "Record request count, latency, response size and free heap per webserver route. "
+        "The statistics are available at /diagnostics/routes and can be cleared with a POST to /diagnostics/routes/reset"
+    );
+
     // Hardware section
 
     // OLED
@@ -917,6 +1094,17 @@ void ParameterRegistry::initialize(Config& config) {
         true
     );
 
+    addEnumConfigParam(
+        "hardware.relays.heater.modulation",
+        "Heater Modulation",
+        sHardwareRelaySection,
+        2104,
+        &heaterModulation,
+        heaterModulations,
+        2,
+        "Window switches the heater on once per second for the PID's share of that second. Pulse density spreads the same on-time evenly in 10 ms steps, which reduces the temperature ripple of small boilers. Only use pulse density with solid state relays."
+    );
+
     // Switches
     addBoolConfigParam(
         "hardware.switches.brew.enabled",
@@ -26,18 +26,18 @@ inline uint8_t currReadingBrewSwitch = LOW;
 inline bool brewSwitchWasOff = false;
 
 // Brew values
-inline double targetBrewTime = TARGET_BREW_TIME;          // brew time in s
-inline double preinfusion = PRE_INFUSION_TIME;            // preinfusion time in s
-inline double preinfusionPause = PRE_INFUSION_PAUSE_TIME; // preinfusion pause time in s
-inline double totalTargetBrewTime = 0;                    // total target brew time including preinfusion and preinfusion pause
-inline double currBrewTime = 0;                           // current running total brewed time
+inline float targetBrewTime = TARGET_BREW_TIME;          // brew time in s
+inline float preinfusion = PRE_INFUSION_TIME;            // preinfusion time in s
+inline float preinfusionPause = PRE_INFUSION_PAUSE_TIME; // preinfusion pause time in s
+inline float totalTargetBrewTime = 0;                    // total target brew time including preinfusion and preinfusion pause
+inline float currBrewTime = 0;                           // current running total brewed time
 inline unsigned long startingTime = 0;                    // start time of brew
 inline bool brewPidDisabled = false;                      // is PID disabled for delay after brew has started?
 
 // Backflush values
 inline int backflushCycles = BACKFLUSH_CYCLES;
-inline double backflushFillTime = BACKFLUSH_FILL_TIME;
-inline double backflushFlushTime = BACKFLUSH_FLUSH_TIME;
+inline float backflushFillTime = BACKFLUSH_FILL_TIME;
+inline float backflushFlushTime = BACKFLUSH_FLUSH_TIME;
 inline bool backflushOn = false;
 inline int currBackflushCycles = 1;
 
@@ -0,0 +1,85 @@
+/**
+ * @file controlTask.h
+ *
+ * @brief Runs temperature control and the machine state at a fixed period in its own task
+ *
+ * The control task is pinned to the application core with a higher priority than loop(), which keeps networking,
+ * scale, pressure and the display. WiFi and the async webserver run on the other core. Both sides share the globals
+ * of the machine, loop() holds a ControlLock whenever it reads or changes them. The webserver hands its toggles to the
+ * control task through a queue, see processWebCommands(), and holds the lock while it applies parameter changes.
+ */
+
+#pragma once
+
+#include "utils/PeriodicTaskStats.h"
+
+constexpr uint32_t CONTROL_TASK_PERIOD_MS = 10;
+constexpr uint32_t CONTROL_TASK_STACK_SIZE = 8192;
+constexpr UBaseType_t CONTROL_TASK_PRIORITY = 3;
+constexpr BaseType_t CONTROL_TASK_CORE = 1;
+
+void loopControl();
+
+inline TaskHandle_t controlTaskHandle = nullptr;
+inline SemaphoreHandle_t controlMutex = nullptr;
+
+// start time jitter and execution time of the control task
+inline PeriodicTaskStats controlStats;
+
+// display power save state wanted by the control task, -1 if unchanged, the display itself is only accessed from loop()
+inline int8_t displayPowerSaveRequest = -1;
+
+/**
+ * @brief Holds the control mutex for the lifetime of the object, does nothing before the control task is started
+ */
+class ControlLock {
+    public:
+        ControlLock() {
+            if (controlMutex != nullptr) {
+                xSemaphoreTake(controlMutex, portMAX_DELAY);
+            }
+        }
+
+        ~ControlLock() {
+            if (controlMutex != nullptr) {
+                xSemaphoreGive(controlMutex);
+            }
+        }
+
+        ControlLock(const ControlLock&) = delete;
+        ControlLock& operator=(const ControlLock&) = delete;
+};
+
+inline void requestDisplayPowerSave(const bool enabled) {
+    displayPowerSaveRequest = enabled ? 1 : 0;
+}
+
+inline void controlTask(void*) {
+    const uint32_t periodMicros = CONTROL_TASK_PERIOD_MS * 1000;
+    TickType_t lastWakeTime = xTaskGetTickCount();
+    uint32_t scheduledStart = micros();
+
+    controlStats.begin(periodMicros);
+
+    for (;;) {
+        // a run that took longer than the period is followed right away by the next one, the schedule is kept
+        vTaskDelayUntil(&lastWakeTime, pdMS_TO_TICKS(CONTROL_TASK_PERIOD_MS));
+        scheduledStart += periodMicros;
+
+        ControlLock lock;
+        const uint32_t start = micros();
+
+        loopControl();
+
+        controlStats.record(static_cast<int32_t>(start - scheduledStart), micros() - start);
+    }
+}
+
+/**
+ * @brief Create the control mutex and start the control task, called at the end of setup()
+ */
+inline void startControlTask() {
+    controlMutex = xSemaphoreCreateMutex();
+
+    xTaskCreatePinnedToCore(controlTask, "control", CONTROL_TASK_STACK_SIZE, nullptr, CONTROL_TASK_PRIORITY, &controlTaskHandle, CONTROL_TASK_CORE);
+}
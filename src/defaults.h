@@ -47,6 +47,13 @@
 #define MQTT_PASSWORD            "silvia"          // default MQTT password
 #define MQTT_TOPIC               "custom/kitchen/" // default MQTT topic prefix
 #define MQTT_HASSIO_PREFIX       "homeassistant"   // default MQTT prefix for Home Assistant
+#define MQTT_BUFFER_SIZE         4096              // bytes of MQTT messages kept while the broker is unreachable
+#define MQTT_SHOT_TELEMETRY_RATE 10                // shot telemetry samples per second
+#define MQTT_POWER_TOPIC         "coffee/power/"   // topic prefix shared by all machines coordinating their heater power
+#define MQTT_POWER_BUDGET        3000              // W available to the heaters of all coordinating machines
+#define MQTT_POWER_HEATER_WATTS  1200              // W of the heater at full duty
+#define MQTT_POWER_PRIORITY      5                 // machines with higher priority get their heater power first
+#define MQTT_POWER_FALLBACK      25                // % heater duty while the power can't be coordinated
 #define SCREEN_WIDTH             128               // OLED display width, in pixels
 #define SCREEN_HEIGHT            64                // OLED display height, in pixels
 #define AUTH_PASSWORD            "admin"           // default password for web authentication
@@ -109,4 +116,15 @@
 #define PASSWORD_MAX_LENGTH           64
 #define MQTT_TOPIC_MAX_LENGTH         48
 #define MQTT_HASSIO_PREFIX_MAX_LENGTH 24
+#define MQTT_BUFFER_SIZE_MAX          16384
+#define MQTT_SHOT_TELEMETRY_RATE_MIN  10
+#define MQTT_SHOT_TELEMETRY_RATE_MAX  20
+#define MQTT_POWER_BUDGET_MIN         100
+#define MQTT_POWER_BUDGET_MAX         20000
+#define MQTT_POWER_HEATER_WATTS_MIN   100
+#define MQTT_POWER_HEATER_WATTS_MAX   5000
+#define MQTT_POWER_PRIORITY_MIN       0
+#define MQTT_POWER_PRIORITY_MAX       9
+#define MQTT_POWER_FALLBACK_MIN       0
+#define MQTT_POWER_FALLBACK_MAX       100
 #define HOSTNAME_MAX_LENGTH           64
@@ -9,6 +9,8 @@
 
 #include <Arduino.h>
 
+#include <memory>
+
 #include "FS.h"
 #include <AsyncTCP.h>
 #include <WiFi.h>
@@ -18,6 +20,12 @@
 #include <ESPAsyncWebServer.h>
 
 #include "LittleFS.h"
+#include "utils/AssetBundle.h"
+#include "utils/GzipStream.h"
+#include "utils/MqttStats.h"
+#include "utils/ResponseWriter.h"
+#include "utils/RouteStats.h"
+#include "webSession.h"
 
 inline AsyncWebServer server(80);
 inline AsyncEventSource events("/events");
@@ -26,40 +34,186 @@ inline double curTemp = 0.0;
 inline double tTemp = 0.0;
 inline double hPower = 0.0;
 
+#define GZIP_MIN_RESPONSE_SIZE 1024 // smaller responses are not worth the CPU time and RAM of the encoder
+
 #define HISTORY_LENGTH 600 // 20 mins of values (30 vals/min * 20 min) = 600 (3.6kb)
 
 static int16_t tempHistory[3][HISTORY_LENGTH] = {};
 inline int historyCurrentIndex = 0;
 inline int historyValueCount = 0;
 
+inline AssetBundle assetBundle;
+
+// Only accessed from the webserver task: set while /update/assets rewrites the partition, and the number of responses still reading from the mapped bundle
+inline bool assetBundleUpdating = false;
+inline int assetResponsesInFlight = 0;
+
+// Served as start page if neither the asset partition nor the file system holds the web interface
+inline constexpr char assetFallbackPage[] =
+    R"(<!DOCTYPE html><html><head><meta charset="utf-8"><meta name="viewport" content="width=device-width"><title>CleverCoffee</title></head><body>)"
+    R"(<h1>Web interface not installed</h1><p>The asset partition holds no valid web interface bundle. Upload assets.bin from the release or the build directory:</p>)"
+    R"(<form method="POST" action="/update/assets" enctype="multipart/form-data"><input type="file" name="file" accept=".bin"> <button>Upload</button></form>)"
+    R"(<p>The machine restarts once the bundle has been written. Machines that were only updated over the network still have the old partition table without an asset partition, )"
+    R"(it has to be flashed over USB first. Flashing the new partition table erases the configuration, <a href="/download/config">download the configuration</a> before.</p></body></html>)";
+
+// per-route statistics, toggled at runtime via system.route_stats.enabled
+inline RouteStats routeStats;
+inline bool routeStatsEnabled = false;
+
+// MQTT throughput and timing, recorded by the MQTT task and the control loop
+inline MqttStats mqttStats;
+
+/**
+ * @brief Machine state changes requested from the web interface, applied by the control loop
+ */
+enum WebCommand : uint8_t {
+    kWebToggleSteam,
+    kWebTogglePid,
+    kWebToggleBackflush
+};
+
+constexpr size_t WEB_COMMAND_QUEUE_LENGTH = 4;
+
+inline QueueHandle_t webCommandQueue = nullptr;
+
 void serverSetup();
 
 inline bool authenticate(AsyncWebServerRequest* request) {
-    if (!config.get<bool>("system.auth.enabled")) {
+    if (!authEnabled) {
         return true;
     }
 
-    const auto clientIP = request->client()->remoteIP().toString();
-    const auto requestedPath = request->url();
-    const auto username = config.get<String>("system.auth.username");
-    const auto password = config.get<String>("system.auth.password");
+    if (hasValidSession(request)) {
+        return true;
+    }
 
-    if (request->authenticate(username.c_str(), password.c_str())) {
-        LOGF(DEBUG, "Web auth OK: %s -> %s", clientIP.c_str(), requestedPath.c_str());
+    // fall back to basic auth, e.g. for scripts and API clients that don't keep cookies
+    // (the log arguments are only evaluated if the respective level is active)
+    if (request->authenticate(authUsername.c_str(), authPassword.c_str())) {
+        LOGF(DEBUG, "Web auth OK: %s -> %s", request->client()->remoteIP().toString().c_str(), request->url().c_str());
 
         return true;
     }
 
     if (request->hasHeader("Authorization")) {
-        LOGF(WARNING, "Web auth FAIL: %s -> %s (wrong credentials)", clientIP.c_str(), requestedPath.c_str());
+        LOGF(WARNING, "Web auth FAIL: %s -> %s (wrong credentials)", request->client()->remoteIP().toString().c_str(), request->url().c_str());
     }
     else {
-        LOGF(DEBUG, "Web auth required: %s -> %s", clientIP.c_str(), requestedPath.c_str());
+        LOGF(DEBUG, "Web auth required: %s -> %s", request->client()->remoteIP().toString().c_str(), request->url().c_str());
     }
 
     return false;
 }
 
+/**
+ * @brief Response stream that accounts the written body to the route being handled
+ */
+class MeteredResponseStream : public AsyncResponseStream {
+    public:
+        static constexpr size_t BUFFER_SIZE = 1460; // one TCP segment, same as beginResponseStream()
+
+        explicit MeteredResponseStream(const char* contentType) :
+            AsyncResponseStream(contentType, BUFFER_SIZE) {
+        }
+
+        size_t write(const uint8_t* data, const size_t len) override {
+            const size_t written = AsyncResponseStream::write(data, len);
+            routeStats.addBytes(written);
+
+            return written;
+        }
+
+        size_t write(const uint8_t data) override {
+            return write(&data, 1);
+        }
+
+        using Print::write;
+};
+
+/**
+ * @brief Wrap a request handler so that its latency, response size and heap usage are recorded for the route
+ * @details Costs a single flag check while the statistics are disabled
+ *
+ * @param uri Route the handler is registered for, has to stay valid (string literal)
+ * @param handler Handler to wrap
+ */
+inline ArRequestHandlerFunction instrumented(const char* uri, ArRequestHandlerFunction handler) {
+    RouteStats::Route* route = routeStats.add(uri);
+
+    if (route == nullptr) {
+        LOGF(WARNING, "No statistics slot left for route %s", uri);
+        return handler;
+    }
+
+    return [route, handler](AsyncWebServerRequest* request) {
+        if (!routeStatsEnabled) {
+            handler(request);
+            return;
+        }
+
+        const uint32_t heapBefore = ESP.getFreeHeap();
+        routeStats.begin(route);
+
+        const int64_t start = esp_timer_get_time();
+        handler(request);
+        const auto elapsed = static_cast<uint32_t>(esp_timer_get_time() - start);
+
+        // streamed responses are still buffered at this point, so this is close to the peak usage of the request
+        routeStats.end(elapsed, min(heapBefore, ESP.getFreeHeap()));
+    };
+}
+
+/**
+ * @brief Register an instrumented route on the webserver
+ */
+inline AsyncCallbackWebHandler& onRoute(const char* uri, const WebRequestMethodComposite method, ArRequestHandlerFunction handler) {
+    return server.on(uri, method, instrumented(uri, std::move(handler)));
+}
+
+/**
+ * @brief Register an instrumented route with an upload handler, only the final request handler is measured
+ */
+inline AsyncCallbackWebHandler& onRoute(const char* uri, const WebRequestMethodComposite method, ArRequestHandlerFunction handler, ArUploadHandlerFunction upload) {
+    return server.on(uri, method, instrumented(uri, std::move(handler)), std::move(upload));
+}
+
+/**
+ * @brief Start a streamed API response in the encoding requested by the client's Accept header
+ */
+inline AsyncResponseStream* beginApiResponse(AsyncWebServerRequest* request, ResponseWriter::Format& format) {
+    const AsyncWebHeader* accept = request->getHeader("Accept");
+    format = accept != nullptr ? ResponseWriter::negotiate(accept->value()) : ResponseWriter::JSON;
+
+    AsyncResponseStream* response = new MeteredResponseStream(ResponseWriter::contentType(format));
+    response->addHeader("Vary", "Accept, Accept-Encoding");
+
+    return response;
+}
+
+/**
+ * @brief Compress a streamed response if the client accepts gzip and the expected payload is large enough
+ *
+ * @param request Request to answer
+ * @param response Response stream receiving the compressed data
+ * @param expectedSize Estimated size of the uncompressed body
+ * @return Encoder the body has to be written to (finish() it before sending), nullptr to send the body uncompressed
+ */
+inline std::unique_ptr<GzipStream> beginCompression(AsyncWebServerRequest* request, AsyncResponseStream* response, const size_t expectedSize) {
+    if (expectedSize < GZIP_MIN_RESPONSE_SIZE) {
+        return nullptr;
+    }
+
+    const AsyncWebHeader* acceptEncoding = request->getHeader("Accept-Encoding");
+
+    if (acceptEncoding == nullptr || acceptEncoding->value().indexOf("gzip") < 0) {
+        return nullptr;
+    }
+
+    response->addHeader("Content-Encoding", "gzip");
+
+    return std::make_unique<GzipStream>(*response);
+}
+
 inline uint8_t flipUintValue(const uint8_t value) {
     return (value + 3) % 2;
 }
@@ -162,79 +316,254 @@ inline void paramToJson(const String& name, const std::shared_ptr<Parameter>& pa
     doc["max"] = param->getMaxValue();
 }
 
-inline String staticProcessor(const String& var) {
-    // try replacing var for variables in ParameterRegistry
-    if (var.startsWith("VAR_SHOW_")) {
-        return getValue(var.substring(9)); // cut off "VAR_SHOW_"
-    }
+inline const char* assetContentType(const String& path) {
+    if (path.endsWith(".html")) return "text/html";
+    if (path.endsWith(".css")) return "text/css";
+    if (path.endsWith(".js")) return "application/javascript";
+    if (path.endsWith(".json")) return "application/json";
+    if (path.endsWith(".png")) return "image/png";
+    if (path.endsWith(".svg")) return "image/svg+xml";
+    if (path.endsWith(".ico")) return "image/x-icon";
+    if (path.endsWith(".woff2")) return "font/woff2";
+
+    return "application/octet-stream";
+}
+
+/**
+ * @brief Serves the web interface straight from the memory-mapped asset bundle
+ * @details Files are sent from mapped flash without going through the file system, the content hash from the
+ * bundle index is used as ETag so unchanged files are answered with 304. Without a mapped bundle, requests that
+ * no route handles are answered with 503 while a new bundle is uploaded. Otherwise they are served from the
+ * file system, where partition tables without an asset partition keep the web interface, and the start page
+ * falls back to a page offering the upload and the configuration download.
+ */
+class AssetBundleHandler : public AsyncWebHandler {
+    public:
+        bool canHandle(AsyncWebServerRequest* request) const override {
+            if (!(request->method() & (HTTP_GET | HTTP_HEAD))) {
+                return false;
+            }
+
+            if (!assetBundle.isValid()) {
+                return true;
+            }
+
+            AssetBundle::Asset asset;
+
+            return assetBundle.find(assetPath(request).c_str(), asset);
+        }
+
+        void handleRequest(AsyncWebServerRequest* request) override {
+            const String path = assetPath(request);
+            AssetBundle::Asset asset;
+
+            if (assetBundleUpdating) {
+                AsyncWebServerResponse* response = request->beginResponse(503, "text/plain", "Web interface is being updated");
+                response->addHeader("Retry-After", "10");
+                request->send(response);
+                return;
+            }
+
+            if (!assetBundle.isValid()) {
+                sendFileSystemAsset(request, path);
+                return;
+            }
+
+            if (!assetBundle.find(path.c_str(), asset)) {
+                request->send(404, "text/plain", "Not found");
+                return;
+            }
+
+            char etag[AssetBundle::HASH_SIZE * 2 + 3] = "\"";
+
+            for (size_t i = 0; i < AssetBundle::HASH_SIZE; i++) {
+                snprintf(etag + 1 + i * 2, 3, "%02x", asset.hash[i]);
+            }
+
+            strcat(etag, "\"");
+
+            AsyncWebServerResponse* response;
+
+            if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == etag) {
+                response = request->beginResponse(304);
+            }
+            else {
+                response = request->beginResponse(200, assetContentType(path), asset.data, asset.length);
+
+                if (asset.gzip) {
+                    response->addHeader("Content-Encoding", "gzip");
+                }
 
-    // var didn't start with above names, try opening var as fragment file and use contents if it exists
-    // TODO: this seems to consume too much heap in some cases, probably better to remove fragment loading and only use one SPA in the long term (or only support ESP32 which has more RAM)
-    String varLower(var);
-    varLower.toLowerCase();
+                // the response reads from the mapping until the request is gone, the bundle can't be replaced before
+                assetResponsesInFlight++;
+                request->onDisconnect([] { assetResponsesInFlight--; });
+            }
+
+            response->addHeader("Cache-Control", "max-age=604800"); // cache for one week
+            response->addHeader("ETag", etag);
+            request->send(response);
+        }
+
+        bool isRequestHandlerTrivial() const override {
+            return true;
+        }
+
+    private:
+        // the file system also holds the configuration, only the web interface directories are served from it
+        static bool isFileSystemAsset(const String& path) {
+            if (path.indexOf("..") >= 0) {
+                return false;
+            }
+
+            return path.startsWith("/css/") || path.startsWith("/js/") || path.startsWith("/img/") || path.startsWith("/webfonts/") || path == "/manifest.json";
+        }
+
+        static void sendFileSystemAsset(AsyncWebServerRequest* request, const String& path) {
+            // pages are only served prerendered, plain html files left by older releases still hold template placeholders
+            const bool page = path.endsWith(".html") && path.indexOf('/', 1) < 0;
+            const String file = page ? "/html" + path : path;
+            AsyncWebServerResponse* response = nullptr;
+
+            if (page || isFileSystemAsset(path)) {
+                if (LittleFS.exists(file + ".gz")) {
+                    response = request->beginResponse(LittleFS, file + ".gz", assetContentType(path));
+                    response->addHeader("Content-Encoding", "gzip");
+                }
+                else if (!page && LittleFS.exists(file)) {
+                    response = request->beginResponse(LittleFS, file, assetContentType(path));
+                }
+            }
 
-    if (File file = LittleFS.open("/html_fragments/" + varLower + ".html", "r")) {
-        if (file.size() * 2 < ESP.getFreeHeap()) {
-            String ret = file.readString();
-            file.close();
-            return ret;
+            if (response == nullptr) {
+                if (path == "/index.html") {
+                    request->send(200, "text/html", assetFallbackPage);
+                }
+                else {
+                    request->send(404, "text/plain", "Not found");
+                }
+
+                return;
+            }
+
+            response->addHeader("Cache-Control", "max-age=604800"); // cache for one week
+            request->send(response);
         }
 
-        LOGF(DEBUG, "Can't open file %s, not enough memory available", file.name());
+        static String assetPath(AsyncWebServerRequest* request) {
+            String path = request->url();
+
+            if (path.endsWith("/")) {
+                path += "index.html";
+            }
+
+            return path;
+        }
+};
+
+/**
+ * @brief Hand a machine state change to the control loop, the webserver task never changes it directly
+ */
+inline void postWebCommand(const WebCommand command) {
+    if (xQueueSend(webCommandQueue, &command, 0) != pdTRUE) {
+        LOGF(WARNING, "Web command queue full, dropping command %d", command);
     }
-    else {
-        LOGF(DEBUG, "Fragment %s not found", varLower.c_str());
+}
+
+/**
+ * @brief Apply the state changes requested from the web interface, called from the control loop
+ */
+inline void processWebCommands() {
+    if (webCommandQueue == nullptr) {
+        return;
     }
 
-    // didn't find a value for the var, replace var with empty string
-    return {};
+    WebCommand command;
+
+    while (xQueueReceive(webCommandQueue, &command, 0) == pdTRUE) {
+        switch (command) {
+            case kWebToggleSteam:
+                setSteamMode(!steamON);
+                LOGF(DEBUG, "Toggle steam mode: %s", steamON ? "on" : "off");
+                break;
+
+            case kWebTogglePid: {
+                const bool newPidState = !ParameterRegistry::getInstance().getParameterById("pid.enabled")->getValueAs<bool>();
+                ParameterRegistry::getInstance().setParameterValue("pid.enabled", newPidState);
+                pidON = newPidState;
+                LOGF(DEBUG, "Toggle PID state: %d", newPidState);
+                break;
+            }
+
+            case kWebToggleBackflush:
+                backflushOn = !backflushOn;
+                LOGF(DEBUG, "Toggle backflush mode: %s", backflushOn ? "on" : "off");
+                break;
+        }
+    }
 }
 
 inline void serverSetup() {
-    server.on("/toggleSteam", HTTP_POST, [](AsyncWebServerRequest* request) {
+    webCommandQueue = xQueueCreate(WEB_COMMAND_QUEUE_LENGTH, sizeof(WebCommand));
+    refreshSessionKey();
+
+    // exchange the credentials once for a session cookie, so that later requests don't need basic auth
+    onRoute("/login", HTTP_ANY, [](AsyncWebServerRequest* request) {
         if (!authenticate(request)) {
             return request->requestAuthentication();
         }
 
-        const bool steamMode = !steamON;
-        setSteamMode(steamMode);
+        AsyncWebServerResponse* response;
+
+        if (request->method() == HTTP_GET) {
+            response = request->beginResponse(302, "text/plain", "");
+            response->addHeader("Location", "/");
+        }
+        else {
+            response = request->beginResponse(200, "text/plain", "OK");
+        }
+
+        if (authEnabled) {
+            addSessionCookie(response);
+        }
 
-        LOGF(DEBUG, "Toggle steam mode: %s", steamON ? "on" : "off");
+        request->send(response);
+    });
 
-        request->redirect("/");
+    onRoute("/logout", HTTP_POST, [](AsyncWebServerRequest* request) {
+        AsyncWebServerResponse* response = request->beginResponse(200, "text/plain", "OK");
+        clearSessionCookie(response);
+        request->send(response);
     });
 
-    server.on("/togglePid", HTTP_POST, [](AsyncWebServerRequest* request) {
+    onRoute("/toggleSteam", HTTP_POST, [](AsyncWebServerRequest* request) {
         if (!authenticate(request)) {
             return request->requestAuthentication();
         }
 
-        LOGF(DEBUG, "/togglePid requested, method: %d", request->method());
-
-        const auto pidParam = ParameterRegistry::getInstance().getParameterById("pid.enabled");
-        const bool newPidState = !pidParam->getValueAs<bool>();
-        ParameterRegistry::getInstance().setParameterValue("pid.enabled", newPidState);
-
-        pidON = newPidState;
+        postWebCommand(kWebToggleSteam);
+        request->redirect("/");
+    });
 
-        LOGF(DEBUG, "Toggle PID state: %d\n", newPidState);
+    onRoute("/togglePid", HTTP_POST, [](AsyncWebServerRequest* request) {
+        if (!authenticate(request)) {
+            return request->requestAuthentication();
+        }
 
+        postWebCommand(kWebTogglePid);
         request->redirect("/");
     });
 
-    server.on("/toggleBackflush", HTTP_POST, [](AsyncWebServerRequest* request) {
+    onRoute("/toggleBackflush", HTTP_POST, [](AsyncWebServerRequest* request) {
         if (!authenticate(request)) {
             return request->requestAuthentication();
         }
 
-        backflushOn = !backflushOn;
-        LOGF(DEBUG, "Toggle backflush mode: %s", backflushOn ? "on" : "off");
-
+        postWebCommand(kWebToggleBackflush);
         request->redirect("/");
     });
 
     if (config.get<bool>("hardware.sensors.scale.enabled")) {
-        server.on("/toggleTareScale", HTTP_POST, [](AsyncWebServerRequest* request) {
+        onRoute("/toggleTareScale", HTTP_POST, [](AsyncWebServerRequest* request) {
             if (!authenticate(request)) {
                 return request->requestAuthentication();
             }
@@ -246,7 +575,7 @@ inline void serverSetup() {
             request->redirect("/");
         });
 
-        server.on("/toggleScaleCalibration", HTTP_POST, [](AsyncWebServerRequest* request) {
+        onRoute("/toggleScaleCalibration", HTTP_POST, [](AsyncWebServerRequest* request) {
             if (!authenticate(request)) {
                 return request->requestAuthentication();
             }
@@ -259,7 +588,7 @@ inline void serverSetup() {
         });
     }
 
-    server.on("/parameters", [](AsyncWebServerRequest* request) {
+    onRoute("/parameters", HTTP_ANY, [](AsyncWebServerRequest* request) {
         if (!request->client() || !request->client()->connected()) {
             return;
         }
@@ -290,12 +619,11 @@ inline void serverSetup() {
                 limit = request->getParam("limit")->value().toInt();
             }
 
-            AsyncResponseStream* response = request->beginResponseStream("application/json");
-            response->print("{\"parameters\":[");
+            // collect the requested page first, MessagePack needs the element count up front
+            std::vector<std::shared_ptr<Parameter>> selected;
+            selected.reserve(max(limit, 0));
 
-            bool first = true;
             int filteredParameterCount = 0;
-            int sent = 0;
 
             // Get parameters based on filter
             for (const auto& param : parameters) {
@@ -326,26 +654,42 @@ inline void serverSetup() {
                         continue;
                     }
 
-                    if (sent >= limit) {
+                    if (static_cast<int>(selected.size()) >= limit) {
                         break;
                     }
 
-                    if (!first) {
-                        response->print(",");
-                    }
+                    selected.push_back(param);
+                }
+            }
 
-                    first = false;
+            ResponseWriter::Format format;
+            AsyncResponseStream* response = beginApiResponse(request, format);
+            const auto gzip = beginCompression(request, response, selected.size() * 250);
+            ResponseWriter writer(gzip ? static_cast<Print&>(*gzip) : *response, format);
 
-                    JsonDocument doc;
-                    paramToJson(param->getId(), param, doc.to<JsonVariant>());
-                    serializeJson(doc, *response);
+            writer.beginObject(4);
+            writer.key("parameters");
+            writer.beginArray(selected.size());
 
-                    sent++;
-                    LOGF(DEBUG, "[Heap] Free: %u  MaxAlloc: %u, Param: %d", ESP.getFreeHeap(), heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT), filteredParameterCount);
-                }
+            for (const auto& param : selected) {
+                JsonDocument doc;
+                paramToJson(param->getId(), param, doc.to<JsonVariant>());
+                writer.value(doc.as<JsonVariantConst>());
+            }
+
+            writer.endArray();
+            writer.key("offset");
+            writer.value(static_cast<int32_t>(offset));
+            writer.key("limit");
+            writer.value(static_cast<int32_t>(limit));
+            writer.key("returned");
+            writer.value(static_cast<int32_t>(selected.size()));
+            writer.endObject();
+
+            if (gzip) {
+                gzip->finish();
             }
 
-            response->printf(R"(],"offset":%d,"limit":%d,"returned":%d})", offset, limit, sent);
             request->send(response);
         }
         else if (request->method() == 2) { // HTTP_POST
@@ -353,37 +697,51 @@ inline void serverSetup() {
 
             String responseMessage = "OK";
             bool hasErrors = false;
+            bool authChanged = false;
 
             const auto requestParams = request->params();
 
-            for (auto i = 0u; i < requestParams; ++i) {
-                if (auto* p = request->getParam(i); p && p->name().length() > 0 && p->value().length() > 0) {
-                    const String& varName = p->name();
-                    const String& value = p->value();
-
-                    try {
-                        std::shared_ptr<Parameter> paramPtr = registry.getParameterById(varName.c_str());
-
-                        if (paramPtr == nullptr || !paramPtr->shouldShow()) {
-                            continue;
-                        }
-
-                        if (paramPtr->getType() == kCString) {
-                            registry.setParameterValue(varName.c_str(), value);
-                        }
-                        else {
-                            double newVal = std::stod(value.c_str());
-                            registry.setParameterValue(varName.c_str(), newVal);
+            {
+                // the values are applied while the control task is held, so it never sees a partial change of e.g. the PID gains
+                ControlLock lock;
+
+                for (auto i = 0u; i < requestParams; ++i) {
+                    if (auto* p = request->getParam(i); p && p->name().length() > 0 && p->value().length() > 0) {
+                        const String& varName = p->name();
+                        const String& value = p->value();
+
+                        try {
+                            std::shared_ptr<Parameter> paramPtr = registry.getParameterById(varName.c_str());
+
+                            if (paramPtr == nullptr || !paramPtr->shouldShow()) {
+                                continue;
+                            }
+
+                            if (paramPtr->getType() == kCString) {
+                                registry.setParameterValue(varName.c_str(), value);
+                            }
+                            else {
+                                double newVal = std::stod(value.c_str());
+                                registry.setParameterValue(varName.c_str(), newVal);
+                            }
+
+                            if (varName.startsWith("system.auth.")) {
+                                authChanged = true;
+                            }
+                        } catch (const std::exception& e) {
+                            LOGF(INFO, "Parameter %s processing failed: %s", varName.c_str(), e.what());
+                            hasErrors = true;
                         }
-                    } catch (const std::exception& e) {
-                        LOGF(INFO, "Parameter %s processing failed: %s", varName.c_str(), e.what());
-                        hasErrors = true;
                     }
                 }
             }
 
             registry.forceSave();
-            writeSysParamsToMQTT(true);
+            requestMqttRepublish();
+
+            if (authChanged) {
+                refreshSessionKey();
+            }
 
             AsyncWebServerResponse* response = request->beginResponse(200, "text/plain", hasErrors ? "Partial Success" : "OK");
             response->addHeader("Connection", "close");
@@ -397,8 +755,7 @@ inline void serverSetup() {
         }
     });
 
-    server.on("/parameterHelp", HTTP_GET, [](AsyncWebServerRequest* request) {
-        JsonDocument doc;
+    onRoute("/parameterHelp", HTTP_GET, [](AsyncWebServerRequest* request) {
         auto* p = request->getParam(0);
 
         if (p == nullptr) {
@@ -415,70 +772,88 @@ inline void serverSetup() {
             return;
         }
 
-        doc["name"] = varValue;
-        doc["helpText"] = param->getHelpText();
+        ResponseWriter::Format format;
+        AsyncResponseStream* response = beginApiResponse(request, format);
+        ResponseWriter writer(*response, format);
 
-        String helpJson;
-        serializeJson(doc, helpJson);
-        request->send(200, "application/json", helpJson);
+        writer.beginObject(2);
+        writer.key("name");
+        writer.value(varValue.c_str());
+        writer.key("helpText");
+        writer.value(param->getHelpText());
+        writer.endObject();
+
+        request->send(response);
     });
 
-    server.on("/temperatures", HTTP_GET, [](AsyncWebServerRequest* request) {
-        AsyncResponseStream* response = request->beginResponseStream("application/json");
-        response->print('{');
-        response->print("\"currentTemp\":");
-        response->print(curTemp, 2);
-        response->print(",\"targetTemp\":");
-        response->print(tTemp, 2);
-        response->print(",\"heaterPower\":");
-        response->print(hPower, 2);
-        response->print('}');
+    // static information shown in the web interface (the pages themselves are served without any template processing)
+    onRoute("/info", HTTP_GET, [](AsyncWebServerRequest* request) {
+        ResponseWriter::Format format;
+        AsyncResponseStream* response = beginApiResponse(request, format);
+        ResponseWriter writer(*response, format);
+
+        writer.beginObject(1);
+        writer.key("version");
+        writer.value(getValue("VERSION").c_str());
+        writer.endObject();
+
         request->send(response);
     });
 
-    server.on("/timeseries", HTTP_GET, [](AsyncWebServerRequest* request) {
-        AsyncResponseStream* response = request->beginResponseStream("application/json");
-        response->addHeader("Connection", "close"); // Force connection close
+    onRoute("/temperatures", HTTP_GET, [](AsyncWebServerRequest* request) {
+        ResponseWriter::Format format;
+        AsyncResponseStream* response = beginApiResponse(request, format);
+        ResponseWriter writer(*response, format);
 
-        response->print('{');
+        writer.beginObject(3);
+        writer.key("currentTemp");
+        writer.value(static_cast<float>(curTemp));
+        writer.key("targetTemp");
+        writer.value(static_cast<float>(tTemp));
+        writer.key("heaterPower");
+        writer.value(static_cast<float>(hPower));
+        writer.endObject();
 
-        response->print("\"currentTemps\":[");
-        bool first = true;
+        request->send(response);
+    });
 
-        for (int i = mod(historyCurrentIndex - historyValueCount, HISTORY_LENGTH); i != mod(historyCurrentIndex, HISTORY_LENGTH); i = mod(i + 1, HISTORY_LENGTH)) {
-            if (!first) response->print(',');
-            first = false;
-            response->print(tempHistory[0][i] * 0.01f, 2);
-        }
+    onRoute("/timeseries", HTTP_GET, [](AsyncWebServerRequest* request) {
+        ResponseWriter::Format format;
+        AsyncResponseStream* response = beginApiResponse(request, format);
+        response->addHeader("Connection", "close"); // Force connection close
 
-        response->print("],");
+        static constexpr const char* seriesNames[] = {"currentTemps", "targetTemps", "heaterPowers"};
 
-        response->print("\"targetTemps\":[");
-        first = true;
+        // snapshot the ring buffer position, the element count must match the array header even if a new value arrives meanwhile
+        const int count = historyValueCount;
+        const int start = mod(historyCurrentIndex - count, HISTORY_LENGTH);
 
-        for (int i = mod(historyCurrentIndex - historyValueCount, HISTORY_LENGTH); i != mod(historyCurrentIndex, HISTORY_LENGTH); i = mod(i + 1, HISTORY_LENGTH)) {
-            if (!first) response->print(',');
-            first = false;
-            response->print(tempHistory[1][i] * 0.01f, 2);
-        }
+        const auto gzip = beginCompression(request, response, count * 3 * 6);
+        ResponseWriter writer(gzip ? static_cast<Print&>(*gzip) : *response, format);
 
-        response->print("],");
+        writer.beginObject(3);
 
-        response->print("\"heaterPowers\":[");
-        first = true;
+        for (int series = 0; series < 3; series++) {
+            writer.key(seriesNames[series]);
+            writer.beginArray(count);
 
-        for (int i = mod(historyCurrentIndex - historyValueCount, HISTORY_LENGTH); i != mod(historyCurrentIndex, HISTORY_LENGTH); i = mod(i + 1, HISTORY_LENGTH)) {
-            if (!first) response->print(',');
-            first = false;
-            response->print(tempHistory[2][i] * 0.01f, 2);
+            for (int n = 0; n < count; n++) {
+                writer.value(tempHistory[series][(start + n) % HISTORY_LENGTH] * 0.01f);
+            }
+
+            writer.endArray();
         }
 
-        response->print("]}");
+        writer.endObject();
+
+        if (gzip) {
+            gzip->finish();
+        }
 
         request->send(response);
     });
 
-    server.on("/wifireset", HTTP_POST, [](AsyncWebServerRequest* request) {
+    onRoute("/wifireset", HTTP_POST, [](AsyncWebServerRequest* request) {
         if (!authenticate(request)) {
             return request->requestAuthentication();
         }
@@ -494,7 +869,7 @@ inline void serverSetup() {
         wiFiReset();
     });
 
-    server.on("/download/config", HTTP_GET, [](AsyncWebServerRequest* request) {
+    onRoute("/download/config", HTTP_GET, [](AsyncWebServerRequest* request) {
         if (!authenticate(request)) {
             return request->requestAuthentication();
         }
@@ -511,6 +886,8 @@ inline void serverSetup() {
             return;
         }
 
+        const size_t configSize = configFile.size();
+
         JsonDocument doc;
         const DeserializationError error = deserializeJson(doc, configFile);
         configFile.close();
@@ -520,17 +897,23 @@ inline void serverSetup() {
             return;
         }
 
-        // Serialize as pretty JSON
-        String prettifiedJson;
-        serializeJsonPretty(doc, prettifiedJson);
-
-        // Send the prettified JSON
-        AsyncWebServerResponse* response = request->beginResponse(200, "application/json", prettifiedJson);
+        // Send as pretty JSON
+        AsyncResponseStream* response = new MeteredResponseStream("application/json");
         response->addHeader("Content-Disposition", "attachment; filename=\"config.json\"");
+        response->addHeader("Vary", "Accept-Encoding");
+
+        if (const auto gzip = beginCompression(request, response, configSize)) {
+            serializeJsonPretty(doc, *gzip);
+            gzip->finish();
+        }
+        else {
+            serializeJsonPretty(doc, *response);
+        }
+
         request->send(response);
     });
 
-    server.on(
+    onRoute(
         "/upload/config", HTTP_POST,
         [](AsyncWebServerRequest* request) {
             // This response will be set by the upload handler
@@ -579,7 +962,7 @@ inline void serverSetup() {
             }
         });
 
-    server.on("/restart", HTTP_POST, [](AsyncWebServerRequest* request) {
+    onRoute("/restart", HTTP_POST, [](AsyncWebServerRequest* request) {
         if (!authenticate(request)) {
             return request->requestAuthentication();
         }
@@ -594,7 +977,7 @@ inline void serverSetup() {
         ESP.restart();
     });
 
-    server.on("/factoryreset", HTTP_POST, [](AsyncWebServerRequest* request) {
+    onRoute("/factoryreset", HTTP_POST, [](AsyncWebServerRequest* request) {
         if (!authenticate(request)) {
             return request->requestAuthentication();
         }
@@ -611,6 +994,156 @@ inline void serverSetup() {
         ESP.restart();
     });
 
+    // route statistics, not instrumented themselves so that polling them doesn't skew the numbers
+    server.on("/diagnostics/routes", HTTP_GET, [](AsyncWebServerRequest* request) {
+        if (!authenticate(request)) {
+            return request->requestAuthentication();
+        }
+
+        ResponseWriter::Format format;
+        AsyncResponseStream* response = beginApiResponse(request, format);
+        ResponseWriter writer(*response, format);
+
+        writer.beginObject(2);
+        writer.key("enabled");
+        writer.value(routeStatsEnabled ? 1 : 0);
+        writer.key("routes");
+        writer.beginArray(routeStats.size());
+
+        for (size_t i = 0; i < routeStats.size(); i++) {
+            const RouteStats::Route& route = routeStats.get(i);
+
+            writer.beginObject(7);
+            writer.key("route");
+            writer.value(route.path);
+            writer.key("count");
+            writer.value(static_cast<int32_t>(route.count));
+            writer.key("p50Us");
+            writer.value(static_cast<int32_t>(RouteStats::percentile(route, 50)));
+            writer.key("p99Us");
+            writer.value(static_cast<int32_t>(RouteStats::percentile(route, 99)));
+            writer.key("maxUs");
+            writer.value(static_cast<int32_t>(route.maxMicros));
+            writer.key("bytes");
+            writer.value(static_cast<int32_t>(min(route.bytes, static_cast<uint32_t>(INT32_MAX))));
+            writer.key("minFreeHeap");
+            writer.value(route.count > 0 ? static_cast<int32_t>(route.minFreeHeap) : 0);
+            writer.endObject();
+        }
+
+        writer.endArray();
+        writer.endObject();
+
+        request->send(response);
+    });
+
+    server.on("/diagnostics/routes/reset", HTTP_POST, [](AsyncWebServerRequest* request) {
+        if (!authenticate(request)) {
+            return request->requestAuthentication();
+        }
+
+        routeStats.reset();
+        request->send(200, "text/plain", "OK");
+    });
+
+    server.on("/diagnostics/mqtt", HTTP_GET, [](AsyncWebServerRequest* request) {
+        if (!authenticate(request)) {
+            return request->requestAuthentication();
+        }
+
+        ResponseWriter::Format format;
+        AsyncResponseStream* response = beginApiResponse(request, format);
+        ResponseWriter writer(*response, format);
+
+        const float seconds = max(mqttStats.elapsed(), static_cast<uint32_t>(1)) / 1000.0f;
+
+        writer.beginObject(8);
+        writer.key("elapsedMs");
+        writer.value(static_cast<int32_t>(min(mqttStats.elapsed(), static_cast<uint32_t>(INT32_MAX))));
+        writer.key("messages");
+        writer.value(static_cast<int32_t>(mqttStats.messages()));
+        writer.key("bytes");
+        writer.value(static_cast<int32_t>(min(mqttStats.bytes(), static_cast<uint32_t>(INT32_MAX))));
+        writer.key("messagesPerSecond");
+        writer.value(mqttStats.messages() / seconds);
+        writer.key("bytesPerSecond");
+        writer.value(mqttStats.bytes() / seconds);
+        writer.key("failures");
+        writer.value(static_cast<int32_t>(mqttStats.failures()));
+        writer.key("dropped");
+        writer.value(static_cast<int32_t>(mqttStats.dropped()));
+        writer.key("operations");
+        writer.beginArray(MqttStats::OPERATION_COUNT);
+
+        for (size_t i = 0; i < MqttStats::OPERATION_COUNT; i++) {
+            const auto operation = static_cast<MqttStats::Operation>(i);
+            const MqttStats::Timing& timing = mqttStats.get(operation);
+
+            writer.beginObject(4);
+            writer.key("name");
+            writer.value(MqttStats::name(operation));
+            writer.key("count");
+            writer.value(static_cast<int32_t>(timing.count));
+            writer.key("avgUs");
+            writer.value(timing.count > 0 ? static_cast<int32_t>(timing.totalMicros / timing.count) : 0);
+            writer.key("maxUs");
+            writer.value(static_cast<int32_t>(timing.maxMicros));
+            writer.endObject();
+        }
+
+        writer.endArray();
+        writer.endObject();
+
+        request->send(response);
+    });
+
+    server.on("/diagnostics/mqtt/reset", HTTP_POST, [](AsyncWebServerRequest* request) {
+        if (!authenticate(request)) {
+            return request->requestAuthentication();
+        }
+
+        mqttStats.reset();
+        request->send(200, "text/plain", "OK");
+    });
+
+    server.on("/diagnostics/control", HTTP_GET, [](AsyncWebServerRequest* request) {
+        if (!authenticate(request)) {
+            return request->requestAuthentication();
+        }
+
+        ResponseWriter::Format format;
+        AsyncResponseStream* response = beginApiResponse(request, format);
+        ResponseWriter writer(*response, format);
+
+        writer.beginObject(7);
+        writer.key("periodUs");
+        writer.value(static_cast<int32_t>(controlStats.period()));
+        writer.key("count");
+        writer.value(static_cast<int32_t>(controlStats.count()));
+        writer.key("overruns");
+        writer.value(static_cast<int32_t>(controlStats.overruns()));
+        writer.key("jitterAvgUs");
+        writer.value(static_cast<int32_t>(controlStats.averageJitter()));
+        writer.key("jitterMaxUs");
+        writer.value(static_cast<int32_t>(controlStats.maxJitter()));
+        writer.key("executionAvgUs");
+        writer.value(static_cast<int32_t>(controlStats.averageExecution()));
+        writer.key("executionMaxUs");
+        writer.value(static_cast<int32_t>(controlStats.maxExecution()));
+        writer.endObject();
+
+        request->send(response);
+    });
+
+    server.on("/diagnostics/control/reset", HTTP_POST, [](AsyncWebServerRequest* request) {
+        if (!authenticate(request)) {
+            return request->requestAuthentication();
+        }
+
+        controlStats.reset();
+        request->send(200, "text/plain", "OK");
+    });
+
     server.onNotFound([](AsyncWebServerRequest* request) { request->send(404, "text/plain", "Not found"); });
 
     // set up event handler for temperature messages
@@ -625,13 +1158,17 @@ inline void serverSetup() {
     server.addHandler(&events);
 
     // serve static files
-    LittleFS.begin();
-    server.serveStatic("/css", LittleFS, "/css/", "max-age=604800"); // cache for one week
-    server.serveStatic("/js", LittleFS, "/js/", "max-age=604800");
-    server.serveStatic("/img", LittleFS, "/img/", "max-age=604800"); // cache for one week
-    server.serveStatic("/webfonts", LittleFS, "/webfonts/", "max-age=604800");
-    server.serveStatic("/manifest.json", LittleFS, "/manifest.json", "max-age=604800");
-    server.serveStatic("/", LittleFS, "/html/", "max-age=604800").setDefaultFile("index.html").setTemplateProcessor(staticProcessor);
+    server.addHandler(new AssetBundleHandler());
+
+    if (assetBundle.begin()) {
+        LOGF(INFO, "Serving web interface from asset bundle (%u files)", assetBundle.size());
+    }
+    else if (AssetBundle::findPartition() == nullptr) {
+        LOG(ERROR, "No asset partition, serving the web interface from the file system until the partition table is updated over USB");
+    }
+    else {
+        LOG(ERROR, "No valid asset bundle, serving the web interface from the file system, assets.bin can be uploaded on the start page");
+    }
 
     server.begin();
 
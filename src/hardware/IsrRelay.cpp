@@ -0,0 +1,42 @@
+/**
+ * @file IsrRelay.cpp
+ *
+ * @brief A relay switched from interrupt context by writing the GPIO registers directly
+ */
+
+#include "IsrRelay.h"
+#include <soc/gpio_struct.h>
+
+IsrRelay::IsrRelay(const int pinNumber, const Relay::TriggerType trigger) {
+    volatile uint32_t* setRegister;
+    volatile uint32_t* clearRegister;
+
+    // pins 32 and up are in the second output register
+    if (pinNumber < 32) {
+        setRegister = &GPIO.out_w1ts;
+        clearRegister = &GPIO.out_w1tc;
+        mask = 1UL << pinNumber;
+    }
+    else {
+        setRegister = &GPIO.out1_w1ts.val;
+        clearRegister = &GPIO.out1_w1tc.val;
+        mask = 1UL << (pinNumber - 32);
+    }
+
+    if (trigger == Relay::HIGH_TRIGGER) {
+        onRegister = setRegister;
+        offRegister = clearRegister;
+    }
+    else {
+        onRegister = clearRegister;
+        offRegister = setRegister;
+    }
+}
+
+void IRAM_ATTR IsrRelay::on() const {
+    *onRegister = mask;
+}
+
+void IRAM_ATTR IsrRelay::off() const {
+    *offRegister = mask;
+}
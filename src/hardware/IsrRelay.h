@@ -0,0 +1,44 @@
+/**
+ * @file IsrRelay.h
+ *
+ * @brief A relay switched from interrupt context by writing the GPIO registers directly
+ */
+
+#pragma once
+
+#include "Relay.h"
+#include <Arduino.h>
+
+/**
+ * @class IsrRelay
+ * @brief Relay driver for the heater timer interrupt
+ * @details The GPIO register and pin mask are resolved once in the constructor, switching is a single register
+ *          store placed in IRAM. The interrupt keeps running while the flash cache is disabled, e.g. while the
+ *          config is written to LittleFS, so nothing it calls may live in flash. The pin has to be configured as
+ *          output before, e.g. by a GPIOPin. check_iram.py verifies after linking that the interrupt only reaches IRAM.
+ */
+class IsrRelay {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param pinNumber GPIO pin the relay is connected to, 0-33
+         * @param trigger Trigger type this relay requires
+         */
+        IsrRelay(int pinNumber, Relay::TriggerType trigger);
+
+        /**
+         * @brief Switch relay on, safe to call from an IRAM interrupt
+         */
+        void on() const;
+
+        /**
+         * @brief Switch relay off, safe to call from an IRAM interrupt
+         */
+        void off() const;
+
+    private:
+        volatile uint32_t* onRegister;
+        volatile uint32_t* offRegister;
+        uint32_t mask;
+};
@@ -8,10 +8,12 @@
 #include "GPIOPin.h"
 
 Relay::Relay(GPIOPin& gpioInstance, const TriggerType trigger) :
-    gpio(gpioInstance), relayTrigger(trigger) {
+    gpio(gpioInstance), relayTrigger(trigger), state(false) {
 }
 
-void Relay::on() const {
+void Relay::on() {
+    state = true;
+
     if (relayTrigger == HIGH_TRIGGER) {
         gpio.write(HIGH);
     }
@@ -20,7 +22,9 @@ void Relay::on() const {
     }
 }
 
-void Relay::off() const {
+void Relay::off() {
+    state = false;
+
     if (relayTrigger == HIGH_TRIGGER) {
         gpio.write(LOW);
     }
@@ -29,6 +33,10 @@ void Relay::off() const {
     }
 }
 
+bool Relay::isOn() const {
+    return state;
+}
+
 GPIOPin& Relay::getGPIOInstance() const {
     return gpio;
 }
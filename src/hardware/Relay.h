@@ -35,12 +35,18 @@ class Relay {
         /**
          * @brief Switch relay on
          */
-        void on() const;
+        void on();
 
         /**
          * @brief Switch relay off
          */
-        void off() const;
+        void off();
+
+        /**
+         * @brief Get the state the relay was last switched to
+         * @return true if the relay is on
+         */
+        [[nodiscard]] bool isOn() const;
 
         /**
          * @brief Get the GPIO pin this relay is connected to
@@ -51,4 +57,5 @@ class Relay {
     private:
         GPIOPin& gpio;
         TriggerType relayTrigger;
+        volatile bool state;
 };
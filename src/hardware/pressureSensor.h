@@ -17,15 +17,15 @@ inline unsigned long previousMillisPressureDebug = 0;
 inline uint8_t ABP2_id = 0x28;                   // i2c address
 inline uint8_t ABP2_data[7];                     // holds output data
 inline uint8_t ABP2_cmd[3] = {0xAA, 0x00, 0x00}; // command to be sent
-inline double ABP2_press_counts = 0.0;           // digital pressure reading [counts]
-inline double ABP2_temp_counts = 0.0;            // digital temperature reading [counts]
-inline double ABP2_pressure = -1.0;              // pressure reading [bar, psi, kPa, etc.]
-inline double ABP2_temperature = 0.0;            // temperature reading in deg C
-inline double ABP2_outputmax = 15099494.0;       // output at maximum pressure [counts]
-inline double ABP2_outputmin = 1677722.0;        // output at minimum pressure [counts]
-inline double ABP2_pmax = 10.0;                  // maximum value of pressure range [bar, psi, kPa, etc.]
-inline double ABP2_pmin = 0.0;                   // minimum value of pressure range [bar, psi, kPa, etc.]
-inline double ABP2_percentage = 0.0;             // holds percentage of full scale data
+inline float ABP2_press_counts = 0.0f;           // digital pressure reading [counts], 24 bit values are exact in a float
+inline float ABP2_temp_counts = 0.0f;            // digital temperature reading [counts]
+inline float ABP2_pressure = -1.0f;              // pressure reading [bar, psi, kPa, etc.]
+inline float ABP2_temperature = 0.0f;            // temperature reading in deg C
+inline float ABP2_outputmax = 15099494.0f;       // output at maximum pressure [counts]
+inline float ABP2_outputmin = 1677722.0f;        // output at minimum pressure [counts]
+inline float ABP2_pmax = 10.0f;                  // maximum value of pressure range [bar, psi, kPa, etc.]
+inline float ABP2_pmin = 0.0f;                   // minimum value of pressure range [bar, psi, kPa, etc.]
+inline float ABP2_percentage = 0.0f;             // holds percentage of full scale data
 
 inline float measurePressure() {
     static uint8_t errorCount = 0;
@@ -36,7 +36,7 @@ inline float measurePressure() {
     if (stat != 3) {
         LOG(ERROR, "Write Error");
 
-        return static_cast<float>(ABP2_pressure);
+        return ABP2_pressure;
     }
 
     stat = Wire.endTransmission();
@@ -48,7 +48,7 @@ inline float measurePressure() {
             errorCount++;
         }
 
-        return static_cast<float>(ABP2_pressure);
+        return ABP2_pressure;
     }
 
     errorCount = 0;
@@ -63,16 +63,16 @@ inline float measurePressure() {
     }
 
     // calculate digital pressure counts
-    ABP2_press_counts = static_cast<double>(ABP2_data[3] + ABP2_data[2] * 256 + ABP2_data[1] * 65536);
+    ABP2_press_counts = static_cast<float>(ABP2_data[3] + ABP2_data[2] * 256 + ABP2_data[1] * 65536);
 
     // calculate digital temperature counts
-    ABP2_temp_counts = static_cast<double>(ABP2_data[6] + ABP2_data[5] * 256 + ABP2_data[4] * 65536);
+    ABP2_temp_counts = static_cast<float>(ABP2_data[6] + ABP2_data[5] * 256 + ABP2_data[4] * 65536);
 
     // calculate temperature in deg c
-    ABP2_temperature = ABP2_temp_counts * 270.0 / 16777215.0 - 40.0;
+    ABP2_temperature = ABP2_temp_counts * 270.0f / 16777215.0f - 40.0f;
 
     // calculate pressure as percentage of full scale
-    ABP2_percentage = ABP2_press_counts / 16777215.0 * 100.0;
+    ABP2_percentage = ABP2_press_counts / 16777215.0f * 100.0f;
 
     // calculation of pressure value according to equation 2 of datasheet
     ABP2_pressure = (ABP2_press_counts - ABP2_outputmin) * (ABP2_pmax - ABP2_pmin) / (ABP2_outputmax - ABP2_outputmin) + ABP2_pmin;
@@ -82,5 +82,5 @@ inline float measurePressure() {
         previousMillisPressureDebug = currentMillisPressureDebug;
     }
 
-    return static_cast<float>(ABP2_pressure);
+    return ABP2_pressure;
 }
@@ -32,13 +32,13 @@ class TempSensor {
          * @details Requests sampling from attached sensor and returns reading.
          * @return Temperature in degrees Celsius
          */
-        double getCurrentTemperature() {
+        float getCurrentTemperature() {
             // Trigger the timer to update the temperature:
             update_temperature();
             return last_temperature_;
         }
 
-        double getAverageTemperatureRate() {
+        float getAverageTemperatureRate() {
             // Trigger the timer to update the temperature:
             update_temperature();
             return average_temp_rate_;
@@ -65,7 +65,7 @@ class TempSensor {
          *          of the function is true.
          * @return Boolean indicating whether the reading has been successful
          */
-        virtual bool sample_temperature(double& temperature) const = 0;
+        virtual bool sample_temperature(float& temperature) const = 0;
 
     private:
         /**
@@ -97,7 +97,7 @@ class TempSensor {
         }
 
         Timer update_temperature;
-        double last_temperature_{};
+        float last_temperature_{};
         int bad_readings_{0};
         int max_bad_treadings_{10};
         bool error_{false};
@@ -118,18 +118,18 @@ class TempSensor {
             tempValues[valueIndex] = last_temperature_;
 
             // local change rate of temperature
-            double tempChangeRate = 0;
+            float tempChangeRate = 0;
 
             if (valueIndex == numValues - 1) {
-                tempChangeRate = (tempValues[numValues - 1] - tempValues[0]) / (timeValues[numValues - 1] - timeValues[0]) * 10000;
+                tempChangeRate = (tempValues[numValues - 1] - tempValues[0]) / static_cast<float>(timeValues[numValues - 1] - timeValues[0]) * 10000;
             }
             else {
-                tempChangeRate = (tempValues[valueIndex] - tempValues[valueIndex + 1]) / (timeValues[valueIndex] - timeValues[valueIndex + 1]) * 10000;
+                tempChangeRate = (tempValues[valueIndex] - tempValues[valueIndex + 1]) / static_cast<float>(timeValues[valueIndex] - timeValues[valueIndex + 1]) * 10000;
             }
 
             tempChangeRates[valueIndex] = tempChangeRate;
 
-            const double totalTempChangeRateSum = std::accumulate(std::begin(tempChangeRates), std::end(tempChangeRates), 0, std::plus<>());
+            const float totalTempChangeRateSum = std::accumulate(std::begin(tempChangeRates), std::end(tempChangeRates), 0, std::plus<>());
             average_temp_rate_ = totalTempChangeRateSum / numValues * 100;
 
             if (valueIndex >= numValues - 1) {
@@ -142,10 +142,10 @@ class TempSensor {
         }
 
         // Moving average:
-        double average_temp_rate_{};
+        float average_temp_rate_{};
         constexpr static size_t numValues = 15;
-        std::array<double, numValues> tempValues{};        // array of temp values
+        std::array<float, numValues> tempValues{};         // array of temp values
         std::array<unsigned long, numValues> timeValues{}; // array of time values
-        std::array<double, numValues> tempChangeRates{};
+        std::array<float, numValues> tempChangeRates{};
         int valueIndex{-1};                                // the index of the current value
 };
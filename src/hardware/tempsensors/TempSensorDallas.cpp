@@ -18,7 +18,7 @@ TempSensorDallas::TempSensorDallas(const int GPIOPin) {
     dallasSensor_->requestTemperaturesByAddress(sensorDeviceAddress_);
 }
 
-bool TempSensorDallas::sample_temperature(double& temperature) const {
+bool TempSensorDallas::sample_temperature(float& temperature) const {
 
     // Read temperature from device
     const auto temp = dallasSensor_->getTempC(sensorDeviceAddress_);
@@ -14,7 +14,7 @@ class TempSensorDallas final : public TempSensor {
         explicit TempSensorDallas(int GPIOPin);
 
     protected:
-        bool sample_temperature(double& temperature) const override;
+        bool sample_temperature(float& temperature) const override;
 
     private:
         OneWire* oneWire_;
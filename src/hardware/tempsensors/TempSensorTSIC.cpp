@@ -17,16 +17,16 @@ TempSensorTSIC::TempSensorTSIC(const int GPIOPin) {
     tsicSensor_->begin();
 }
 
-bool TempSensorTSIC::sample_temperature(double& temperature) const {
+bool TempSensorTSIC::sample_temperature(float& temperature) const {
     static bool validTemps = false;
-    float temp = 0.0;
+    float temp = 0.0f;
 
     if (!validTemps) {
         temp = tsicSensor_->getTemp(INITIAL_CHANGERATE);
 
         // if current and previous reading is in range and their difference is low then reduce changerate
-        if (temp > 0.0 && temp < 180.0) {
-            if (temperature > 0.0 && temperature < 180.0 && abs(temperature - temp) < RUNTIME_CHANGERATE) {
+        if (temp > 0.0f && temp < 180.0f) {
+            if (temperature > 0.0f && temperature < 180.0f && fabsf(temperature - temp) < RUNTIME_CHANGERATE) {
                 validTemps = true;
             }
             else {
@@ -14,7 +14,7 @@ class TempSensorTSIC final : public TempSensor {
         explicit TempSensorTSIC(int GPIOPin);
 
     protected:
-        bool sample_temperature(double& temperature) const override;
+        bool sample_temperature(float& temperature) const override;
 
     private:
         ZACwire* tsicSensor_;
@@ -27,7 +27,7 @@ inline HotWaterState currHotWaterState = kHotWaterIdle;
 
 inline uint8_t hotWaterSwitchReading = LOW;
 inline uint8_t currReadingHotWaterSwitch = LOW;
-inline double currPumpOnTime = 0;          // current running total pump on time
+inline float currPumpOnTime = 0;           // current running total pump on time
 inline unsigned long pumpStartingTime = 0; // start time of pump
 
 /**
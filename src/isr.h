@@ -7,38 +7,128 @@
 
 #pragma once
 
-#include "hardware/Relay.h"
+#include "hardware/IsrRelay.h"
+#include <esp_intr_alloc.h>
 
-extern double pidOutput;
+constexpr unsigned int HEATER_TICK_MS = 10; // period of the timer interrupt
+
+/**
+ * @brief How the heater on-ticks are placed within a window
+ */
+enum HeaterModulation {
+    kHeaterWindow,      // on at the start of the window, then off for the rest of it
+    kHeaterPulseDensity // on-ticks spread evenly over the window, less temperature ripple but more switching
+};
+
+/**
+ * @brief Producers that can limit the heater duty independently of the PID, the lowest limit applies
+ */
+enum HeaterDutyLimit {
+    kHeaterLimitPower,  // power budget shared with other machines
+    kHeaterLimitSafety, // emergency stop
+    kHeaterLimitCount
+};
 
 unsigned int isrCounter = 0;  // counter for ISR
+unsigned int isrTick = 0;     // timer ticks since the start of the window
 unsigned int isrWatchdog = 0; // test to verify ISR active
 unsigned long windowStartTime;
 unsigned int windowSize = 1000;
+uint32_t heaterWindowTicks = 0;        // timer ticks per window
+uint32_t heaterDensityAccumulator = 0; // sigma-delta state of the pulse density modulation
+int heaterModulation = kHeaterWindow;
+
+// heater on-time per window in timer ticks, an aligned 32 bit store is atomic so the ISR never sees a partial update
+volatile uint32_t heaterDutyTicks = 0;
+uint32_t heaterDutyLimits[kHeaterLimitCount] = {UINT32_MAX, UINT32_MAX};
 
 void IRAM_ATTR onTimer() {
-    if (pidOutput <= isrCounter) {
-        heaterRelay->off();
+    bool heat;
+
+    if (heaterModulation == kHeaterPulseDensity) {
+        // first order sigma-delta, switches on whenever the accumulated duty reaches a full window
+        heaterDensityAccumulator += heaterDutyTicks;
+        heat = heaterDensityAccumulator >= heaterWindowTicks;
+
+        if (heat) {
+            heaterDensityAccumulator -= heaterWindowTicks;
+        }
     }
     else {
-        heaterRelay->on();
+        heat = isrTick < heaterDutyTicks;
+    }
+
+    if (heat) {
+        heaterIsrRelay->on();
+    }
+    else {
+        heaterIsrRelay->off();
     }
 
     isrWatchdog++;
-    isrCounter += 10; // += 10 because one tick = 10ms
+    isrTick++;
+    isrCounter += HEATER_TICK_MS;
 
     // set PID output as relay commands
     if (isrCounter >= windowSize) {
         isrCounter = 0;
+        isrTick = 0;
     }
 }
 
+/**
+ * @brief Convert a duty in ms per window to timer ticks, a started tick heats for the whole tick
+ */
+inline uint32_t heaterMillisToTicks(const float millis) {
+    return millis > 0 ? static_cast<uint32_t>(ceilf(millis / HEATER_TICK_MS)) : 0;
+}
+
+/**
+ * @brief Convert a duty limit in ms per window to timer ticks, a partial tick is dropped so that the limit is never exceeded
+ *        A thousandth of a tick absorbs the float error of the duty, 0.53f * 3000 ms would lose a whole tick otherwise
+ */
+inline uint32_t heaterLimitToTicks(const float millis) {
+    return millis > 0 ? static_cast<uint32_t>(floorf(millis / HEATER_TICK_MS + 0.001f)) : 0;
+}
+
+/**
+ * @brief Limit the heater duty on behalf of one producer until the limit is changed or cleared
+ *
+ * @param source Producer of the limit
+ * @param duty Highest duty allowed, 0-1
+ */
+inline void setHeaterDutyLimit(const HeaterDutyLimit source, const float duty) {
+    heaterDutyLimits[source] = heaterLimitToTicks(constrain(duty, 0.0f, 1.0f) * windowSize);
+}
+
+inline void clearHeaterDutyLimit(const HeaterDutyLimit source) {
+    heaterDutyLimits[source] = UINT32_MAX;
+}
+
+/**
+ * @brief Hand the PID output to the ISR, limited by all producers, called by the control loop once the output is final
+ *        The duty never exceeds a full window, the pulse density accumulator would grow without bound otherwise
+ *
+ * @param output PID output in ms of heating per window
+ */
+inline void publishHeaterDuty(const float output) {
+    uint32_t ticks = min(heaterMillisToTicks(output), heaterWindowTicks);
+
+    for (const uint32_t limit : heaterDutyLimits) {
+        ticks = min(ticks, limit);
+    }
+
+    heaterDutyTicks = ticks;
+}
+
 /**
  * @brief Initialize hardware timers
  */
 void initTimer1() {
+    heaterWindowTicks = windowSize / HEATER_TICK_MS;
+
     timer = timerBegin(0, 80, true);
-    timerAttachInterrupt(timer, &onTimer, true);
+    timerAttachInterruptFlag(timer, &onTimer, true, ESP_INTR_FLAG_IRAM); // keep switching the heater while the flash cache is disabled
     timerAlarmWrite(timer, 10000, true); // set to automatically restart
 }
 
@@ -13,7 +13,7 @@
 #include "Logger.h"
 #include <ArduinoOTA.h>
 #include <LittleFS.h>
-#include <PID_v1.h>  // for PID calculation
+#include <PID.h>     // for PID calculation
 #include <U8g2lib.h> // i2c display
 #include <WiFiManager.h>
 #include <os.h>
@@ -28,6 +28,7 @@
 // Hardware classes
 #include "hardware/GPIOPin.h"
 #include "hardware/IOSwitch.h"
+#include "hardware/IsrRelay.h"
 #include "hardware/LED.h"
 #include "hardware/Relay.h"
 #include "hardware/StandardLED.h"
@@ -94,7 +95,7 @@ U8G2* u8g2 = nullptr;
 bool featureFullscreenBrewTimer = false;
 bool featureFullscreenManualFlushTimer = false;
 bool featureFullscreenHotWaterTimer = false;
-double postBrewTimerDuration = POST_BREW_TIMER_DURATION;
+float postBrewTimerDuration = POST_BREW_TIMER_DURATION;
 bool featureHeatingLogo = false;
 
 // WiFi
@@ -147,6 +148,8 @@ Relay* heaterRelay = nullptr;
 Relay* pumpRelay = nullptr;
 Relay* valveRelay = nullptr;
 
+IsrRelay* heaterIsrRelay = nullptr; // same pin as heaterRelay, used by the timer interrupt
+
 Switch* powerSwitch = nullptr;
 Switch* brewSwitch = nullptr;
 Switch* steamSwitch = nullptr;
@@ -162,14 +165,13 @@ void setPIDTunings(bool usePonM);
 void setBDPIDTunings();
 void setRuntimePidState(bool enabled);
 void loopcalibrate();
-void loopPid();
+void loopInterface();
 void loopLED();
 void checkWaterTank();
 void printMachineState();
 char const* machinestateEnumToString(MachineState machineState);
-inline std::vector<const char*> getMachineStateOptions();
 float filterPressureValue(float input);
-int writeSysParamsToMQTT(bool continueOnError);
+void requestMqttRepublish();
 void updateStandbyTimer();
 void resetStandbyTimer();
 void wiFiReset();
@@ -181,28 +183,28 @@ String lastHotWaterStateDebug = "off";
 // system parameters
 bool pidON = false;
 bool usePonM = false;
-double brewSetpoint = SETPOINT;
-double brewTempOffset = TEMPOFFSET;
-double setpoint = brewSetpoint;
-double steamSetpoint = STEAMSETPOINT;
-double steamKp = STEAMKP;
-double aggKp = AGGKP;
-double aggTn = AGGTN;
-double aggTv = AGGTV;
-double aggIMax = AGGIMAX;
-double emaFactor = EMA_FACTOR;
+float brewSetpoint = SETPOINT;
+float brewTempOffset = TEMPOFFSET;
+float setpoint = brewSetpoint;
+float steamSetpoint = STEAMSETPOINT;
+float steamKp = STEAMKP;
+float aggKp = AGGKP;
+float aggTn = AGGTN;
+float aggTv = AGGTV;
+float aggIMax = AGGIMAX;
+float emaFactor = EMA_FACTOR;
 
 // PID - values for offline brew detection
 bool useBDPID = false;
-double aggbKp = AGGBKP;
-double aggbTn = AGGBTN;
-double aggbTv = AGGBTV;
-double aggbKi = (aggbTn == 0) ? 0 : aggbKp / aggbTn;
-double aggbKd = aggbTv * aggbKp;
-double aggKi = (aggTn == 0) ? 0 : aggKp / aggTn;
-double aggKd = aggTv * aggKp;
+float aggbKp = AGGBKP;
+float aggbTn = AGGBTN;
+float aggbTv = AGGBTV;
+float aggbKi = (aggbTn == 0) ? 0 : aggbKp / aggbTn;
+float aggbKd = aggbTv * aggbKp;
+float aggKi = (aggTn == 0) ? 0 : aggKp / aggTn;
+float aggKd = aggTv * aggKp;
 
-double brewPidDelay = BREW_PID_DELAY; // Time PID will be disabled after brew started
+float brewPidDelay = BREW_PID_DELAY; // Time PID will be disabled after brew started
 
 bool standbyModeOn = false;
 double standbyModeTime = STANDBY_MODE_TIME;
@@ -210,18 +212,18 @@ double standbyModeTime = STANDBY_MODE_TIME;
 #include "standby.h"
 
 // Variables to hold PID values (Temp input, Heater output)
-double temperature, pidOutput;
+float temperature, pidOutput;
 bool steamON = false;
 bool steamFirstON = false;
 
-PID bPID(&temperature, &pidOutput, &setpoint, aggKp, aggKi, aggKd, 1, DIRECT);
+BasicPID<float> bPID(&temperature, &pidOutput, &setpoint, aggKp, aggKi, aggKd, 1, DIRECT);
 
 #include "brewHandler.h"
 #include "hotWaterHandler.h"
 
 // Other variables
 boolean emergencyStop = false;                // Emergency stop if temperature is too high
-constexpr double EmergencyStopTemp = 145;     // Temp EmergencyStopTemp
+constexpr float EmergencyStopTemp = 145;      // Temp EmergencyStopTemp
 float inX = 0, inY = 0, inOld = 0, inSum = 0; // used for filterPressureValue()
 boolean setupDone = false;
 
@@ -233,17 +235,15 @@ Timer loopWaterTank(&checkWaterTank, 200); // Check water tank level every 200 m
 unsigned long previousMillistemp; // initialisation at the end of init()
 unsigned long previousMillisTimer;
 
-double setpointTemp;
-double previousInput = 0;
+float setpointTemp;
+float previousInput = 0;
+
+// Fixed period control task
+#include "controlTask.h"
 
 // Embedded HTTP Server
 #include "embeddedWebserver.h"
-
-struct cmp_str {
-        bool operator()(char const* a, char const* b) const {
-            return strcmp(a, b) < 0;
-        }
-};
+#include "otaHandler.h"
 
 // MQTT
 bool hassioFailed = false;
@@ -251,9 +251,6 @@ bool mqtt_was_connected = false;
 
 #include "mqtt.h"
 
-std::map<const char*, const char*, cmp_str> mqttVars;
-std::map<const char*, std::function<double()>, cmp_str> mqttSensors = {};
-
 unsigned long lastTempEvent = 0;
 unsigned long tempEventInterval = 1000;
 
@@ -297,17 +294,66 @@ void u8g2_prepare();
 
 Timer printDisplayTimer(&DisplayTemplateManager::printScreen, 100);
 
+#include "powerCoordination.h"
 #include "powerHandler.h"
 #include "scaleHandler.h"
+#include "shotTelemetry.h"
 #include "steamHandler.h"
 
+// Read-only values of the MQTT topic table
+double mqttTemperature() {
+    return temperature;
+}
+
+double mqttHeaterPower() {
+    return pidOutput / 10;
+}
+
+double mqttStandbyModeTimeRemaining() {
+    return standbyModeRemainingTimeMillis / 1000;
+}
+
+double mqttCurrentKp() {
+    return bPID.GetKp();
+}
+
+double mqttCurrentKi() {
+    return bPID.GetKi();
+}
+
+double mqttCurrentKd() {
+    return bPID.GetKd();
+}
+
+double mqttMachineState() {
+    return machineState;
+}
+
+double mqttCurrBrewTime() {
+    return currBrewTime / 1000;
+}
+
+double mqttCurrReadingWeight() {
+    return currReadingWeight;
+}
+
+double mqttCurrBrewWeight() {
+    return currBrewWeight;
+}
+
+double mqttPressure() {
+    return inputPressureFilter;
+}
+
 // Emergency stop if temp is too high
 void testEmergencyStop() {
     if (temperature > EmergencyStopTemp && emergencyStop == false) {
         emergencyStop = true;
+        setHeaterDutyLimit(kHeaterLimitSafety, 0);
     }
     else if (temperature < (brewSetpoint + 5) && emergencyStop == true) {
         emergencyStop = false;
+        clearHeaterDutyLimit(kHeaterLimitSafety);
     }
 }
 
@@ -675,17 +721,15 @@ void handleMachineState() {
 
         case kStandby:
             {
-                if (standbyModeRemainingTimeDisplayOffMillis == 0 && u8g2 != nullptr) {
-                    u8g2->setPowerSave(1);
+                if (standbyModeRemainingTimeDisplayOffMillis == 0) {
+                    requestDisplayPowerSave(true);
                 }
 
                 if (pidON) {
                     machineState = kPidNormal;
                     resetStandbyTimer(machineState);
 
-                    if (u8g2 != nullptr) {
-                        u8g2->setPowerSave(0);
-                    }
+                    requestDisplayPowerSave(false);
                 }
 
                 if (brew()) {
@@ -693,9 +737,7 @@ void handleMachineState() {
                     machineState = kBrew;
                     resetStandbyTimer(machineState);
 
-                    if (u8g2 != nullptr) {
-                        u8g2->setPowerSave(0);
-                    }
+                    requestDisplayPowerSave(false);
                 }
 
                 if (manualFlush()) {
@@ -703,9 +745,7 @@ void handleMachineState() {
                     machineState = kManualFlush;
                     resetStandbyTimer(machineState);
 
-                    if (u8g2 != nullptr) {
-                        u8g2->setPowerSave(0);
-                    }
+                    requestDisplayPowerSave(false);
                 }
 
                 if (checkHotWaterStates()) {
@@ -713,9 +753,7 @@ void handleMachineState() {
                     machineState = kHotWater;
                     resetStandbyTimer(machineState);
 
-                    if (u8g2 != nullptr) {
-                        u8g2->setPowerSave(0);
-                    }
+                    requestDisplayPowerSave(false);
                 }
 
                 if (steamON) {
@@ -723,24 +761,18 @@ void handleMachineState() {
                     machineState = kSteam;
                     resetStandbyTimer(machineState);
 
-                    if (u8g2 != nullptr) {
-                        u8g2->setPowerSave(0);
-                    }
+                    requestDisplayPowerSave(false);
                 }
 
                 if (backflushOn) {
                     machineState = kBackflush;
                     resetStandbyTimer(machineState);
 
-                    if (u8g2 != nullptr) {
-                        u8g2->setPowerSave(0);
-                    }
+                    requestDisplayPowerSave(false);
                 }
 
                 if (tempSensor != nullptr && tempSensor->hasError()) {
-                    if (u8g2 != nullptr) {
-                        u8g2->setPowerSave(0);
-                    }
+                    requestDisplayPowerSave(false);
 
                     machineState = kSensorError;
                 }
@@ -777,16 +809,6 @@ inline const char* machinestateEnumToString(MachineState state) {
     return "Unknown";
 }
 
-inline std::vector<const char*> getMachineStateOptions() {
-    std::vector<const char*> options;
-
-    for (auto& opt : machineStateOptions) {
-        options.push_back(opt.name);
-    }
-
-    return options;
-}
-
 /**
  * @brief Set up internal WiFi hardware
  */
@@ -982,6 +1004,7 @@ void setup() {
     const auto heaterTriggerType = static_cast<Relay::TriggerType>(config.get<int>("hardware.relays.heater.trigger_type"));
     heaterRelay = new Relay(*heaterRelayPin, heaterTriggerType);
     heaterRelay->off();
+    heaterIsrRelay = new IsrRelay(PIN_HEATER, heaterTriggerType);
 
     valveRelayPin = new GPIOPin(PIN_VALVE, GPIOPin::OUT);
     const auto valveTriggerType = static_cast<Relay::TriggerType>(config.get<int>("hardware.relays.valve.trigger_type"));
@@ -1045,86 +1068,33 @@ void setup() {
     if (!config.get<bool>("system.offline_mode")) { // WiFi Mode
         wiFiSetup();
         serverSetup();
+        setupWebUpdate();
 
         // OTA Updates
         if (WiFi.status() == WL_CONNECTED) {
             otaPass = config.get<String>("system.ota_password");
             ArduinoOTA.setHostname(hostname.c_str()); //  Device name for OTA
             ArduinoOTA.setPassword(otaPass.c_str());  //  Password for OTA
-            ArduinoOTA.begin();
-        }
 
-        setupMqtt();
-
-        if (mqtt_enabled) {
-            // Editable values reported to MQTT
-            mqttVars["pidON"] = "pid.enabled";
-            mqttVars["brewSetpoint"] = "brew.setpoint";
-            mqttVars["brewTempOffset"] = "brew.temp_offset";
-            mqttVars["steamON"] = "STEAM_MODE";
-            mqttVars["steamSetpoint"] = "steam.setpoint";
-            mqttVars["pidUsePonM"] = "pid.use_ponm";
-            mqttVars["aggKp"] = "pid.regular.kp";
-            mqttVars["aggTn"] = "pid.regular.tn";
-            mqttVars["aggTv"] = "pid.regular.tv";
-            mqttVars["aggIMax"] = "pid.regular.i_max";
-            mqttVars["steamKp"] = "pid.steam.kp";
-            mqttVars["standbyModeOn"] = "standby.enabled";
-
-            // Values reported to MQTT
-            mqttSensors["temperature"] = [] { return temperature; };
-            mqttSensors["heaterPower"] = [] { return pidOutput / 10; };
-            mqttSensors["standbyModeTimeRemaining"] = [] { return standbyModeRemainingTimeMillis / 1000; };
-            mqttSensors["currentKp"] = [] { return bPID.GetKp(); };
-            mqttSensors["currentKi"] = [] { return bPID.GetKi(); };
-            mqttSensors["currentKd"] = [] { return bPID.GetKd(); };
-            mqttSensors["machineState"] = [] { return machineState; };
-
-            if (config.get<bool>("hardware.switches.brew.enabled")) {
-                mqttVars["aggbKp"] = "pid.bd.kp";
-                mqttVars["aggbTn"] = "pid.bd.tn";
-                mqttVars["aggbTv"] = "pid.bd.tv";
-                mqttVars["pidUseBD"] = "pid.bd.enabled";
-                mqttVars["brewPidDelay"] = "brew.pid_delay";
-                mqttSensors["currBrewTime"] = [] { return currBrewTime / 1000; };
-                mqttVars["targetBrewTime"] = "brew.by_time.target_time";
-                mqttVars["preinfusion"] = "brew.pre_infusion.time";
-                mqttVars["preinfusionPause"] = "brew.pre_infusion.pause";
-                mqttVars["backflushOn"] = "BACKFLUSH_ON";
-                mqttVars["backflushCycles"] = "backflush.cycles";
-                mqttVars["backflushFillTime"] = "backflush.fill_time";
-                mqttVars["backflushFlushTime"] = "backflush.flush_time";
-            }
-
-            if (config.get<bool>("hardware.sensors.scale.enabled")) {
-                if (config.get<bool>("brew.mode") == 1) {
-                    mqttVars["targetBrewWeight"] = "brew.by_weight.target_weight";
-                }
-
-                mqttVars["scaleCalibration"] = "hardware.sensors.scale.calibration";
-
-                if (config.get<int>("hardware.sensors.scale.type") == 0) {
-                    mqttVars["scale2Calibration"] = "hardware.sensors.scale.calibration2";
-                }
+            // Disable interrupt if OTA is starting, otherwise it will not work
+            ArduinoOTA.onStart([]() {
+                disableTimer1();
+                heaterRelay->off();
+            });
 
-                mqttVars["scaleKnownWeight"] = "hardware.sensors.scale.known_weight";
-                mqttVars["scaleTareOn"] = "TARE_ON";
-                mqttVars["scaleCalibrationOn"] = "CALIBRATION_ON";
+            ArduinoOTA.onError([](ota_error_t error) { enableTimer1(); });
 
-                mqttSensors["currReadingWeight"] = [] { return currReadingWeight; };
-                mqttSensors["currBrewWeight"] = [] { return currBrewWeight; };
-            }
+            // Enable interrupts if OTA is finished
+            ArduinoOTA.onEnd([]() { enableTimer1(); });
 
-            if (config.get<bool>("hardware.sensors.pressure.enabled")) {
-                mqttSensors["pressure"] = [] { return inputPressureFilter; };
-            }
+            ArduinoOTA.begin();
+        }
 
-            snprintf(topic_will, sizeof(topic_will), "%s%s/%s", mqtt_topic_prefix.c_str(), hostname.c_str(), "status");
-            snprintf(topic_set, sizeof(topic_set), "%s%s/+/%s", mqtt_topic_prefix.c_str(), hostname.c_str(), "set");
-            mqtt.setServer(mqtt_server_ip.c_str(), mqtt_server_port);
-            mqtt.setCallback(mqtt_callback);
+        setupMqtt();
 
-            checkMQTT();
+        if (mqtt_enabled) {
+            buildMqttTopics();
+            startMqttTask();
 
             if (mqtt_hassio_enabled) {
                 sendHASSIODiscoveryMsg();
@@ -1215,20 +1185,25 @@ void setup() {
             machineState = kPidDisabled;
         }
     }
+
+    startControlTask();
 }
 
 void loop() {
     // Accept potential connections for remote logging
     Logger::update();
 
-    // Update water tank sensor
-    loopWaterTank();
+    // Networking, scale, pressure and display, the control loop runs in its own task
+    loopInterface();
 
-    // Update PID settings & machine state
-    loopPid();
+    // Supervise web firmware uploads (stall timeout, deferred reboot)
+    loopWebUpdate();
 
     // Update LED output based on machine state
-    loopLED();
+    {
+        ControlLock lock;
+        loopLED();
+    }
 
     // print timing related data to check what is causing stutters
     debugTimingLoop();
@@ -1237,7 +1212,10 @@ void loop() {
     ParameterRegistry::getInstance().processPeriodicSave();
 }
 
-void loopPid() {
+void loopControl() {
+
+    // Apply the toggles requested from the web interface
+    processWebCommands();
 
     // Update the temperature:
     temperatureUpdateRunning = false;
@@ -1250,6 +1228,103 @@ void loopPid() {
         }
     }
 
+    // Update water tank sensor
+    loopWaterTank();
+
+    testEmergencyStop(); // test if temp is too high
+    bPID.Compute();      // the variable pidOutput now has new values from PID (handed to the ISR by publishHeaterDuty())
+
+    // limit the heater duty if the power budget is shared with other machines
+    loopPowerCoordination();
+
+    checkSteamSwitch();
+
+    // set setpoint depending on steam or brew mode
+    if (steamON == 1) {
+        setpoint = steamSetpoint;
+    }
+    else if (steamON == 0) {
+        setpoint = brewSetpoint;
+    }
+
+    updateStandbyTimer();
+    handleMachineState();
+    loopShotTelemetry();
+    hotWaterHandler();
+    valveSafetyShutdownCheck();
+    testTimer();
+
+    // Check if PID should run or not. If not, set to manual and force output to zero (also while a firmware upload is running)
+    if (machineState == kPidDisabled || machineState == kWaterTankEmpty || machineState == kSensorError || machineState == kEmergencyStop || machineState == kStandby || machineState == kBackflush || brewPidDisabled ||
+        otaUpdateRunning) {
+        if (bPID.GetMode() == 1) {
+            // Force PID shutdown
+            bPID.SetMode(0);
+            pidOutput = 0;
+            heaterRelay->off();
+        }
+    }
+    else { // no sensorerror, no pid off or no Emergency Stop
+        if (bPID.GetMode() == 0) {
+            bPID.SetMode(1);
+        }
+    }
+
+    // Regular PID operation
+    if (machineState == kPidNormal) {
+        setPIDTunings(usePonM);
+    }
+
+    // Brew PID
+    if (machineState == kBrew) {
+        if (brewPidDelay > 0 && currBrewTime > 0 && currBrewTime < brewPidDelay * 1000) {
+            // disable PID for brewPidDelay seconds, enable PID again with new tunings after that
+            if (!brewPidDisabled) {
+                brewPidDisabled = true;
+                bPID.SetMode(MANUAL);
+                pidOutput = 0;
+                heaterRelay->off();
+                LOGF(DEBUG, "disabled PID, waiting for %.0f seconds before enabling PID again", brewPidDelay);
+            }
+        }
+        else {
+            if (brewPidDisabled) {
+                // enable PID again
+                bPID.SetMode(AUTOMATIC);
+                brewPidDisabled = false;
+                LOGF(DEBUG, "Enabled PID again after %.0f seconds of brew pid delay", brewPidDelay);
+            }
+
+            if (useBDPID) {
+                setBDPIDTunings();
+            }
+            else {
+                setPIDTunings(usePonM);
+            }
+        }
+    }
+    // Reset brewPidDisabled if brew was aborted
+    if (machineState != kBrew && brewPidDisabled) {
+        // enable PID again
+        bPID.SetMode(AUTOMATIC);
+        brewPidDisabled = false;
+        LOG(DEBUG, "Enabled PID again after brew was manually stopped");
+    }
+
+    // Steam on
+    if (machineState == kSteam) {
+        if (lastmachinestatepid != machineState) {
+            LOGF(DEBUG, "new PID-Values: P=%.1f  I=%.1f  D=%.1f", 150.0, 0.0, 0.0);
+            lastmachinestatepid = machineState;
+        }
+
+        bPID.SetTunings(steamKp, 0, 0, 1);
+    }
+
+    publishHeaterDuty(pidOutput);
+}
+
+void loopInterface() {
     static bool wifiWasConnected = false;
 
     // Only do Wifi stuff, if Wifi is connected
@@ -1261,23 +1336,25 @@ void loopPid() {
         }
 
         if (mqtt_enabled) {
+            ControlLock lock;
             mqttUpdateRunning = false;
 
-            if (getSignalStrength() > 1) {
-                checkMQTT();
+            // the connection itself is handled by the MQTT task, only exchange messages with it here
+            processMqttCommands();
+
+            // if screen is ready to refresh wait for next loop
+            if (!displayBufferReady && !temperatureUpdateRunning) {
+                const uint32_t publishStart = micros();
+                writeSysParamsToMQTT();
 
-                // if screen is ready to refresh wait for next loop
-                if (!displayBufferReady && !temperatureUpdateRunning) {
-                    writeSysParamsToMQTT(true); // Continue on error
+                if (mqttUpdateRunning) {
+                    mqttStats.record(MqttStats::PUBLISH_CYCLE, micros() - publishStart);
                 }
             }
 
             hassioUpdateRunning = false;
 
-            if (mqtt.connected() == 1) {
-                mqtt.loop();
-                previousMqttConnection = millis();
-
+            if (mqttConnected) {
                 if (mqtt_hassio_enabled) {
                     // resend discovery messages if not during a main function and MQTT has been disconnected but has now reconnected, or if last send failed
                     if (!(machineState >= kBrew && machineState <= kBackflush) && ((!mqtt_was_connected || hassioFailed) && !displayBufferReady && !temperatureUpdateRunning)) {
@@ -1296,17 +1373,6 @@ void loopPid() {
 
         ArduinoOTA.handle(); // For OTA
 
-        // Disable interrupt if OTA is starting, otherwise it will not work
-        ArduinoOTA.onStart([]() {
-            disableTimer1();
-            heaterRelay->off();
-        });
-
-        ArduinoOTA.onError([](ota_error_t error) { enableTimer1(); });
-
-        // Enable interrupts if OTA is finished
-        ArduinoOTA.onEnd([]() { enableTimer1(); });
-
         wifiReconnects = 0; // reset wifi reconnects if connected
     }
     else {
@@ -1314,21 +1380,31 @@ void loopPid() {
         checkWifi();
     }
 
-    testEmergencyStop(); // test if temp is too high
-    bPID.Compute();      // the variable pidOutput now has new values from PID (will be written to heater pin in ISR.cpp)
-
     websiteUpdateRunning = false;
 
     // refresh website if loop does not have anoth long running process already
     if (((millis() - lastTempEvent) > tempEventInterval) && (!mqttUpdateRunning && !hassioUpdateRunning && !displayBufferReady && !temperatureUpdateRunning)) {
         websiteUpdateRunning = true;
 
-        // send temperatures to website endpoint
-        sendTempEvent(temperature, brewSetpoint, pidOutput / 10); // pidOutput is promill, so /10 to get percent value
+        double currentTemp;
+        double targetTemp;
+        double heaterPower;
+
+        {
+            ControlLock lock;
+            currentTemp = temperature;
+            targetTemp = brewSetpoint;
+            heaterPower = pidOutput / 10; // pidOutput is promill, so /10 to get percent value
+        }
+
+        // send temperatures to website endpoint, without the lock as the event is queued for every connected client
+        sendTempEvent(currentTemp, targetTemp, heaterPower);
 
         lastTempEvent = millis();
 
         if (pidON) {
+            ControlLock lock;
+
             LOGF(TRACE, "Current PID mode: %s", bPID.GetPonE() ? "PonE" : "PonM");
 
             // P-Part
@@ -1353,7 +1429,10 @@ void loopPid() {
     }
 
     if (scale) {
-        checkWeight();    // Check Weight Scale in the loop
+        const float weight = checkWeight(); // Check Weight Scale in the loop
+
+        ControlLock lock;
+        currReadingWeight = weight;
         shotTimerScale(); // Calculation of weight of shot while brew is running
     }
 
@@ -1365,30 +1444,26 @@ void loopPid() {
         }
     }
 
-    checkSteamSwitch();
-    checkPowerSwitch();
+    int8_t displayPowerSave;
 
-    // set setpoint depending on steam or brew mode
-    if (steamON == 1) {
-        setpoint = steamSetpoint;
-    }
-    else if (steamON == 0) {
-        setpoint = brewSetpoint;
-    }
+    {
+        ControlLock lock;
+        checkPowerSwitch();
 
-    updateStandbyTimer();
-    handleMachineState();
-    hotWaterHandler();
-    valveSafetyShutdownCheck();
-    testTimer();
+        if (config.get<bool>("hardware.switches.brew.enabled")) {
+            shouldDisplayBrewTimer();
+        }
 
-    if (config.get<bool>("hardware.switches.brew.enabled")) {
-        shouldDisplayBrewTimer();
+        displayPowerSave = displayPowerSaveRequest;
+        displayPowerSaveRequest = -1;
     }
 
     displayUpdateRunning = false;
 
     if (u8g2 != nullptr) {
+        if (displayPowerSave >= 0) {
+            u8g2->setPowerSave(displayPowerSave);
+        }
 
         // update display on loops that have not had other major tasks running, if blocked it will send in the next loop (average 0.5ms)
         if ((!websiteUpdateRunning && !mqttUpdateRunning && !hassioUpdateRunning && !temperatureUpdateRunning) || (millis() - lastDisplayUpdate > 500)) {
@@ -1396,14 +1471,17 @@ void loopPid() {
             if (standbyModeRemainingTimeDisplayOffMillis > 0) {
 
                 // displayUpdateRunning currently doesn't block anything as it is near the end of the loop, but if this code block moves it can be used to block other processes
-                // sendBuffer() takes around 35ms so it flags that it has happened
+                // sendBuffer() takes around 35ms so it flags that it has happened, it only touches the display and runs without holding the control lock
                 if (displayBufferReady) {
                     u8g2->sendBuffer();
                     displayBufferReady = false;
                     displayUpdateRunning = true;
                 }
                 else {
-                    printDisplayTimer();
+                    {
+                        ControlLock lock;
+                        printDisplayTimer();
+                    }
 
                     if (millis() - lastDisplayUpdate > 500) {
                         u8g2->sendBuffer();
@@ -1415,78 +1493,12 @@ void loopPid() {
             lastDisplayUpdate = millis();
         }
     }
-
-    // Check if PID should run or not. If not, set to manual and force output to zero
-    if (machineState == kPidDisabled || machineState == kWaterTankEmpty || machineState == kSensorError || machineState == kEmergencyStop || machineState == kStandby || machineState == kBackflush || brewPidDisabled) {
-        if (bPID.GetMode() == 1) {
-            // Force PID shutdown
-            bPID.SetMode(0);
-            pidOutput = 0;
-            heaterRelay->off();
-        }
-    }
-    else { // no sensorerror, no pid off or no Emergency Stop
-        if (bPID.GetMode() == 0) {
-            bPID.SetMode(1);
-        }
-    }
-
-    // Regular PID operation
-    if (machineState == kPidNormal) {
-        setPIDTunings(usePonM);
-    }
-
-    // Brew PID
-    if (machineState == kBrew) {
-        if (brewPidDelay > 0 && currBrewTime > 0 && currBrewTime < brewPidDelay * 1000) {
-            // disable PID for brewPidDelay seconds, enable PID again with new tunings after that
-            if (!brewPidDisabled) {
-                brewPidDisabled = true;
-                bPID.SetMode(MANUAL);
-                pidOutput = 0;
-                heaterRelay->off();
-                LOGF(DEBUG, "disabled PID, waiting for %.0f seconds before enabling PID again", brewPidDelay);
-            }
-        }
-        else {
-            if (brewPidDisabled) {
-                // enable PID again
-                bPID.SetMode(AUTOMATIC);
-                brewPidDisabled = false;
-                LOGF(DEBUG, "Enabled PID again after %.0f seconds of brew pid delay", brewPidDelay);
-            }
-
-            if (useBDPID) {
-                setBDPIDTunings();
-            }
-            else {
-                setPIDTunings(usePonM);
-            }
-        }
-    }
-    // Reset brewPidDisabled if brew was aborted
-    if (machineState != kBrew && brewPidDisabled) {
-        // enable PID again
-        bPID.SetMode(AUTOMATIC);
-        brewPidDisabled = false;
-        LOG(DEBUG, "Enabled PID again after brew was manually stopped");
-    }
-
-    // Steam on
-    if (machineState == kSteam) {
-        if (lastmachinestatepid != machineState) {
-            LOGF(DEBUG, "new PID-Values: P=%.1f  I=%.1f  D=%.1f", 150.0, 0.0, 0.0);
-            lastmachinestatepid = machineState;
-        }
-
-        bPID.SetTunings(steamKp, 0, 0, 1);
-    }
 }
 
 void loopLED() {
     // status LED active when not in error state and temperature is in setpoint range
     if (config.get<bool>("hardware.leds.status.enabled") && statusLed != nullptr) {
-        bool nearSetpoint = fabs(temperature - setpoint) <= (machineState == kSteam ? 5 : config.get<float>("display.blinking.delta"));
+        bool nearSetpoint = fabsf(temperature - setpoint) <= (machineState == kSteam ? 5 : config.get<float>("display.blinking.delta"));
 
         if (machineState <= kBackflush && nearSetpoint) {
             statusLed->turnOn();
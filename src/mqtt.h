@@ -8,19 +8,22 @@
 #pragma once
 
 #include "Parameter.h"
+#include "mqttTopicTable.h"
+#include "utils/ChunkedPrint.h"
+#include "utils/MqttOutbox.h"
+#include "utils/PowerBudget.h"
+#include "utils/ResponseWriter.h"
+#include "utils/StoreForwardBuffer.h"
 #include <Arduino.h>
+#include <Preferences.h>
 #include <PubSubClient.h>
-#include <map>
-#include <os.h>
-#include <string>
-
-std::map<const char*, std::string> mqttLastSent;
+#include <cmath>
+#include <vector>
 
 inline unsigned long previousMillisMQTT;
-const unsigned long intervalMQTT = 5000;
-const unsigned long intervalMQTTbrew = 500;
-const unsigned long intervalMQTTstandby = 10000;
-unsigned long timeBudget = 10; // milliseconds per loop until all data is sent
+
+// Publish policies of all topics are evaluated on this tick
+constexpr unsigned long MQTT_POLICY_TICK_MS = 100;
 
 inline WiFiClient net;
 inline PubSubClient mqtt(net);
@@ -34,22 +37,193 @@ inline String mqtt_topic_prefix = "";
 inline bool mqtt_hassio_enabled = false;
 inline String mqtt_hassio_discovery_prefix = "";
 
+/**
+ * @enum HassioDiscoveryMode
+ * @brief How entities are announced to Home Assistant
+ */
+enum HassioDiscoveryMode {
+    kHassioDiscoveryEntity, // one retained config message per entity
+    kHassioDiscoveryDevice  // one retained config message for the whole machine, only sent when it changes
+};
+
+inline HassioDiscoveryMode mqtt_hassio_discovery_mode = kHassioDiscoveryEntity;
+
+// Hash of the published device discovery message, kept in NVS so an unchanged message isn't sent again after a reboot
+constexpr const char* HASSIO_PREFERENCES_NAMESPACE = "hassio";
+constexpr const char* HASSIO_PREFERENCES_HASH_KEY = "deviceHash";
+inline uint32_t hassioPublishedHash = 0;
+
+/**
+ * @enum MqttPublishMode
+ * @brief How values are published to the broker
+ */
+enum MqttPublishMode {
+    kMqttPerTopic,     // one retained message per value, "<prefix><hostname>/<name>"
+    kMqttStateDocument // all values in one JSON document, "<prefix><hostname>/state"
+};
+
+inline MqttPublishMode mqtt_publish_mode = kMqttPerTopic;
+inline bool mqtt_shot_telemetry_enabled = false;
+inline int mqtt_shot_telemetry_rate = MQTT_SHOT_TELEMETRY_RATE;
+inline bool mqtt_power_enabled = false;
+inline String mqtt_power_topic = "";
+inline int mqtt_power_budget = MQTT_POWER_BUDGET;
+inline int mqtt_power_heater_watts = MQTT_POWER_HEATER_WATTS;
+inline int mqtt_power_priority = MQTT_POWER_PRIORITY;
+inline int mqtt_power_fallback = MQTT_POWER_FALLBACK;
+
 inline char topic_will[256];
 inline char topic_set[256];
+inline char topic_config_ack[256];
+inline char topic_state[256];
+inline char topic_shot_samples[256];
+inline char topic_shot_summary[256];
+inline char topic_power[256];
+inline char topic_power_subscribe[256];
+inline char topic_hassio_status[128];
 
 inline unsigned long lastMQTTConnectionAttempt = millis();
 inline unsigned int MQTTReCnctCount = 0;
 unsigned long previousMqttConnection = millis();
 unsigned long mqttReconnectInterval = 300000; // 5 minutes
 
-extern std::map<const char*, const char*, cmp_str> mqttVars;
-extern std::map<const char*, std::function<double()>, cmp_str> mqttSensors;
+// The MQTT client runs on its own task, the control loop only exchanges messages with it through these queues
+constexpr size_t MQTT_OUTBOUND_QUEUE_LENGTH = 32;
+constexpr size_t MQTT_INBOUND_QUEUE_LENGTH = 8;
+constexpr uint32_t MQTT_TASK_STACK_SIZE = 6144;
+constexpr UBaseType_t MQTT_TASK_PRIORITY = 1;
+constexpr BaseType_t MQTT_TASK_CORE = 0;
+constexpr uint32_t MQTT_TASK_IDLE_MS = 50; // longest wait for outbound messages before serving the connection again
+constexpr uint16_t MQTT_SOCKET_TIMEOUT = 5; // seconds, bounds connect() and writes on a congested link
+constexpr uint16_t MQTT_PACKET_SIZE = 512; // largest inbound message, bounds the size of a bulk config set
+
+// Bulk parameter changes received on "<prefix><hostname>/config/set", applied by the control loop in one step
+constexpr size_t MQTT_CONFIG_SET_MAX_KEYS = 16;
+constexpr size_t MQTT_CONFIG_SET_QUEUE_LENGTH = 2;
+
+// The state document is built in a fixed buffer and handed to the MQTT task through a single slot mailbox, only the latest one matters
+constexpr size_t MQTT_STATE_DOCUMENT_SIZE = 1536;
+
+// Messages buffered while the broker is unreachable are sent in batches after reconnecting, so the link isn't flooded
+constexpr size_t MQTT_FLUSH_BATCH = 8;
+constexpr uint32_t MQTT_FLUSH_INTERVAL_MS = 100;
+
+// Shot telemetry is recorded by the control loop and handed to the MQTT task in batches of about one second
+constexpr size_t SHOT_TELEMETRY_BATCH_SIZE = MQTT_SHOT_TELEMETRY_RATE_MAX;
+constexpr uint32_t SHOT_TELEMETRY_BATCH_INTERVAL = 1000;
+constexpr size_t SHOT_TELEMETRY_QUEUE_LENGTH = 3;
+
+// Heater demands of the other machines sharing the power budget, received by the MQTT task and applied by the control loop
+constexpr size_t MQTT_POWER_QUEUE_LENGTH = PowerBudget::MAX_MACHINES;
+
+/**
+ * @brief Value queued for publishing, topic is an index into the topic table
+ */
+struct MqttOutboundMessage {
+        uint16_t topic;
+        char payload[22];
+};
+
+/**
+ * @brief Parameter change received from the broker, applied by the control loop
+ */
+struct MqttCommand {
+        uint16_t topic;
+        double value;
+};
+
+/**
+ * @brief Validated set of parameter changes that has to be applied as a whole
+ */
+struct MqttConfigSet {
+        size_t count;
+        MqttCommand commands[MQTT_CONFIG_SET_MAX_KEYS];
+};
+
+/**
+ * @brief Values recorded at one point of a shot
+ */
+struct ShotSample {
+        uint32_t time; // ms since the start of the shot
+        float temperature;
+        float pressure;
+        float weight;
+        float flow; // g/s
+        bool pump;
+        bool valve;
+};
 
-struct DiscoveryObject {
-        char discovery_topic[160];
-        char payload_json[650];
+/**
+ * @brief Statistics of a finished shot
+ */
+struct ShotSummary {
+        uint32_t duration; // ms
+        float weight;
+        float temperatureAverage;
+        float temperatureMin;
+        float temperatureMax;
+        float pressureAverage;
+        float pressureMax;
+        float flowMax;
+        uint32_t samples;
+        uint32_t dropped; // batches that couldn't be queued
 };
 
+/**
+ * @brief Batch of shot samples, or the summary once the shot is over
+ */
+struct ShotTelemetryMessage {
+        uint32_t shot;
+        uint16_t sequence;
+        uint8_t count; // number of samples, 0 marks a summary
+        ShotSample samples[SHOT_TELEMETRY_BATCH_SIZE];
+        ShotSummary summary;
+};
+
+/**
+ * @brief Shot summary as kept in the offline buffer
+ */
+struct StoredShotSummary {
+        uint32_t shot;
+        ShotSummary summary;
+};
+
+// Offline buffer topic of shot summaries, all other buffer topics are indices into the topic table
+constexpr uint16_t MQTT_SHOT_SUMMARY_TOPIC = UINT16_MAX;
+
+inline TaskHandle_t mqttTaskHandle = nullptr;
+inline QueueHandle_t mqttOutboundQueue = nullptr;
+inline QueueHandle_t mqttSendFailedQueue = nullptr; // topics whose publish failed, reported back so the control loop sends them again
+inline QueueHandle_t mqttInboundQueue = nullptr;
+inline QueueHandle_t mqttConfigSetQueue = nullptr;
+inline QueueHandle_t mqttStateQueue = nullptr;
+inline QueueHandle_t mqttShotQueue = nullptr; // only created if shot telemetry is enabled
+inline QueueHandle_t mqttPowerQueue = nullptr; // only created if power coordination is enabled, like the announce mailbox
+inline QueueHandle_t mqttPowerAnnounceQueue = nullptr;
+
+// Only used by the MQTT task
+inline MqttOutbox mqttOutbox;
+
+// Set by the MQTT task, read by the control loop
+inline volatile bool mqttConnected = false;
+inline volatile bool mqttResyncRequested = false;
+
+// Set by the control loop or the webserver, read by the MQTT task or the control loop
+inline volatile bool mqttRepublishRequested = false;
+inline volatile bool mqttDiscoveryRequested = false;
+inline volatile bool hassioForceRequested = false; // publish device discovery even if unchanged, set when Home Assistant restarts
+
+inline MqttTopicState mqttTopicStates[MQTT_MAX_TOPICS];
+
+// full topic names ("<prefix><hostname>/<name>"), built once by buildMqttTopics()
+inline std::vector<char> mqttTopicArena;
+
+inline char mqttTopicBase[256];
+inline size_t mqttTopicBaseLength = 0;
+
+// Inbound topics are routed by matching "<prefix><hostname>/" and looking up the name segment
+inline MqttRouter mqttRouter;
+
 inline void setupMqtt() {
     ParameterRegistry& registry = ParameterRegistry::getInstance();
 
@@ -71,14 +245,49 @@ inline void setupMqtt() {
     mqtt_topic_prefix = registry.getParameterById("mqtt.topic")->getValueAs<String>();
     mqtt_hassio_enabled = registry.getParameterById("mqtt.hassio.enabled")->getValueAs<bool>();
     mqtt_hassio_discovery_prefix = registry.getParameterById("mqtt.hassio.prefix")->getValueAs<String>();
+    mqtt_hassio_discovery_mode = static_cast<HassioDiscoveryMode>(registry.getParameterById("mqtt.hassio.discovery_mode")->getValueAs<int>());
+    mqtt_publish_mode = static_cast<MqttPublishMode>(registry.getParameterById("mqtt.publish_mode")->getValueAs<int>());
+    mqtt_shot_telemetry_enabled = registry.getParameterById("mqtt.shot_telemetry.enabled")->getValueAs<bool>();
+    mqtt_shot_telemetry_rate = registry.getParameterById("mqtt.shot_telemetry.rate")->getValueAs<int>();
+    mqtt_power_enabled = registry.getParameterById("mqtt.power.enabled")->getValueAs<bool>();
+    mqtt_power_topic = registry.getParameterById("mqtt.power.topic")->getValueAs<String>();
+
+    // The machines subscribe to "<topic>+" and match incoming commands by prefix, so the topic has to be a non-empty level of its own
+    if (mqtt_power_topic.isEmpty() || mqtt_power_topic.indexOf('+') >= 0 || mqtt_power_topic.indexOf('#') >= 0) {
+        LOGF(WARNING, "Invalid power coordination topic '%s', using %s", mqtt_power_topic.c_str(), MQTT_POWER_TOPIC);
+        mqtt_power_topic = MQTT_POWER_TOPIC;
+    }
+    else if (!mqtt_power_topic.endsWith("/")) {
+        mqtt_power_topic += '/';
+    }
+
+    mqtt_power_budget = registry.getParameterById("mqtt.power.budget")->getValueAs<int>();
+    mqtt_power_heater_watts = registry.getParameterById("mqtt.power.heater_watts")->getValueAs<int>();
+    mqtt_power_priority = registry.getParameterById("mqtt.power.priority")->getValueAs<int>();
+    mqtt_power_fallback = registry.getParameterById("mqtt.power.fallback")->getValueAs<int>();
+
+    const int bufferSize = registry.getParameterById("mqtt.buffer.size")->getValueAs<int>();
+    const auto dropPolicy = static_cast<StoreForwardBuffer::DropPolicy>(registry.getParameterById("mqtt.buffer.drop_policy")->getValueAs<int>());
+
+    if (!mqttOutbox.begin(bufferSize, dropPolicy) && bufferSize > 0) {
+        LOGF(WARNING, "Could not allocate %i bytes for the MQTT offline buffer", bufferSize);
+    }
+
+    Preferences preferences;
+
+    if (preferences.begin(HASSIO_PREFERENCES_NAMESPACE, true)) {
+        hassioPublishedHash = preferences.getUInt(HASSIO_PREFERENCES_HASH_KEY, 0);
+        preferences.end();
+    }
 }
 
 /**
- * @brief Check if MQTT is connected, if not reconnect. Abort function if offline or brew is running
+ * @brief Check if MQTT is connected, if not reconnect. Abort function if offline
  *      MQTT is also using maxWifiReconnects!
+ *      Only called from the MQTT task, so a blocking connect() doesn't delay the control loop
  */
 inline void checkMQTT() {
-    if (offlineMode || checkBrewActive()) {
+    if (offlineMode) {
         return;
     }
 
@@ -95,6 +304,17 @@ inline void checkMQTT() {
             if (mqtt.connect(hostname.c_str(), mqtt_username.c_str(), mqtt_password.c_str(), topic_will, 0, true, "offline")) {
                 mqtt.subscribe(topic_set);
                 LOGF(DEBUG, "Subscribed to MQTT Topic: %s", topic_set);
+
+                // replaces the retained last will, so that clients subscribing later don't see the machine as offline
+                mqtt.publish(topic_will, "online", true);
+
+                if (mqtt_hassio_enabled) {
+                    mqtt.subscribe(topic_hassio_status);
+                }
+
+                if (mqtt_power_enabled) {
+                    mqtt.subscribe(topic_power_subscribe);
+                }
                 MQTTReCnctCount = 0; // reset MQTT reconnect count to zero after a successful connection
             } // Try to reconnect to the server; connect() is a blocking
               // function, watch the timeout!
@@ -110,606 +330,1076 @@ inline void checkMQTT() {
     }
 }
 
+inline bool isMqttFeatureEnabled(const MqttTopicFeature feature) {
+    switch (feature) {
+        case kMqttBrewSwitch:
+            return config.get<bool>("hardware.switches.brew.enabled");
+        case kMqttScale:
+            return config.get<bool>("hardware.sensors.scale.enabled");
+        case kMqttScaleByWeight:
+            return config.get<bool>("hardware.sensors.scale.enabled") && config.get<int>("brew.mode") != 0;
+        case kMqttDualScale:
+            return config.get<bool>("hardware.sensors.scale.enabled") && config.get<int>("hardware.sensors.scale.type") == 0;
+        case kMqttPressure:
+            return config.get<bool>("hardware.sensors.pressure.enabled");
+        default:
+            return true;
+    }
+}
+
 /**
- * @brief Publish Data to MQTT
+ * @brief Resolve the topic table against the current configuration and precompute all topic names
+ * @details Has to be called again whenever the hostname or the topic prefix change, publishing itself doesn't format any topic names
  */
-inline bool mqtt_publish(const char* reading, const char* payload, const boolean retain = false) {
-    char topic[120];
-    snprintf(topic, 120, "%s%s/%s", mqtt_topic_prefix.c_str(), hostname.c_str(), reading);
-    return mqtt.publish(topic, payload, retain);
+inline void buildMqttTopics() {
+    auto& registry = ParameterRegistry::getInstance();
+    const size_t baseLength = mqtt_topic_prefix.length() + hostname.length() + 1;
+    size_t arenaSize = 0;
+
+    for (size_t i = 0; i < mqttTopicCount; i++) {
+        arenaSize += baseLength + strlen(mqttTopics[i].name) + 1;
+    }
+
+    mqttTopicArena.assign(arenaSize, '\0');
+    size_t offset = 0;
+
+    for (size_t i = 0; i < mqttTopicCount; i++) {
+        const MqttTopic& topic = mqttTopics[i];
+        MqttTopicState& state = mqttTopicStates[i];
+
+        state.parameter = nullptr;
+        state.offset = static_cast<uint16_t>(offset);
+        state.lastSent = MQTT_NEVER_SENT;
+        state.lastSentAt = 0;
+        state.enabled = isMqttFeatureEnabled(topic.feature);
+        state.format = kMqttDecimal;
+
+        if (topic.parameterId != nullptr) {
+            state.parameter = registry.getParameterById(topic.parameterId).get();
+
+            if (state.parameter == nullptr || state.parameter->getType() == kCString || state.parameter->getType() == kEnum) {
+                LOGF(WARNING, "Parameter %s can not be published on MQTT topic %s", topic.parameterId, topic.name);
+                state.enabled = false;
+            }
+            else if (state.parameter->getType() == kInteger) {
+                state.format = kMqttInteger;
+            }
+            else if (state.parameter->getType() == kUInt8) {
+                state.format = kMqttUnsigned;
+            }
+        }
+
+        offset += snprintf(&mqttTopicArena[offset], arenaSize - offset, "%s%s/%s", mqtt_topic_prefix.c_str(), hostname.c_str(), topic.name) + 1;
+    }
+
+    snprintf(topic_will, sizeof(topic_will), "%s%s/%s", mqtt_topic_prefix.c_str(), hostname.c_str(), "status");
+    snprintf(topic_set, sizeof(topic_set), "%s%s/+/%s", mqtt_topic_prefix.c_str(), hostname.c_str(), "set");
+    snprintf(topic_config_ack, sizeof(topic_config_ack), "%s%s/%s", mqtt_topic_prefix.c_str(), hostname.c_str(), "config/ack");
+    snprintf(topic_state, sizeof(topic_state), "%s%s/%s", mqtt_topic_prefix.c_str(), hostname.c_str(), "state");
+    snprintf(topic_shot_samples, sizeof(topic_shot_samples), "%s%s/%s", mqtt_topic_prefix.c_str(), hostname.c_str(), "shot/samples");
+    snprintf(topic_shot_summary, sizeof(topic_shot_summary), "%s%s/%s", mqtt_topic_prefix.c_str(), hostname.c_str(), "shot/summary");
+    snprintf(topic_hassio_status, sizeof(topic_hassio_status), "%s/status", mqtt_hassio_discovery_prefix.c_str());
+    snprintf(topic_power, sizeof(topic_power), "%s%s", mqtt_power_topic.c_str(), hostname.c_str());
+    snprintf(topic_power_subscribe, sizeof(topic_power_subscribe), "%s+", mqtt_power_topic.c_str());
+    mqttTopicBaseLength = min(static_cast<size_t>(snprintf(mqttTopicBase, sizeof(mqttTopicBase), "%s%s/", mqtt_topic_prefix.c_str(), hostname.c_str())), sizeof(mqttTopicBase) - 1);
+
+    mqttRouter.build(mqttTopics, mqttTopicStates, mqttTopicCount);
 }
 
 /**
- * @brief Publishes a large message to an MQTT topic, splitting it into smaller chunks if necessary.
+ * @brief Find an enabled topic by its name
  *
- * @param topic The MQTT topic to publish the message to.
- * @param largeMessage The large message to be published.
- * @return 0 if the message was successfully published, otherwise an MQTT error code.
+ * @param name Topic name, doesn't have to be null terminated
+ * @param length Length of the name
+ * @return Index into the topic table, -1 if there is no such topic
  */
-inline int PublishLargeMessage(const char* topic, const char* largeMessage) {
-    constexpr size_t splitSize = 128; // Maximum Message Size
+inline int findMqttTopic(const char* name, const size_t length) {
+    return mqttRouter.find(name, length);
+}
 
-    if (const size_t messageLength = strlen(largeMessage); messageLength > splitSize) {
-        const size_t count = messageLength / splitSize;
-        mqtt.beginPublish(topic, messageLength, true);
+inline int findMqttTopic(const char* name) {
+    return findMqttTopic(name, strlen(name));
+}
 
-        for (size_t i = 0; i < count; i++) {
-            mqtt.print(String(largeMessage + i * splitSize).substring(0, splitSize));
-        }
+/**
+ * @brief Read the current value of a topic
+ */
+inline double readMqttTopic(const size_t index) {
+    const MqttTopicState& state = mqttTopicStates[index];
 
-        mqtt.print(String(largeMessage + count * splitSize));
+    return state.parameter != nullptr ? state.parameter->getValue() : mqttTopics[index].read();
+}
 
-        if (int publishResult = mqtt.endPublish(); publishResult == 0) {
-            LOG(WARNING, "[MQTT] PublishLargeMessage sent failed");
-            return 1;
-        }
-        else {
-            return 0;
-        }
+/**
+ * @brief Format the payload of a topic
+ */
+inline void formatMqttValue(const size_t index, const double value, char* buf, const size_t size) {
+    if (mqttTopics[index].payload == kMqttMachineState) {
+        snprintf(buf, size, "%s", machinestateEnumToString(static_cast<MachineState>(value)));
+        return;
     }
-    else {
-        return mqtt.publish(topic, largeMessage) ? 0 : -1; // Return 0 for success, -1 for failure
+
+    formatMqttNumber(mqttTopicStates[index].format, value, buf, size);
+}
+
+/**
+ * @brief Queue a value of a topic of the table for the MQTT task and remember it as sent
+ * @details In state document mode the value is sent with the next document instead, which is requested right away
+ *
+ * @param index Index into the topic table
+ * @param value Value to publish
+ * @return false if the queue is full
+ */
+inline bool publishMqttTopic(const size_t index, const double value) {
+    if (mqtt_publish_mode == kMqttStateDocument) {
+        mqttTopicStates[index].lastSent = MQTT_NEVER_SENT;
+        mqttRepublishRequested = true;
+
+        return true;
+    }
+
+    MqttOutboundMessage message;
+    message.topic = static_cast<uint16_t>(index);
+    formatMqttValue(index, value, message.payload, sizeof(message.payload));
+
+    if (xQueueSend(mqttOutboundQueue, &message, 0) != pdTRUE) {
+        mqttStats.addDropped();
+        return false;
     }
+
+    mqttTopicStates[index].lastSent = quantizeMqttValue(value);
+    mqttTopicStates[index].lastSentAt = millis();
+
+    return true;
 }
 
 /**
- * @brief Assign the value of the mqtt parameter to the associated variable
+ * @brief Account a message handed to the client in the MQTT statistics, called by the MQTT task
  *
- * @param param MQTT parameter name
- * @param value MQTT value
+ * @param start micros() before the message was handed to the client
+ * @param topic Topic of the message
+ * @param length Payload length
+ * @param sent Result of the publish
+ * @return sent
  */
-inline void assignMQTTParam(char* param, double value) {
-    try {
-        const auto it = mqttVars.find(param);
+inline bool recordMqttSend(const uint32_t start, const char* topic, const size_t length, const bool sent) {
+    mqttStats.record(MqttStats::SEND, micros() - start);
+    mqttStats.addMessage(strlen(topic) + length, sent);
 
-        if (it == mqttVars.end()) {
-            LOGF(WARNING, "MQTT topic %s not found in mapping", param);
-            return;
+    return sent;
+}
+
+/**
+ * @brief Publish a queued message, called by the MQTT task
+ * @details The topic state table belongs to the control loop, only its constant fields are read here
+ */
+inline bool sendMqttMessage(const MqttOutboundMessage& message) {
+    const MqttTopicState& state = mqttTopicStates[message.topic];
+    const char* topic = &mqttTopicArena[state.offset];
+    const uint32_t start = micros();
+
+    // editable parameters are retained, so that clients know the current setting right after subscribing
+    if (!recordMqttSend(start, topic, strlen(message.payload), mqtt.publish(topic, message.payload, state.parameter != nullptr))) {
+        // have the control loop send the value again, or everything if the report doesn't fit
+        if (xQueueSend(mqttSendFailedQueue, &message.topic, 0) != pdTRUE) {
+            mqttResyncRequested = true;
         }
 
-        const char* parameterId = it->second;
+        return false;
+    }
 
-        auto& registry = ParameterRegistry::getInstance();
-        auto var = registry.getParameterById(parameterId);
+    return true;
+}
 
-        if (!var) {
-            LOGF(WARNING, "Parameter %s not found in ParameterRegistry", parameterId);
-            return;
-        }
+/**
+ * @brief Set the parameter of a topic, without publishing the new value
+ *
+ * @param index Index of the parameter in the topic table
+ * @param value MQTT value
+ * @return true if the parameter was changed
+ */
+inline bool applyMqttParam(const size_t index, const double value) {
+    const char* param = mqttTopics[index].name;
+
+    try {
+        const char* parameterId = mqttTopics[index].parameterId;
+        const Parameter* var = mqttTopicStates[index].parameter;
+        auto& registry = ParameterRegistry::getInstance();
 
         if (value >= var->getMinValue() && value <= var->getMaxValue()) {
             bool success = false;
-            char buf[12];
 
             switch (var->getType()) {
                 case kDouble:
                     success = registry.setParameterValue(parameterId, value);
-
-                    if (success) {
-                        snprintf(buf, sizeof(buf), "%.2f", value);
-                    }
-
                     break;
                 case kFloat:
                     success = registry.setParameterValue(parameterId, static_cast<float>(value));
-
-                    if (success) {
-                        snprintf(buf, sizeof(buf), "%.2f", static_cast<float>(value));
-                    }
-
                     break;
                 case kUInt8:
                     success = registry.setParameterValue(parameterId, static_cast<uint8_t>(value));
 
-                    if (success) {
-                        snprintf(buf, sizeof(buf), "%u", static_cast<uint8_t>(value));
-
-                        if (strcasecmp(param, "steamON") == 0) {
-                            steamFirstON = value;
-                        }
+                    if (success && strcmp(param, "steamON") == 0) {
+                        steamFirstON = value;
                     }
 
                     break;
                 case kInteger:
                     success = registry.setParameterValue(parameterId, static_cast<int>(value));
-
-                    if (success) {
-                        snprintf(buf, sizeof(buf), "%d", static_cast<int>(value));
-                    }
-
                     break;
                 default:
-                    LOGF(WARNING, "%s is not a recognized type for this MQTT parameter.", var->getType());
-                    return;
+                    LOGF(WARNING, "%d is not a recognized type for this MQTT parameter.", var->getType());
+                    return false;
             }
 
             if (success) {
-                mqtt_publish(param, buf, true);
                 LOGF(DEBUG, "MQTT parameter %s (ID: %s) updated to %f", param, parameterId, value);
+
+                // sessions are signed with a key derived from the credentials, like a change through the website
+                if (strncmp(parameterId, "system.auth.", 12) == 0) {
+                    refreshSessionKey();
+                }
             }
             else {
                 LOGF(WARNING, "Failed to update MQTT parameter %s", param);
             }
+
+            return success;
         }
-        else {
-            LOGF(WARNING, "Value %f is out of range for MQTT parameter %s (min: %f, max: %f)", value, param, var->getMinValue(), var->getMaxValue());
-        }
+
+        LOGF(WARNING, "Value %f is out of range for MQTT parameter %s (min: %f, max: %f)", value, param, var->getMinValue(), var->getMaxValue());
     } catch (const std::exception& e) {
         LOGF(WARNING, "Error processing MQTT parameter %s: %s", param, e.what());
     }
+
+    return false;
+}
+
+/**
+ * @brief Assign the value of the mqtt parameter to the associated variable and publish the result
+ *
+ * @param index Index of the parameter in the topic table
+ * @param value MQTT value
+ */
+inline void assignMQTTParam(const size_t index, const double value) {
+    if (applyMqttParam(index, value)) {
+        publishMqttTopic(index, mqttTopicStates[index].parameter->getValue());
+    }
+}
+
+/**
+ * @brief Validate a bulk config set and hand it to the control loop, runs on the MQTT task
+ * @details The payload is a JSON object of topic names and values. Either all values are valid and applied together, or none is.
+ * The outcome is published to "<prefix><hostname>/config/ack" with a result per key.
+ */
+inline void handleMqttConfigSet(const byte* data, const unsigned int length) {
+    JsonDocument request;
+    JsonDocument ack;
+    MqttConfigSet set = {};
+    bool valid = true;
+
+    if (deserializeJson(request, data, length) != DeserializationError::Ok || !request.is<JsonObject>()) {
+        valid = false;
+        ack["error"] = "payload is not a JSON object";
+    }
+    else {
+        const JsonObject results = ack["results"].to<JsonObject>();
+
+        for (const JsonPair pair : request.as<JsonObject>()) {
+            const char* name = pair.key().c_str();
+            const int index = findMqttTopic(name);
+            const char* result = "ok";
+
+            if (index < 0 || mqttTopics[index].parameterId == nullptr) {
+                result = "unknown parameter";
+            }
+            else if (!pair.value().is<double>()) {
+                result = "not a number";
+            }
+            else if (const Parameter* parameter = mqttTopicStates[index].parameter;
+                     pair.value().as<double>() < parameter->getMinValue() || pair.value().as<double>() > parameter->getMaxValue()) {
+                result = "out of range";
+            }
+            else if (set.count == MQTT_CONFIG_SET_MAX_KEYS) {
+                result = "too many parameters";
+            }
+            else {
+                set.commands[set.count++] = {static_cast<uint16_t>(index), pair.value().as<double>()};
+            }
+
+            valid = valid && strcmp(result, "ok") == 0;
+            results[name] = result;
+        }
+
+        if (valid && set.count > 0 && xQueueSend(mqttConfigSetQueue, &set, 0) != pdTRUE) {
+            valid = false;
+            ack["error"] = "busy";
+        }
+    }
+
+    ack["ok"] = valid;
+
+    // the request isn't referenced any more, so the client buffer holding it can be reused for the ack
+    const size_t ackLength = measureJson(ack);
+    const uint32_t start = micros();
+    recordMqttSend(start, topic_config_ack, ackLength, mqtt.beginPublish(topic_config_ack, ackLength, false) && serializeJson(ack, mqtt) == ackLength && mqtt.endPublish());
+}
+
+/**
+ * @brief Hand the heater demand announced by another machine to the control loop
+ *
+ * @param name Hostname of the machine, the last level of the topic
+ * @param data Payload, e.g. {"watts":1200,"duty":0.42,"priority":5}
+ * @param length Payload length
+ */
+inline void handleMqttPowerRequest(const char* name, const byte* data, const unsigned int length) {
+    // the own announcement comes back through the wildcard subscription
+    if (*name == '\0' || strlen(name) >= PowerBudget::NAME_SIZE || strcmp(name, hostname.c_str()) == 0) {
+        return;
+    }
+
+    JsonDocument document;
+
+    if (deserializeJson(document, data, length) != DeserializationError::Ok || !document["watts"].is<float>() || !document["duty"].is<float>()) {
+        LOGF(WARNING, "Invalid power request from %s: %.*s", name, static_cast<int>(length), reinterpret_cast<const char*>(data));
+        return;
+    }
+
+    PowerBudget::Request request = {};
+    strlcpy(request.name, name, sizeof(request.name));
+    request.watts = constrain(document["watts"].as<float>(), 0.0f, static_cast<float>(MQTT_POWER_HEATER_WATTS_MAX));
+    request.duty = constrain(document["duty"].as<float>(), 0.0f, 1.0f);
+    request.priority = constrain(document["priority"].as<int>(), MQTT_POWER_PRIORITY_MIN, MQTT_POWER_PRIORITY_MAX);
+
+    if (xQueueSend(mqttPowerQueue, &request, 0) != pdTRUE) {
+        LOGF(WARNING, "MQTT power queue full, dropping request from %s", name);
+    }
 }
 
 /**
  * @brief MQTT Callback Function: set Parameters through MQTT
  */
 inline void mqtt_callback(const char* topic, const byte* data, const unsigned int length) {
-    char topic_str[256];
-    os_memcpy(topic_str, topic, sizeof(topic_str));
-    topic_str[255] = '\0';
-    char data_str[length + 1];
-    os_memcpy(data_str, data, length);
-    data_str[length] = '\0';
-    char topic_pattern[255];
-    char configVar[120];
-    char cmd[64];
-    double data_double;
-
-    snprintf(topic_pattern, sizeof(topic_pattern), "%s%s/%%[^\\/]/%%[^\\/]", mqtt_topic_prefix.c_str(), hostname.c_str());
-
-    if (sscanf(topic_str, topic_pattern, &configVar, &cmd) != 2 || strcmp(cmd, "set") != 0) {
-        LOGF(WARNING, "Invalid MQTT topic/command: %s", topic_str);
+    // Home Assistant announces a restart, it may have lost the discovery messages if the broker doesn't retain them
+    if (mqtt_hassio_enabled && strcmp(topic, topic_hassio_status) == 0) {
+        if (length == sizeof("online") - 1 && memcmp(data, "online", length) == 0) {
+            hassioForceRequested = true;
+            mqttDiscoveryRequested = true;
+        }
+
         return;
     }
 
-    LOGF(DEBUG, "Received MQTT command %s %s\n", topic_str, data_str);
+    // the subscription only delivers a single level below the power topic, everything deeper belongs to the command topics
+    if (mqtt_power_enabled && strncmp(topic, mqtt_power_topic.c_str(), mqtt_power_topic.length()) == 0 && strchr(topic + mqtt_power_topic.length(), '/') == nullptr) {
+        handleMqttPowerRequest(topic + mqtt_power_topic.length(), data, length);
+        return;
+    }
+
+    // topics look like "<prefix><hostname>/<name>/set", the subscription guarantees everything but the name
+    const char* name;
+    size_t nameLength;
+
+    if (!parseMqttCommandTopic(topic, mqttTopicBase, mqttTopicBaseLength, name, nameLength)) {
+        LOGF(WARNING, "Invalid MQTT topic/command: %s", topic);
+        return;
+    }
+
+    if (nameLength == sizeof("config") - 1 && strncmp(name, "config", nameLength) == 0) {
+        handleMqttConfigSet(data, length);
+        return;
+    }
+
+    LOGF(DEBUG, "Received MQTT command %s %.*s", topic, static_cast<int>(length), reinterpret_cast<const char*>(data));
+
+    const int index = findMqttTopic(name, nameLength);
+
+    if (index < 0 || mqttTopics[index].parameterId == nullptr) {
+        LOGF(WARNING, "MQTT topic %.*s not found in mapping", static_cast<int>(nameLength), name);
+        return;
+    }
 
-    // convert received string value to double assuming it's a number
-    sscanf(data_str, "%lf", &data_double);
-    assignMQTTParam(configVar, data_double);
+    double value;
+
+    if (!parseMqttNumber(data, length, value)) {
+        LOGF(WARNING, "Invalid MQTT payload for %s: %.*s", mqttTopics[index].name, static_cast<int>(length), reinterpret_cast<const char*>(data));
+        return;
+    }
+
+    // the parameter is changed by the control loop, see processMqttCommands()
+    const MqttCommand command = {static_cast<uint16_t>(index), value};
+
+    if (xQueueSend(mqttInboundQueue, &command, 0) != pdTRUE) {
+        LOGF(WARNING, "MQTT command queue full, dropping %s", topic);
+    }
 }
 
 /**
- * @brief Send all current system parameter values to MQTT if changed, exit early if process is taking too long and return next loop
- *
- * @param continueOnError Flag to specify whether to continue publishing messages in case of an error (default: true)
- * @return 0 = success, MQTT error code = failure
+ * @brief Apply the parameter changes received by the MQTT task, called from the control loop
  */
+inline void processMqttCommands() {
+    MqttCommand command;
 
-inline int writeSysParamsToMQTT(const bool continueOnError = true) {
-    static auto mqttVarsIt = mqttVars.begin();
-    static auto mqttSensorsIt = mqttSensors.begin();
-    static bool inSensors = false;
+    while (xQueueReceive(mqttInboundQueue, &command, 0) == pdTRUE) {
+        assignMQTTParam(command.topic, command.value);
+    }
+
+    MqttConfigSet set;
+
+    while (xQueueReceive(mqttConfigSetQueue, &set, 0) == pdTRUE) {
+        // apply the whole set before anything else runs, so the controller never works with a partial change of e.g. PID gains
+        for (size_t i = 0; i < set.count; i++) {
+            applyMqttParam(set.commands[i].topic, set.commands[i].value);
+        }
+
+        for (size_t i = 0; i < set.count; i++) {
+            publishMqttTopic(set.commands[i].topic, mqttTopicStates[set.commands[i].topic].parameter->getValue());
+        }
+    }
+}
 
-    unsigned long currentMillisMQTT = millis();
-    unsigned long interval = (machineState == kBrew) ? intervalMQTTbrew : (machineState == kStandby) ? intervalMQTTstandby : intervalMQTT;
+/**
+ * @brief Minimum interval between publishes of a changed value for policies following the machine state
+ */
+inline uint32_t mqttMachineInterval() {
+    return mqttMachineInterval(machineState == kBrew, machineState == kStandby);
+}
 
-    if ((currentMillisMQTT - previousMillisMQTT < interval) || !mqtt_enabled || !mqtt.connected()) {
-        return 0;
+/**
+ * @brief Build the JSON state document of all enabled topics and hand it to the MQTT task, if the policy of any topic asks for it
+ */
+inline void publishMqttStateDocument() {
+    static char document[MQTT_STATE_DOCUMENT_SIZE];
+    const uint32_t now = millis();
+    const uint32_t machineInterval = mqttMachineInterval();
+    bool due = false;
+
+    for (size_t i = 0; i < mqttTopicCount && !due; i++) {
+        due = mqttTopicStates[i].enabled && isMqttTopicDue(mqttTopics[i], mqttTopicStates[i], quantizeMqttValue(readMqttTopic(i)), now, machineInterval);
     }
 
-    if (!inSensors && mqttVarsIt == mqttVars.begin()) {
-        previousMillisMQTT = currentMillisMQTT;
-        mqtt_publish("status", (char*)"online");
+    if (!due) {
+        return;
     }
 
     mqttUpdateRunning = true;
-    unsigned long start = millis();
 
-    char data[12];
-    int errorState = 0;
-    auto& registry = ParameterRegistry::getInstance();
+    MqttStateDocument writer(document, sizeof(document));
 
-    if (!inSensors) {
-        // Iterate through the mqttVars mapping to publish parameters
-        while (mqttVarsIt != mqttVars.end()) {
-            const char* mqttTopic = mqttVarsIt->first;
-            const char* parameterId = mqttVarsIt->second;
+    for (size_t i = 0; i < mqttTopicCount; i++) {
+        if (!mqttTopicStates[i].enabled) {
+            continue;
+        }
 
-            std::shared_ptr<Parameter> param = registry.getParameterById(parameterId);
+        const double value = readMqttTopic(i);
+        char formatted[sizeof(MqttOutboundMessage::payload)] = "null";
 
-            if (param == nullptr) {
-                if (!continueOnError) {
-                    LOGF(ERROR, "Parameter %s not found for MQTT topic %s", parameterId, mqttTopic);
-                    return 1;
-                }
+        // JSON has no representation for a failed sensor reading
+        if (std::isfinite(value)) {
+            formatMqttValue(i, value, formatted, sizeof(formatted));
+        }
 
-                LOGF(WARNING, "Parameter %s not found for MQTT topic %s, skipping", parameterId, mqttTopic);
-                ++mqttVarsIt;
-                continue;
-            }
+        if (!writer.add(mqttTopics[i].name, formatted, mqttTopics[i].payload == kMqttMachineState)) {
+            LOG(ERROR, "MQTT state document exceeds its buffer, not publishing");
+            return;
+        }
 
-            // Get value based on parameter type and format as string
-            switch (param->getType()) {
-                case kInteger:
-                    snprintf(data, sizeof(data), "%d", param->getValueAs<int>());
-                    break;
-                case kUInt8:
-                    snprintf(data, sizeof(data), "%u", param->getValueAs<uint8_t>());
-                    break;
-                case kDouble:
-                    snprintf(data, sizeof(data), "%.2f", param->getValueAs<double>());
-                    break;
-                case kFloat:
-                    snprintf(data, sizeof(data), "%.2f", param->getValueAs<float>());
-                    break;
-                case kCString:
-                    snprintf(data, sizeof(data), "%s", param->getValueAs<String>().c_str());
-                    break;
-                default:
+        mqttTopicStates[i].lastSent = quantizeMqttValue(value);
+        mqttTopicStates[i].lastSentAt = now;
+    }
 
-                    if (!continueOnError) {
-                        LOGF(ERROR, "Unknown parameter type for topic %s", mqttTopic);
-                        return 1;
-                    }
+    if (!writer.finish()) {
+        LOG(ERROR, "MQTT state document exceeds its buffer, not publishing");
+        return;
+    }
 
-                    LOGF(WARNING, "Skipping unknown parameter type for topic %s", mqttTopic);
-                    ++mqttVarsIt;
-                    continue;
-            }
+    // the mailbox holds one document, an unsent one is simply replaced by the newer state
+    xQueueOverwrite(mqttStateQueue, document);
+}
 
-            if (mqttLastSent[mqttTopic].compare(data) != 0) {
-                if (!mqtt_publish(mqttTopic, data, true)) {
-                    errorState = mqtt.state();
+/**
+ * @brief Queue the values whose publish policy is due for the MQTT task, continue next loop if the queue is full
+ * @details Evaluated every MQTT_POLICY_TICK_MS in O(topics) without allocations. Only reads values and posts to the outbound queue,
+ * so it never waits for the network.
+ */
+inline void writeSysParamsToMQTT() {
+    static size_t next = 0;
 
-                    if (!continueOnError) {
-                        LOGF(ERROR, "Failed to publish parameter %s to MQTT, error: %d", mqttTopic, errorState);
-                        return errorState;
-                    }
+    // values are queued while disconnected as well, the MQTT task keeps them until the broker is back
+    if (!mqtt_enabled) {
+        return;
+    }
 
-                    LOGF(WARNING, "Failed to publish parameter %s to MQTT, error: %d", mqttTopic, errorState);
-                }
-                else {
-                    mqttLastSent[mqttTopic].assign(data); // Update only if sent successfully
-                    LOGF(DEBUG, "Published %s = %s to MQTT, length: %i", mqttTopic, data, strlen(data) + 1);
-                }
-            }
+    uint16_t failed;
 
-            ++mqttVarsIt;
+    while (xQueueReceive(mqttSendFailedQueue, &failed, 0) == pdTRUE) {
+        mqttTopicStates[failed].lastSent = MQTT_NEVER_SENT;
+    }
 
-            // Return early, continue next time
-            if (millis() - start >= timeBudget) {
-                return 0;
-            }
+    if (mqttResyncRequested) {
+        // the offline buffer or the failure reports overflowed, so the broker may have missed changes
+        mqttResyncRequested = false;
+
+        for (size_t i = 0; i < mqttTopicCount; i++) {
+            mqttTopicStates[i].lastSent = MQTT_NEVER_SENT;
         }
 
-        // Done with mqttVars, start sensors
-        mqttVarsIt = mqttVars.begin();
-        inSensors = true;
+        mqttRepublishRequested = true;
     }
 
-    while (mqttSensorsIt != mqttSensors.end()) {
-        const char* topic = mqttSensorsIt->first;
-        const auto& sensorFunc = mqttSensorsIt->second;
+    const unsigned long now = millis();
 
-        char buf[20];
-
-        if (strcmp(topic, "machineState") == 0) {
-            snprintf(buf, sizeof(buf), "%s", machinestateEnumToString(machineState));
+    if (next == 0) {
+        if (now - previousMillisMQTT < MQTT_POLICY_TICK_MS && !mqttRepublishRequested) {
+            return;
         }
-        else {
-            snprintf(buf, sizeof(buf), "%.2f", sensorFunc());
+
+        mqttRepublishRequested = false;
+        previousMillisMQTT = now;
+
+        if (mqtt_publish_mode == kMqttStateDocument) {
+            publishMqttStateDocument();
+            return;
         }
+    }
+
+    const uint32_t machineInterval = mqttMachineInterval();
 
-        if (mqttLastSent[topic].compare(buf) != 0) {
+    // editable parameters come first in the table, followed by the read-only values
+    while (next < mqttTopicCount) {
+        if (mqttTopicStates[next].enabled) {
+            const double value = readMqttTopic(next);
 
-            if (!mqtt_publish(topic, buf)) {
-                errorState = mqtt.state();
+            if (isMqttTopicDue(mqttTopics[next], mqttTopicStates[next], quantizeMqttValue(value), now, machineInterval)) {
+                mqttUpdateRunning = true;
 
-                if (!continueOnError) {
-                    return errorState;
+                if (!publishMqttTopic(next, value)) {
+                    // the MQTT task is behind, continue with this topic next loop
+                    return;
                 }
             }
-            else {
-                mqttLastSent[topic].assign(buf);
-            }
         }
 
-        ++mqttSensorsIt;
+        next++;
+    }
+
+    next = 0;
+}
 
-        if (millis() - start >= timeBudget) {
-            return 0; // Return early, continue next time
-        }
+/**
+ * @brief Publish all values on the next loop instead of waiting for the interval, safe to call from other tasks
+ */
+inline void requestMqttRepublish() {
+    mqttRepublishRequested = true;
+}
+
+// Discovery is sent a few entities per MQTT task iteration, so that queued values aren't held back by it
+constexpr size_t HASSIO_DISCOVERY_BATCH = 2;
+
+// Next entity to publish, in device mode the device message follows the last entity
+constexpr size_t HASSIO_CURSOR_IDLE = SIZE_MAX;
+inline size_t hassioCursor = HASSIO_CURSOR_IDLE;
+
+/**
+ * @brief Machine the Home Assistant entities belong to, as currently configured
+ */
+inline HassioDevice hassioDevice() {
+    static const char* stateNames[sizeof(machineStateOptions) / sizeof(machineStateOptions[0])];
+
+    for (size_t i = 0; i < sizeof(stateNames) / sizeof(stateNames[0]); i++) {
+        stateNames[i] = machineStateOptions[i].name;
     }
 
-    // Done with both loops
-    mqttSensorsIt = mqttSensors.begin();
-    inSensors = false;
+    return {hostname.c_str(), mqtt_hassio_discovery_prefix.c_str(), mqttTopicBase, topic_will, mqtt_publish_mode == kMqttStateDocument, stateNames, sizeof(stateNames) / sizeof(stateNames[0])};
+}
 
-    return 0;
+/**
+ * @brief Hash of the device discovery message including its topic, compared against the one of the last published message
+ */
+inline uint32_t hassioDeviceHash() {
+    const HassioDevice device = hassioDevice();
+    char topic[160];
+    formatHassioDeviceTopic(topic, sizeof(topic), device);
+
+    ChunkedPrint counter;
+    counter.print(topic);
+    writeHassioDevice(counter, device, hassioEntities, HASSIO_ENTITY_COUNT, isMqttFeatureEnabled);
+
+    return counter.hash();
 }
 
 /**
- * @brief Generate a switch device for Home Assistant MQTT discovery
- *
- * This function generates a switch device configuration for Home Assistant MQTT discovery. It creates a `DiscoveryObject` containing the necessary information for Home Assistant to discover and control the switch device.
- *
- * @param name The name of the switch (used in MQTT topics)
- * @param displayName The display name of the switch (shown in Home Assistant)
- * @param payload_on The payload value to turn the switch on (default: "1")
- * @param payload_off The payload value to turn the switch off (default: "0")
- * @return A `DiscoveryObject` containing the switch device configuration
- */
-inline DiscoveryObject GenerateSwitchDevice(const char* name, const char* displayName, const char* payload_on = "1", const char* payload_off = "0") {
-    DiscoveryObject switch_device;
-
-    char mqtt_topic[128];
-    char unique_id[80];
-    char topic_buffer[160];
-
-    snprintf(mqtt_topic, sizeof(mqtt_topic), "%s%s", mqtt_topic_prefix.c_str(), hostname.c_str());
-    snprintf(unique_id, sizeof(unique_id), "clevercoffee-%s", hostname);
-    snprintf(switch_device.discovery_topic, sizeof(switch_device.discovery_topic), "%s/switch/%s/%s/config", mqtt_hassio_discovery_prefix, unique_id, name);
-
-    JsonDocument switchConfigDoc;
-    switchConfigDoc["name"] = displayName;
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/%s/set", mqtt_topic, name);
-    switchConfigDoc["command_topic"] = String(topic_buffer);
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/%s", mqtt_topic, name);
-    switchConfigDoc["state_topic"] = String(topic_buffer);
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s-%s", unique_id, name);
-    switchConfigDoc["unique_id"] = String(topic_buffer);
-    switchConfigDoc["payload_on"] = payload_on;
-    switchConfigDoc["payload_off"] = payload_off;
-    switchConfigDoc["payload_available"] = "online";
-    switchConfigDoc["payload_not_available"] = "offline";
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/status", mqtt_topic);
-    switchConfigDoc["availability_topic"] = String(topic_buffer);
-
-    JsonObject device = switchConfigDoc["device"].to<JsonObject>();
-    device["identifiers"] = hostname;
-    device["manufacturer"] = "CleverCoffee";
-    device["name"] = hostname;
-
-    serializeJson(switchConfigDoc, switch_device.payload_json, sizeof(switch_device.payload_json));
-
-    return switch_device;
-}
-
-/**
- * @brief Generate a button device for Home Assistant MQTT discovery
- *
- * This function generates a button device configuration for Home Assistant MQTT discovery. It creates a `DiscoveryObject` containing the necessary information for Home Assistant to discover and control the button device.
+ * @brief Remember the hash of the published device message across reboots, 0 if none is published
+ */
+inline void storeHassioDeviceHash(const uint32_t hash) {
+    if (hash == hassioPublishedHash) {
+        return;
+    }
+
+    Preferences preferences;
+
+    if (preferences.begin(HASSIO_PREFERENCES_NAMESPACE, false)) {
+        preferences.putUInt(HASSIO_PREFERENCES_HASH_KEY, hash);
+        preferences.end();
+    }
+
+    hassioPublishedHash = hash;
+}
+
+/**
+ * @brief Publish a message streamed straight into the client without building it in memory
  *
- * @param name The name of the button (used in MQTT topics)
- * @param displayName The display name of the button (shown in Home Assistant)
- * @param payload_press The payload value to turn the button is pressed (default: "1")
- * @return A `DiscoveryObject` containing the switch device configuration
+ * @param topic Topic to publish to
+ * @param retain Publish as retained message
+ * @param write Writes the payload, called twice
+ * @return true if the message was sent
  */
-inline DiscoveryObject GenerateButtonDevice(const char* name, const char* displayName, const char* payload_press = "1") {
-    DiscoveryObject button_device;
+template <typename Writer>
+bool publishStreamedMessage(const char* topic, const bool retain, Writer write) {
+    // the length has to be known before the first byte is sent, so the payload is generated twice
+    ChunkedPrint counter;
+    write(counter);
 
-    char mqtt_topic[128];
-    char unique_id[80];
-    char topic_buffer[160];
+    const uint32_t start = micros();
 
-    snprintf(mqtt_topic, sizeof(mqtt_topic), "%s%s", mqtt_topic_prefix.c_str(), hostname.c_str());
-    snprintf(unique_id, sizeof(unique_id), "clevercoffee-%s", hostname);
-    snprintf(button_device.discovery_topic, sizeof(button_device.discovery_topic), "%s/button/%s/%s/config", mqtt_hassio_discovery_prefix, unique_id, name);
+    if (!mqtt.beginPublish(topic, counter.length(), retain)) {
+        return recordMqttSend(start, topic, counter.length(), false);
+    }
 
-    JsonDocument buttonConfigDoc;
-    buttonConfigDoc["name"] = displayName;
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/%s/set", mqtt_topic, name);
-    buttonConfigDoc["command_topic"] = String(topic_buffer);
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/%s", mqtt_topic, name);
-    buttonConfigDoc["state_topic"] = String(topic_buffer);
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s-%s", unique_id, name);
-    buttonConfigDoc["unique_id"] = String(topic_buffer);
-    buttonConfigDoc["payload_press"] = payload_press;
-    buttonConfigDoc["payload_available"] = "online";
-    buttonConfigDoc["payload_not_available"] = "offline";
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/status", mqtt_topic);
-    buttonConfigDoc["availability_topic"] = String(topic_buffer);
+    ChunkedPrint out(&mqtt);
+    write(out);
 
-    JsonObject device = buttonConfigDoc["device"].to<JsonObject>();
-    device["identifiers"] = hostname;
-    device["manufacturer"] = "CleverCoffee";
-    device["name"] = hostname;
+    return recordMqttSend(start, topic, counter.length(), out.send() && mqtt.endPublish());
+}
 
-    serializeJson(buttonConfigDoc, button_device.payload_json, sizeof(button_device.payload_json));
+/**
+ * @brief Publish or, with an empty retained message, remove the discovery message of an entity
+ * @return true if the message was sent
+ */
+inline bool publishHassioEntity(const HassioEntity& entity, const bool remove) {
+    const HassioDevice device = hassioDevice();
+    char topic[160];
+    formatHassioEntityTopic(topic, sizeof(topic), device, entity);
+
+    if (remove) {
+        const uint32_t start = micros();
+        return recordMqttSend(start, topic, 0, mqtt.publish(topic, "", true));
+    }
 
-    return button_device;
+    return publishStreamedMessage(topic, true, [&device, &entity](Print& out) { writeHassioEntity(out, device, entity); });
 }
 
 /**
- * @brief Generate a sensor device for Home Assistant MQTT discovery
- *
- * This function generates a sensor device configuration for Home Assistant MQTT discovery. It creates a `DiscoveryObject` containing the necessary information for Home Assistant to discover and monitor the sensor device.
- *
- * @param name The name of the sensor (used in MQTT topics)
- * @param displayName The display name of the sensor (shown in Home Assistant)
- * @param unit_of_measurement The unit of measurement for the sensor data (default: "°C")
- * @param device_class
- * @return A `DiscoveryObject` containing the sensor device configuration
- */
-inline DiscoveryObject GenerateSensorDevice(const char* name, const char* displayName, const char* unit_of_measurement, const char* device_class, const std::vector<const char*>& options = {}) {
-    DiscoveryObject sensor_device;
-
-    char mqtt_topic[128];
-    char unique_id[80];
-    char topic_buffer[160];
-
-    snprintf(mqtt_topic, sizeof(mqtt_topic), "%s%s", mqtt_topic_prefix.c_str(), hostname.c_str());
-    snprintf(unique_id, sizeof(unique_id), "clevercoffee-%s", hostname);
-    snprintf(sensor_device.discovery_topic, sizeof(sensor_device.discovery_topic), "%s/sensor/%s/%s/config", mqtt_hassio_discovery_prefix, unique_id, name);
-
-    JsonDocument sensorConfigDoc;
-    sensorConfigDoc["name"] = displayName;
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/%s", mqtt_topic, name);
-    sensorConfigDoc["state_topic"] = String(topic_buffer);
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s-%s", unique_id, name);
-    sensorConfigDoc["unique_id"] = String(topic_buffer);
-
-    if (device_class != "enum") {
-        sensorConfigDoc["unit_of_measurement"] = unit_of_measurement;
-    }
-
-    sensorConfigDoc["device_class"] = device_class;
-    sensorConfigDoc["payload_available"] = "online";
-    sensorConfigDoc["payload_not_available"] = "offline";
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/status", mqtt_topic);
-    sensorConfigDoc["availability_topic"] = String(topic_buffer);
-
-    if (!options.empty()) {
-        sensorConfigDoc["options"] = JsonArray();
-        for (auto& opt : options) {
-            sensorConfigDoc["options"].add(opt);
+ * @brief Publish or, with an empty retained message, remove the device discovery message
+ * @return true if the message was sent
+ */
+inline bool publishHassioDevice(const bool remove) {
+    const HassioDevice device = hassioDevice();
+    char topic[160];
+    formatHassioDeviceTopic(topic, sizeof(topic), device);
+
+    if (remove) {
+        const uint32_t start = micros();
+        return recordMqttSend(start, topic, 0, mqtt.publish(topic, "", true));
+    }
+
+    return publishStreamedMessage(topic, true, [&device](Print& out) { writeHassioDevice(out, device, hassioEntities, HASSIO_ENTITY_COUNT, isMqttFeatureEnabled); });
+}
+
+/**
+ * @brief Continue sending Home Assistant discovery messages, called by the MQTT task on every iteration
+ * @details Restarts from the first entity whenever discovery is requested and resumes where it stopped otherwise.
+ * In device mode nothing is sent if the device message matches the last published one. Otherwise the per-entity messages
+ * are removed first, so that Home Assistant doesn't see every entity twice, followed by the device message.
+ * Switching back to entity mode removes the device message again.
+ */
+inline void publishHassioDiscoveryStep() {
+    const bool deviceMode = mqtt_hassio_discovery_mode == kHassioDiscoveryDevice;
+
+    if (mqttDiscoveryRequested) {
+        mqttDiscoveryRequested = false;
+        hassioCursor = 0;
+
+        if (deviceMode && !hassioForceRequested && hassioDeviceHash() == hassioPublishedHash) {
+            LOG(DEBUG, "Hassio device discovery unchanged");
+            hassioFailed = false;
+            hassioCursor = HASSIO_CURSOR_IDLE;
+        }
+
+        hassioForceRequested = false;
+    }
+
+    if (hassioCursor == HASSIO_CURSOR_IDLE) {
+        return;
+    }
+
+    for (size_t sent = 0; sent < HASSIO_DISCOVERY_BATCH && hassioCursor < HASSIO_ENTITY_COUNT; hassioCursor++) {
+        const HassioEntity& entity = hassioEntities[hassioCursor];
+
+        if (!deviceMode && !isMqttFeatureEnabled(entity.feature)) {
+            continue;
         }
+
+        if (!publishHassioEntity(entity, deviceMode)) {
+            LOGF(WARNING, "[MQTT] Failed to publish discovery message for %s, error: %d", entity.name, mqtt.state());
+
+            // retried by the discovery timer of the control loop
+            hassioFailed = true;
+            hassioCursor = HASSIO_CURSOR_IDLE;
+            return;
+        }
+
+        sent++;
+    }
+
+    if (hassioCursor < HASSIO_ENTITY_COUNT) {
+        return;
     }
 
-    JsonObject device = sensorConfigDoc["device"].to<JsonObject>();
-    device["identifiers"] = hostname;
-    device["manufacturer"] = "CleverCoffee";
-    device["name"] = hostname;
+    hassioCursor = HASSIO_CURSOR_IDLE;
 
-    serializeJson(sensorConfigDoc, sensor_device.payload_json, sizeof(sensor_device.payload_json));
+    if (deviceMode || hassioPublishedHash != 0) {
+        if (!publishHassioDevice(!deviceMode)) {
+            LOGF(WARNING, "[MQTT] Failed to publish device discovery message, error: %d", mqtt.state());
+            hassioFailed = true;
+            return;
+        }
 
-    return sensor_device;
+        storeHassioDeviceHash(deviceMode ? hassioDeviceHash() : 0);
+    }
+
+    LOG(DEBUG, "Hassio send successful");
+    hassioFailed = false;
 }
 
 /**
- * @brief Generate a number device for Home Assistant MQTT discovery
- *
- * This function generates a number device configuration for Home Assistant MQTT discovery. It creates a `DiscoveryObject` containing the necessary information for Home Assistant to discover and control the number device.
- *
- * @param name The name of the number device (used in MQTT topics)
- * @param displayName The display name of the number device (shown in Home Assistant)
- * @param min_value The minimum value allowed for the number device
- * @param max_value The maximum value allowed for the number device
- * @param steps_value The step value for incrementing/decrementing the number device value
- * @param unit_of_measurement The unit of measurement for the number device (default: "°C")
- * @param ui_mode Control how the number should be displayed in the UI
- * @return A `DiscoveryObject` containing the number device configuration
+ * @brief Have the MQTT task send the Homeassistant discovery messages as soon as it is connected
+ * @return Always 0, failures are reported through hassioFailed
  */
-inline DiscoveryObject GenerateNumberDevice(const char* name, const char* displayName, int min_value, int max_value, float steps_value, const char* unit_of_measurement, const char* ui_mode = "box") {
-    DiscoveryObject number_device;
-
-    char mqtt_topic[128];
-    char unique_id[80];
-    char topic_buffer[160];
+inline int sendHASSIODiscoveryMsg() {
+    mqttDiscoveryRequested = true;
 
-    snprintf(mqtt_topic, sizeof(mqtt_topic), "%s%s", mqtt_topic_prefix.c_str(), hostname.c_str());
-    snprintf(unique_id, sizeof(unique_id), "clevercoffee-%s", hostname);
-    snprintf(number_device.discovery_topic, sizeof(number_device.discovery_topic), "%s/number/%s/%s/config", mqtt_hassio_discovery_prefix, unique_id, name);
+    return 0;
+}
 
-    JsonDocument numberConfigDoc;
-    numberConfigDoc["name"] = displayName;
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/%s/set", mqtt_topic, name);
-    numberConfigDoc["command_topic"] = String(topic_buffer);
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/%s", mqtt_topic, name);
-    numberConfigDoc["state_topic"] = String(topic_buffer);
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s-%s", unique_id, name);
-    numberConfigDoc["unique_id"] = String(topic_buffer);
-    numberConfigDoc["min"] = min_value;
-    numberConfigDoc["max"] = max_value;
-    snprintf(topic_buffer, sizeof(topic_buffer), "%.2f", steps_value);
-    numberConfigDoc["step"] = String(topic_buffer);
-    numberConfigDoc["unit_of_measurement"] = unit_of_measurement;
-    numberConfigDoc["mode"] = ui_mode;
-    numberConfigDoc["payload_available"] = "online";
-    numberConfigDoc["payload_not_available"] = "offline";
-    snprintf(topic_buffer, sizeof(topic_buffer), "%s/status", mqtt_topic);
-    numberConfigDoc["availability_topic"] = String(topic_buffer);
+/**
+ * @brief Publish a state document, called by the MQTT task
+ * @details Streamed, as the document is larger than the client buffer. Retained, so that clients get the state right after subscribing.
+ */
+inline void sendMqttStateDocument(const char* document) {
+    const size_t length = strlen(document);
+    const uint32_t start = micros();
 
-    JsonObject device = numberConfigDoc["device"].to<JsonObject>();
-    device["identifiers"] = hostname;
-    device["manufacturer"] = "CleverCoffee";
-    device["name"] = hostname;
+    if (!recordMqttSend(start, topic_state, length, mqtt.beginPublish(topic_state, length, true) && mqtt.write(reinterpret_cast<const uint8_t*>(document), length) == length && mqtt.endPublish())) {
+        LOGF(DEBUG, "Failed to publish MQTT state document, error: %d", mqtt.state());
 
-    serializeJson(numberConfigDoc, number_device.payload_json, sizeof(number_device.payload_json));
+        // keep the document for the next attempt, unless a newer one is already waiting
+        xQueueSend(mqttStateQueue, document, 0);
+    }
+}
 
-    return number_device;
+/**
+ * @brief Write a shot telemetry value, JSON has no representation for NaN, e.g. of a failed sensor
+ */
+inline void writeShotValue(ResponseWriter& writer, const float value, const int decimals) {
+    if (std::isfinite(value)) {
+        writer.value(value, decimals);
+    }
+    else {
+        writer.value(JsonVariantConst());
+    }
 }
 
 /**
- * @brief Send MQTT Homeassistant Discovery Messages
- * @return 0 if successful, MQTT connection error code if failed to send messages
+ * @brief Write one value of all samples in a batch as an array
  */
-inline int publishDiscovery(const DiscoveryObject& obj) {
-    if (obj.discovery_topic == nullptr || obj.discovery_topic[0] == '\0' || obj.payload_json == nullptr || obj.payload_json[0] == '\0') {
-        LOGF(WARNING, "[MQTT] Skipping invalid discovery message: topic or payload is empty");
-        return 1;
+inline void writeShotColumn(ResponseWriter& writer, const char* name, const ShotTelemetryMessage& message, float ShotSample::*field, const int decimals) {
+    writer.key(name);
+    writer.beginArray(message.count);
+
+    for (size_t i = 0; i < message.count; i++) {
+        writeShotValue(writer, message.samples[i].*field, decimals);
     }
 
-    LOGF(DEBUG, "Publishing topic: %s, payload length: %d", obj.discovery_topic, strlen(obj.payload_json));
+    writer.endArray();
+}
 
-    int result = PublishLargeMessage(obj.discovery_topic, obj.payload_json);
+inline void writeShotColumn(ResponseWriter& writer, const char* name, const ShotTelemetryMessage& message, bool ShotSample::*field) {
+    writer.key(name);
+    writer.beginArray(message.count);
 
-    if (result != 0) {
-        LOGF(ERROR, "[MQTT] Failed to publish discovery message. Error code: %d", result);
-        return 1;
+    for (size_t i = 0; i < message.count; i++) {
+        writer.value(static_cast<int32_t>(message.samples[i].*field));
     }
 
-    return 0;
+    writer.endArray();
 }
 
 /**
- * @brief Send MQTT Homeassistant Discovery Messages
- * @return 0 if successful, MQTT connection error code if failed to send messages. Sets failed flag for later retry
+ * @brief Write a batch of shot samples, one array per value keeps the message compact
  */
-inline int sendHASSIODiscoveryMsg() {
-    hassioUpdateRunning = true;
+inline void writeShotSamples(Print& out, const ShotTelemetryMessage& message) {
+    ResponseWriter writer(out, ResponseWriter::JSON);
+
+    writer.beginObject(9);
+    writer.key("shot");
+    writer.value(static_cast<int32_t>(message.shot));
+    writer.key("seq");
+    writer.value(static_cast<int32_t>(message.sequence));
+
+    writer.key("t");
+    writer.beginArray(message.count);
 
-    if (!mqtt.connected()) {
-        LOG(DEBUG, "[MQTT] Failed to send Hassio Discover, MQTT Client is not connected");
-        hassioFailed = true;
-        hassioUpdateRunning = false;
-        return -1;
+    for (size_t i = 0; i < message.count; i++) {
+        writer.value(static_cast<int32_t>(message.samples[i].time));
     }
 
-    int failures = 0;
+    writer.endArray();
 
-    // Always published devices
-    failures += publishDiscovery(GenerateSensorDevice("machineState", "Machine State", "", "enum", getMachineStateOptions()));
-    failures += publishDiscovery(GenerateSensorDevice("temperature", "Boiler Temperature", "°C", "temperature"));
-    failures += publishDiscovery(GenerateSensorDevice("heaterPower", "Heater Power", "%", "power_factor"));
+    writeShotColumn(writer, "temperature", message, &ShotSample::temperature, 2);
+    writeShotColumn(writer, "pressure", message, &ShotSample::pressure, 2);
+    writeShotColumn(writer, "weight", message, &ShotSample::weight, 1);
+    writeShotColumn(writer, "flow", message, &ShotSample::flow, 2);
+    writeShotColumn(writer, "pump", message, &ShotSample::pump);
+    writeShotColumn(writer, "valve", message, &ShotSample::valve);
+    writer.endObject();
+}
 
-    failures += publishDiscovery(GenerateNumberDevice("brewSetpoint", "Brew setpoint", BREW_SETPOINT_MIN, BREW_SETPOINT_MAX, 0.1, "°C"));
-    failures += publishDiscovery(GenerateNumberDevice("steamSetpoint", "Steam setpoint", STEAM_SETPOINT_MIN, STEAM_SETPOINT_MAX, 0.1, "°C"));
-    failures += publishDiscovery(GenerateNumberDevice("brewTempOffset", "Brew Temp. Offset", BREW_TEMP_OFFSET_MIN, BREW_TEMP_OFFSET_MAX, 0.1, "°C"));
-    failures += publishDiscovery(GenerateNumberDevice("steamKp", "Steam Kp", PID_KP_STEAM_MIN, PID_KP_STEAM_MAX, 0.1, ""));
-    failures += publishDiscovery(GenerateNumberDevice("aggKp", "aggKp", PID_KP_REGULAR_MIN, PID_KP_REGULAR_MAX, 0.1, ""));
-    failures += publishDiscovery(GenerateNumberDevice("aggTn", "aggTn", PID_TN_REGULAR_MIN, PID_TN_REGULAR_MAX, 0.1, ""));
-    failures += publishDiscovery(GenerateNumberDevice("aggTv", "aggTv", PID_TV_REGULAR_MIN, PID_TV_REGULAR_MAX, 0.1, ""));
-    failures += publishDiscovery(GenerateNumberDevice("aggIMax", "aggIMax", PID_I_MAX_REGULAR_MIN, PID_I_MAX_REGULAR_MAX, 0.1, ""));
+/**
+ * @brief Write the summary of a finished shot
+ */
+inline void writeShotSummary(Print& out, const ShotTelemetryMessage& message) {
+    const ShotSummary& summary = message.summary;
+    ResponseWriter writer(out, ResponseWriter::JSON);
+
+    writer.beginObject(11);
+    writer.key("shot");
+    writer.value(static_cast<int32_t>(message.shot));
+    writer.key("duration");
+    writer.value(static_cast<int32_t>(summary.duration));
+    writer.key("weight");
+    writeShotValue(writer, summary.weight, 1);
+    writer.key("temperatureAvg");
+    writeShotValue(writer, summary.temperatureAverage, 2);
+    writer.key("temperatureMin");
+    writeShotValue(writer, summary.temperatureMin, 2);
+    writer.key("temperatureMax");
+    writeShotValue(writer, summary.temperatureMax, 2);
+    writer.key("pressureAvg");
+    writeShotValue(writer, summary.pressureAverage, 2);
+    writer.key("pressureMax");
+    writeShotValue(writer, summary.pressureMax, 2);
+    writer.key("flowMax");
+    writeShotValue(writer, summary.flowMax, 2);
+    writer.key("samples");
+    writer.value(static_cast<int32_t>(summary.samples));
+    writer.key("dropped");
+    writer.value(static_cast<int32_t>(summary.dropped));
+    writer.endObject();
+}
 
-    failures += publishDiscovery(GenerateSwitchDevice("pidON", "Use PID"));
-    failures += publishDiscovery(GenerateSwitchDevice("steamON", "Steam"));
-    failures += publishDiscovery(GenerateSwitchDevice("usePonM", "Use PonM"));
+/**
+ * @brief Publish a batch of shot samples or a shot summary, called by the MQTT task
+ * @details The summary is retained, so that a logger connecting later still gets the last shot
+ *
+ * @return true if the message was sent
+ */
+inline bool sendShotTelemetry(const ShotTelemetryMessage& message) {
+    bool sent;
 
-    // Conditional devices
-    if (config.get<bool>("hardware.switches.brew.enabled")) {
-        failures += publishDiscovery(GenerateSensorDevice("currBrewTime", "Current Brew Time ", "s", "duration"));
-        failures += publishDiscovery(GenerateNumberDevice("brewPidDelay", "Brew Pid Delay", BREW_PID_DELAY_MIN, BREW_PID_DELAY_MAX, 0.1, "s"));
-        failures += publishDiscovery(GenerateNumberDevice("targetBrewTime", "Target Brew time", TARGET_BREW_TIME_MIN, TARGET_BREW_TIME_MAX, 0.1, "s"));
-        failures += publishDiscovery(GenerateNumberDevice("preinfusion", "Preinfusion filling time", PRE_INFUSION_TIME_MIN, PRE_INFUSION_TIME_MAX, 0.1, "s"));
-        failures += publishDiscovery(GenerateNumberDevice("preinfusionPause", "Preinfusion pause time", PRE_INFUSION_PAUSE_MIN, PRE_INFUSION_PAUSE_MAX, 0.1, "s"));
-        failures += publishDiscovery(GenerateNumberDevice("backflushCycles", "Backflush Cycles", BACKFLUSH_CYCLES_MIN, BACKFLUSH_CYCLES_MAX, 1, ""));
-        failures += publishDiscovery(GenerateNumberDevice("backflushFillTime", "Backflush filling time", BACKFLUSH_FILL_TIME_MIN, BACKFLUSH_FILL_TIME_MAX, 0.1, "s"));
-        failures += publishDiscovery(GenerateNumberDevice("backflushFlushTime", "Backflush flushing time", BACKFLUSH_FLUSH_TIME_MIN, BACKFLUSH_FLUSH_TIME_MAX, 0.1, "s"));
-        failures += publishDiscovery(GenerateSwitchDevice("backflushOn", "Backflush"));
+    if (message.count == 0) {
+        sent = publishStreamedMessage(topic_shot_summary, true, [&message](Print& out) { writeShotSummary(out, message); });
+    }
+    else {
+        sent = publishStreamedMessage(topic_shot_samples, false, [&message](Print& out) { writeShotSamples(out, message); });
     }
 
-    if (config.get<bool>("hardware.sensors.scale.enabled")) {
-        failures += publishDiscovery(GenerateSensorDevice("currReadingWeight", "Weight", "g", "weight"));
-        failures += publishDiscovery(GenerateSensorDevice("currBrewWeight", "current Brew Weight", "g", "weight"));
-        failures += publishDiscovery(GenerateButtonDevice("scaleCalibrationOn", "Calibrate Scale"));
-        failures += publishDiscovery(GenerateButtonDevice("scaleTareOn", "Tare Scale"));
-        failures += publishDiscovery(GenerateNumberDevice("targetBrewWeight", "Brew Weight Target", TARGET_BREW_WEIGHT_MIN, TARGET_BREW_WEIGHT_MAX, 0.1, "g"));
+    if (!sent) {
+        LOGF(DEBUG, "Failed to publish shot telemetry, error: %d", mqtt.state());
     }
 
-    if (config.get<bool>("hardware.sensors.pressure.enabled")) {
-        failures += publishDiscovery(GenerateSensorDevice("pressure", "Pressure", "bar", "pressure"));
+    return sent;
+}
+
+/**
+ * @brief Announce the heater demand of this machine to the others, called by the MQTT task
+ * @details Not retained, a machine that is switched off must drop out of the budget once its announcements stop
+ */
+inline void sendMqttPowerRequest(const PowerBudget::Request& request) {
+    char payload[64];
+    const int length = snprintf(payload, sizeof(payload), R"({"watts":%.0f,"duty":%.3f,"priority":%u})", request.watts, request.duty, static_cast<unsigned>(request.priority));
+    const uint32_t start = micros();
+
+    if (!recordMqttSend(start, topic_power, length, mqtt.publish(topic_power, payload, false))) {
+        LOGF(DEBUG, "Failed to publish power request, error: %d", mqtt.state());
     }
+}
+
+/**
+ * @brief Move queued messages into the offline buffer, called by the MQTT task
+ *
+ * @param wait Ticks to wait for the first message
+ */
+inline void storeMqttMessages(TickType_t wait) {
+    MqttOutboundMessage message;
 
-    if (failures > 0) {
-        LOGF(DEBUG, "Hassio failed to send %d entries", failures);
-        hassioFailed = true;
+    while (xQueueReceive(mqttOutboundQueue, &message, wait) == pdTRUE) {
+        // every topic sent from the queue is a state, only its latest value matters
+        mqttOutbox.store(message.topic, message.payload, strlen(message.payload), true);
+        wait = 0;
     }
-    else {
-        LOG(DEBUG, "Hassio send successful");
-        hassioFailed = false;
-        return 0;
+}
+
+/**
+ * @brief Move shot telemetry into the offline buffer while the broker is unreachable, called by the MQTT task
+ * @details Summaries are buffered as events. Sample batches are live data of several kB per shot that would push all states
+ * out of the buffer, so they are dropped and counted in the MQTT statistics. The state document needs no buffering, its
+ * single slot mailbox already keeps the latest one until it can be sent.
+ */
+inline void storeShotTelemetry(ShotTelemetryMessage& message) {
+    while (mqttShotQueue != nullptr && xQueueReceive(mqttShotQueue, &message, 0) == pdTRUE) {
+        if (message.count > 0) {
+            mqttStats.addDropped();
+            continue;
+        }
+
+        const StoredShotSummary stored = {message.shot, message.summary};
+        mqttOutbox.store(MQTT_SHOT_SUMMARY_TOPIC, reinterpret_cast<const char*>(&stored), sizeof(stored), false);
+    }
+}
+
+/**
+ * @brief Publish a message taken from the offline buffer, called by the MQTT task
+ *
+ * @param topic Buffer topic, an index into the topic table or MQTT_SHOT_SUMMARY_TOPIC
+ * @param payload Buffered payload
+ * @param length Payload length
+ * @param shotMessage Scratch buffer for summaries, too large for the task stack
+ * @return true if the message was sent
+ */
+inline bool sendStoredMqttMessage(const uint16_t topic, const char* payload, const size_t length, ShotTelemetryMessage& shotMessage) {
+    if (topic == MQTT_SHOT_SUMMARY_TOPIC) {
+        if (length != sizeof(StoredShotSummary)) {
+            return true; // nothing that can be sent, drop it
+        }
+
+        StoredShotSummary stored;
+        memcpy(&stored, payload, sizeof(stored));
+
+        shotMessage.shot = stored.shot;
+        shotMessage.sequence = 0;
+        shotMessage.count = 0;
+        shotMessage.summary = stored.summary;
+
+        return sendShotTelemetry(shotMessage);
+    }
+
+    MqttOutboundMessage message;
+    message.topic = topic;
+    memcpy(message.payload, payload, min(length, sizeof(message.payload) - 1));
+    message.payload[min(length, sizeof(message.payload) - 1)] = '\0';
+
+    return sendMqttMessage(message);
+}
+
+/**
+ * @brief MQTT task: keeps the connection alive, receives commands and publishes the queued messages
+ */
+inline void mqttTask(void*) {
+    static char stateDocument[MQTT_STATE_DOCUMENT_SIZE];
+    static ShotTelemetryMessage shotMessage;
+    PowerBudget::Request powerRequest;
+    MqttOutboundMessage message;
+    char storedPayload[max(sizeof(MqttOutboundMessage::payload), sizeof(StoredShotSummary))];
+
+    for (;;) {
+        if (WiFi.status() == WL_CONNECTED) {
+            checkMQTT();
+        }
+
+        bool resync;
+        const MqttOutbox::Action action = mqttOutbox.update(mqtt.connected(), resync);
+        mqttConnected = action != MqttOutbox::STORE;
+
+        if (resync) {
+            mqttResyncRequested = true;
+        }
+
+        if (action == MqttOutbox::STORE) {
+            // keep what the control loop publishes meanwhile, it is sent once the broker is back
+            storeShotTelemetry(shotMessage);
+            storeMqttMessages(pdMS_TO_TICKS(MQTT_TASK_IDLE_MS));
+            continue;
+        }
+
+        previousMqttConnection = millis();
+
+        const uint32_t loopStart = micros();
+        mqtt.loop();
+        mqttStats.record(MqttStats::CLIENT_LOOP, micros() - loopStart);
+
+        if (mqttDiscoveryRequested || hassioCursor != HASSIO_CURSOR_IDLE) {
+            const uint32_t discoveryStart = micros();
+            publishHassioDiscoveryStep();
+            mqttStats.record(MqttStats::DISCOVERY, micros() - discoveryStart);
+        }
+
+        if (action == MqttOutbox::FLUSH) {
+            // nothing is dropped from the buffer while the broker is reachable, a full queue makes the control loop send the value again
+            mqttOutbox.flush(MQTT_FLUSH_BATCH, storedPayload, sizeof(storedPayload), [](const uint16_t topic, const char* payload, const size_t length) {
+                return sendStoredMqttMessage(topic, payload, length, shotMessage);
+            });
+
+            vTaskDelay(pdMS_TO_TICKS(MQTT_FLUSH_INTERVAL_MS));
+            continue;
+        }
+
+        // wait for outbound messages, but come back in time to serve keepalives and incoming messages
+        if (xQueueReceive(mqttOutboundQueue, &message, pdMS_TO_TICKS(MQTT_TASK_IDLE_MS)) == pdTRUE) {
+            do {
+                if (!sendMqttMessage(message)) {
+                    LOGF(DEBUG, "Failed to publish MQTT message, error: %d", mqtt.state());
+                }
+            } while (mqtt.connected() && xQueueReceive(mqttOutboundQueue, &message, 0) == pdTRUE);
+        }
+
+        if (mqtt.connected() && xQueueReceive(mqttStateQueue, stateDocument, 0) == pdTRUE) {
+            sendMqttStateDocument(stateDocument);
+        }
+
+        while (mqttShotQueue != nullptr && mqtt.connected() && xQueueReceive(mqttShotQueue, &shotMessage, 0) == pdTRUE) {
+            sendShotTelemetry(shotMessage);
+        }
+
+        if (mqttPowerAnnounceQueue != nullptr && mqtt.connected() && xQueueReceive(mqttPowerAnnounceQueue, &powerRequest, 0) == pdTRUE) {
+            sendMqttPowerRequest(powerRequest);
+        }
     }
+}
+
+/**
+ * @brief Create the message queues and start the MQTT task, buildMqttTopics() has to be called before
+ */
+inline void startMqttTask() {
+    mqttOutboundQueue = xQueueCreate(MQTT_OUTBOUND_QUEUE_LENGTH, sizeof(MqttOutboundMessage));
+    mqttSendFailedQueue = xQueueCreate(MQTT_OUTBOUND_QUEUE_LENGTH, sizeof(uint16_t));
+    mqttInboundQueue = xQueueCreate(MQTT_INBOUND_QUEUE_LENGTH, sizeof(MqttCommand));
+    mqttConfigSetQueue = xQueueCreate(MQTT_CONFIG_SET_QUEUE_LENGTH, sizeof(MqttConfigSet));
+    mqttStateQueue = xQueueCreate(1, MQTT_STATE_DOCUMENT_SIZE);
+
+    if (mqtt_shot_telemetry_enabled) {
+        mqttShotQueue = xQueueCreate(SHOT_TELEMETRY_QUEUE_LENGTH, sizeof(ShotTelemetryMessage));
+    }
+
+    if (mqtt_power_enabled) {
+        mqttPowerQueue = xQueueCreate(MQTT_POWER_QUEUE_LENGTH, sizeof(PowerBudget::Request));
+        mqttPowerAnnounceQueue = xQueueCreate(1, sizeof(PowerBudget::Request));
+    }
+
+    mqtt.setServer(mqtt_server_ip.c_str(), mqtt_server_port);
+    mqtt.setCallback(mqtt_callback);
+    mqtt.setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    mqtt.setBufferSize(MQTT_PACKET_SIZE);
 
-    return -1;
+    xTaskCreatePinnedToCore(mqttTask, "mqtt", MQTT_TASK_STACK_SIZE, nullptr, MQTT_TASK_PRIORITY, &mqttTaskHandle, MQTT_TASK_CORE);
 }
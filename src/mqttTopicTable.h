@@ -0,0 +1,111 @@
+/**
+ * @file mqttTopicTable.h
+ *
+ * @brief MQTT topics and Home Assistant entities of the machine
+ * @details Kept apart from mqtt.h, so that the host tests run the MQTT units on the tables of the firmware
+ */
+
+#pragma once
+
+#include "defaults.h"
+#include "utils/HassioDiscovery.h"
+#include "utils/MqttTopics.h"
+
+// Read-only values, defined in main.cpp
+double mqttTemperature();
+double mqttHeaterPower();
+double mqttStandbyModeTimeRemaining();
+double mqttCurrentKp();
+double mqttCurrentKi();
+double mqttCurrentKd();
+double mqttMachineState();
+double mqttCurrBrewTime();
+double mqttCurrReadingWeight();
+double mqttCurrBrewWeight();
+double mqttPressure();
+
+// MQTT topics, editable parameters first, then read-only values with publish policies matching their noise
+inline constexpr MqttTopic mqttTopics[] = {
+    {"pidON", "pid.enabled", nullptr, kMqttAlways},
+    {"brewSetpoint", "brew.setpoint", nullptr, kMqttAlways},
+    {"brewTempOffset", "brew.temp_offset", nullptr, kMqttAlways},
+    {"steamON", "STEAM_MODE", nullptr, kMqttAlways},
+    {"steamSetpoint", "steam.setpoint", nullptr, kMqttAlways},
+    {"pidUsePonM", "pid.use_ponm", nullptr, kMqttAlways},
+    {"aggKp", "pid.regular.kp", nullptr, kMqttAlways},
+    {"aggTn", "pid.regular.tn", nullptr, kMqttAlways},
+    {"aggTv", "pid.regular.tv", nullptr, kMqttAlways},
+    {"aggIMax", "pid.regular.i_max", nullptr, kMqttAlways},
+    {"steamKp", "pid.steam.kp", nullptr, kMqttAlways},
+    {"standbyModeOn", "standby.enabled", nullptr, kMqttAlways},
+    {"aggbKp", "pid.bd.kp", nullptr, kMqttBrewSwitch},
+    {"aggbTn", "pid.bd.tn", nullptr, kMqttBrewSwitch},
+    {"aggbTv", "pid.bd.tv", nullptr, kMqttBrewSwitch},
+    {"pidUseBD", "pid.bd.enabled", nullptr, kMqttBrewSwitch},
+    {"brewPidDelay", "brew.pid_delay", nullptr, kMqttBrewSwitch},
+    {"targetBrewTime", "brew.by_time.target_time", nullptr, kMqttBrewSwitch},
+    {"preinfusion", "brew.pre_infusion.time", nullptr, kMqttBrewSwitch},
+    {"preinfusionPause", "brew.pre_infusion.pause", nullptr, kMqttBrewSwitch},
+    {"backflushOn", "BACKFLUSH_ON", nullptr, kMqttBrewSwitch},
+    {"backflushCycles", "backflush.cycles", nullptr, kMqttBrewSwitch},
+    {"backflushFillTime", "backflush.fill_time", nullptr, kMqttBrewSwitch},
+    {"backflushFlushTime", "backflush.flush_time", nullptr, kMqttBrewSwitch},
+    {"targetBrewWeight", "brew.by_weight.target_weight", nullptr, kMqttScaleByWeight},
+    {"scaleCalibration", "hardware.sensors.scale.calibration", nullptr, kMqttScale},
+    {"scale2Calibration", "hardware.sensors.scale.calibration2", nullptr, kMqttDualScale},
+    {"scaleKnownWeight", "hardware.sensors.scale.known_weight", nullptr, kMqttScale},
+    {"scaleTareOn", "TARE_ON", nullptr, kMqttScale},
+    {"scaleCalibrationOn", "CALIBRATION_ON", nullptr, kMqttScale},
+
+    {"temperature", nullptr, mqttTemperature, kMqttAlways, kMqttNumber, mqttDeadband(0.1)},
+    {"heaterPower", nullptr, mqttHeaterPower, kMqttAlways, kMqttNumber, mqttDeadband(1)},
+    {"standbyModeTimeRemaining", nullptr, mqttStandbyModeTimeRemaining, kMqttAlways, kMqttNumber, mqttDeadband(10)},
+    {"currentKp", nullptr, mqttCurrentKp, kMqttAlways, kMqttNumber, mqttDeadband(0.01, true)},
+    {"currentKi", nullptr, mqttCurrentKi, kMqttAlways, kMqttNumber, mqttDeadband(0.01, true)},
+    {"currentKd", nullptr, mqttCurrentKd, kMqttAlways, kMqttNumber, mqttDeadband(0.01, true)},
+    {"machineState", nullptr, mqttMachineState, kMqttAlways, kMqttMachineState, mqttOnChange(MQTT_HEARTBEAT_INTERVAL)},
+    {"currBrewTime", nullptr, mqttCurrBrewTime, kMqttBrewSwitch, kMqttNumber, mqttDeadband(0.1)},
+    {"currReadingWeight", nullptr, mqttCurrReadingWeight, kMqttScale, kMqttNumber, mqttDeadband(0.1)},
+    {"currBrewWeight", nullptr, mqttCurrBrewWeight, kMqttScale, kMqttNumber, mqttDeadband(0.1)},
+    {"pressure", nullptr, mqttPressure, kMqttPressure, kMqttNumber, mqttDeadband(0.05)},
+};
+
+constexpr size_t mqttTopicCount = sizeof(mqttTopics) / sizeof(mqttTopics[0]);
+
+static_assert(mqttTopicCount <= MQTT_MAX_TOPICS, "Increase MQTT_MAX_TOPICS");
+
+// clang-format off
+inline constexpr HassioEntity hassioEntities[] = {
+    {kHassioSensor, "machineState",       "Machine State",            "",    "enum",         0,                         0,                         0,   kMqttAlways},
+    {kHassioSensor, "temperature",        "Boiler Temperature",       "°C",  "temperature",  0,                         0,                         0,   kMqttAlways},
+    {kHassioSensor, "heaterPower",        "Heater Power",             "%",   "power_factor", 0,                         0,                         0,   kMqttAlways},
+    {kHassioNumber, "brewSetpoint",       "Brew setpoint",            "°C",  nullptr,        BREW_SETPOINT_MIN,         BREW_SETPOINT_MAX,         0.1, kMqttAlways},
+    {kHassioNumber, "steamSetpoint",      "Steam setpoint",           "°C",  nullptr,        STEAM_SETPOINT_MIN,        STEAM_SETPOINT_MAX,        0.1, kMqttAlways},
+    {kHassioNumber, "brewTempOffset",     "Brew Temp. Offset",        "°C",  nullptr,        BREW_TEMP_OFFSET_MIN,      BREW_TEMP_OFFSET_MAX,      0.1, kMqttAlways},
+    {kHassioNumber, "steamKp",            "Steam Kp",                 "",    nullptr,        PID_KP_STEAM_MIN,          PID_KP_STEAM_MAX,          0.1, kMqttAlways},
+    {kHassioNumber, "aggKp",              "aggKp",                    "",    nullptr,        PID_KP_REGULAR_MIN,        PID_KP_REGULAR_MAX,        0.1, kMqttAlways},
+    {kHassioNumber, "aggTn",              "aggTn",                    "",    nullptr,        PID_TN_REGULAR_MIN,        PID_TN_REGULAR_MAX,        0.1, kMqttAlways},
+    {kHassioNumber, "aggTv",              "aggTv",                    "",    nullptr,        PID_TV_REGULAR_MIN,        PID_TV_REGULAR_MAX,        0.1, kMqttAlways},
+    {kHassioNumber, "aggIMax",            "aggIMax",                  "",    nullptr,        PID_I_MAX_REGULAR_MIN,     PID_I_MAX_REGULAR_MAX,     0.1, kMqttAlways},
+    {kHassioSwitch, "pidON",              "Use PID",                  "",    nullptr,        0,                         0,                         0,   kMqttAlways},
+    {kHassioSwitch, "steamON",            "Steam",                    "",    nullptr,        0,                         0,                         0,   kMqttAlways},
+    {kHassioSwitch, "usePonM",            "Use PonM",                 "",    nullptr,        0,                         0,                         0,   kMqttAlways},
+    {kHassioSensor, "currBrewTime",       "Current Brew Time ",       "s",   "duration",     0,                         0,                         0,   kMqttBrewSwitch},
+    {kHassioNumber, "brewPidDelay",       "Brew Pid Delay",           "s",   nullptr,        BREW_PID_DELAY_MIN,        BREW_PID_DELAY_MAX,        0.1, kMqttBrewSwitch},
+    {kHassioNumber, "targetBrewTime",     "Target Brew time",         "s",   nullptr,        TARGET_BREW_TIME_MIN,      TARGET_BREW_TIME_MAX,      0.1, kMqttBrewSwitch},
+    {kHassioNumber, "preinfusion",        "Preinfusion filling time", "s",   nullptr,        PRE_INFUSION_TIME_MIN,     PRE_INFUSION_TIME_MAX,     0.1, kMqttBrewSwitch},
+    {kHassioNumber, "preinfusionPause",   "Preinfusion pause time",   "s",   nullptr,        PRE_INFUSION_PAUSE_MIN,    PRE_INFUSION_PAUSE_MAX,    0.1, kMqttBrewSwitch},
+    {kHassioNumber, "backflushCycles",    "Backflush Cycles",         "",    nullptr,        BACKFLUSH_CYCLES_MIN,      BACKFLUSH_CYCLES_MAX,      1,   kMqttBrewSwitch},
+    {kHassioNumber, "backflushFillTime",  "Backflush filling time",   "s",   nullptr,        BACKFLUSH_FILL_TIME_MIN,   BACKFLUSH_FILL_TIME_MAX,   0.1, kMqttBrewSwitch},
+    {kHassioNumber, "backflushFlushTime", "Backflush flushing time",  "s",   nullptr,        BACKFLUSH_FLUSH_TIME_MIN,  BACKFLUSH_FLUSH_TIME_MAX,  0.1, kMqttBrewSwitch},
+    {kHassioSwitch, "backflushOn",        "Backflush",                "",    nullptr,        0,                         0,                         0,   kMqttBrewSwitch},
+    {kHassioSensor, "currReadingWeight",  "Weight",                   "g",   "weight",       0,                         0,                         0,   kMqttScale},
+    {kHassioSensor, "currBrewWeight",     "current Brew Weight",      "g",   "weight",       0,                         0,                         0,   kMqttScale},
+    {kHassioButton, "scaleCalibrationOn", "Calibrate Scale",          "",    nullptr,        0,                         0,                         0,   kMqttScale},
+    {kHassioButton, "scaleTareOn",        "Tare Scale",               "",    nullptr,        0,                         0,                         0,   kMqttScale},
+    {kHassioNumber, "targetBrewWeight",   "Brew Weight Target",       "g",   nullptr,        TARGET_BREW_WEIGHT_MIN,    TARGET_BREW_WEIGHT_MAX,    0.1, kMqttScale},
+    {kHassioSensor, "pressure",           "Pressure",                 "bar", "pressure",     0,                         0,                         0,   kMqttPressure},
+};
+// clang-format on
+
+constexpr size_t HASSIO_ENTITY_COUNT = sizeof(hassioEntities) / sizeof(hassioEntities[0]);
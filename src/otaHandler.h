@@ -0,0 +1,528 @@
+/**
+ * @file otaHandler.h
+ *
+ * @brief Firmware update through the embedded webserver
+ *
+ * The image is streamed chunk by chunk into the inactive OTA partition while it is being received,
+ * the control loop keeps running with the heater forced off until the device reboots into the new firmware.
+ * Besides full images, delta patches (see create_delta_update.py) are reconstructed on the fly from the running firmware,
+ * and the web interface asset bundle (assets.bin) can be replaced the same way.
+ */
+
+#pragma once
+
+#include "utils/AssetBundle.h"
+#include <DeltaPatch.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/md.h>
+
+#define OTA_PROGRESS_INTERVAL 32768 // bytes between two progress events
+#define OTA_STALL_TIMEOUT     30000 // abort the update if no data arrived for this long (ms)
+#define OTA_REBOOT_DELAY      1000  // time to deliver the final response before rebooting (ms)
+
+enum OtaTarget {
+    kOtaFirmware,
+    kOtaDelta,
+    kOtaAssets
+};
+
+enum OtaState {
+    kOtaIdle,
+    kOtaReceiving,
+    kOtaFinished,
+    kOtaFailed
+};
+
+// Written from the webserver task, read by loopControl() to keep the heater off while an update is running
+inline volatile bool otaUpdateRunning = false;
+
+inline OtaState otaState = kOtaIdle;
+inline String otaError;
+inline size_t otaWritten = 0;
+inline size_t otaTotal = 0;
+inline size_t otaNextProgress = 0;
+inline unsigned long otaLastChunk = 0;
+inline unsigned long otaRebootAt = 0;
+inline uint8_t otaExpectedHash[32] = {};
+inline bool otaHashExpected = false;
+inline char otaReceivedHash[65] = {};
+inline mbedtls_md_context_t otaHashContext;
+inline bool otaHashActive = false;
+
+// Patch applier of a running delta update, nullptr for full images
+inline DeltaPatch* otaDelta = nullptr;
+
+// Asset partition while an asset bundle is uploaded, nullptr for firmware updates
+inline const esp_partition_t* otaAssetPartition = nullptr;
+inline size_t otaAssetErased = 0;
+inline uint8_t otaAssetHeader[AssetBundle::HEADER_SIZE] = {};
+
+// Request that owns the running update, chunks of concurrent uploads are ignored
+inline AsyncWebServerRequest* otaRequest = nullptr;
+
+// Serializes the upload handlers on the webserver task with the supervision in loop(), Update must not be aborted during a write
+inline SemaphoreHandle_t otaMutex = nullptr;
+
+/**
+ * @brief Holds the OTA mutex for the lifetime of the object
+ * @details The mutex is recursive, the disconnect handler may run while a response is sent from within a locked handler
+ */
+class OtaLock {
+    public:
+        explicit OtaLock(const TickType_t wait = portMAX_DELAY) :
+            locked_(xSemaphoreTakeRecursive(otaMutex, wait) == pdTRUE) {
+        }
+
+        ~OtaLock() {
+            if (locked_) {
+                xSemaphoreGiveRecursive(otaMutex);
+            }
+        }
+
+        OtaLock(const OtaLock&) = delete;
+        OtaLock& operator=(const OtaLock&) = delete;
+
+        [[nodiscard]] bool isLocked() const {
+            return locked_;
+        }
+
+    private:
+        bool locked_;
+};
+
+/**
+ * @brief Parse a hex encoded SHA-256 digest
+ * @return true if the string contains exactly 64 hex digits
+ */
+inline bool otaParseHash(const String& hex, uint8_t* out) {
+    if (hex.length() != 64) {
+        return false;
+    }
+
+    for (int i = 0; i < 32; i++) {
+        char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+        char* end;
+        out[i] = static_cast<uint8_t>(strtoul(byte, &end, 16));
+
+        if (*end != '\0') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline void otaSendProgress() {
+    char msg[80];
+    snprintf(msg, sizeof(msg), R"({"state":%d,"written":%u,"total":%u})", otaState, otaWritten, otaTotal);
+    events.send(msg, "ota_progress", millis());
+}
+
+/**
+ * @brief Abort a running update and release the heater lock
+ */
+inline void otaFail(const char* reason) {
+    if (Update.isRunning()) {
+        Update.abort();
+    }
+
+    if (otaHashActive) {
+        mbedtls_md_free(&otaHashContext);
+        otaHashActive = false;
+    }
+
+    delete otaDelta;
+    otaDelta = nullptr;
+
+    if (otaAssetPartition != nullptr) {
+        // the old bundle is still intact if nothing was erased yet, otherwise the start page offers the upload again
+        otaAssetPartition = nullptr;
+        assetBundleUpdating = false;
+        assetBundle.begin();
+    }
+
+    otaError = reason;
+    otaState = kOtaFailed;
+    otaRequest = nullptr;
+    otaUpdateRunning = false;
+
+    LOGF(ERROR, "Firmware update failed: %s", reason);
+
+    otaSendProgress();
+}
+
+inline void otaBeginHash() {
+    mbedtls_md_init(&otaHashContext);
+    mbedtls_md_setup(&otaHashContext, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+    mbedtls_md_starts(&otaHashContext);
+    otaHashActive = true;
+}
+
+/**
+ * @brief Start writing an image of the given size into the inactive OTA partition
+ */
+inline bool otaBeginImage(const size_t size) {
+    if (!Update.begin(size, U_FLASH)) {
+        return false;
+    }
+
+    otaBeginHash();
+
+    return true;
+}
+
+/**
+ * @brief Write a chunk of an asset bundle into the asset partition
+ * @details The bundle header is held back and only written once the upload is complete and verified,
+ * so an interrupted upload leaves an invalid bundle rather than a corrupt one
+ */
+inline bool otaWriteAssets(const uint8_t* data, size_t len) {
+    size_t offset = otaWritten;
+
+    if (offset + len > otaAssetPartition->size) {
+        return false;
+    }
+
+    while (len > 0 && offset < AssetBundle::HEADER_SIZE) {
+        otaAssetHeader[offset++] = *data++;
+        len--;
+    }
+
+    // erase sectors right before they are written
+    while (otaAssetErased < offset + len) {
+        if (esp_partition_erase_range(otaAssetPartition, otaAssetErased, SPI_FLASH_SEC_SIZE) != ESP_OK) {
+            return false;
+        }
+
+        otaAssetErased += SPI_FLASH_SEC_SIZE;
+    }
+
+    return len == 0 || esp_partition_write(otaAssetPartition, offset, data, len) == ESP_OK;
+}
+
+/**
+ * @brief Append data to the new image
+ */
+inline bool otaWriteImage(const uint8_t* data, const size_t len) {
+    if (otaAssetPartition != nullptr) {
+        if (!otaWriteAssets(data, len)) {
+            return false;
+        }
+    }
+    else if (Update.write(const_cast<uint8_t*>(data), len) != len) {
+        return false;
+    }
+
+    mbedtls_md_update(&otaHashContext, data, len);
+
+    otaWritten += len;
+
+    if (otaWritten >= otaNextProgress) {
+        otaNextProgress = otaWritten + OTA_PROGRESS_INTERVAL;
+        otaSendProgress();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Validate the header of a delta patch against the running firmware and start writing the new image
+ */
+inline bool otaBeginDelta(const DeltaPatch::Header& header) {
+    const esp_partition_t* running = esp_ota_get_running_partition();
+
+    if (running == nullptr || header.sourceSize > running->size) {
+        LOG(ERROR, "Delta update rejected, source image is larger than the running partition");
+        return false;
+    }
+
+    // the running partition contains the source image followed by erased flash, hash only the image itself
+    // (small buffer, this runs on the stack of the webserver task)
+    uint8_t buffer[256];
+    uint8_t hash[32];
+
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+    mbedtls_md_starts(&ctx);
+
+    bool readOk = true;
+
+    for (uint32_t offset = 0; offset < header.sourceSize && readOk; offset += sizeof(buffer)) {
+        const size_t n = min(static_cast<size_t>(header.sourceSize - offset), sizeof(buffer));
+        readOk = esp_partition_read(running, offset, buffer, n) == ESP_OK;
+        mbedtls_md_update(&ctx, buffer, n);
+    }
+
+    mbedtls_md_finish(&ctx, hash);
+    mbedtls_md_free(&ctx);
+
+    if (!readOk || memcmp(hash, header.sourceHash, sizeof(hash)) != 0) {
+        LOG(ERROR, "Delta update rejected, patch was not created for the running firmware");
+        return false;
+    }
+
+    memcpy(otaExpectedHash, header.targetHash, sizeof(otaExpectedHash));
+    otaHashExpected = true;
+    otaTotal = header.targetSize;
+
+    LOGF(INFO, "Delta update matches running firmware, reconstructing %u byte image", header.targetSize);
+
+    if (!otaBeginImage(header.targetSize)) {
+        LOGF(ERROR, "Delta update could not be started: %s", Update.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+inline void otaBegin(AsyncWebServerRequest* request, const OtaTarget target) {
+    if (otaState == kOtaReceiving) {
+        LOG(WARNING, "Firmware update rejected, another update is already running");
+        return;
+    }
+
+    otaError = "";
+    otaWritten = 0;
+    otaTotal = request->contentLength();
+    otaNextProgress = OTA_PROGRESS_INTERVAL;
+    otaReceivedHash[0] = '\0';
+    otaHashExpected = false;
+
+    if (target == kOtaDelta) {
+        // the target image is written once the patch header has been received and checked
+        const esp_partition_t* running = esp_ota_get_running_partition();
+
+        otaDelta = new DeltaPatch([running](const uint32_t offset, uint8_t* buffer, const size_t len) { return esp_partition_read(running, offset, buffer, len) == ESP_OK; }, otaWriteImage, otaBeginDelta);
+    }
+    else {
+        // the digest can be passed as header or as form field in front of the file
+        String expected;
+
+        if (request->hasHeader("X-Update-SHA256")) {
+            expected = request->getHeader("X-Update-SHA256")->value();
+        }
+        else if (request->hasParam("sha256", true)) {
+            expected = request->getParam("sha256", true)->value();
+        }
+
+        otaHashExpected = expected.length() > 0;
+
+        if (otaHashExpected && !otaParseHash(expected, otaExpectedHash)) {
+            otaFail("Invalid SHA-256 digest");
+            return;
+        }
+
+        if (target == kOtaAssets) {
+            const esp_partition_t* partition = AssetBundle::findPartition();
+
+            if (partition == nullptr) {
+                otaFail("No asset partition, the partition table has to be updated over USB first");
+                return;
+            }
+
+            if (assetResponsesInFlight > 0) {
+                otaFail("Web interface files are still being sent, try again");
+                return;
+            }
+
+            // requests for assets are answered with 503 from now on, the partition is only erased once it is unmapped
+            assetBundleUpdating = true;
+            assetBundle.end();
+
+            otaAssetPartition = partition;
+            otaAssetErased = 0;
+
+            otaBeginHash();
+        }
+        else if (!otaBeginImage(UPDATE_SIZE_UNKNOWN)) {
+            otaFail(Update.errorString());
+            return;
+        }
+    }
+
+    otaState = kOtaReceiving;
+    otaRequest = request;
+    otaUpdateRunning = true;
+    otaLastChunk = millis();
+
+    static constexpr const char* targetNames[] = {"update", "delta update", "asset update"};
+    LOGF(INFO, "Firmware %s started, heater disabled until reboot (%u bytes announced)", targetNames[target], request->contentLength());
+
+    request->onDisconnect([request]() {
+        OtaLock lock;
+
+        if (otaState == kOtaReceiving && otaRequest == request) {
+            otaFail("Connection lost");
+        }
+    });
+
+    otaSendProgress();
+}
+
+inline void otaFinish() {
+    if (otaDelta != nullptr) {
+        if (const DeltaPatch::Status status = otaDelta->finish(); status != DeltaPatch::OK) {
+            otaFail(DeltaPatch::statusString(status));
+            return;
+        }
+
+        delete otaDelta;
+        otaDelta = nullptr;
+    }
+
+    uint8_t hash[32];
+    mbedtls_md_finish(&otaHashContext, hash);
+    mbedtls_md_free(&otaHashContext);
+    otaHashActive = false;
+
+    for (int i = 0; i < 32; i++) {
+        snprintf(otaReceivedHash + i * 2, 3, "%02x", hash[i]);
+    }
+
+    if (otaHashExpected && memcmp(hash, otaExpectedHash, sizeof(hash)) != 0) {
+        otaFail("SHA-256 mismatch");
+        return;
+    }
+
+    if (otaAssetPartition != nullptr) {
+        // the bundle becomes valid with its header, which is only written after the hash has been verified
+        if (otaWritten < AssetBundle::HEADER_SIZE || esp_partition_write(otaAssetPartition, 0, otaAssetHeader, sizeof(otaAssetHeader)) != ESP_OK) {
+            otaFail("Writing the asset bundle header failed");
+            return;
+        }
+
+        otaAssetPartition = nullptr;
+        assetBundleUpdating = false;
+
+        if (!assetBundle.begin()) {
+            otaFail("The uploaded asset bundle is invalid");
+            return;
+        }
+    }
+    // end() verifies the image and marks the new partition bootable
+    else if (!Update.end(true)) {
+        otaFail(Update.errorString());
+        return;
+    }
+
+    otaState = kOtaFinished;
+    otaRequest = nullptr;
+
+    LOGF(INFO, "Firmware update written (%u bytes, sha256 %s), rebooting", otaWritten, otaReceivedHash);
+
+    otaSendProgress();
+}
+
+/**
+ * @brief Upload handler, called by the webserver for every received chunk of the image or patch
+ */
+inline void otaHandleUpload(AsyncWebServerRequest* request, const String& filename, const size_t index, const uint8_t* data, const size_t len, const bool final) {
+    OtaLock lock;
+
+    if (index == 0) {
+        if (!authenticate(request)) {
+            return;
+        }
+
+        if (request->url() == "/update/delta") {
+            otaBegin(request, kOtaDelta);
+        }
+        else if (request->url() == "/update/assets") {
+            otaBegin(request, kOtaAssets);
+        }
+        else {
+            otaBegin(request, kOtaFirmware);
+        }
+    }
+
+    if (otaState != kOtaReceiving || otaRequest != request) {
+        return;
+    }
+
+    if (len > 0) {
+        otaLastChunk = millis();
+
+        if (otaDelta != nullptr) {
+            if (const DeltaPatch::Status status = otaDelta->write(data, len); status != DeltaPatch::OK) {
+                otaFail(status == DeltaPatch::TARGET_WRITE_FAILED ? Update.errorString() : DeltaPatch::statusString(status));
+                return;
+            }
+        }
+        else if (!otaWriteImage(data, len)) {
+            otaFail(otaAssetPartition != nullptr ? "Writing the asset partition failed" : Update.errorString());
+            return;
+        }
+    }
+
+    if (final) {
+        otaFinish();
+    }
+}
+
+/**
+ * @brief Request handler, called once the upload has been received completely
+ */
+inline void otaHandleRequest(AsyncWebServerRequest* request) {
+    if (!authenticate(request)) {
+        return request->requestAuthentication();
+    }
+
+    OtaLock lock;
+    char body[160];
+    AsyncWebServerResponse* response;
+
+    if (otaState == kOtaFinished) {
+        snprintf(body, sizeof(body), R"({"success":true,"size":%u,"sha256":"%s","restart":true})", otaWritten, otaReceivedHash);
+        response = request->beginResponse(200, "application/json", body);
+
+        otaRebootAt = millis() + OTA_REBOOT_DELAY;
+    }
+    else {
+        if (otaState == kOtaReceiving && otaRequest == request) {
+            otaFail("Upload incomplete");
+        }
+
+        snprintf(body, sizeof(body), R"({"success":false,"message":"%s"})", otaError.length() > 0 ? otaError.c_str() : "No firmware image received");
+        response = request->beginResponse(400, "application/json", body);
+    }
+
+    response->addHeader("Connection", "close");
+    request->send(response);
+}
+
+/**
+ * @brief Register the /update endpoint
+ * @details The handler also receives requests to /update/delta and /update/assets (sub paths match the same handler),
+ * which carry a delta patch or an asset bundle instead of a full image
+ */
+inline void setupWebUpdate() {
+    otaMutex = xSemaphoreCreateRecursiveMutex();
+
+    onRoute("/update", HTTP_POST, otaHandleRequest, otaHandleUpload);
+}
+
+/**
+ * @brief Supervise a running update from the main loop
+ * @details Aborts stalled uploads and performs the deferred reboot once the response has been delivered.
+ * The mutex is only tried, if the webserver task holds it the upload is progressing and not stalled.
+ */
+inline void loopWebUpdate() {
+    if (otaState == kOtaReceiving) {
+        if (const OtaLock lock(0); lock.isLocked() && otaState == kOtaReceiving && millis() - otaLastChunk > OTA_STALL_TIMEOUT) {
+            otaFail("Upload stalled");
+        }
+    }
+
+    if (otaState == kOtaFinished && otaRebootAt != 0 && static_cast<long>(millis() - otaRebootAt) >= 0) {
+        heaterRelay->off();
+
+        if (u8g2 != nullptr) {
+            u8g2->setPowerSave(1);
+        }
+
+        ESP.restart();
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * @file powerCoordination.h
+ *
+ * @brief Limits the heater duty so that several machines on one circuit stay within a shared power budget
+ */
+
+#pragma once
+
+#include "utils/PowerCoordinator.h"
+
+inline PowerCoordinator powerCoordinator;
+
+/**
+ * @brief Update the heater duty limit from the demands of all machines, called from the control loop after the PID
+ */
+inline void loopPowerCoordination() {
+    if (mqttPowerQueue == nullptr) {
+        return;
+    }
+
+    const unsigned long now = millis();
+    PowerBudget::Request request;
+
+    while (xQueueReceive(mqttPowerQueue, &request, 0) == pdTRUE) {
+        if (!powerCoordinator.receive(request, now)) {
+            LOGF(WARNING, "Too many machines share the power budget, ignoring %s", request.name);
+        }
+    }
+
+    PowerBudget::Request self = {};
+    strlcpy(self.name, hostname.c_str(), sizeof(self.name));
+    self.watts = static_cast<float>(mqtt_power_heater_watts);
+    self.duty = constrain(static_cast<float>(pidOutput / windowSize), 0.0f, 1.0f);
+    self.priority = static_cast<uint8_t>(mqtt_power_priority);
+
+    setHeaterDutyLimit(kHeaterLimitPower, powerCoordinator.limit(self, mqttConnected, static_cast<float>(mqtt_power_budget), mqtt_power_fallback / 100.0f, now));
+
+    if (powerCoordinator.announce(self, now)) {
+        xQueueOverwrite(mqttPowerAnnounceQueue, &self);
+    }
+}
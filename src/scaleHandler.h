@@ -56,7 +56,11 @@ inline void checkBluetoothScaleConnection() {
 
         lastScaleConnectionCheck = currentTime;
 
-        if (const bool connected = scale->isConnected(); !connected) {
+        // the fallback changes the brew state, which belongs to the control task
+        const bool connected = scale->isConnected();
+        ControlLock lock;
+
+        if (!connected) {
             if (!scaleConnectionLost) {
                 // Connection just lost
                 scaleConnectionLost = true;
@@ -199,15 +203,21 @@ inline void scaleCalibrate(const int cellNumber, const int pin) {
 inline float w1 = 0.0;
 inline float w2 = 0.0;
 
-inline void checkWeight() {
+/**
+ * @brief Read the scale and run a requested calibration or tare
+ * @details Called without the control lock, reading the scale and especially taring and calibrating it take a while
+ *
+ * @return Current weight, to be stored in currReadingWeight under the control lock
+ */
+inline float checkWeight() {
     if (!scale) {
-        return;
+        return currReadingWeight;
     }
 
-    currReadingWeight = getScaleWeight();
+    const float weight = getScaleWeight();
 
     if (scaleFailure) {
-        return;
+        return weight;
     }
 
     if (scaleCalibrationOn && !isBluetoothScale) {
@@ -229,6 +239,8 @@ inline void checkWeight() {
         displayWrappedMessage("Taring scale,\nremove any load!\n....\ndone", 0, 2);
         delay(2000);
     }
+
+    return weight;
 }
 
 inline void initScale() {
@@ -0,0 +1,142 @@
+/**
+ * @file shotTelemetry.h
+ *
+ * @brief Records shots at a high rate and hands the samples to the MQTT task in batches
+ */
+
+#pragma once
+
+constexpr float SHOT_FLOW_SMOOTHING = 0.3; // weight of a new flow reading, the scale reading is too coarse for a raw derivative
+
+inline bool shotRecording = false;
+inline uint32_t shotCounter = 0;
+inline unsigned long shotNextSample = 0;
+inline unsigned long shotBatchStart = 0;
+inline float shotLastWeight = 0;
+inline unsigned long shotLastWeightTime = 0;
+inline float shotFlow = 0;
+inline float shotTemperatureSum = 0;
+inline float shotPressureSum = 0;
+inline ShotTelemetryMessage shotTelemetry;
+
+/**
+ * @brief Hand the message to the MQTT task, it is dropped if the queue is still full from a slow or lost connection
+ */
+inline void queueShotTelemetry() {
+    if (xQueueSend(mqttShotQueue, &shotTelemetry, 0) != pdTRUE) {
+        shotTelemetry.summary.dropped++;
+    }
+
+    shotTelemetry.sequence++;
+    shotTelemetry.count = 0;
+}
+
+inline void beginShotTelemetry(const unsigned long now) {
+    shotRecording = true;
+    shotNextSample = now;
+    shotBatchStart = now;
+    shotLastWeight = currBrewWeight;
+    shotLastWeightTime = now;
+    shotFlow = 0;
+    shotTemperatureSum = 0;
+    shotPressureSum = 0;
+
+    shotTelemetry.shot = ++shotCounter;
+    shotTelemetry.sequence = 0;
+    shotTelemetry.count = 0;
+    shotTelemetry.summary = {};
+    shotTelemetry.summary.temperatureMin = INFINITY;
+    shotTelemetry.summary.temperatureMax = -INFINITY;
+}
+
+inline void finishShotTelemetry() {
+    shotRecording = false;
+
+    if (shotTelemetry.count > 0) {
+        queueShotTelemetry();
+    }
+
+    ShotSummary& summary = shotTelemetry.summary;
+    summary.duration = static_cast<uint32_t>(currBrewTime);
+    summary.weight = currBrewWeight;
+
+    if (summary.samples > 0) {
+        summary.temperatureAverage = shotTemperatureSum / summary.samples;
+        summary.pressureAverage = shotPressureSum / summary.samples;
+    }
+    else {
+        summary.temperatureMin = summary.temperatureMax = NAN;
+    }
+
+    LOGF(DEBUG, "Shot %u recorded with %u samples, %u batches dropped", static_cast<unsigned>(shotTelemetry.shot), static_cast<unsigned>(summary.samples), static_cast<unsigned>(summary.dropped));
+
+    queueShotTelemetry();
+}
+
+inline void recordShotSample(const unsigned long now) {
+    // weight readings arrive slower than samples are taken, so the flow is only updated when the weight actually changed
+    if (currBrewWeight != shotLastWeight && now > shotLastWeightTime) {
+        const float flow = (currBrewWeight - shotLastWeight) * 1000 / (now - shotLastWeightTime);
+        shotFlow += SHOT_FLOW_SMOOTHING * (flow - shotFlow);
+        shotLastWeight = currBrewWeight;
+        shotLastWeightTime = now;
+    }
+
+    ShotSample& sample = shotTelemetry.samples[shotTelemetry.count++];
+    sample.time = now - startingTime;
+    sample.temperature = temperature;
+    sample.pressure = inputPressureFilter;
+    sample.weight = currBrewWeight;
+    sample.flow = shotFlow;
+    sample.pump = pumpRelay->isOn();
+    sample.valve = valveRelay->isOn();
+
+    ShotSummary& summary = shotTelemetry.summary;
+    summary.samples++;
+    summary.temperatureMin = min(summary.temperatureMin, sample.temperature);
+    summary.temperatureMax = max(summary.temperatureMax, sample.temperature);
+    summary.pressureMax = max(summary.pressureMax, sample.pressure);
+    summary.flowMax = max(summary.flowMax, sample.flow);
+    shotTemperatureSum += sample.temperature;
+    shotPressureSum += sample.pressure;
+}
+
+/**
+ * @brief Sample the running shot, called from the control loop after the brew state machine
+ * @details kBrewFinished is left again within the same call of brew(), so the end of a shot is detected by leaving the active brew states
+ */
+inline void loopShotTelemetry() {
+    if (mqttShotQueue == nullptr) {
+        return;
+    }
+
+    const unsigned long now = millis();
+
+    if (!checkBrewActive()) {
+        if (shotRecording) {
+            finishShotTelemetry();
+        }
+
+        return;
+    }
+
+    if (!shotRecording) {
+        beginShotTelemetry(now);
+    }
+
+    if (static_cast<long>(now - shotNextSample) < 0) {
+        return;
+    }
+
+    const unsigned long period = 1000 / mqtt_shot_telemetry_rate;
+
+    // a stalled loop skips the missed samples instead of recording a burst of identical ones
+    shotNextSample = now - shotNextSample >= period ? now + period : shotNextSample + period;
+
+    recordShotSample(now);
+
+    if (shotTelemetry.count >= SHOT_TELEMETRY_BATCH_SIZE || now - shotBatchStart >= SHOT_TELEMETRY_BATCH_INTERVAL) {
+        queueShotTelemetry();
+        shotBatchStart = now;
+    }
+}
@@ -0,0 +1,108 @@
+#include "AssetBundle.h"
+
+#include <cstring>
+
+#include "Logger.h"
+
+AssetBundle::AssetBundle() :
+    base_(nullptr), entries_(nullptr), count_(0), handle_(0) {
+}
+
+const esp_partition_t* AssetBundle::findPartition() {
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PARTITION_LABEL);
+}
+
+bool AssetBundle::begin() {
+    end();
+
+    const esp_partition_t* partition = findPartition();
+
+    if (partition == nullptr) {
+        LOG(INFO, "No asset partition found");
+        return false;
+    }
+
+    uint8_t header[HEADER_SIZE];
+
+    if (esp_partition_read(partition, 0, header, sizeof(header)) != ESP_OK || memcmp(header, "CCAB", 4) != 0) {
+        LOG(WARNING, "Asset partition does not contain a bundle");
+        return false;
+    }
+
+    const uint16_t version = header[4] | header[5] << 8;
+    const uint16_t count = header[6] | header[7] << 8;
+    const uint32_t totalSize = header[8] | header[9] << 8 | header[10] << 16 | static_cast<uint32_t>(header[11]) << 24;
+
+    if (version != VERSION || totalSize > partition->size || HEADER_SIZE + count * sizeof(Entry) > totalSize) {
+        LOGF(WARNING, "Asset bundle is invalid (version %u, %u files, %u bytes)", version, count, totalSize);
+        return false;
+    }
+
+    const void* mapped;
+
+    if (esp_partition_mmap(partition, 0, totalSize, SPI_FLASH_MMAP_DATA, &mapped, &handle_) != ESP_OK) {
+        LOG(ERROR, "Mapping the asset partition failed");
+        return false;
+    }
+
+    base_ = static_cast<const uint8_t*>(mapped);
+    entries_ = reinterpret_cast<const Entry*>(base_ + HEADER_SIZE);
+    count_ = count;
+
+    for (uint16_t i = 0; i < count_; i++) {
+        if (entries_[i].offset > totalSize || entries_[i].length > totalSize - entries_[i].offset) {
+            LOGF(WARNING, "Asset bundle entry %u is out of bounds", i);
+            end();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void AssetBundle::end() {
+    if (base_ != nullptr) {
+        spi_flash_munmap(handle_);
+    }
+
+    base_ = nullptr;
+    entries_ = nullptr;
+    count_ = 0;
+}
+
+bool AssetBundle::isValid() const {
+    return base_ != nullptr;
+}
+
+uint16_t AssetBundle::size() const {
+    return count_;
+}
+
+bool AssetBundle::find(const char* path, Asset& asset) const {
+    // the index is sorted by path
+    int low = 0;
+    int high = count_ - 1;
+
+    while (low <= high) {
+        const int mid = (low + high) / 2;
+        const Entry& entry = entries_[mid];
+        const int cmp = strncmp(path, entry.path, sizeof(entry.path));
+
+        if (cmp == 0) {
+            asset.data = base_ + entry.offset;
+            asset.length = entry.length;
+            asset.hash = entry.hash;
+            asset.gzip = entry.flags & FLAG_GZIP;
+            return true;
+        }
+
+        if (cmp < 0) {
+            high = mid - 1;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file AssetBundle.h
+ *
+ * @brief Read-only bundle of web interface assets in a memory-mapped flash partition
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+
+/**
+ * @brief Index of the asset bundle created by auto_compression.py
+ * @details The bundle is mapped into the address space once, lookups return pointers into mapped flash,
+ * so responses can be sent without copying the files into RAM or going through the file system.
+ */
+class AssetBundle {
+    public:
+        static constexpr const char* PARTITION_LABEL = "assets";
+        static constexpr uint16_t VERSION = 1;
+        static constexpr size_t HEADER_SIZE = 16;
+        static constexpr size_t HASH_SIZE = 8;
+
+        struct Asset {
+                const uint8_t* data;
+                uint32_t length;
+                const uint8_t* hash;
+                bool gzip;
+        };
+
+        AssetBundle();
+
+        /**
+         * @brief Find the asset partition
+         * @return Partition or nullptr if the partition table has no asset partition
+         */
+        static const esp_partition_t* findPartition();
+
+        /**
+         * @brief Map the bundle and validate its index
+         * @return true if a valid bundle is available
+         */
+        bool begin();
+
+        /**
+         * @brief Unmap the bundle, e.g. before the partition gets rewritten
+         */
+        void end();
+
+        /**
+         * @brief Check if a valid bundle is mapped
+         */
+        [[nodiscard]] bool isValid() const;
+
+        /**
+         * @brief Get the number of files in the bundle
+         */
+        [[nodiscard]] uint16_t size() const;
+
+        /**
+         * @brief Look up a file by its URL path
+         *
+         * @param path URL path, e.g. "/js/app.js"
+         * @param asset Receives pointers into the mapped bundle
+         * @return true if the file exists
+         */
+        bool find(const char* path, Asset& asset) const;
+
+    private:
+        struct Entry {
+                char path[44];
+                uint32_t offset;
+                uint32_t length;
+                uint8_t hash[HASH_SIZE];
+                uint8_t flags;
+                uint8_t reserved[3];
+        };
+
+        static_assert(sizeof(Entry) == 64, "Entry layout has to match auto_compression.py");
+
+        static constexpr uint8_t FLAG_GZIP = 0x01;
+
+        const uint8_t* base_;
+        const Entry* entries_;
+        uint16_t count_;
+        spi_flash_mmap_handle_t handle_;
+};
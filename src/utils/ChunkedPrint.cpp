@@ -0,0 +1,52 @@
+#include "ChunkedPrint.h"
+
+ChunkedPrint::ChunkedPrint(Print* target) :
+    target_(target), length_(0), hash_(2166136261u), used_(0), failed_(false), buffer_() {
+}
+
+size_t ChunkedPrint::write(const uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t ChunkedPrint::write(const uint8_t* buffer, const size_t size) {
+    length_ += size;
+
+    for (size_t i = 0; i < size; i++) {
+        hash_ = (hash_ ^ buffer[i]) * 16777619u;
+    }
+
+    if (target_ == nullptr) {
+        return size;
+    }
+
+    for (size_t remaining = size; remaining > 0;) {
+        const size_t chunk = min(remaining, CHUNK_SIZE - used_);
+        memcpy(buffer_ + used_, buffer, chunk);
+        used_ += chunk;
+        buffer += chunk;
+        remaining -= chunk;
+
+        if (used_ == CHUNK_SIZE) {
+            send();
+        }
+    }
+
+    return size;
+}
+
+bool ChunkedPrint::send() {
+    if (target_ != nullptr && used_ > 0) {
+        failed_ = failed_ || target_->write(buffer_, used_) != used_;
+        used_ = 0;
+    }
+
+    return !failed_;
+}
+
+size_t ChunkedPrint::length() const {
+    return length_;
+}
+
+uint32_t ChunkedPrint::hash() const {
+    return hash_;
+}
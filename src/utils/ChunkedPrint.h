@@ -0,0 +1,50 @@
+/**
+ * @file ChunkedPrint.h
+ *
+ * @brief Print adapter that counts and hashes the written bytes and forwards them to another Print in chunks
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+class ChunkedPrint : public Print {
+    public:
+        static constexpr size_t CHUNK_SIZE = 128;
+
+        /**
+         * @brief Constructor
+         *
+         * @param target Print receiving the data, e.g. a client in the middle of a streamed publish; nullptr only counts,
+         *               which sizes a payload before it is actually written
+         */
+        explicit ChunkedPrint(Print* target = nullptr);
+
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t* buffer, size_t size) override;
+
+        /**
+         * @brief Forward the buffered bytes to the target
+         *
+         * @return false if the target didn't accept all bytes written so far
+         */
+        bool send();
+
+        /**
+         * @brief Number of bytes written
+         */
+        [[nodiscard]] size_t length() const;
+
+        /**
+         * @brief FNV-1a hash of the bytes written, detects changes of generated content without storing it
+         */
+        [[nodiscard]] uint32_t hash() const;
+
+    private:
+        Print* target_;
+        size_t length_;
+        uint32_t hash_;
+        size_t used_;
+        bool failed_;
+        uint8_t buffer_[CHUNK_SIZE];
+};
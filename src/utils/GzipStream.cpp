@@ -0,0 +1,245 @@
+#include "GzipStream.h"
+
+#include <cstring>
+
+namespace {
+    // Deflate length codes 257..285 (RFC 1951, 3.2.5)
+    constexpr uint16_t lengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    constexpr uint8_t lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+    // Deflate distance codes 0..29
+    constexpr uint16_t distanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    constexpr uint8_t distanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    // CRC-32 lookup table for one nibble, small enough to not matter but 4x faster than bitwise calculation
+    constexpr uint32_t crcTable[] = {0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+                                     0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+}
+
+GzipStream::GzipStream(Print& out) :
+    out_(out), buffer_(), fill_(0), pos_(0), head_(), bitBuffer_(0), bitCount_(0), output_(), outputLen_(0), crc_(0xffffffff), inputSize_(0), outputSize_(0), finished_(false) {
+
+    // gzip header: magic, deflate, no flags, no mtime, no extra flags, unknown OS
+    static constexpr uint8_t header[] = {0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff};
+    memcpy(output_, header, sizeof(header));
+    outputLen_ = sizeof(header);
+
+    // a single deflate block with fixed Huffman codes (BFINAL = 0, BTYPE = 01), closed in finish()
+    writeBits(0b010, 3);
+}
+
+size_t GzipStream::write(const uint8_t byte) {
+    return write(&byte, 1);
+}
+
+size_t GzipStream::write(const uint8_t* buffer, const size_t size) {
+    if (finished_) {
+        return 0;
+    }
+
+    crc_ = updateCrc(crc_, buffer, size);
+    inputSize_ += size;
+
+    size_t remaining = size;
+
+    while (remaining > 0) {
+        if (fill_ == BUFFER_SIZE) {
+            compress(false);
+            slide();
+        }
+
+        const size_t n = min(remaining, BUFFER_SIZE - fill_);
+        memcpy(buffer_ + fill_, buffer, n);
+        fill_ += n;
+        buffer += n;
+        remaining -= n;
+    }
+
+    return size;
+}
+
+void GzipStream::finish() {
+    if (finished_) {
+        return;
+    }
+
+    compress(true);
+
+    // end of the open block, then an empty final block
+    writeSymbol(256);
+    writeBits(0b011, 3);
+    writeSymbol(256);
+    flushBits();
+
+    const uint32_t crc = ~crc_;
+    const uint8_t trailer[] = {static_cast<uint8_t>(crc), static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc >> 16), static_cast<uint8_t>(crc >> 24),
+                               static_cast<uint8_t>(inputSize_), static_cast<uint8_t>(inputSize_ >> 8), static_cast<uint8_t>(inputSize_ >> 16), static_cast<uint8_t>(inputSize_ >> 24)};
+
+    for (const uint8_t b : trailer) {
+        if (outputLen_ == sizeof(output_)) {
+            flushOutput();
+        }
+
+        output_[outputLen_++] = b;
+    }
+
+    flushOutput();
+    finished_ = true;
+}
+
+size_t GzipStream::getInputSize() const {
+    return inputSize_;
+}
+
+size_t GzipStream::getOutputSize() const {
+    return outputSize_ + outputLen_;
+}
+
+void GzipStream::compress(const bool flush) {
+    // without flush keep enough lookahead so that matches are not cut short at the end of the buffer
+    const size_t limit = flush ? fill_ : fill_ - MAX_MATCH;
+
+    while (pos_ < limit) {
+        const size_t available = min(MAX_MATCH, fill_ - pos_);
+
+        if (available >= MIN_MATCH) {
+            const uint32_t h = hash(buffer_ + pos_);
+            const size_t candidate = head_[h];
+            head_[h] = static_cast<uint16_t>(pos_ + 1);
+
+            if (candidate > 0 && pos_ - (candidate - 1) <= WINDOW_SIZE) {
+                const uint8_t* current = buffer_ + pos_;
+                const uint8_t* previous = buffer_ + candidate - 1;
+                size_t length = 0;
+
+                while (length < available && current[length] == previous[length]) {
+                    length++;
+                }
+
+                if (length >= MIN_MATCH) {
+                    writeMatch(length, current - previous);
+
+                    // index the skipped positions as well, so later data can refer to them
+                    for (size_t i = 1; i < length && pos_ + i + MIN_MATCH <= fill_; i++) {
+                        head_[hash(buffer_ + pos_ + i)] = static_cast<uint16_t>(pos_ + i + 1);
+                    }
+
+                    pos_ += length;
+                    continue;
+                }
+            }
+        }
+
+        writeLiteral(buffer_[pos_]);
+        pos_++;
+    }
+}
+
+void GzipStream::slide() {
+    if (pos_ <= WINDOW_SIZE) {
+        return;
+    }
+
+    // keep WINDOW_SIZE bytes of history in front of the current position
+    const size_t shift = pos_ - WINDOW_SIZE;
+    memmove(buffer_, buffer_ + shift, fill_ - shift);
+    fill_ -= shift;
+    pos_ -= shift;
+
+    for (uint16_t& entry : head_) {
+        entry = entry > shift ? static_cast<uint16_t>(entry - shift) : 0;
+    }
+}
+
+void GzipStream::writeLiteral(const uint8_t literal) {
+    writeSymbol(literal);
+}
+
+void GzipStream::writeMatch(const size_t length, const size_t distance) {
+    size_t code = sizeof(lengthBase) / sizeof(lengthBase[0]) - 1;
+
+    while (lengthBase[code] > length) {
+        code--;
+    }
+
+    writeSymbol(static_cast<uint16_t>(257 + code));
+    writeBits(length - lengthBase[code], lengthExtra[code]);
+
+    code = 0;
+
+    while (code + 1 < sizeof(distanceBase) / sizeof(distanceBase[0]) && distanceBase[code + 1] <= distance) {
+        code++;
+    }
+
+    writeHuffman(static_cast<uint16_t>(code), 5);
+    writeBits(distance - distanceBase[code], distanceExtra[code]);
+}
+
+void GzipStream::writeSymbol(const uint16_t symbol) {
+    // fixed literal/length code (RFC 1951, 3.2.6)
+    if (symbol < 144) {
+        writeHuffman(0x30 + symbol, 8);
+    }
+    else if (symbol < 256) {
+        writeHuffman(0x190 + symbol - 144, 9);
+    }
+    else if (symbol < 280) {
+        writeHuffman(symbol - 256, 7);
+    }
+    else {
+        writeHuffman(0xc0 + symbol - 280, 8);
+    }
+}
+
+void GzipStream::writeBits(const uint32_t value, const uint8_t count) {
+    bitBuffer_ |= value << bitCount_;
+    bitCount_ += count;
+
+    while (bitCount_ >= 8) {
+        if (outputLen_ == sizeof(output_)) {
+            flushOutput();
+        }
+
+        output_[outputLen_++] = static_cast<uint8_t>(bitBuffer_);
+        bitBuffer_ >>= 8;
+        bitCount_ -= 8;
+    }
+}
+
+void GzipStream::writeHuffman(const uint16_t code, const uint8_t length) {
+    // Huffman codes are packed starting with the most significant bit
+    uint16_t reversed = 0;
+
+    for (uint8_t i = 0; i < length; i++) {
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    }
+
+    writeBits(reversed, length);
+}
+
+void GzipStream::flushBits() {
+    if (bitCount_ > 0) {
+        writeBits(0, 8 - bitCount_);
+    }
+}
+
+void GzipStream::flushOutput() {
+    out_.write(output_, outputLen_);
+    outputSize_ += outputLen_;
+    outputLen_ = 0;
+}
+
+// multiplicative hash of all three bytes, the top bits are the best mixed ones
+uint32_t GzipStream::hash(const uint8_t* data) {
+    return ((data[0] << 16 | data[1] << 8 | data[2]) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+uint32_t GzipStream::updateCrc(uint32_t crc, const uint8_t* data, size_t len) {
+    while (len--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ crcTable[crc & 0x0f];
+        crc = (crc >> 4) ^ crcTable[crc & 0x0f];
+    }
+
+    return crc;
+}
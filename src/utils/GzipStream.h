@@ -0,0 +1,88 @@
+/**
+ * @file GzipStream.h
+ *
+ * @brief Streaming gzip encoder for dynamic webserver responses
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+class GzipStream : public Print {
+    public:
+        // Maximum distance of back references, determines most of the memory footprint
+        static constexpr size_t WINDOW_SIZE = 2048;
+
+        /**
+         * @brief Constructor
+         * @details Writes the gzip header to the output stream right away. Needs around 6kB of RAM for the window and hash table,
+         * so instances should be allocated on the heap when used from the webserver task.
+         *
+         * @param out Stream receiving the compressed data (e.g. an AsyncResponseStream)
+         */
+        explicit GzipStream(Print& out);
+
+        GzipStream(const GzipStream&) = delete;
+        GzipStream& operator=(const GzipStream&) = delete;
+
+        size_t write(uint8_t byte) override;
+        size_t write(const uint8_t* buffer, size_t size) override;
+
+        /**
+         * @brief Compress the remaining data and write the gzip trailer
+         * @details Has to be called once after all data has been written, later writes are ignored
+         */
+        void finish();
+
+        /**
+         * @brief Number of uncompressed bytes written so far
+         */
+        [[nodiscard]] size_t getInputSize() const;
+
+        /**
+         * @brief Number of compressed bytes (including gzip header and trailer) written to the output so far
+         */
+        [[nodiscard]] size_t getOutputSize() const;
+
+    private:
+        static constexpr size_t BUFFER_SIZE = 2 * WINDOW_SIZE;
+        static constexpr unsigned HASH_BITS = 10;
+        static constexpr size_t HASH_SIZE = 1 << HASH_BITS;
+        static constexpr size_t MIN_MATCH = 3;
+        static constexpr size_t MAX_MATCH = 258;
+
+        void compress(bool flush);
+        void slide();
+
+        void writeLiteral(uint8_t literal);
+        void writeMatch(size_t length, size_t distance);
+        void writeSymbol(uint16_t symbol);
+        void writeBits(uint32_t value, uint8_t count);
+        void writeHuffman(uint16_t code, uint8_t length);
+        void flushBits();
+        void flushOutput();
+
+        static uint32_t hash(const uint8_t* data);
+        static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t len);
+
+        Print& out_;
+
+        // Input buffer: history of up to WINDOW_SIZE bytes followed by data that hasn't been encoded yet
+        uint8_t buffer_[BUFFER_SIZE];
+        size_t fill_;
+        size_t pos_;
+
+        // Most recent position + 1 for each hash of three bytes, 0 if empty
+        uint16_t head_[HASH_SIZE];
+
+        uint32_t bitBuffer_;
+        uint8_t bitCount_;
+
+        uint8_t output_[64];
+        size_t outputLen_;
+
+        uint32_t crc_;
+        size_t inputSize_;
+        size_t outputSize_;
+        bool finished_;
+};
@@ -0,0 +1,149 @@
+#include "HassioDiscovery.h"
+
+#include <cstring>
+
+void writeHassioEntityFields(ResponseWriter& writer, const HassioDevice& device, const HassioEntity& entity) {
+    char buffer[160];
+
+    writer.key("name");
+    writer.value(entity.displayName);
+
+    snprintf(buffer, sizeof(buffer), "clevercoffee-%s-%s", device.hostname, entity.name);
+    writer.key("unique_id");
+    writer.value(buffer);
+
+    if (entity.component != kHassioSensor) {
+        snprintf(buffer, sizeof(buffer), "%s%s/set", device.topicBase, entity.name);
+        writer.key("command_topic");
+        writer.value(buffer);
+    }
+
+    if (device.stateDocument) {
+        snprintf(buffer, sizeof(buffer), "%sstate", device.topicBase);
+        writer.key("state_topic");
+        writer.value(buffer);
+
+        snprintf(buffer, sizeof(buffer), "{{ value_json.%s }}", entity.name);
+        writer.key("value_template");
+        writer.value(buffer);
+    }
+    else {
+        snprintf(buffer, sizeof(buffer), "%s%s", device.topicBase, entity.name);
+        writer.key("state_topic");
+        writer.value(buffer);
+    }
+
+    switch (entity.component) {
+        case kHassioSensor:
+            if (strcmp(entity.deviceClass, "enum") == 0) {
+                writer.key("options");
+                writer.beginArray(device.stateCount);
+
+                for (size_t i = 0; i < device.stateCount; i++) {
+                    writer.value(device.stateNames[i]);
+                }
+
+                writer.endArray();
+            }
+            else {
+                writer.key("unit_of_measurement");
+                writer.value(entity.unit);
+            }
+
+            writer.key("device_class");
+            writer.value(entity.deviceClass);
+            break;
+        case kHassioNumber:
+            writer.key("min");
+            writer.value(entity.min, 1);
+            writer.key("max");
+            writer.value(entity.max, 1);
+            writer.key("step");
+            writer.value(entity.step, 2);
+            writer.key("unit_of_measurement");
+            writer.value(entity.unit);
+            writer.key("mode");
+            writer.value("box");
+            break;
+        case kHassioSwitch:
+            writer.key("payload_on");
+            writer.value("1");
+            writer.key("payload_off");
+            writer.value("0");
+            break;
+        case kHassioButton:
+            writer.key("payload_press");
+            writer.value("1");
+            break;
+    }
+}
+
+void writeHassioDeviceFields(ResponseWriter& writer, const HassioDevice& device) {
+    writer.key("payload_available");
+    writer.value("online");
+    writer.key("payload_not_available");
+    writer.value("offline");
+    writer.key("availability_topic");
+    writer.value(device.availabilityTopic);
+
+    writer.key("device");
+    writer.beginObject(0);
+    writer.key("identifiers");
+    writer.value(device.hostname);
+    writer.key("manufacturer");
+    writer.value("CleverCoffee");
+    writer.key("name");
+    writer.value(device.hostname);
+    writer.endObject();
+}
+
+void writeHassioEntity(Print& out, const HassioDevice& device, const HassioEntity& entity) {
+    ResponseWriter writer(out, ResponseWriter::JSON);
+
+    writer.beginObject(0);
+    writeHassioEntityFields(writer, device, entity);
+    writeHassioDeviceFields(writer, device);
+    writer.endObject();
+}
+
+void writeHassioDevice(Print& out, const HassioDevice& device, const HassioEntity* entities, const size_t count, bool (*enabled)(MqttTopicFeature)) {
+    ResponseWriter writer(out, ResponseWriter::JSON);
+
+    writer.beginObject(0);
+    writeHassioDeviceFields(writer, device);
+
+    writer.key("origin");
+    writer.beginObject(0);
+    writer.key("name");
+    writer.value("CleverCoffee");
+    writer.endObject();
+
+    writer.key("components");
+    writer.beginObject(0);
+
+    for (size_t i = 0; i < count; i++) {
+        const HassioEntity& entity = entities[i];
+
+        if (!enabled(entity.feature)) {
+            continue;
+        }
+
+        writer.key(entity.name);
+        writer.beginObject(0);
+        writer.key("platform");
+        writer.value(hassioComponentNames[entity.component]);
+        writeHassioEntityFields(writer, device, entity);
+        writer.endObject();
+    }
+
+    writer.endObject();
+    writer.endObject();
+}
+
+void formatHassioEntityTopic(char* topic, const size_t size, const HassioDevice& device, const HassioEntity& entity) {
+    snprintf(topic, size, "%s/%s/clevercoffee-%s/%s/config", device.discoveryPrefix, hassioComponentNames[entity.component], device.hostname, entity.name);
+}
+
+void formatHassioDeviceTopic(char* topic, const size_t size, const HassioDevice& device) {
+    snprintf(topic, size, "%s/device/clevercoffee-%s/config", device.discoveryPrefix, device.hostname);
+}
@@ -0,0 +1,89 @@
+/**
+ * @file HassioDiscovery.h
+ *
+ * @brief Home Assistant discovery messages of the MQTT values
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+#include "MqttTopics.h"
+#include "ResponseWriter.h"
+
+/**
+ * @enum HassioComponent
+ * @brief Home Assistant entity types used for discovery
+ */
+enum HassioComponent : uint8_t {
+    kHassioSensor,
+    kHassioNumber,
+    kHassioSwitch,
+    kHassioButton
+};
+
+inline constexpr const char* hassioComponentNames[] = {"sensor", "number", "switch", "button"};
+
+/**
+ * @brief Entry of the Home Assistant discovery table, each entity reads and sets the MQTT topic of the same name
+ */
+struct HassioEntity {
+        HassioComponent component;
+        const char* name;
+        const char* displayName;
+        const char* unit;        // sensors and numbers
+        const char* deviceClass; // sensors, "enum" lists the machine states as options
+        float min;               // numbers
+        float max;
+        float step;
+        MqttTopicFeature feature;
+};
+
+/**
+ * @brief Machine the entities belong to
+ */
+struct HassioDevice {
+        const char* hostname;
+        const char* discoveryPrefix;
+        const char* topicBase;         // "<prefix><hostname>/"
+        const char* availabilityTopic; // last will of the MQTT connection
+        bool stateDocument;            // values are published in one state document instead of a topic each
+        const char* const* stateNames; // options of the machine state sensor
+        size_t stateCount;
+};
+
+/**
+ * @brief Write the members describing an entity to the current object
+ */
+void writeHassioEntityFields(ResponseWriter& writer, const HassioDevice& device, const HassioEntity& entity);
+
+/**
+ * @brief Write the availability and device members shared by all entities to the current object
+ */
+void writeHassioDeviceFields(ResponseWriter& writer, const HassioDevice& device);
+
+/**
+ * @brief Write the discovery payload of an entity
+ */
+void writeHassioEntity(Print& out, const HassioDevice& device, const HassioEntity& entity);
+
+/**
+ * @brief Write the device discovery payload, a single message describing all enabled entities as components of the machine
+ *
+ * @param out Stream the payload is written to
+ * @param device Machine the entities belong to
+ * @param entities Discovery table
+ * @param count Number of entities
+ * @param enabled Tells if the hardware an entity depends on is present
+ */
+void writeHassioDevice(Print& out, const HassioDevice& device, const HassioEntity* entities, size_t count, bool (*enabled)(MqttTopicFeature));
+
+/**
+ * @brief Build the discovery topic of an entity
+ */
+void formatHassioEntityTopic(char* topic, size_t size, const HassioDevice& device, const HassioEntity& entity);
+
+/**
+ * @brief Build the topic of the device discovery message
+ */
+void formatHassioDeviceTopic(char* topic, size_t size, const HassioDevice& device);
@@ -0,0 +1,66 @@
+#include "MqttOutbox.h"
+
+MqttOutbox::MqttOutbox() :
+    connected_(false), droppedBefore_(0) {
+}
+
+bool MqttOutbox::begin(const size_t capacity, const StoreForwardBuffer::DropPolicy policy) {
+    droppedBefore_ = 0;
+
+    return buffer_.begin(capacity, policy);
+}
+
+MqttOutbox::Action MqttOutbox::update(const bool connected, bool& resync) {
+    resync = false;
+
+    if (!connected) {
+        connected_ = false;
+        return STORE;
+    }
+
+    if (!connected_) {
+        connected_ = true;
+
+        // changes that didn't fit into the buffer are only recovered by publishing everything again
+        if (buffer_.dropped() != droppedBefore_) {
+            droppedBefore_ = buffer_.dropped();
+            resync = true;
+        }
+    }
+
+    return buffer_.empty() ? SEND : FLUSH;
+}
+
+bool MqttOutbox::store(const uint16_t topic, const char* payload, const size_t length, const bool coalesce) {
+    return buffer_.push(topic, payload, length, coalesce);
+}
+
+void MqttOutbox::flush(const size_t batch, char* payload, const size_t size, const Sender& send) {
+    uint16_t topic;
+
+    for (size_t i = 0; i < batch; i++) {
+        const int length = buffer_.peek(topic, payload, size);
+
+        if (length < 0) {
+            return;
+        }
+
+        if (!send(topic, payload, min(static_cast<size_t>(length), size))) {
+            return;
+        }
+
+        buffer_.pop();
+    }
+}
+
+bool MqttOutbox::empty() const {
+    return buffer_.empty();
+}
+
+size_t MqttOutbox::count() const {
+    return buffer_.count();
+}
+
+uint32_t MqttOutbox::dropped() const {
+    return buffer_.dropped();
+}
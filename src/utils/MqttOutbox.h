@@ -0,0 +1,84 @@
+/**
+ * @file MqttOutbox.h
+ *
+ * @brief Decides how the MQTT task handles outgoing messages: buffer them while offline, flush the buffer after reconnecting or send them
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+#include <functional>
+
+#include "StoreForwardBuffer.h"
+
+class MqttOutbox {
+    public:
+        /**
+         * @enum Action
+         * @brief What the MQTT task does with outgoing messages in this pass
+         */
+        enum Action {
+            STORE, // broker unreachable, move new messages into the buffer
+            FLUSH, // send a batch of buffered messages, new messages wait in their queues so that an old value never overwrites a newer one
+            SEND   // buffer empty, send new messages right away
+        };
+
+        /** Publish a buffered message, returning false keeps it in the buffer */
+        using Sender = std::function<bool(uint16_t topic, const char* payload, size_t length)>;
+
+        MqttOutbox();
+
+        /**
+         * @brief Allocate the offline buffer, see StoreForwardBuffer::begin()
+         */
+        bool begin(size_t capacity, StoreForwardBuffer::DropPolicy policy);
+
+        /**
+         * @brief Track the connection and choose the action of this pass
+         *
+         * @param connected Broker connection state
+         * @param resync Set if messages were dropped from the buffer during the last outage, the broker may have missed changes then
+         *        and everything has to be published again
+         * @return Action of this pass
+         */
+        Action update(bool connected, bool& resync);
+
+        /**
+         * @brief Buffer a message while the broker is unreachable
+         *
+         * @param topic Topic identifier of the caller
+         * @param payload Message payload
+         * @param length Payload length
+         * @param coalesce States replace their older value, events are kept
+         * @return false if the message was dropped
+         */
+        bool store(uint16_t topic, const char* payload, size_t length, bool coalesce);
+
+        /**
+         * @brief Send the oldest buffered messages, stops at the first failure since the connection is probably gone again
+         *
+         * @param batch Maximum number of messages to send
+         * @param payload Scratch buffer for a payload, longer payloads are truncated
+         * @param size Size of the scratch buffer
+         * @param send Publishes a message
+         */
+        void flush(size_t batch, char* payload, size_t size, const Sender& send);
+
+        [[nodiscard]] bool empty() const;
+
+        /**
+         * @brief Number of buffered messages
+         */
+        [[nodiscard]] size_t count() const;
+
+        /**
+         * @brief Number of messages lost to the drop policy since begin()
+         */
+        [[nodiscard]] uint32_t dropped() const;
+
+    private:
+        StoreForwardBuffer buffer_;
+        bool connected_;
+        uint32_t droppedBefore_;
+};
@@ -0,0 +1,75 @@
+#include "MqttStats.h"
+
+MqttStats::MqttStats() :
+    timings_(), messages_(0), bytes_(0), failures_(0), dropped_(0), start_(0) {
+}
+
+void MqttStats::record(const Operation operation, const uint32_t micros) {
+    Timing& timing = timings_[operation];
+
+    timing.count++;
+    timing.totalMicros += micros;
+    timing.maxMicros = max(timing.maxMicros, micros);
+}
+
+void MqttStats::addMessage(const size_t bytes, const bool sent) {
+    if (!sent) {
+        failures_++;
+        return;
+    }
+
+    messages_++;
+    bytes_ += bytes;
+}
+
+void MqttStats::addDropped() {
+    dropped_++;
+}
+
+void MqttStats::reset() {
+    memset(timings_, 0, sizeof(timings_));
+    messages_ = 0;
+    bytes_ = 0;
+    failures_ = 0;
+    dropped_ = 0;
+    start_ = millis();
+}
+
+const MqttStats::Timing& MqttStats::get(const Operation operation) const {
+    return timings_[operation];
+}
+
+const char* MqttStats::name(const Operation operation) {
+    switch (operation) {
+        case PUBLISH_CYCLE:
+            return "publishCycle";
+        case CLIENT_LOOP:
+            return "clientLoop";
+        case SEND:
+            return "send";
+        case DISCOVERY:
+            return "discovery";
+        default:
+            return "unknown";
+    }
+}
+
+uint32_t MqttStats::messages() const {
+    return messages_;
+}
+
+uint32_t MqttStats::bytes() const {
+    return bytes_;
+}
+
+uint32_t MqttStats::failures() const {
+    return failures_;
+}
+
+uint32_t MqttStats::dropped() const {
+    return dropped_;
+}
+
+uint32_t MqttStats::elapsed() const {
+    return millis() - start_;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file MqttStats.h
+ *
+ * @brief Throughput and timing statistics of the MQTT client
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+class MqttStats {
+    public:
+        /**
+         * @enum Operation
+         * @brief Timed parts of the MQTT handling
+         */
+        enum Operation {
+            PUBLISH_CYCLE, // control loop: one call of writeSysParamsToMQTT() that queued values
+            CLIENT_LOOP,   // MQTT task: one call of the client loop, including the handling of received messages
+            SEND,          // MQTT task: one published message, blocks as long as the broker doesn't take the data
+            DISCOVERY,     // MQTT task: one step of the Home Assistant discovery
+            OPERATION_COUNT
+        };
+
+        struct Timing {
+                uint32_t count;
+                uint64_t totalMicros;
+                uint32_t maxMicros;
+        };
+
+        MqttStats();
+
+        /**
+         * @brief Record the duration of an operation
+         * @details Each operation is only recorded by one task, so no locking is needed
+         */
+        void record(Operation operation, uint32_t micros);
+
+        /**
+         * @brief Count a message handed to the client
+         *
+         * @param bytes Topic and payload length
+         * @param sent false if the client failed to send it
+         */
+        void addMessage(size_t bytes, bool sent);
+
+        /**
+         * @brief Count a value the control loop couldn't queue because the MQTT task fell behind
+         */
+        void addDropped();
+
+        /**
+         * @brief Clear all values and restart the measuring period
+         */
+        void reset();
+
+        [[nodiscard]] const Timing& get(Operation operation) const;
+
+        /**
+         * @brief Get the name of an operation as used in reports
+         */
+        static const char* name(Operation operation);
+
+        [[nodiscard]] uint32_t messages() const;
+        [[nodiscard]] uint32_t bytes() const;
+        [[nodiscard]] uint32_t failures() const;
+        [[nodiscard]] uint32_t dropped() const;
+
+        /**
+         * @brief Time since the last reset in ms, the base for rates
+         */
+        [[nodiscard]] uint32_t elapsed() const;
+
+    private:
+        Timing timings_[OPERATION_COUNT];
+        uint32_t messages_;
+        uint32_t bytes_;
+        uint32_t failures_;
+        uint32_t dropped_;
+        uint32_t start_;
+};
@@ -0,0 +1,184 @@
+#include "MqttTopics.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+void MqttRouter::build(const MqttTopic* topics, const MqttTopicState* states, const size_t count) {
+    topics_ = topics;
+    memset(slots_, 0, sizeof(slots_));
+
+    for (size_t i = 0; i < count; i++) {
+        if (!states[i].enabled) {
+            continue;
+        }
+
+        size_t slot = hash(topics[i].name, strlen(topics[i].name));
+
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & (SIZE - 1);
+        }
+
+        slots_[slot] = static_cast<uint8_t>(i + 1);
+    }
+}
+
+int MqttRouter::find(const char* name, const size_t length) const {
+    for (size_t slot = hash(name, length);; slot = (slot + 1) & (SIZE - 1)) {
+        if (slots_[slot] == 0) {
+            return -1;
+        }
+
+        const size_t index = slots_[slot] - 1;
+        const char* candidate = topics_[index].name;
+
+        if (strncmp(candidate, name, length) == 0 && candidate[length] == '\0') {
+            return static_cast<int>(index);
+        }
+    }
+}
+
+// FNV-1a, reduced to a slot
+size_t MqttRouter::hash(const char* name, const size_t length) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+    }
+
+    return hash & (SIZE - 1);
+}
+
+bool parseMqttCommandTopic(const char* topic, const char* base, const size_t baseLength, const char*& name, size_t& nameLength) {
+    const size_t topicLength = strlen(topic);
+    constexpr size_t suffixLength = sizeof("/set") - 1;
+
+    if (topicLength <= baseLength + suffixLength || strncmp(topic, base, baseLength) != 0 || strcmp(topic + topicLength - suffixLength, "/set") != 0) {
+        return false;
+    }
+
+    name = topic + baseLength;
+    nameLength = topicLength - baseLength - suffixLength;
+
+    return true;
+}
+
+bool parseMqttNumber(const uint8_t* data, const unsigned int length, double& value) {
+    unsigned int i = 0;
+
+    while (i < length && isspace(data[i])) {
+        i++;
+    }
+
+    const bool negative = i < length && data[i] == '-';
+
+    if (i < length && (data[i] == '-' || data[i] == '+')) {
+        i++;
+    }
+
+    double result = 0;
+    double scale = 1;
+    bool fraction = false;
+    bool digits = false;
+
+    for (; i < length && !isspace(data[i]); i++) {
+        if (data[i] == '.' && !fraction) {
+            fraction = true;
+        }
+        else if (isdigit(data[i])) {
+            digits = true;
+            result = result * 10 + (data[i] - '0');
+
+            if (fraction) {
+                scale *= 10;
+            }
+        }
+        else {
+            return false;
+        }
+    }
+
+    while (i < length && isspace(data[i])) {
+        i++;
+    }
+
+    if (!digits || i != length) {
+        return false;
+    }
+
+    value = (negative ? -result : result) / scale;
+
+    return true;
+}
+
+int32_t quantizeMqttValue(const double value) {
+    return static_cast<int32_t>(lround(constrain(value, -2.0e7, 2.0e7) * 100));
+}
+
+int formatMqttNumber(const MqttFormat format, const double value, char* buf, const size_t size) {
+    switch (format) {
+        case kMqttInteger:
+            return snprintf(buf, size, "%d", static_cast<int>(value));
+        case kMqttUnsigned:
+            return snprintf(buf, size, "%u", static_cast<uint8_t>(value));
+        default:
+            return snprintf(buf, size, "%.2f", value);
+    }
+}
+
+uint32_t mqttMachineInterval(const bool brewing, const bool standby) {
+    return brewing ? intervalMQTTbrew : standby ? intervalMQTTstandby : intervalMQTT;
+}
+
+bool isMqttTopicDue(const MqttTopic& topic, const MqttTopicState& state, const int32_t quantized, const uint32_t now, const uint32_t machineInterval) {
+    const MqttPublishPolicy& policy = topic.policy;
+
+    if (state.lastSent == MQTT_NEVER_SENT) {
+        return true;
+    }
+
+    const uint32_t elapsed = now - state.lastSentAt;
+
+    if (policy.maxInterval > 0 && elapsed >= policy.maxInterval) {
+        return true;
+    }
+
+    if (quantized == state.lastSent || elapsed < (policy.machineRate ? machineInterval : policy.minInterval)) {
+        return false;
+    }
+
+    // compared against the last published value, so that slow drift is published once it adds up to the deadband
+    const double change = fabs(static_cast<double>(quantized) - state.lastSent);
+    const double deadband = policy.deadband * (policy.relative ? fabs(static_cast<double>(state.lastSent)) : 100.0);
+
+    return change >= deadband;
+}
+
+MqttStateDocument::MqttStateDocument(char* buffer, const size_t size) :
+    buffer_(buffer), size_(size), length_(snprintf(buffer, size, "{")) {
+}
+
+bool MqttStateDocument::add(const char* name, const char* value, const bool quoted) {
+    if (length_ >= size_ - 1) {
+        return false;
+    }
+
+    const char* quote = quoted ? "\"" : "";
+    length_ += snprintf(buffer_ + length_, size_ - length_, "%s\"%s\":%s%s%s", length_ > 1 ? "," : "", name, quote, value, quote);
+
+    return length_ < size_ - 1;
+}
+
+bool MqttStateDocument::finish() {
+    if (length_ >= size_ - 1) {
+        return false;
+    }
+
+    length_ += snprintf(buffer_ + length_, size_ - length_, "}");
+
+    return length_ < size_;
+}
+
+size_t MqttStateDocument::length() const {
+    return length_;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file MqttTopics.h
+ *
+ * @brief Topic table, inbound routing and publish policies of the MQTT values
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+class Parameter;
+
+// Minimum interval between publishes of a changed measurement, depending on the machine state
+constexpr uint32_t intervalMQTT = 5000;
+constexpr uint32_t intervalMQTTbrew = 500;
+constexpr uint32_t intervalMQTTstandby = 10000;
+
+constexpr uint32_t MQTT_HEARTBEAT_INTERVAL = 60000;
+
+/**
+ * @brief Hardware a topic depends on, topics of missing hardware are neither published nor accepted
+ */
+enum MqttTopicFeature : uint8_t {
+    kMqttAlways,
+    kMqttBrewSwitch,
+    kMqttScale,
+    kMqttScaleByWeight,
+    kMqttDualScale,
+    kMqttPressure
+};
+
+/**
+ * @brief Payload encoding of read-only values, editable parameters are formatted according to their type
+ */
+enum MqttPayload : uint8_t {
+    kMqttNumber,
+    kMqttMachineState
+};
+
+/**
+ * @brief Number format of a payload
+ */
+enum MqttFormat : uint8_t {
+    kMqttDecimal, // two decimals, the resolution values are compared at
+    kMqttInteger,
+    kMqttUnsigned
+};
+
+/**
+ * @brief When a value of a topic is published
+ * @details A value is published if it moved by at least the deadband since it was last published and the minimum interval has passed,
+ * or if it wasn't published for the maximum interval even though it didn't change.
+ */
+struct MqttPublishPolicy {
+        float deadband;       // smallest change that is published, in the unit of the value
+        bool relative;        // deadband is a fraction of the last published value
+        bool machineRate;     // minimum interval depends on the machine state: intervalMQTT, intervalMQTTbrew or intervalMQTTstandby
+        uint32_t minInterval; // ms between two publishes of a changed value, unless machineRate is set
+        uint32_t maxInterval; // ms after which an unchanged value is published again, 0 never
+};
+
+/**
+ * @brief Publish every change within one policy tick, e.g. for settings and states
+ */
+constexpr MqttPublishPolicy mqttOnChange(const uint32_t maxInterval = 0) {
+    return {0, false, false, 0, maxInterval};
+}
+
+/**
+ * @brief Publish measurements that moved by more than their noise, at the rate of the machine state and with a heartbeat
+ */
+constexpr MqttPublishPolicy mqttDeadband(const float deadband, const bool relative = false) {
+    return {deadband, relative, true, 0, MQTT_HEARTBEAT_INTERVAL};
+}
+
+/**
+ * @brief Entry of the static MQTT topic table
+ * @details Editable parameters set parameterId and are published retained, read-only values set read instead.
+ */
+struct MqttTopic {
+        const char* name;
+        const char* parameterId;
+        double (*read)();
+        MqttTopicFeature feature;
+        MqttPayload payload = kMqttNumber;
+        MqttPublishPolicy policy = mqttOnChange(); // parameters are retained, so they need no heartbeat
+};
+
+/**
+ * @brief Runtime state of a topic, kept in a fixed-size array parallel to the topic table
+ */
+struct MqttTopicState {
+        Parameter* parameter;
+        uint16_t offset;     // full topic name in mqttTopicArena
+        int32_t lastSent;    // last published value in hundredths, the resolution of the payload
+        uint32_t lastSentAt; // millis() of the last publish
+        bool enabled;
+        MqttFormat format;
+};
+
+constexpr size_t MQTT_MAX_TOPICS = 48;
+constexpr int32_t MQTT_NEVER_SENT = INT32_MIN;
+
+/**
+ * @brief Routes the name segment of inbound topics to the topic table
+ * @details Names are hashed into an open addressing table, so a lookup costs one hash and usually a single comparison
+ */
+class MqttRouter {
+    public:
+        static constexpr size_t SIZE = 128;
+
+        /**
+         * @brief Insert all enabled topics, collisions are resolved by linear probing
+         *
+         * @param topics Topic table, has to outlive the router
+         * @param states Runtime states parallel to the table
+         * @param count Number of topics, at most MQTT_MAX_TOPICS
+         */
+        void build(const MqttTopic* topics, const MqttTopicState* states, size_t count);
+
+        /**
+         * @brief Find an enabled topic by its name
+         *
+         * @param name Topic name, doesn't have to be null terminated
+         * @param length Length of the name
+         * @return Index into the topic table, -1 if there is no such topic
+         */
+        [[nodiscard]] int find(const char* name, size_t length) const;
+
+    private:
+        static size_t hash(const char* name, size_t length);
+
+        const MqttTopic* topics_ = nullptr;
+        uint8_t slots_[SIZE] = {}; // topic index + 1, 0 marks an empty slot
+};
+
+static_assert(MqttRouter::SIZE >= 2 * MQTT_MAX_TOPICS && (MqttRouter::SIZE & (MqttRouter::SIZE - 1)) == 0, "router table has to be a power of two with a low load factor");
+static_assert(MQTT_MAX_TOPICS < UINT8_MAX, "router slots store the topic index in a byte");
+
+/**
+ * @brief Split a command topic "<base><name>/set" into its name segment
+ *
+ * @param topic Received topic
+ * @param base Topic base "<prefix><hostname>/"
+ * @param baseLength Length of the base
+ * @param name Receives the start of the name, not null terminated
+ * @param nameLength Receives the length of the name
+ * @return false if the topic doesn't have that form
+ */
+bool parseMqttCommandTopic(const char* topic, const char* base, size_t baseLength, const char*& name, size_t& nameLength);
+
+/**
+ * @brief Parse a numeric payload without copying it, PubSubClient doesn't terminate payloads
+ *
+ * @param data Payload bytes
+ * @param length Payload length
+ * @param value Receives the parsed value
+ * @return false if the payload isn't a plain decimal number
+ */
+bool parseMqttNumber(const uint8_t* data, unsigned int length, double& value);
+
+/**
+ * @brief Quantize a value to the resolution of the published payload, so that values are compared the way they are sent
+ */
+int32_t quantizeMqttValue(double value);
+
+/**
+ * @brief Format a numeric payload
+ *
+ * @return Length of the payload, see snprintf()
+ */
+int formatMqttNumber(MqttFormat format, double value, char* buf, size_t size);
+
+/**
+ * @brief Minimum interval between publishes of a changed value for policies following the machine state
+ */
+uint32_t mqttMachineInterval(bool brewing, bool standby);
+
+/**
+ * @brief Evaluate the publish policy of a topic
+ *
+ * @param topic Entry of the topic table
+ * @param state Runtime state of the topic
+ * @param quantized Current value, see quantizeMqttValue()
+ * @param now Current millis()
+ * @param machineInterval Result of mqttMachineInterval(), evaluated once per tick
+ * @return true if the value has to be published now
+ */
+bool isMqttTopicDue(const MqttTopic& topic, const MqttTopicState& state, int32_t quantized, uint32_t now, uint32_t machineInterval);
+
+/**
+ * @brief JSON object of all values, built in a fixed buffer
+ */
+class MqttStateDocument {
+    public:
+        /**
+         * @brief Constructor, starts the document
+         *
+         * @param buffer Buffer the document is written to
+         * @param size Size of the buffer
+         */
+        MqttStateDocument(char* buffer, size_t size);
+
+        /**
+         * @brief Append a member
+         *
+         * @param name Topic name
+         * @param value Formatted value, "null" for a failed reading
+         * @param quoted Write the value as a string
+         * @return false if the document exceeds the buffer
+         */
+        bool add(const char* name, const char* value, bool quoted);
+
+        /**
+         * @brief Close the document
+         *
+         * @return false if the document exceeds the buffer, it must not be published then
+         */
+        bool finish();
+
+        [[nodiscard]] size_t length() const;
+
+    private:
+        char* buffer_;
+        size_t size_;
+        size_t length_;
+};
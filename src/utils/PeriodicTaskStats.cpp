@@ -0,0 +1,62 @@
+#include "PeriodicTaskStats.h"
+
+PeriodicTaskStats::PeriodicTaskStats() :
+    period_(0), count_(0), overruns_(0), totalJitter_(0), maxJitter_(0), totalExecution_(0), maxExecution_(0) {
+}
+
+void PeriodicTaskStats::begin(const uint32_t periodMicros) {
+    period_ = periodMicros;
+    reset();
+}
+
+void PeriodicTaskStats::record(const int32_t jitterMicros, const uint32_t executionMicros) {
+    // early starts only happen within a tick of the scheduler, they count as jitter just like late ones
+    const uint32_t jitter = abs(jitterMicros);
+
+    count_++;
+    totalJitter_ += jitter;
+    maxJitter_ = max(maxJitter_, jitter);
+    totalExecution_ += executionMicros;
+    maxExecution_ = max(maxExecution_, executionMicros);
+
+    if (executionMicros > period_) {
+        overruns_++;
+    }
+}
+
+void PeriodicTaskStats::reset() {
+    count_ = 0;
+    overruns_ = 0;
+    totalJitter_ = 0;
+    maxJitter_ = 0;
+    totalExecution_ = 0;
+    maxExecution_ = 0;
+}
+
+uint32_t PeriodicTaskStats::period() const {
+    return period_;
+}
+
+uint32_t PeriodicTaskStats::count() const {
+    return count_;
+}
+
+uint32_t PeriodicTaskStats::overruns() const {
+    return overruns_;
+}
+
+uint32_t PeriodicTaskStats::averageJitter() const {
+    return count_ > 0 ? totalJitter_ / count_ : 0;
+}
+
+uint32_t PeriodicTaskStats::maxJitter() const {
+    return maxJitter_;
+}
+
+uint32_t PeriodicTaskStats::averageExecution() const {
+    return count_ > 0 ? totalExecution_ / count_ : 0;
+}
+
+uint32_t PeriodicTaskStats::maxExecution() const {
+    return maxExecution_;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file PeriodicTaskStats.h
+ *
+ * @brief Start time jitter and execution time of a task running at a fixed period
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+class PeriodicTaskStats {
+    public:
+        PeriodicTaskStats();
+
+        /**
+         * @brief Set the period of the task and clear all values, called when the task starts
+         *
+         * @param periodMicros Period of the task in us
+         */
+        void begin(uint32_t periodMicros);
+
+        /**
+         * @brief Record one run of the task
+         *
+         * @param jitterMicros Start time of the run relative to its scheduled start, positive if late
+         * @param executionMicros Time the run took
+         */
+        void record(int32_t jitterMicros, uint32_t executionMicros);
+
+        /**
+         * @brief Clear the recorded values
+         */
+        void reset();
+
+        [[nodiscard]] uint32_t period() const;
+        [[nodiscard]] uint32_t count() const;
+
+        /**
+         * @brief Number of runs that took longer than the period, delaying the following ones
+         */
+        [[nodiscard]] uint32_t overruns() const;
+
+        [[nodiscard]] uint32_t averageJitter() const;
+        [[nodiscard]] uint32_t maxJitter() const;
+        [[nodiscard]] uint32_t averageExecution() const;
+        [[nodiscard]] uint32_t maxExecution() const;
+
+    private:
+        uint32_t period_;
+        uint32_t count_;
+        uint32_t overruns_;
+        uint64_t totalJitter_;
+        uint32_t maxJitter_;
+        uint64_t totalExecution_;
+        uint32_t maxExecution_;
+};
@@ -0,0 +1,106 @@
+#include "PowerBudget.h"
+
+namespace {
+    float demand(const PowerBudget::Request& request) {
+        return constrain(request.duty, 0.0f, 1.0f) * max(request.watts, 0.0f);
+    }
+
+    // by priority, then by demand, ties are broken by name so that the order is the same on every machine
+    bool servedBefore(const PowerBudget::Request& a, const PowerBudget::Request& b) {
+        if (a.priority != b.priority) {
+            return a.priority > b.priority;
+        }
+
+        if (demand(a) != demand(b)) {
+            return demand(a) < demand(b);
+        }
+
+        return strcmp(a.name, b.name) < 0;
+    }
+}
+
+PowerBudget::PowerBudget() :
+    entries_(), count_(0) {
+}
+
+bool PowerBudget::update(const Request& request, const uint32_t now) {
+    for (size_t i = 0; i < count_; i++) {
+        if (strcmp(entries_[i].request.name, request.name) == 0) {
+            entries_[i] = {request, now};
+            return true;
+        }
+    }
+
+    if (count_ == MAX_MACHINES) {
+        return false;
+    }
+
+    entries_[count_++] = {request, now};
+
+    return true;
+}
+
+void PowerBudget::expire(const uint32_t now, const uint32_t timeout) {
+    for (size_t i = 0; i < count_;) {
+        if (now - entries_[i].lastSeen > timeout) {
+            entries_[i] = entries_[--count_];
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+void PowerBudget::clear() {
+    count_ = 0;
+}
+
+size_t PowerBudget::size() const {
+    return count_;
+}
+
+float PowerBudget::allocate(const Request& self, const float budget) const {
+    const Request* requests[MAX_MACHINES + 1];
+    size_t count = 0;
+
+    requests[count++] = &self;
+
+    for (size_t i = 0; i < count_; i++) {
+        if (strcmp(entries_[i].request.name, self.name) != 0) {
+            requests[count++] = &entries_[i].request;
+        }
+    }
+
+    for (size_t i = 1; i < count; i++) {
+        const Request* request = requests[i];
+        size_t j = i;
+
+        for (; j > 0 && servedBefore(*request, *requests[j - 1]); j--) {
+            requests[j] = requests[j - 1];
+        }
+
+        requests[j] = request;
+    }
+
+    float remaining = max(budget, 0.0f);
+
+    for (size_t i = 0; i < count;) {
+        size_t end = i;
+
+        while (end < count && requests[end]->priority == requests[i]->priority) {
+            end++;
+        }
+
+        // machines of one priority come sorted by increasing demand, whatever the smaller ones don't need is left for the larger ones
+        for (; i < end; i++) {
+            const float grant = min(demand(*requests[i]), remaining / (end - i));
+            remaining -= grant;
+
+            if (requests[i] == &self) {
+                return self.watts > 0 ? min(grant / self.watts, 1.0f) : 0.0f;
+            }
+        }
+    }
+
+    return 0.0f;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file PowerBudget.h
+ *
+ * @brief Shares a power budget between the heaters of several machines on one circuit
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+class PowerBudget {
+    public:
+        static constexpr size_t MAX_MACHINES = 8;
+        static constexpr size_t NAME_SIZE = 32;
+
+        /**
+         * @brief Heater demand announced by a machine
+         */
+        struct Request {
+                char name[NAME_SIZE]; // hostname, unique within the group
+                float watts;          // heater power at full duty
+                float duty;           // duty the controller asks for, 0-1
+                uint8_t priority;     // higher priorities are served first
+        };
+
+        PowerBudget();
+
+        /**
+         * @brief Store the latest request of another machine
+         *
+         * @param request Request received from the machine
+         * @param now Current time in ms
+         * @return false if the table is full and the machine is ignored
+         */
+        bool update(const Request& request, uint32_t now);
+
+        /**
+         * @brief Forget machines that stopped announcing their requests, e.g. because they were switched off
+         *
+         * @param now Current time in ms
+         * @param timeout Time in ms after which a machine is considered gone
+         */
+        void expire(uint32_t now, uint32_t timeout);
+
+        /**
+         * @brief Forget all machines
+         */
+        void clear();
+
+        /**
+         * @brief Number of other machines known
+         */
+        [[nodiscard]] size_t size() const;
+
+        /**
+         * @brief Compute the duty limit of this machine
+         * @details Priorities are served from the highest down. Within a priority the remaining budget is split evenly,
+         * shares a machine doesn't need go to the others. Only depends on the requests, not on the order they arrived in,
+         * so all machines come to the same result once they have seen the same requests.
+         *
+         * @param self Current request of this machine
+         * @param budget Total power available to the group in W
+         * @return Duty limit of this machine, 0-1
+         */
+        [[nodiscard]] float allocate(const Request& self, float budget) const;
+
+    private:
+        struct Entry {
+                Request request;
+                uint32_t lastSeen;
+        };
+
+        Entry entries_[MAX_MACHINES];
+        size_t count_;
+};
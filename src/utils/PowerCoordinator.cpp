@@ -0,0 +1,48 @@
+#include "PowerCoordinator.h"
+
+PowerCoordinator::PowerCoordinator() :
+    listening_(false), listenStart_(0), announced_(false), lastAnnouncement_(0), announcedDuty_(0) {
+}
+
+bool PowerCoordinator::receive(const PowerBudget::Request& request, const uint32_t now) {
+    return budget_.update(request, now);
+}
+
+float PowerCoordinator::limit(const PowerBudget::Request& self, const bool connected, const float budget, const float fallback, const uint32_t now) {
+    if (!connected) {
+        listening_ = false;
+        return fallback;
+    }
+
+    if (!listening_) {
+        listening_ = true;
+        listenStart_ = now;
+    }
+
+    budget_.expire(now, POWER_PEER_TIMEOUT);
+    const float limit = budget_.allocate(self, budget);
+
+    if (now - listenStart_ < POWER_LISTEN_PERIOD) {
+        return min(limit, fallback);
+    }
+
+    return limit;
+}
+
+bool PowerCoordinator::announce(const PowerBudget::Request& self, const uint32_t now) {
+    const uint32_t elapsed = now - lastAnnouncement_;
+
+    if (announced_ && elapsed < POWER_ANNOUNCE_INTERVAL && (fabsf(self.duty - announcedDuty_) < POWER_ANNOUNCE_DELTA || elapsed < POWER_ANNOUNCE_MIN_INTERVAL)) {
+        return false;
+    }
+
+    announced_ = true;
+    lastAnnouncement_ = now;
+    announcedDuty_ = self.duty;
+
+    return true;
+}
+
+size_t PowerCoordinator::peers() const {
+    return budget_.size();
+}
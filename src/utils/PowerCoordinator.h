@@ -0,0 +1,68 @@
+/**
+ * @file PowerCoordinator.h
+ *
+ * @brief Timing of the power coordination: when the shared budget applies, when to fall back and when to announce the demand
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+#include "PowerBudget.h"
+
+constexpr uint32_t POWER_ANNOUNCE_INTERVAL = 1000;    // ms between announcements of an unchanged demand
+constexpr uint32_t POWER_ANNOUNCE_MIN_INTERVAL = 200; // ms between announcements of a changing demand
+constexpr float POWER_ANNOUNCE_DELTA = 0.05;          // duty change that is announced right away
+constexpr uint32_t POWER_PEER_TIMEOUT = 5000;         // ms without announcement after which a machine is considered switched off
+constexpr uint32_t POWER_LISTEN_PERIOD = 2000;        // ms after connecting until the demands of the other machines are known
+
+class PowerCoordinator {
+    public:
+        PowerCoordinator();
+
+        /**
+         * @brief Store a request announced by another machine
+         *
+         * @param request Request received from the machine
+         * @param now Current time in ms
+         * @return false if too many machines share the budget and the machine is ignored
+         */
+        bool receive(const PowerBudget::Request& request, uint32_t now);
+
+        /**
+         * @brief Compute the heater duty limit of this machine
+         * @details Without a broker connection the last demands of the others may be outdated in either direction, so the
+         * fallback applies. After connecting, the fallback also caps the share until the others had time to announce themselves.
+         *
+         * @param self Current request of this machine, the duty is what the PID asks for and not what the limit lets through
+         * @param connected Broker connection state
+         * @param budget Total power available to the group in W
+         * @param fallback Duty limit while the demands of the others are unknown, 0-1
+         * @param now Current time in ms
+         * @return Duty limit, 0-1
+         */
+        float limit(const PowerBudget::Request& self, bool connected, float budget, float fallback, uint32_t now);
+
+        /**
+         * @brief Check if the demand has to be announced, an unchanged demand once per interval and a changing one sooner
+         * @details The first demand is announced right away. A true result counts as announced.
+         *
+         * @param self Current request of this machine
+         * @param now Current time in ms
+         * @return true if the request has to be published now
+         */
+        bool announce(const PowerBudget::Request& self, uint32_t now);
+
+        /**
+         * @brief Number of other machines known
+         */
+        [[nodiscard]] size_t peers() const;
+
+    private:
+        PowerBudget budget_;
+        bool listening_;
+        uint32_t listenStart_;
+        bool announced_;
+        uint32_t lastAnnouncement_;
+        float announcedDuty_;
+};
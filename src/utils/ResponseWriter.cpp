@@ -0,0 +1,185 @@
+#include "ResponseWriter.h"
+
+#include <cstring>
+
+ResponseWriter::ResponseWriter(Print& out, const Format format) :
+    out_(out), format_(format), first_(true), afterKey_(false) {
+}
+
+ResponseWriter::Format ResponseWriter::negotiate(const String& accept) {
+    if (accept.indexOf("application/msgpack") >= 0 || accept.indexOf("application/x-msgpack") >= 0 || accept.indexOf("application/vnd.msgpack") >= 0) {
+        return MSGPACK;
+    }
+
+    return JSON;
+}
+
+const char* ResponseWriter::contentType(const Format format) {
+    return format == MSGPACK ? "application/msgpack" : "application/json";
+}
+
+void ResponseWriter::beginObject(const size_t size) {
+    separate();
+
+    if (format_ == MSGPACK) {
+        writeHeader(0x80, 16, 0xde, size);
+    }
+    else {
+        out_.write('{');
+        first_ = true;
+    }
+}
+
+void ResponseWriter::endObject() {
+    if (format_ == JSON) {
+        out_.write('}');
+        first_ = false;
+    }
+}
+
+void ResponseWriter::beginArray(const size_t size) {
+    separate();
+
+    if (format_ == MSGPACK) {
+        writeHeader(0x90, 16, 0xdc, size);
+    }
+    else {
+        out_.write('[');
+        first_ = true;
+    }
+}
+
+void ResponseWriter::endArray() {
+    if (format_ == JSON) {
+        out_.write(']');
+        first_ = false;
+    }
+}
+
+void ResponseWriter::key(const char* name) {
+    separate();
+    writeString(name, strlen(name));
+
+    if (format_ == JSON) {
+        out_.write(':');
+        afterKey_ = true;
+    }
+}
+
+void ResponseWriter::value(const char* str) {
+    separate();
+    writeString(str, strlen(str));
+}
+
+void ResponseWriter::value(const int32_t number) {
+    separate();
+
+    if (format_ == JSON) {
+        out_.print(number);
+        return;
+    }
+
+    if (number >= -32 && number <= 127) {
+        out_.write(static_cast<uint8_t>(number)); // positive/negative fixint
+    }
+    else if (number >= INT16_MIN && number <= INT16_MAX) {
+        const uint8_t buf[] = {0xd1, static_cast<uint8_t>(number >> 8), static_cast<uint8_t>(number)};
+        out_.write(buf, sizeof(buf));
+    }
+    else {
+        const uint8_t buf[] = {0xd2, static_cast<uint8_t>(number >> 24), static_cast<uint8_t>(number >> 16), static_cast<uint8_t>(number >> 8), static_cast<uint8_t>(number)};
+        out_.write(buf, sizeof(buf));
+    }
+}
+
+void ResponseWriter::value(const float number, const int decimals) {
+    separate();
+
+    if (format_ == JSON) {
+        out_.print(number, decimals);
+        return;
+    }
+
+    uint32_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+
+    const uint8_t buf[] = {0xca, static_cast<uint8_t>(bits >> 24), static_cast<uint8_t>(bits >> 16), static_cast<uint8_t>(bits >> 8), static_cast<uint8_t>(bits)};
+    out_.write(buf, sizeof(buf));
+}
+
+void ResponseWriter::value(const JsonVariantConst variant) {
+    separate();
+
+    if (format_ == MSGPACK) {
+        serializeMsgPack(variant, out_);
+    }
+    else {
+        serializeJson(variant, out_);
+    }
+}
+
+void ResponseWriter::separate() {
+    if (format_ == MSGPACK) {
+        return;
+    }
+
+    if (afterKey_) {
+        afterKey_ = false;
+    }
+    else if (!first_) {
+        out_.write(',');
+    }
+
+    first_ = false;
+}
+
+void ResponseWriter::writeString(const char* str, const size_t length) {
+    if (format_ == MSGPACK) {
+        if (length < 32) {
+            out_.write(static_cast<uint8_t>(0xa0 | length));
+        }
+        else if (length <= UINT8_MAX) {
+            const uint8_t buf[] = {0xd9, static_cast<uint8_t>(length)};
+            out_.write(buf, sizeof(buf));
+        }
+        else {
+            const uint8_t buf[] = {0xda, static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+            out_.write(buf, sizeof(buf));
+        }
+
+        out_.write(reinterpret_cast<const uint8_t*>(str), length);
+        return;
+    }
+
+    out_.write('"');
+
+    for (size_t i = 0; i < length; i++) {
+        const char c = str[i];
+
+        if (c == '"' || c == '\\') {
+            out_.write('\\');
+            out_.write(c);
+        }
+        else if (c == '\n') {
+            out_.print("\\n");
+        }
+        else if (static_cast<uint8_t>(c) < 0x20) {
+            out_.printf("\\u%04x", c);
+        }
+        else {
+            out_.write(c);
+        }
+    }
+
+    out_.write('"');
+}
+
+void ResponseWriter::writeHeader(const uint8_t fixType, const uint8_t fixLimit, const uint8_t type16, const size_t size) {
+    if (size < fixLimit) {
+        out_.write(static_cast<uint8_t>(fixType | size));
+    }
+    else {
+        const uint8_t buf[] = {type16, static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size)};
+        out_.write(buf, sizeof(buf));
+    }
+}
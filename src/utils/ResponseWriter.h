@@ -0,0 +1,112 @@
+/**
+ * @file ResponseWriter.h
+ *
+ * @brief Streaming writer for API responses in JSON or MessagePack encoding
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+#include <ArduinoJson.h>
+
+class ResponseWriter {
+    public:
+        /**
+         * @enum Format
+         * @brief Encoding of the written response
+         */
+        enum Format {
+            JSON,
+            MSGPACK
+        };
+
+        /**
+         * @brief Constructor
+         *
+         * @param out Stream the encoded response is written to (e.g. an AsyncResponseStream)
+         * @param format Encoding to use
+         */
+        ResponseWriter(Print& out, Format format);
+
+        /**
+         * @brief Select the response format from the value of an Accept header
+         * @details MessagePack is only used if the client explicitly asks for it, everything else gets JSON
+         *
+         * @param accept Value of the Accept header, may be empty
+         * @return Format to use for the response
+         */
+        static Format negotiate(const String& accept);
+
+        /**
+         * @brief Get the MIME type for a format
+         */
+        static const char* contentType(Format format);
+
+        /**
+         * @brief Start an object
+         *
+         * @param size Number of key/value pairs that will follow (required up front by MessagePack)
+         */
+        void beginObject(size_t size);
+
+        /**
+         * @brief Finish the current object
+         */
+        void endObject();
+
+        /**
+         * @brief Start an array
+         *
+         * @param size Number of elements that will follow (required up front by MessagePack)
+         */
+        void beginArray(size_t size);
+
+        /**
+         * @brief Finish the current array
+         */
+        void endArray();
+
+        /**
+         * @brief Write the key of the next object member
+         */
+        void key(const char* name);
+
+        /**
+         * @brief Write a string value
+         */
+        void value(const char* str);
+
+        /**
+         * @brief Write an integer value
+         */
+        void value(int32_t number);
+
+        /**
+         * @brief Write a floating point value
+         *
+         * @param number Value to write
+         * @param decimals Number of decimals used for JSON, MessagePack always encodes a float32
+         */
+        void value(float number, int decimals = 2);
+
+        /**
+         * @brief Write an ArduinoJson document or variant as a single value
+         * @details Allows building larger elements with ArduinoJson while still streaming the surrounding structure
+         */
+        void value(JsonVariantConst variant);
+
+    private:
+        void separate();
+        void writeString(const char* str, size_t length);
+        void writeHeader(uint8_t fixType, uint8_t fixLimit, uint8_t type16, size_t size);
+
+        Print& out_;
+        Format format_;
+
+        // JSON only: true if no element has been written to the current container yet
+        bool first_;
+
+        // JSON only: true if a key has been written and its value is pending
+        bool afterKey_;
+};
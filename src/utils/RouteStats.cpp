@@ -0,0 +1,91 @@
+#include "RouteStats.h"
+
+RouteStats::RouteStats() :
+    routes_(), count_(0), active_(nullptr) {
+}
+
+RouteStats::Route* RouteStats::add(const char* path) {
+    for (size_t i = 0; i < count_; i++) {
+        if (strcmp(routes_[i].path, path) == 0) {
+            return &routes_[i];
+        }
+    }
+
+    if (count_ == MAX_ROUTES) {
+        return nullptr;
+    }
+
+    Route& route = routes_[count_++];
+    route.path = path;
+    clear(route);
+
+    return &route;
+}
+
+void RouteStats::begin(Route* route) {
+    active_ = route;
+}
+
+void RouteStats::addBytes(const size_t bytes) {
+    if (active_ != nullptr) {
+        active_->bytes += bytes;
+    }
+}
+
+void RouteStats::end(const uint32_t micros, const uint32_t freeHeap) {
+    if (active_ == nullptr) {
+        return;
+    }
+
+    // 31 - clz is the index of the highest set bit, i.e. floor(log2(micros))
+    const size_t bucket = micros > 0 ? min(static_cast<size_t>(31 - __builtin_clz(micros)), BUCKETS - 1) : 0;
+
+    active_->count++;
+    active_->histogram[bucket]++;
+    active_->maxMicros = max(active_->maxMicros, micros);
+    active_->minFreeHeap = min(active_->minFreeHeap, freeHeap);
+    active_ = nullptr;
+}
+
+void RouteStats::reset() {
+    for (size_t i = 0; i < count_; i++) {
+        clear(routes_[i]);
+    }
+}
+
+size_t RouteStats::size() const {
+    return count_;
+}
+
+const RouteStats::Route& RouteStats::get(const size_t index) const {
+    return routes_[index];
+}
+
+uint32_t RouteStats::percentile(const Route& route, const uint8_t percentile) {
+    if (route.count == 0) {
+        return 0;
+    }
+
+    // rank of the requested sample, rounded up so that p99 of few requests is the slowest one
+    const uint32_t rank = (static_cast<uint64_t>(route.count) * percentile + 99) / 100;
+    uint32_t seen = 0;
+
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += route.histogram[i];
+
+        if (seen >= rank) {
+            // the slowest request is known exactly, no need to report a bucket bound above it
+            return i == BUCKETS - 1 ? route.maxMicros : min(route.maxMicros, (2u << i) - 1);
+        }
+    }
+
+    return route.maxMicros;
+}
+
+void RouteStats::clear(Route& route) {
+    route.count = 0;
+    route.maxMicros = 0;
+    route.minFreeHeap = UINT32_MAX;
+    route.bytes = 0;
+    memset(route.histogram, 0, sizeof(route.histogram));
+}
@@ -0,0 +1,79 @@
+/**
+ * @file RouteStats.h
+ *
+ * @brief Per-route latency, response size and heap statistics for the webserver
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+class RouteStats {
+    public:
+        static constexpr size_t MAX_ROUTES = 32;
+
+        // Latency histogram with power of two buckets: bucket i counts requests taking [2^i, 2^(i+1)) us, the last one everything above
+        static constexpr size_t BUCKETS = 24;
+
+        struct Route {
+                const char* path;
+                uint32_t count;
+                uint32_t maxMicros;
+                uint32_t minFreeHeap;
+                uint32_t bytes;
+                uint32_t histogram[BUCKETS];
+        };
+
+        RouteStats();
+
+        /**
+         * @brief Register a route, done once while setting up the webserver
+         *
+         * @param path Route path, has to stay valid (string literal)
+         * @return Statistics slot of the route, nullptr if all slots are taken
+         */
+        Route* add(const char* path);
+
+        /**
+         * @brief Mark the start of a request to a route
+         * @details Requests are handled one at a time by the async_tcp task, so one active route is enough
+         */
+        void begin(Route* route);
+
+        /**
+         * @brief Account response bytes to the route currently being handled, ignored outside of a request
+         */
+        void addBytes(size_t bytes);
+
+        /**
+         * @brief Record a finished request of the route passed to begin()
+         *
+         * @param micros Time spent in the handler
+         * @param freeHeap Lowest free heap seen while handling the request
+         */
+        void end(uint32_t micros, uint32_t freeHeap);
+
+        /**
+         * @brief Clear the recorded values of all routes
+         */
+        void reset();
+
+        [[nodiscard]] size_t size() const;
+        [[nodiscard]] const Route& get(size_t index) const;
+
+        /**
+         * @brief Estimate a latency percentile of a route from its histogram
+         *
+         * @param route Route to evaluate
+         * @param percentile Percentile between 0 and 100
+         * @return Upper bound of the bucket containing the percentile in us, 0 if the route has no requests yet
+         */
+        static uint32_t percentile(const Route& route, uint8_t percentile);
+
+    private:
+        static void clear(Route& route);
+
+        Route routes_[MAX_ROUTES];
+        size_t count_;
+        Route* active_;
+};
@@ -0,0 +1,218 @@
+#include "StoreForwardBuffer.h"
+
+#include <new>
+
+StoreForwardBuffer::StoreForwardBuffer() :
+    data_(nullptr), capacity_(0), head_(0), used_(0), live_(0), count_(0), dropped_(0), policy_(DROP_OLDEST) {
+}
+
+StoreForwardBuffer::~StoreForwardBuffer() {
+    delete[] data_;
+}
+
+bool StoreForwardBuffer::begin(const size_t capacity, const DropPolicy policy) {
+    delete[] data_;
+
+    data_ = capacity > 0 ? new (std::nothrow) uint8_t[capacity] : nullptr;
+    capacity_ = data_ != nullptr ? capacity : 0;
+    policy_ = policy;
+    dropped_ = 0;
+    clear();
+
+    return data_ != nullptr;
+}
+
+bool StoreForwardBuffer::push(const uint16_t topic, const char* payload, const size_t length, const bool coalesce) {
+    const size_t size = HEADER_SIZE + length;
+
+    if (size > capacity_ || length > UINT16_MAX) {
+        dropped_++;
+        return false;
+    }
+
+    const size_t previous = coalesce ? find(topic) : NOT_FOUND;
+
+    // the buffered state of the topic is only replaced if the new one fits, otherwise DROP_NEWEST would lose the topic entirely
+    if (policy_ == DROP_NEWEST) {
+        const size_t replaced = previous != NOT_FOUND ? HEADER_SIZE + readHeader(previous).length : 0;
+
+        if (capacity_ - live_ + replaced < size) {
+            dropped_++;
+            return false;
+        }
+    }
+
+    if (previous != NOT_FOUND) {
+        discard(previous);
+    }
+
+    if (capacity_ - used_ < size) {
+        compact();
+    }
+
+    while (capacity_ - used_ < size) {
+        removeHead();
+    }
+
+    const size_t tail = advance(head_, used_);
+    const uint8_t header[HEADER_SIZE] = {static_cast<uint8_t>(topic), static_cast<uint8_t>(topic >> 8), static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+                                         static_cast<uint8_t>(FLAG_LIVE | (coalesce ? FLAG_COALESCE : 0))};
+
+    writeBytes(tail, header, HEADER_SIZE);
+    writeBytes(advance(tail, HEADER_SIZE), reinterpret_cast<const uint8_t*>(payload), length);
+    used_ += size;
+    live_ += size;
+    count_++;
+
+    return true;
+}
+
+int StoreForwardBuffer::peek(uint16_t& topic, char* payload, const size_t size) {
+    skipDead();
+
+    if (count_ == 0) {
+        return -1;
+    }
+
+    const Header header = readHeader(head_);
+    topic = header.topic;
+    readBytes(advance(head_, HEADER_SIZE), reinterpret_cast<uint8_t*>(payload), min(static_cast<size_t>(header.length), size));
+
+    return header.length;
+}
+
+void StoreForwardBuffer::pop() {
+    skipDead();
+
+    if (count_ > 0) {
+        count_--;
+        const Header header = readHeader(head_);
+        head_ = advance(head_, HEADER_SIZE + header.length);
+        used_ -= HEADER_SIZE + header.length;
+        live_ -= HEADER_SIZE + header.length;
+    }
+}
+
+void StoreForwardBuffer::clear() {
+    head_ = 0;
+    used_ = 0;
+    live_ = 0;
+    count_ = 0;
+}
+
+bool StoreForwardBuffer::empty() const {
+    return count_ == 0;
+}
+
+size_t StoreForwardBuffer::count() const {
+    return count_;
+}
+
+uint32_t StoreForwardBuffer::dropped() const {
+    return dropped_;
+}
+
+StoreForwardBuffer::Header StoreForwardBuffer::readHeader(const size_t pos) const {
+    uint8_t bytes[HEADER_SIZE];
+    readBytes(pos, bytes, HEADER_SIZE);
+
+    return {static_cast<uint16_t>(bytes[0] | bytes[1] << 8), static_cast<uint16_t>(bytes[2] | bytes[3] << 8), bytes[4]};
+}
+
+void StoreForwardBuffer::writeBytes(const size_t pos, const uint8_t* data, const size_t n) {
+    const size_t first = min(n, capacity_ - pos);
+    memcpy(data_ + pos, data, first);
+    memcpy(data_, data + first, n - first);
+}
+
+void StoreForwardBuffer::readBytes(const size_t pos, uint8_t* data, const size_t n) const {
+    const size_t first = min(n, capacity_ - pos);
+    memcpy(data, data_ + pos, first);
+    memcpy(data + first, data_, n - first);
+}
+
+size_t StoreForwardBuffer::advance(const size_t pos, const size_t n) const {
+    return capacity_ > 0 ? (pos + n) % capacity_ : 0;
+}
+
+size_t StoreForwardBuffer::find(const uint16_t topic) const {
+    // at most one message per coalesced topic is live, so stop at the first match
+    for (size_t pos = head_, remaining = used_; remaining > 0;) {
+        const Header header = readHeader(pos);
+
+        if ((header.flags & (FLAG_LIVE | FLAG_COALESCE)) == (FLAG_LIVE | FLAG_COALESCE) && header.topic == topic) {
+            return pos;
+        }
+
+        pos = advance(pos, HEADER_SIZE + header.length);
+        remaining -= HEADER_SIZE + header.length;
+    }
+
+    return NOT_FOUND;
+}
+
+void StoreForwardBuffer::discard(const size_t pos) {
+    const Header header = readHeader(pos);
+    const uint8_t flags = header.flags & ~FLAG_LIVE;
+
+    writeBytes(advance(pos, HEADER_SIZE - 1), &flags, 1);
+    live_ -= HEADER_SIZE + header.length;
+    count_--;
+
+    skipDead();
+}
+
+void StoreForwardBuffer::removeHead() {
+    const Header header = readHeader(head_);
+
+    if (header.flags & FLAG_LIVE) {
+        live_ -= HEADER_SIZE + header.length;
+        count_--;
+        dropped_++;
+    }
+
+    head_ = advance(head_, HEADER_SIZE + header.length);
+    used_ -= HEADER_SIZE + header.length;
+}
+
+void StoreForwardBuffer::skipDead() {
+    while (used_ > 0) {
+        const Header header = readHeader(head_);
+
+        if (header.flags & FLAG_LIVE) {
+            break;
+        }
+
+        head_ = advance(head_, HEADER_SIZE + header.length);
+        used_ -= HEADER_SIZE + header.length;
+    }
+}
+
+void StoreForwardBuffer::compact() {
+    // move live messages towards the head over discarded ones, the write position never overtakes the read position
+    size_t read = head_;
+    size_t write = head_;
+    size_t remaining = used_;
+    size_t kept = 0;
+
+    while (remaining > 0) {
+        const Header header = readHeader(read);
+        const size_t size = HEADER_SIZE + header.length;
+
+        if (header.flags & FLAG_LIVE) {
+            if (write != read) {
+                for (size_t i = 0; i < size; i++) {
+                    data_[advance(write, i)] = data_[advance(read, i)];
+                }
+            }
+
+            write = advance(write, size);
+            kept += size;
+        }
+
+        read = advance(read, size);
+        remaining -= size;
+    }
+
+    used_ = kept;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file StoreForwardBuffer.h
+ *
+ * @brief Bounded ring buffer holding outgoing messages while the broker is unreachable
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+class StoreForwardBuffer {
+    public:
+        /**
+         * @enum DropPolicy
+         * @brief What to do with a new message if the buffer is full
+         */
+        enum DropPolicy {
+            DROP_OLDEST, // evict the oldest messages to make room
+            DROP_NEWEST  // reject the new message, a buffered message of the same topic is kept then
+        };
+
+        StoreForwardBuffer();
+        ~StoreForwardBuffer();
+
+        StoreForwardBuffer(const StoreForwardBuffer&) = delete;
+        StoreForwardBuffer& operator=(const StoreForwardBuffer&) = delete;
+
+        /**
+         * @brief Allocate the buffer, all memory is reserved up front
+         *
+         * @param capacity Size in bytes, each message needs its payload plus a 5 byte header; 0 disables buffering
+         * @param policy Behavior when the buffer is full
+         * @return true if the buffer could be allocated
+         */
+        bool begin(size_t capacity, DropPolicy policy);
+
+        /**
+         * @brief Append a message
+         * @details With coalesce set, a buffered message of the same topic that was also pushed with coalesce is discarded,
+         * so only the latest state of a topic is kept, at the position of the latest change. Events are pushed without coalesce.
+         *
+         * @param topic Topic identifier of the caller
+         * @param payload Message payload
+         * @param length Payload length
+         * @param coalesce Replace an older message of the same topic
+         * @return false if the message was dropped
+         */
+        bool push(uint16_t topic, const char* payload, size_t length, bool coalesce);
+
+        /**
+         * @brief Copy the oldest message without removing it
+         *
+         * @param topic Receives the topic identifier
+         * @param payload Receives the payload, truncated to size
+         * @param size Size of the payload buffer
+         * @return Payload length, -1 if the buffer is empty
+         */
+        int peek(uint16_t& topic, char* payload, size_t size);
+
+        /**
+         * @brief Remove the oldest message, typically after it was sent successfully
+         */
+        void pop();
+
+        /**
+         * @brief Discard all messages
+         */
+        void clear();
+
+        [[nodiscard]] bool empty() const;
+
+        /**
+         * @brief Number of buffered messages
+         */
+        [[nodiscard]] size_t count() const;
+
+        /**
+         * @brief Number of messages lost to the drop policy since begin()
+         */
+        [[nodiscard]] uint32_t dropped() const;
+
+    private:
+        static constexpr size_t HEADER_SIZE = 5;
+        static constexpr size_t NOT_FOUND = SIZE_MAX;
+        static constexpr uint8_t FLAG_LIVE = 0x01;
+        static constexpr uint8_t FLAG_COALESCE = 0x02;
+
+        struct Header {
+                uint16_t topic;
+                uint16_t length;
+                uint8_t flags;
+        };
+
+        [[nodiscard]] Header readHeader(size_t pos) const;
+        void writeBytes(size_t pos, const uint8_t* data, size_t n);
+        void readBytes(size_t pos, uint8_t* data, size_t n) const;
+        [[nodiscard]] size_t advance(size_t pos, size_t n) const;
+
+        [[nodiscard]] size_t find(uint16_t topic) const;
+        void discard(size_t pos);
+        void removeHead();
+        void skipDead();
+        void compact();
+
+        uint8_t* data_;
+        size_t capacity_;
+        size_t head_;
+        size_t used_; // bytes between head and tail, including discarded messages
+        size_t live_; // bytes of messages that haven't been discarded
+        size_t count_;
+        uint32_t dropped_;
+        DropPolicy policy_;
+};
@@ -0,0 +1,183 @@
+/**
+ * @file webSession.h
+ *
+ * @brief Cookie based session handling for the embedded webserver
+ *
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <mbedtls/md.h>
+
+#define SESSION_COOKIE_NAME    "ccsession"
+#define SESSION_LIFETIME       604800 // one week in seconds
+#define SESSION_EXPIRY_LENGTH  8      // hex digits of the expiry timestamp
+#define SESSION_MAC_LENGTH     16     // bytes of the truncated HMAC-SHA256
+#define SESSION_TOKEN_LENGTH   (SESSION_EXPIRY_LENGTH + 1 + SESSION_MAC_LENGTH * 2)
+
+// Cached copies of the auth settings, kept up to date by the ParameterRegistry
+inline bool authEnabled = false;
+inline String authUsername = AUTH_USERNAME;
+inline String authPassword = AUTH_PASSWORD;
+
+inline uint8_t sessionBootSecret[32] = {};
+inline uint8_t sessionKey[32] = {};
+
+/**
+ * @brief Seconds since boot, used as time base for session expiry (does not wrap like millis())
+ */
+inline uint32_t sessionNow() {
+    return static_cast<uint32_t>(esp_timer_get_time() / 1000000LL);
+}
+
+/**
+ * @brief Derive the session signing key from the boot secret and the current credentials
+ * @details Has to be called whenever the credentials change, this invalidates all sessions issued before
+ */
+inline void refreshSessionKey() {
+    static bool secretInitialized = false;
+
+    if (!secretInitialized) {
+        esp_fill_random(sessionBootSecret, sizeof(sessionBootSecret));
+        secretInitialized = true;
+    }
+
+    const mbedtls_md_info_t* md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    mbedtls_md_setup(&ctx, md, 1);
+    mbedtls_md_hmac_starts(&ctx, sessionBootSecret, sizeof(sessionBootSecret));
+    mbedtls_md_hmac_update(&ctx, reinterpret_cast<const uint8_t*>(authUsername.c_str()), authUsername.length());
+    mbedtls_md_hmac_update(&ctx, reinterpret_cast<const uint8_t*>(":"), 1);
+    mbedtls_md_hmac_update(&ctx, reinterpret_cast<const uint8_t*>(authPassword.c_str()), authPassword.length());
+    mbedtls_md_hmac_finish(&ctx, sessionKey);
+    mbedtls_md_free(&ctx);
+
+    LOG(DEBUG, "Web session key refreshed, existing sessions invalidated");
+}
+
+/**
+ * @brief Compute the hex encoded MAC for the given expiry part of a token
+ *
+ * @param expiry Hex encoded expiry timestamp (SESSION_EXPIRY_LENGTH characters)
+ * @param out Buffer receiving SESSION_MAC_LENGTH * 2 hex characters (not terminated)
+ */
+inline void sessionMac(const char* expiry, char* out) {
+    uint8_t mac[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), sessionKey, sizeof(sessionKey), reinterpret_cast<const uint8_t*>(expiry), SESSION_EXPIRY_LENGTH, mac);
+
+    static constexpr char hex[] = "0123456789abcdef";
+
+    for (int i = 0; i < SESSION_MAC_LENGTH; i++) {
+        out[i * 2] = hex[mac[i] >> 4];
+        out[i * 2 + 1] = hex[mac[i] & 0x0F];
+    }
+}
+
+/**
+ * @brief Create a new signed session token
+ *
+ * @param token Buffer of at least SESSION_TOKEN_LENGTH + 1 characters
+ */
+inline void createSessionToken(char* token) {
+    snprintf(token, SESSION_EXPIRY_LENGTH + 1, "%08lx", static_cast<unsigned long>(sessionNow() + SESSION_LIFETIME));
+    token[SESSION_EXPIRY_LENGTH] = '.';
+    sessionMac(token, token + SESSION_EXPIRY_LENGTH + 1);
+    token[SESSION_TOKEN_LENGTH] = '\0';
+}
+
+/**
+ * @brief Find a cookie in the value of a Cookie header
+ * @details Only matches whole cookie names, i.e. at the start of the header or after a ';'
+ *
+ * @param header Value of the Cookie header, "name1=value1; name2=value2"
+ * @param name Name of the cookie
+ * @return Start of the cookie value, which ends at the next ';' or the end of the header, nullptr if the cookie isn't set
+ */
+inline const char* findCookie(const char* header, const char* name) {
+    const size_t nameLength = strlen(name);
+
+    while (header != nullptr) {
+        while (*header == ' ') {
+            header++;
+        }
+
+        if (strncmp(header, name, nameLength) == 0 && header[nameLength] == '=') {
+            return header + nameLength + 1;
+        }
+
+        header = strchr(header, ';');
+
+        if (header != nullptr) {
+            header++;
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * @brief Check the session cookie of a request
+ * @details The MAC is compared in constant time, the expiry is only evaluated after the signature has been verified
+ * @return true if the request carries a valid, unexpired session token
+ */
+inline bool hasValidSession(AsyncWebServerRequest* request) {
+    const AsyncWebHeader* cookieHeader = request->getHeader("Cookie");
+
+    if (cookieHeader == nullptr) {
+        return false;
+    }
+
+    const char* token = findCookie(cookieHeader->value().c_str(), SESSION_COOKIE_NAME);
+
+    if (token == nullptr) {
+        return false;
+    }
+
+    if (strnlen(token, SESSION_TOKEN_LENGTH + 1) < SESSION_TOKEN_LENGTH || token[SESSION_EXPIRY_LENGTH] != '.' || (token[SESSION_TOKEN_LENGTH] != '\0' && token[SESSION_TOKEN_LENGTH] != ';')) {
+        return false;
+    }
+
+    char expected[SESSION_MAC_LENGTH * 2];
+    sessionMac(token, expected);
+
+    uint8_t diff = 0;
+
+    for (int i = 0; i < SESSION_MAC_LENGTH * 2; i++) {
+        diff |= expected[i] ^ token[SESSION_EXPIRY_LENGTH + 1 + i];
+    }
+
+    if (diff != 0) {
+        return false;
+    }
+
+    char expiry[SESSION_EXPIRY_LENGTH + 1];
+    memcpy(expiry, token, SESSION_EXPIRY_LENGTH);
+    expiry[SESSION_EXPIRY_LENGTH] = '\0';
+
+    return strtoul(expiry, nullptr, 16) > sessionNow();
+}
+
+/**
+ * @brief Attach a freshly issued session cookie to a response
+ */
+inline void addSessionCookie(AsyncWebServerResponse* response) {
+    char token[SESSION_TOKEN_LENGTH + 1];
+    createSessionToken(token);
+
+    char cookie[SESSION_TOKEN_LENGTH + 80];
+    snprintf(cookie, sizeof(cookie), SESSION_COOKIE_NAME "=%s; Path=/; Max-Age=%d; HttpOnly; SameSite=Strict", token, SESSION_LIFETIME);
+    response->addHeader("Set-Cookie", cookie);
+}
+
+/**
+ * @brief Attach a cookie to a response that removes the session cookie in the browser
+ */
+inline void clearSessionCookie(AsyncWebServerResponse* response) {
+    response->addHeader("Set-Cookie", SESSION_COOKIE_NAME "=; Path=/; Max-Age=0; HttpOnly; SameSite=Strict");
+}
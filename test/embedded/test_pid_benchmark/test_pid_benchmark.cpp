@@ -0,0 +1,65 @@
+/**
+ * @file test_pid_benchmark.cpp
+ *
+ * @brief Cycle counts of one PID computation on the ESP32, float against the double the firmware used before
+ */
+
+#include <Arduino.h>
+#include <PID.h>
+#include <unity.h>
+
+#include "defaults.h"
+
+constexpr unsigned long WINDOW_SIZE = 1000;
+constexpr int ITERATIONS = 10000;
+
+template <typename T>
+static uint32_t cyclesPerCompute() {
+    T temperature = 90;
+    T output = 0;
+    T setpoint = SETPOINT;
+    BasicPID<T> pid(&temperature, &output, &setpoint, AGGKP, AGGKP / AGGTN, AGGTV * AGGKP, P_ON_E, DIRECT);
+
+    pid.SetSampleTime(WINDOW_SIZE);
+    pid.SetOutputLimits(0, WINDOW_SIZE);
+    pid.SetIntegratorLimits(0, AGGIMAX);
+    pid.SetSmoothingFactor(EMA_FACTOR);
+    pid.SetMode(AUTOMATIC);
+
+    const uint32_t start = ESP.getCycleCount();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        temperature = static_cast<T>(90 + (i % 100) * 0.05);
+        pid.Compute(static_cast<unsigned long>(i + 1) * WINDOW_SIZE);
+    }
+
+    return (ESP.getCycleCount() - start) / ITERATIONS;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_float_is_faster_than_double() {
+    const uint32_t floatCycles = cyclesPerCompute<float>();
+    const uint32_t doubleCycles = cyclesPerCompute<double>();
+
+    char message[96];
+    snprintf(message, sizeof(message), "Compute(): float %u cycles, double %u cycles", static_cast<unsigned>(floatCycles), static_cast<unsigned>(doubleCycles));
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_THAN(doubleCycles, floatCycles);
+}
+
+void setup() {
+    delay(2000); // wait for the serial monitor of the test runner
+
+    UNITY_BEGIN();
+    RUN_TEST(test_float_is_faster_than_double);
+    UNITY_END();
+}
+
+void loop() {
+}
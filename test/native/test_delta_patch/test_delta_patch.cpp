@@ -0,0 +1,373 @@
+/**
+ * @file test_delta_patch.cpp
+ *
+ * @brief Applies synthetic patches and patches created by create_delta_update.py between real firmware images
+ *
+ * @details The synthetic patches are built op by op from generated images and cover the cases the release tool rarely
+ *          produces. For the real images the firmware.bin of the esp32_usb and esp32_ota builds are used by default,
+ *          so "pio run" has to be run first. Images of two different releases can be passed with the environment
+ *          variables DELTA_SOURCE and DELTA_TARGET. Those tests are ignored if the images are missing.
+ */
+
+#include <DeltaPatch.h>
+#include <unity.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t> source;
+static std::vector<uint8_t> target;
+static std::vector<uint8_t> patch;
+
+static std::string imagePath(const char* variable, const char* env) {
+    const char* path = getenv(variable);
+
+    return path != nullptr ? path : std::string(PROJECT_DIR) + "/.pio/build/" + env + "/firmware.bin";
+}
+
+static std::vector<uint8_t> readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+/**
+ * @brief Create the patch with the same tool that is used for releases, patch stays empty if that fails
+ */
+static void createPatch(const std::string& sourcePath, const std::string& targetPath) {
+    const std::string patchPath = std::string(PROJECT_DIR) + "/.pio/build/native/firmware.delta";
+    const std::string command = "python3 \"" + std::string(PROJECT_DIR) + "/create_delta_update.py\" \"" + sourcePath + "\" \"" + targetPath + "\" \"" + patchPath + "\"";
+
+    if (system(command.c_str()) == 0) {
+        patch = readFile(patchPath);
+    }
+}
+
+/**
+ * @brief Apply the patch in chunks of the given size
+ *
+ * @param output Reconstructed image
+ * @param image Source image the patch is applied to
+ * @param data Patch to apply
+ * @param chunkSize Size of the chunks the patch is fed in, like the upload handler receives them
+ * @return Status of finish(), or the first error
+ */
+static DeltaPatch::Status apply(std::vector<uint8_t>& output, const std::vector<uint8_t>& image, const std::vector<uint8_t>& data, const size_t chunkSize) {
+    output.clear();
+
+    // COPY ops may only read within the source image
+    DeltaPatch delta(
+        [&image](const uint32_t offset, uint8_t* buffer, const size_t len) {
+            if (static_cast<size_t>(offset) + len > image.size()) {
+                return false;
+            }
+
+            memcpy(buffer, image.data() + offset, len);
+
+            return true;
+        },
+        [&output](const uint8_t* chunk, const size_t len) {
+            output.insert(output.end(), chunk, chunk + len);
+            return true;
+        },
+        [&image](const DeltaPatch::Header& header) { return header.sourceSize == image.size(); });
+
+    for (size_t offset = 0; offset < data.size(); offset += chunkSize) {
+        const size_t len = data.size() - offset < chunkSize ? data.size() - offset : chunkSize;
+        const DeltaPatch::Status status = delta.write(data.data() + offset, len);
+
+        if (status != DeltaPatch::OK) {
+            return status;
+        }
+    }
+
+    return delta.finish();
+}
+
+/**
+ * @brief Builds a patch op by op and the target it reconstructs from the source image
+ * @details The hashes are left zero, they are checked by the update handler and not by DeltaPatch.
+ */
+struct PatchBuilder {
+        const std::vector<uint8_t>& image;
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> target;
+
+        explicit PatchBuilder(const std::vector<uint8_t>& source) :
+            image(source), data(DeltaPatch::HEADER_SIZE, 0) {
+            memcpy(data.data(), "CCDP", 4);
+            data[4] = DeltaPatch::VERSION;
+            putUint32(8, image.size());
+        }
+
+        PatchBuilder& copy(const uint32_t offset, const uint32_t length) {
+            data.push_back(0x01);
+            appendUint32(offset);
+            appendUint32(length);
+
+            // out of bounds ops only go into the patch
+            if (static_cast<size_t>(offset) + length <= image.size()) {
+                target.insert(target.end(), image.begin() + offset, image.begin() + offset + length);
+            }
+
+            return *this;
+        }
+
+        PatchBuilder& insert(const std::vector<uint8_t>& literal) {
+            data.push_back(0x02);
+            appendUint32(literal.size());
+            data.insert(data.end(), literal.begin(), literal.end());
+            target.insert(target.end(), literal.begin(), literal.end());
+
+            return *this;
+        }
+
+        /**
+         * @brief Append the END op and announce the target size, by default the size of the reconstructed target
+         */
+        std::vector<uint8_t> end(const size_t targetSize) {
+            putUint32(12, targetSize);
+            data.push_back(0x00);
+
+            return data;
+        }
+
+        std::vector<uint8_t> end() {
+            return end(target.size());
+        }
+
+    private:
+        void putUint32(const size_t offset, const uint32_t value) {
+            for (size_t i = 0; i < 4; i++) {
+                data[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        }
+
+        void appendUint32(const uint32_t value) {
+            data.resize(data.size() + 4);
+            putUint32(data.size() - 4, value);
+        }
+};
+
+static std::vector<uint8_t> randomBytes(const size_t size, const uint32_t seed) {
+    std::mt19937 random(seed);
+    std::vector<uint8_t> bytes(size);
+
+    for (uint8_t& byte : bytes) {
+        byte = static_cast<uint8_t>(random());
+    }
+
+    return bytes;
+}
+
+// not a multiple of the copy buffer, so that COPY ops up to the end of the image end within a window
+static const std::vector<uint8_t> syntheticSource = randomBytes(3 * DeltaPatch::COPY_BUFFER_SIZE + 517, 1);
+
+/**
+ * @brief Apply a synthetic patch in different chunk sizes and compare the output against the expected target
+ */
+static void checkSynthetic(const std::vector<uint8_t>& data, const std::vector<uint8_t>& expected) {
+    for (const size_t chunkSize : {static_cast<size_t>(1), static_cast<size_t>(7), static_cast<size_t>(1436), data.size()}) {
+        std::vector<uint8_t> output;
+
+        TEST_ASSERT_EQUAL_STRING(DeltaPatch::statusString(DeltaPatch::OK), DeltaPatch::statusString(apply(output, syntheticSource, data, chunkSize)));
+        TEST_ASSERT_EQUAL(expected.size(), output.size());
+        TEST_ASSERT_TRUE(output == expected);
+    }
+}
+
+static void requireImages() {
+    if (source.empty() || target.empty()) {
+        TEST_IGNORE_MESSAGE("No firmware images, run \"pio run\" first or set DELTA_SOURCE and DELTA_TARGET");
+    }
+
+    TEST_ASSERT_FALSE_MESSAGE(patch.empty(), "create_delta_update.py failed");
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// mostly new code with short matches in between, as after a larger refactoring
+void test_insert_heavy_patch() {
+    PatchBuilder builder(syntheticSource);
+    std::mt19937 random(2);
+
+    builder.insert({});
+
+    for (uint32_t i = 0; i < 200; i++) {
+        builder.insert(randomBytes(1 + random() % 600, i + 100));
+
+        if (i % 8 == 0) {
+            builder.copy(random() % (syntheticSource.size() - 32), 24 + random() % 8);
+        }
+    }
+
+    builder.insert({0x00});
+    builder.insert(randomBytes(3 * DeltaPatch::COPY_BUFFER_SIZE, 3));
+
+    const std::vector<uint8_t> data = builder.end();
+
+    TEST_ASSERT_GREATER_THAN(syntheticSource.size() * 10, builder.target.size());
+    checkSynthetic(data, builder.target);
+}
+
+// COPY ops are split into reads of COPY_BUFFER_SIZE, lengths and offsets around that size
+void test_copy_at_window_boundaries() {
+    constexpr uint32_t window = DeltaPatch::COPY_BUFFER_SIZE;
+    PatchBuilder builder(syntheticSource);
+
+    builder.copy(0, window - 1);
+    builder.copy(0, window);
+    builder.copy(0, window + 1);
+    builder.copy(window - 1, window);
+    builder.copy(window, window);
+    builder.copy(window + 1, 2 * window);
+    builder.copy(window, 0);
+
+    checkSynthetic(builder.end(), builder.target);
+}
+
+void test_copy_at_image_boundaries() {
+    const auto size = static_cast<uint32_t>(syntheticSource.size());
+    PatchBuilder builder(syntheticSource);
+
+    builder.copy(0, size);
+    builder.copy(0, 1);
+    builder.copy(size - 1, 1);
+    builder.copy(size - DeltaPatch::COPY_BUFFER_SIZE - 1, DeltaPatch::COPY_BUFFER_SIZE + 1);
+    builder.copy(size, 0);
+
+    checkSynthetic(builder.end(), builder.target);
+}
+
+void test_copy_out_of_bounds_is_rejected() {
+    const auto size = static_cast<uint32_t>(syntheticSource.size());
+
+    // past the end of the source, starting past it and an offset that wraps around
+    for (const auto& [offset, length] : {std::pair<uint32_t, uint32_t>{0, size + 1}, {size - 1, 2}, {size + 1, 0}, {UINT32_MAX, 2}, {1, UINT32_MAX}}) {
+        PatchBuilder builder(syntheticSource);
+        builder.copy(0, 16);
+        builder.copy(offset, length);
+
+        std::vector<uint8_t> output;
+
+        TEST_ASSERT_EQUAL_STRING(DeltaPatch::statusString(DeltaPatch::OUT_OF_BOUNDS), DeltaPatch::statusString(apply(output, syntheticSource, builder.end(16 + 2 * size), 7)));
+        TEST_ASSERT_EQUAL(16, output.size());
+    }
+
+    // within the source but beyond the announced target
+    PatchBuilder builder(syntheticSource);
+    builder.copy(0, 16);
+    builder.copy(16, 16);
+
+    std::vector<uint8_t> output;
+
+    TEST_ASSERT_EQUAL(DeltaPatch::OUT_OF_BOUNDS, apply(output, syntheticSource, builder.end(31), 7));
+    TEST_ASSERT_EQUAL(16, output.size());
+}
+
+void test_insert_beyond_target_is_rejected() {
+    PatchBuilder builder(syntheticSource);
+    builder.insert(randomBytes(16, 4));
+
+    std::vector<uint8_t> output;
+
+    TEST_ASSERT_EQUAL(DeltaPatch::OUT_OF_BOUNDS, apply(output, syntheticSource, builder.end(15), 7));
+    TEST_ASSERT_TRUE(output.empty());
+}
+
+void test_patch_reconstructs_target() {
+    requireImages();
+
+    char message[128];
+    snprintf(message, sizeof(message), "source %zu bytes, target %zu bytes, patch %zu bytes (%.1f%% of the target)", source.size(), target.size(), patch.size(), patch.size() * 100.0 / target.size());
+    TEST_MESSAGE(message);
+
+    // single bytes, odd sizes, roughly one TCP segment as the upload handler gets it and everything at once
+    for (const size_t chunkSize : {static_cast<size_t>(1), static_cast<size_t>(7), static_cast<size_t>(1436), patch.size()}) {
+        std::vector<uint8_t> output;
+
+        TEST_ASSERT_EQUAL_STRING(DeltaPatch::statusString(DeltaPatch::OK), DeltaPatch::statusString(apply(output, source, patch, chunkSize)));
+        TEST_ASSERT_EQUAL(target.size(), output.size());
+        TEST_ASSERT_TRUE(output == target);
+    }
+}
+
+void test_wrong_source_is_rejected() {
+    requireImages();
+
+    std::vector<uint8_t> data = patch;
+    std::vector<uint8_t> output;
+
+    // announce a different source size, the header handler rejects the patch before anything is written
+    data[8] ^= 0x01;
+
+    TEST_ASSERT_EQUAL(DeltaPatch::REJECTED, apply(output, source, data, 1436));
+    TEST_ASSERT_TRUE(output.empty());
+}
+
+void test_truncated_patch_is_incomplete() {
+    requireImages();
+
+    std::vector<uint8_t> data(patch.begin(), patch.end() - 1);
+    std::vector<uint8_t> output;
+
+    TEST_ASSERT_EQUAL(DeltaPatch::INCOMPLETE, apply(output, source, data, 1436));
+}
+
+void test_trailing_data_is_rejected() {
+    requireImages();
+
+    std::vector<uint8_t> data = patch;
+    std::vector<uint8_t> output;
+    data.push_back(0x00);
+
+    TEST_ASSERT_EQUAL(DeltaPatch::TRAILING_DATA, apply(output, source, data, 1436));
+}
+
+void test_invalid_op_is_rejected() {
+    requireImages();
+
+    std::vector<uint8_t> data = patch;
+    std::vector<uint8_t> output;
+
+    // first op follows the header
+    data[DeltaPatch::HEADER_SIZE] = 0x7f;
+
+    TEST_ASSERT_EQUAL(DeltaPatch::INVALID_OP, apply(output, source, data, 1436));
+}
+
+int main() {
+    const std::string sourcePath = imagePath("DELTA_SOURCE", "esp32_usb");
+    const std::string targetPath = imagePath("DELTA_TARGET", "esp32_ota");
+
+    source = readFile(sourcePath);
+    target = readFile(targetPath);
+
+    if (!source.empty() && !target.empty()) {
+        createPatch(sourcePath, targetPath);
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_insert_heavy_patch);
+    RUN_TEST(test_copy_at_window_boundaries);
+    RUN_TEST(test_copy_at_image_boundaries);
+    RUN_TEST(test_copy_out_of_bounds_is_rejected);
+    RUN_TEST(test_insert_beyond_target_is_rejected);
+    RUN_TEST(test_patch_reconstructs_target);
+    RUN_TEST(test_wrong_source_is_rejected);
+    RUN_TEST(test_truncated_patch_is_incomplete);
+    RUN_TEST(test_trailing_data_is_rejected);
+    RUN_TEST(test_invalid_op_is_rejected);
+
+    return UNITY_END();
+}
@@ -0,0 +1,280 @@
+/**
+ * @file test_gzip_stream.cpp
+ *
+ * @brief Checks the output of GzipStream with zlib and compares the bytes saved with the time spent encoding
+ */
+
+#include <unity.h>
+#include <zlib.h>
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "utils/GzipStream.h"
+#include "utils/ResponseWriter.h"
+
+/**
+ * @brief Collects the written response
+ */
+class BufferPrint : public Print {
+    public:
+        size_t write(const uint8_t c) override {
+            buffer.push_back(static_cast<char>(c));
+            return 1;
+        }
+
+        size_t write(const uint8_t* data, const size_t size) override {
+            buffer.append(reinterpret_cast<const char*>(data), size);
+            return size;
+        }
+
+        std::string buffer;
+};
+
+/**
+ * @brief Response of /timeseries with a full history of a machine holding its temperature
+ */
+static std::string timeseries() {
+    constexpr int historyLength = 600;
+    static constexpr const char* seriesNames[] = {"currentTemps", "targetTemps", "heaterPowers"};
+
+    BufferPrint out;
+    ResponseWriter writer(out, ResponseWriter::JSON);
+    uint32_t noise = 1;
+
+    writer.beginObject(3);
+
+    for (int series = 0; series < 3; series++) {
+        writer.key(seriesNames[series]);
+        writer.beginArray(historyLength);
+
+        for (int n = 0; n < historyLength; n++) {
+            noise = noise * 1103515245 + 12345;
+            const float jitter = static_cast<float>(noise >> 16 & 0xff) / 2550.0f;
+
+            switch (series) {
+                case 0:
+                    writer.value(93.0f + 0.4f * sinf(n * 0.05f) + jitter);
+                    break;
+                case 1:
+                    writer.value(93.0f);
+                    break;
+                default:
+                    writer.value(fmaxf(0.0f, 20.0f - 40.0f * sinf(n * 0.05f) + 100 * jitter));
+                    break;
+            }
+        }
+
+        writer.endArray();
+    }
+
+    writer.endObject();
+
+    return out.buffer;
+}
+
+/**
+ * @brief The parameter documentation, a longer text with less repetition than the API responses
+ */
+static std::string configReference() {
+    std::ifstream file(std::string(PROJECT_DIR) + "/CONFIG_REFERENCE.md", std::ios::binary);
+
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+static std::string gzip(const std::string& input, const size_t chunkSize) {
+    BufferPrint out;
+    GzipStream stream(out);
+
+    for (size_t offset = 0; offset < input.size(); offset += chunkSize) {
+        const size_t len = input.size() - offset < chunkSize ? input.size() - offset : chunkSize;
+        stream.write(reinterpret_cast<const uint8_t*>(input.data()) + offset, len);
+    }
+
+    stream.finish();
+
+    TEST_ASSERT_EQUAL(input.size(), stream.getInputSize());
+    TEST_ASSERT_EQUAL(out.buffer.size(), stream.getOutputSize());
+
+    return out.buffer;
+}
+
+/**
+ * @brief Decompress with zlib, fails the test if the data isn't valid gzip (including the CRC and size in the trailer)
+ */
+static std::string gunzip(const std::string& compressed) {
+    z_stream zs{};
+    std::string output;
+    char buffer[4096];
+
+    TEST_ASSERT_EQUAL(Z_OK, inflateInit2(&zs, 16 + MAX_WBITS));
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    zs.avail_in = compressed.size();
+
+    int result;
+
+    do {
+        zs.next_out = reinterpret_cast<Bytef*>(buffer);
+        zs.avail_out = sizeof(buffer);
+        result = inflate(&zs, Z_NO_FLUSH);
+        output.append(buffer, sizeof(buffer) - zs.avail_out);
+    } while (result == Z_OK);
+
+    const size_t remaining = zs.avail_in;
+    inflateEnd(&zs);
+
+    TEST_ASSERT_EQUAL(Z_STREAM_END, result);
+    TEST_ASSERT_EQUAL(0, remaining);
+
+    return output;
+}
+
+/**
+ * @brief Size of the same data gzipped by zlib at the given level, as reference for the compression ratio
+ */
+static size_t zlibSize(const std::string& input, const int level) {
+    z_stream zs{};
+    std::string output(compressBound(input.size()) + 32, '\0');
+
+    deflateInit2(&zs, level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    zs.avail_in = input.size();
+    zs.next_out = reinterpret_cast<Bytef*>(output.data());
+    zs.avail_out = output.size();
+    deflate(&zs, Z_FINISH);
+    deflateEnd(&zs);
+
+    return zs.total_out;
+}
+
+static void roundTrip(const std::string& input) {
+    // single bytes as Print::print produces them, odd sizes and everything at once
+    for (const size_t chunkSize : {static_cast<size_t>(1), static_cast<size_t>(13), input.size() + 1}) {
+        const std::string decompressed = gunzip(gzip(input, chunkSize));
+
+        TEST_ASSERT_EQUAL(input.size(), decompressed.size());
+        TEST_ASSERT_TRUE(decompressed == input);
+    }
+}
+
+/**
+ * @brief Print the bytes saved and the encoding time per input byte
+ * @return Compressed size
+ */
+static size_t benchmark(const char* name, const std::string& input) {
+    constexpr int iterations = 50;
+    size_t compressedSize = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; i++) {
+        compressedSize = gzip(input, 64).size();
+    }
+
+    const double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    char message[200];
+    snprintf(message, sizeof(message), "%s: %zu -> %zu bytes (%.0f%% saved, zlib -1: %zu, -9: %zu), %.1f ns per input byte", name, input.size(), compressedSize, 100.0 - compressedSize * 100.0 / input.size(), zlibSize(input, 1),
+             zlibSize(input, 9), nanoseconds / input.size());
+    TEST_MESSAGE(message);
+
+    return compressedSize;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_empty_input() {
+    roundTrip("");
+}
+
+void test_timeseries_round_trip() {
+    roundTrip(timeseries());
+}
+
+void test_timeseries_ratio() {
+    const std::string input = timeseries();
+
+    // each hash bucket keeps a single candidate, so the hash has to use all three bytes to find the repeated digits of the values
+    TEST_ASSERT_LESS_THAN(input.size() / 3, gzip(input, 64).size());
+}
+
+void test_config_round_trip() {
+    const std::string input = configReference();
+
+    TEST_ASSERT_FALSE(input.empty());
+    roundTrip(input);
+}
+
+void test_long_matches_round_trip() {
+    // matches longer than MAX_MATCH and distances up to the full window
+    std::string input(3 * GzipStream::WINDOW_SIZE, 'a');
+
+    for (size_t i = 0; i < input.size(); i += GzipStream::WINDOW_SIZE - 1) {
+        input[i] = 'b';
+    }
+
+    roundTrip(input);
+}
+
+void test_incompressible_round_trip() {
+    std::string input(10000, '\0');
+    uint32_t state = 42;
+
+    for (char& c : input) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        c = static_cast<char>(state);
+    }
+
+    roundTrip(input);
+}
+
+void test_writes_after_finish_are_ignored() {
+    BufferPrint out;
+    GzipStream stream(out);
+
+    stream.print("{\"value\":1}");
+    stream.finish();
+
+    const size_t size = out.buffer.size();
+
+    TEST_ASSERT_EQUAL(0, stream.write(reinterpret_cast<const uint8_t*>("more"), 4));
+    TEST_ASSERT_EQUAL(size, out.buffer.size());
+    TEST_ASSERT_EQUAL_STRING("{\"value\":1}", gunzip(out.buffer).c_str());
+}
+
+void test_benchmark_timeseries() {
+    const std::string input = timeseries();
+
+    TEST_ASSERT_LESS_THAN(input.size() / 2, benchmark("/timeseries", input));
+}
+
+void test_benchmark_config() {
+    const std::string input = configReference();
+
+    TEST_ASSERT_LESS_THAN(input.size() / 2, benchmark("CONFIG_REFERENCE.md", input));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_input);
+    RUN_TEST(test_timeseries_round_trip);
+    RUN_TEST(test_timeseries_ratio);
+    RUN_TEST(test_config_round_trip);
+    RUN_TEST(test_long_matches_round_trip);
+    RUN_TEST(test_incompressible_round_trip);
+    RUN_TEST(test_writes_after_finish_are_ignored);
+    RUN_TEST(test_benchmark_timeseries);
+    RUN_TEST(test_benchmark_config);
+
+    return UNITY_END();
+}
@@ -0,0 +1,235 @@
+/**
+ * @file test_heater_modulation.cpp
+ *
+ * @brief Runs the heater interrupt of isr.h against a boiler model and compares the temperature ripple of window and pulse density modulation
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <vector>
+
+#include "hardware/IsrRelay.h"
+
+static bool heaterOn = false;
+
+// the relay only records its state, main.cpp defines these before including isr.h
+IsrRelay::IsrRelay(int, Relay::TriggerType) :
+    onRegister(nullptr), offRegister(nullptr), mask(0) {
+}
+
+void IsrRelay::on() const {
+    heaterOn = true;
+}
+
+void IsrRelay::off() const {
+    heaterOn = false;
+}
+
+hw_timer_t* timer = nullptr;
+IsrRelay* heaterIsrRelay = new IsrRelay(0, Relay::HIGH_TRIGGER);
+
+#include "isr.h"
+
+/**
+ * @brief Small boiler, the sensor sits on the wall next to the heater element, which is what the PID sees
+ */
+struct Boiler {
+        double wall = 93;  // °C
+        double water = 93; // °C
+
+        void step(const double seconds, const bool heating) {
+            constexpr double heaterWatts = 1000;
+            constexpr double wallCapacity = 150;   // J/K, heater element and the boiler wall around the sensor
+            constexpr double waterCapacity = 1250; // J/K, 0.3 l of water
+            constexpr double wallToWater = 40;     // W/K
+            constexpr double loss = 1.4;           // W/K
+            constexpr double ambient = 20;
+
+            const double flow = wallToWater * (wall - water);
+            wall += ((heating ? heaterWatts : 0) - flow) * seconds / wallCapacity;
+            water += (flow - loss * (water - ambient)) * seconds / waterCapacity;
+        }
+};
+
+struct Result {
+        double ripple;      // K peak to peak at the sensor
+        uint32_t onTicks;   // per window, on average
+        uint32_t switching; // relay switch-ons per window
+};
+
+/**
+ * @brief Run the interrupt at a fixed duty and measure the ripple once the boiler follows the modulation
+ *
+ * @param modulation Modulation of the ISR
+ * @param duty PID output in ms per window
+ */
+static Result simulate(const HeaterModulation modulation, const float duty) {
+    constexpr int settleWindows = 120;
+    constexpr int measureWindows = 20;
+    constexpr int substeps = 10; // per tick, 1 ms resolution for the boiler
+
+    initTimer1();
+    heaterModulation = modulation;
+    heaterDensityAccumulator = 0;
+    isrCounter = 0;
+    isrTick = 0;
+    publishHeaterDuty(duty);
+
+    Boiler boiler;
+    std::vector<double> samples;
+    bool wasOn = false;
+    Result result = {0, 0, 0};
+
+    // at the equilibrium of the duty, so that only the ripple remains
+    boiler.water = 20 + 1000 * duty / windowSize / 1.4;
+    boiler.wall = boiler.water + 1000 * duty / windowSize / 40;
+
+    for (int window = 0; window < settleWindows + measureWindows; window++) {
+        for (uint32_t tick = 0; tick < heaterWindowTicks; tick++) {
+            onTimer();
+
+            if (window >= settleWindows) {
+                result.onTicks += heaterOn ? 1 : 0;
+                result.switching += heaterOn && !wasOn ? 1 : 0;
+            }
+
+            wasOn = heaterOn;
+
+            for (int i = 0; i < substeps; i++) {
+                boiler.step(HEATER_TICK_MS / 1000.0 / substeps, heaterOn);
+
+                if (window >= settleWindows) {
+                    samples.push_back(boiler.wall);
+                }
+            }
+        }
+    }
+
+    // remove the slow drift with a moving average over one window, what is left is the ripple of the modulation
+    const size_t period = heaterWindowTicks * substeps;
+    double sum = 0;
+    double minimum = 1e9;
+    double maximum = -1e9;
+
+    for (size_t i = 0; i < samples.size(); i++) {
+        sum += samples[i];
+
+        if (i >= period) {
+            sum -= samples[i - period];
+        }
+
+        if (i >= period) {
+            const double deviation = samples[i - period / 2] - sum / period;
+            minimum = min(minimum, deviation);
+            maximum = max(maximum, deviation);
+        }
+    }
+
+    result.ripple = maximum - minimum;
+    result.onTicks /= measureWindows;
+    result.switching /= measureWindows;
+
+    return result;
+}
+
+void setUp() {
+    for (uint32_t& limit : heaterDutyLimits) {
+        limit = UINT32_MAX;
+    }
+}
+
+void tearDown() {
+}
+
+void test_same_energy_per_window() {
+    for (const float duty : {0.0f, 10.0f, 125.0f, 300.0f, 555.0f, 990.0f, 1000.0f, 1500.0f}) {
+        const uint32_t expected = min(heaterMillisToTicks(duty), heaterWindowTicks);
+
+        TEST_ASSERT_EQUAL(expected, simulate(kHeaterWindow, duty).onTicks);
+        TEST_ASSERT_EQUAL(expected, simulate(kHeaterPulseDensity, duty).onTicks);
+    }
+}
+
+void test_pulses_are_spread_evenly() {
+    initTimer1();
+    heaterModulation = kHeaterPulseDensity;
+    heaterDensityAccumulator = 0;
+    publishHeaterDuty(300);
+
+    // 30 % is one tick on, then two or three off, never more than one tick in a row
+    int longestOn = 0;
+    int longestOff = 0;
+    int run = 0;
+    bool previous = false;
+
+    for (uint32_t tick = 0; tick < 10 * heaterWindowTicks; tick++) {
+        onTimer();
+        run = heaterOn == previous ? run + 1 : 1;
+        previous = heaterOn;
+
+        if (heaterOn) {
+            longestOn = max(longestOn, run);
+        }
+        else {
+            longestOff = max(longestOff, run);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(1, longestOn);
+    TEST_ASSERT_EQUAL(3, longestOff);
+}
+
+void test_limit_applies_to_both_modulations() {
+    setHeaterDutyLimit(kHeaterLimitPower, 0.25f);
+
+    TEST_ASSERT_EQUAL(25, simulate(kHeaterWindow, 600).onTicks);
+    TEST_ASSERT_EQUAL(25, simulate(kHeaterPulseDensity, 600).onTicks);
+}
+
+void test_limit_rounds_down() {
+    // a started tick of the PID output heats for the whole tick, a partial tick of a limit is dropped
+    setHeaterDutyLimit(kHeaterLimitPower, 0.2555f);
+
+    TEST_ASSERT_EQUAL(26, heaterMillisToTicks(255.5f));
+    TEST_ASSERT_EQUAL(25, simulate(kHeaterWindow, 600).onTicks);
+    TEST_ASSERT_EQUAL(25, simulate(kHeaterPulseDensity, 600).onTicks);
+
+    // whole ticks that aren't exact in float stay whole ticks
+    for (const unsigned int window : {1000u, 3000u, 5000u}) {
+        windowSize = window;
+
+        for (unsigned int percent = 0; percent <= 100; percent++) {
+            setHeaterDutyLimit(kHeaterLimitPower, percent / 100.0f);
+            TEST_ASSERT_EQUAL(percent * window / 100 / HEATER_TICK_MS, heaterDutyLimits[kHeaterLimitPower]);
+        }
+    }
+
+    windowSize = 1000;
+}
+
+void test_ripple() {
+    for (const float duty : {50.0f, 100.0f, 300.0f, 500.0f, 700.0f}) {
+        const Result window = simulate(kHeaterWindow, duty);
+        const Result density = simulate(kHeaterPulseDensity, duty);
+
+        char message[160];
+        snprintf(message, sizeof(message), "%3.0f %% duty: window %.3f K ripple, %u switch-ons per window; pulse density %.3f K ripple, %u switch-ons per window", duty / 10, window.ripple,
+                 static_cast<unsigned>(window.switching), density.ripple, static_cast<unsigned>(density.switching));
+        TEST_MESSAGE(message);
+
+        TEST_ASSERT_EQUAL(1, window.switching);
+        TEST_ASSERT_TRUE(density.ripple < window.ripple / 4);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_same_energy_per_window);
+    RUN_TEST(test_pulses_are_spread_evenly);
+    RUN_TEST(test_limit_applies_to_both_modulations);
+    RUN_TEST(test_limit_rounds_down);
+    RUN_TEST(test_ripple);
+
+    return UNITY_END();
+}
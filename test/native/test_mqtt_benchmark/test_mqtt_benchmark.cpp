@@ -0,0 +1,892 @@
+/**
+ * @file test_mqtt_benchmark.cpp
+ *
+ * @brief Runs the MQTT units of the firmware through PubSubClient and a socket stand-in and reports traffic and blocking times
+ *
+ * @details The topic table, the router, the publish policies and the discovery writers are the ones of the firmware, fed with the
+ *          values of a simulated machine. As in the firmware the control loop only evaluates the policies and posts to the outbound
+ *          queue, the MQTT task takes the messages from there and publishes them. The socket models the lwIP send buffer of the
+ *          ESP32, a slow broker drains it at a limited rate or stalls, and a publish blocks until the data fits, like
+ *          WiFiClient::write() does. Both publish modes run the same ten minutes of the machine, so their packets and bytes per
+ *          minute compare directly. What the broker spends on them isn't modelled.
+ */
+
+#include <PubSubClient.h>
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mqttTopicTable.h"
+#include "utils/ChunkedPrint.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t TCP_SEND_BUFFER = 5744;     // CONFIG_LWIP_TCP_SND_BUF_DEFAULT of the ESP32 Arduino core
+constexpr uint16_t PACKET_SIZE = 512;        // MQTT_PACKET_SIZE in mqtt.h
+constexpr size_t OUTBOUND_QUEUE_LENGTH = 32; // MQTT_OUTBOUND_QUEUE_LENGTH in mqtt.h
+constexpr uint32_t POLICY_TICK = 100;        // MQTT_POLICY_TICK_MS in mqtt.h
+constexpr size_t STATE_DOCUMENT_SIZE = 1536; // MQTT_STATE_DOCUMENT_SIZE in mqtt.h
+constexpr uint32_t RUN_TIME = 600000;        // ms of machine time in the traffic runs
+
+constexpr const char* TOPIC_BASE = MQTT_TOPIC HOSTNAME "/";
+
+/**
+ * @brief Socket and broker in one: parses the MQTT packets written by the client and answers them
+ */
+class BrokerSocket : public Client {
+    public:
+        // bytes per ms the broker takes from the send buffer, 0 for unlimited
+        size_t drainRate = 0;
+
+        // the broker takes nothing until then
+        Clock::time_point stalledUntil;
+
+        uint32_t published = 0;
+        uint64_t publishedBytes = 0;
+        uint32_t maxPayload = 0;
+
+        int connect(IPAddress, uint16_t) override {
+            return connect("", 0);
+        }
+
+        int connect(const char*, uint16_t) override {
+            connected_ = true;
+            lastDrain_ = Clock::now();
+            return 1;
+        }
+
+        size_t write(const uint8_t c) override {
+            return write(&c, 1);
+        }
+
+        size_t write(const uint8_t* buffer, const size_t size) override {
+            for (size_t remaining = size; remaining > 0;) {
+                drain();
+
+                const size_t chunk = min(remaining, TCP_SEND_BUFFER - queued_);
+
+                if (chunk == 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    continue;
+                }
+
+                queued_ += chunk;
+                remaining -= chunk;
+
+                for (size_t i = 0; i < chunk; i++) {
+                    parse(*buffer++);
+                }
+            }
+
+            return size;
+        }
+
+        int available() override {
+            return static_cast<int>(inbound_.size());
+        }
+
+        int read() override {
+            if (inbound_.empty()) {
+                return -1;
+            }
+
+            const uint8_t c = inbound_.front();
+            inbound_.pop_front();
+
+            return c;
+        }
+
+        int read(uint8_t* buffer, const size_t size) override {
+            size_t n = 0;
+
+            while (n < size && !inbound_.empty()) {
+                buffer[n++] = static_cast<uint8_t>(read());
+            }
+
+            return static_cast<int>(n);
+        }
+
+        int peek() override {
+            return inbound_.empty() ? -1 : inbound_.front();
+        }
+
+        void flush() override {
+        }
+
+        void stop() override {
+            connected_ = false;
+        }
+
+        uint8_t connected() override {
+            return connected_;
+        }
+
+        operator bool() override {
+            return connected_;
+        }
+
+        /**
+         * @brief Send a message to the client, QoS 0
+         */
+        void deliver(const char* topic, const char* payload) {
+            const size_t topicLength = strlen(topic);
+            const size_t payloadLength = strlen(payload);
+            size_t remaining = 2 + topicLength + payloadLength;
+
+            inbound_.push_back(0x30);
+
+            do {
+                inbound_.push_back(static_cast<uint8_t>((remaining & 0x7f) | (remaining > 0x7f ? 0x80 : 0)));
+                remaining >>= 7;
+            } while (remaining > 0);
+
+            inbound_.push_back(static_cast<uint8_t>(topicLength >> 8));
+            inbound_.push_back(static_cast<uint8_t>(topicLength));
+            inbound_.insert(inbound_.end(), topic, topic + topicLength);
+            inbound_.insert(inbound_.end(), payload, payload + payloadLength);
+        }
+
+    private:
+        void drain() {
+            const auto now = Clock::now();
+
+            if (drainRate == 0) {
+                queued_ = 0;
+            }
+            else if (now >= stalledUntil) {
+                const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - max(lastDrain_, stalledUntil)).count();
+                queued_ -= min(queued_, static_cast<size_t>(elapsed) * drainRate / 1000);
+            }
+
+            lastDrain_ = now;
+        }
+
+        /**
+         * @brief Packet parser, fixed header with variable length remaining length followed by the body
+         */
+        void parse(const uint8_t c) {
+            if (state_ == TYPE) {
+                type_ = c;
+                length_ = 0;
+                shift_ = 0;
+                body_.clear();
+                state_ = LENGTH;
+                return;
+            }
+
+            if (state_ == LENGTH) {
+                length_ |= static_cast<size_t>(c & 0x7f) << shift_;
+                shift_ += 7;
+
+                if (c & 0x80) {
+                    return;
+                }
+
+                state_ = BODY;
+            }
+            else {
+                body_.push_back(c);
+            }
+
+            if (body_.size() == length_) {
+                handle();
+                state_ = TYPE;
+            }
+        }
+
+        void handle() {
+            switch (type_ >> 4) {
+                case 1: // CONNECT
+                    inbound_.insert(inbound_.end(), {0x20, 0x02, 0x00, 0x00});
+                    break;
+
+                case 3: // PUBLISH, QoS 0
+                    {
+                        const size_t topicLength = body_[0] << 8 | body_[1];
+                        const size_t payloadLength = body_.size() - 2 - topicLength;
+
+                        published++;
+                        publishedBytes += topicLength + payloadLength;
+                        maxPayload = max(maxPayload, static_cast<uint32_t>(payloadLength));
+                        break;
+                    }
+
+                case 8: // SUBSCRIBE
+                    inbound_.insert(inbound_.end(), {0x90, 0x03, body_[0], body_[1], 0x00});
+                    break;
+
+                case 12: // PINGREQ
+                    inbound_.insert(inbound_.end(), {0xd0, 0x00});
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        enum State {
+            TYPE,
+            LENGTH,
+            BODY
+        };
+
+        bool connected_ = false;
+        size_t queued_ = 0;
+        Clock::time_point lastDrain_;
+        std::deque<uint8_t> inbound_;
+
+        State state_ = TYPE;
+        uint8_t type_ = 0;
+        size_t length_ = 0;
+        unsigned shift_ = 0;
+        std::vector<uint8_t> body_;
+};
+
+/**
+ * @brief Machine states of the simulation, the value of the machineState topic
+ */
+enum SimulatedState {
+    kHeating,
+    kPidNormal,
+    kBrewing,
+    kStandby
+};
+
+static constexpr const char* stateNames[] = {"Heating", "PID Normal", "Brew", "Standby"};
+
+/**
+ * @brief Values of a machine heating up, brewing a shot and going to standby, with the sensor noise the policies have to filter
+ */
+struct Machine {
+        double temperature = 20;
+        double heaterPower = 0;
+        double standbyRemaining = 0;
+        double kp = AGGKP;
+        double ki = AGGKP / AGGTN;
+        double kd = AGGKP * AGGTV;
+        double state = kHeating;
+        double brewTime = 0;
+        double weight = 0;
+        double brewWeight = 0;
+        double pressure = 0;
+
+        void step(const uint32_t now) {
+            constexpr double brewStart = 420;
+            constexpr double brewEnd = 450;
+            constexpr double standbyStart = 540;
+            const double second = now / 1000.0;
+
+            state = second < 240 ? kHeating : second < brewStart || (second >= brewEnd && second < standbyStart) ? kPidNormal : second < brewEnd ? kBrewing : kStandby;
+            standbyRemaining = max(0.0, standbyStart - second);
+
+            switch (static_cast<SimulatedState>(state)) {
+                case kHeating:
+                    temperature = 20 + (SETPOINT - 20) * second / 240 + noise(0.05);
+                    heaterPower = 100;
+                    break;
+                case kPidNormal:
+                    temperature = SETPOINT + noise(0.08);
+                    heaterPower = 25 + 10 * sin(second / 20) + noise(2);
+                    pressure = max(0.0, noise(0.02));
+                    kp = AGGKP;
+                    ki = AGGKP / AGGTN;
+                    kd = AGGKP * AGGTV;
+                    break;
+                case kBrewing:
+                    brewTime = (second - brewStart) * 1000;
+                    brewWeight = max(0.0, (second - brewStart - 6) * 1.5);
+                    weight = brewWeight + noise(0.05);
+                    temperature = SETPOINT - 2 * sin((second - brewStart) / (brewEnd - brewStart) * M_PI) + noise(0.08);
+                    heaterPower = 100;
+                    pressure = min(9.0, (second - brewStart) * 2) + noise(0.1);
+                    kp = AGGBKP;
+                    ki = 0;
+                    kd = AGGBKP * AGGBTV;
+                    break;
+                case kStandby:
+                    temperature = SETPOINT - (second - standbyStart) * 0.05 + noise(0.05);
+                    heaterPower = 0;
+                    break;
+            }
+        }
+
+    private:
+        double noise(const double deviation) {
+            return std::normal_distribution<double>(0, deviation)(random_);
+        }
+
+        std::mt19937 random_{1};
+};
+
+static Machine machine;
+
+double mqttTemperature() {
+    return machine.temperature;
+}
+
+double mqttHeaterPower() {
+    return machine.heaterPower;
+}
+
+double mqttStandbyModeTimeRemaining() {
+    return machine.standbyRemaining;
+}
+
+double mqttCurrentKp() {
+    return machine.kp;
+}
+
+double mqttCurrentKi() {
+    return machine.ki;
+}
+
+double mqttCurrentKd() {
+    return machine.kd;
+}
+
+double mqttMachineState() {
+    return machine.state;
+}
+
+double mqttCurrBrewTime() {
+    return machine.brewTime / 1000;
+}
+
+double mqttCurrReadingWeight() {
+    return machine.weight;
+}
+
+double mqttCurrBrewWeight() {
+    return machine.brewWeight;
+}
+
+double mqttPressure() {
+    return machine.pressure;
+}
+
+// all optional hardware is present
+static bool featureEnabled(MqttTopicFeature) {
+    return true;
+}
+
+/**
+ * @brief Value queued for the MQTT task, MqttOutboundMessage in mqtt.h
+ */
+struct Message {
+        uint16_t topic;
+        char payload[22];
+};
+
+/**
+ * @brief Outbound queue between the control loop and the MQTT task, a full queue doesn't block the sender, like xQueueSend() without wait
+ */
+class OutboundQueue {
+    public:
+        bool send(const Message& message) {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (messages_.size() == OUTBOUND_QUEUE_LENGTH) {
+                return false;
+            }
+
+            messages_.push_back(message);
+            ready_.notify_one();
+
+            return true;
+        }
+
+        bool receive(Message& message, const std::chrono::milliseconds wait) {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            // a timed wait is a system call even without a timeout, the MQTT task only polls with xQueueReceive(..., 0)
+            if (messages_.empty() && (wait.count() == 0 || !ready_.wait_for(lock, wait, [this] { return !messages_.empty(); }))) {
+                return false;
+            }
+
+            message = messages_.front();
+            messages_.pop_front();
+
+            return true;
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<Message> messages_;
+};
+
+static BrokerSocket socket;
+static PubSubClient mqtt(socket);
+static OutboundQueue outbound;
+static MqttTopicState states[MQTT_MAX_TOPICS];
+static MqttRouter router;
+static std::vector<std::string> topics; // full topic names, the topic arena of the firmware
+static size_t nextTopic = 0;
+static uint32_t deferred = 0;
+static uint32_t published[mqttTopicCount];
+static uint32_t commandsReceived = 0;
+
+static const HassioDevice device = {HOSTNAME, MQTT_HASSIO_PREFIX, TOPIC_BASE, MQTT_TOPIC HOSTNAME "/status", false, stateNames, sizeof(stateNames) / sizeof(stateNames[0])};
+
+/**
+ * @brief Like buildMqttTopics(), the settings have no Parameter here and are formatted as decimals
+ */
+static void buildTopics() {
+    topics.clear();
+
+    for (size_t i = 0; i < mqttTopicCount; i++) {
+        states[i] = {nullptr, 0, MQTT_NEVER_SENT, 0, featureEnabled(mqttTopics[i].feature), kMqttDecimal};
+        topics.push_back(std::string(TOPIC_BASE) + mqttTopics[i].name);
+    }
+
+    router.build(mqttTopics, states, mqttTopicCount);
+    nextTopic = 0;
+}
+
+static double readTopic(const size_t index) {
+    // settings don't change during a run
+    return mqttTopics[index].read != nullptr ? mqttTopics[index].read() : 10.0 + index;
+}
+
+static void formatValue(const size_t index, const double value, char* buf, const size_t size) {
+    if (mqttTopics[index].payload == kMqttMachineState) {
+        snprintf(buf, size, "%s", stateNames[static_cast<size_t>(value)]);
+        return;
+    }
+
+    formatMqttNumber(states[index].format, value, buf, size);
+}
+
+static uint32_t machineInterval() {
+    return mqttMachineInterval(machine.state == kBrewing, machine.state == kStandby);
+}
+
+/**
+ * @brief Control loop side of a per-topic tick of writeSysParamsToMQTT(): evaluate the policies and queue the due values
+ * @details A full queue doesn't wait, the tick stops and the next one continues with the same topic
+ */
+static void publishTick(const uint32_t now) {
+    const uint32_t interval = machineInterval();
+
+    for (; nextTopic < mqttTopicCount; nextTopic++) {
+        MqttTopicState& state = states[nextTopic];
+
+        if (!state.enabled) {
+            continue;
+        }
+
+        const double value = readTopic(nextTopic);
+        const int32_t quantized = quantizeMqttValue(value);
+
+        if (!isMqttTopicDue(mqttTopics[nextTopic], state, quantized, now, interval)) {
+            continue;
+        }
+
+        Message message;
+        message.topic = static_cast<uint16_t>(nextTopic);
+        formatValue(nextTopic, value, message.payload, sizeof(message.payload));
+
+        if (!outbound.send(message)) {
+            deferred++;
+            return;
+        }
+
+        state.lastSent = quantized;
+        state.lastSentAt = now;
+    }
+
+    nextTopic = 0;
+}
+
+/**
+ * @brief Control loop side of publishMqttStateDocument(): build the document of all values if the policy of any topic asks for it
+ * @return false if no document is due
+ */
+static bool buildStateDocument(const uint32_t now, char* document, const size_t size) {
+    const uint32_t interval = machineInterval();
+    bool due = false;
+
+    for (size_t i = 0; i < mqttTopicCount && !due; i++) {
+        due = states[i].enabled && isMqttTopicDue(mqttTopics[i], states[i], quantizeMqttValue(readTopic(i)), now, interval);
+    }
+
+    if (!due) {
+        return false;
+    }
+
+    MqttStateDocument writer(document, size);
+
+    for (size_t i = 0; i < mqttTopicCount; i++) {
+        if (!states[i].enabled) {
+            continue;
+        }
+
+        const double value = readTopic(i);
+        char formatted[sizeof(Message::payload)];
+        formatValue(i, value, formatted, sizeof(formatted));
+
+        TEST_ASSERT_TRUE(writer.add(mqttTopics[i].name, formatted, mqttTopics[i].payload == kMqttMachineState));
+
+        states[i].lastSent = quantizeMqttValue(value);
+        states[i].lastSentAt = now;
+    }
+
+    TEST_ASSERT_TRUE(writer.finish());
+
+    return true;
+}
+
+/**
+ * @brief MQTT task side, sendMqttStateDocument(): streamed and retained
+ */
+static bool sendStateDocument(const char* document) {
+    const size_t length = strlen(document);
+    const std::string topic = std::string(TOPIC_BASE) + "state";
+
+    return mqtt.beginPublish(topic.c_str(), length, true) && mqtt.write(reinterpret_cast<const uint8_t*>(document), length) == length && mqtt.endPublish();
+}
+
+/**
+ * @brief MQTT task side, sendMqttMessage(): settings are retained
+ */
+static bool sendMessage(const Message& message) {
+    published[message.topic]++;
+
+    return mqtt.publish(topics[message.topic].c_str(), message.payload, mqttTopics[message.topic].parameterId != nullptr);
+}
+
+/**
+ * @brief Does what mqtt_callback() does with a command, up to handing it to the control loop
+ */
+static void mqttCallback(char* topic, uint8_t* data, const unsigned int length) {
+    const char* name;
+    size_t nameLength;
+
+    if (!parseMqttCommandTopic(topic, TOPIC_BASE, strlen(TOPIC_BASE), name, nameLength)) {
+        return;
+    }
+
+    const int index = router.find(name, nameLength);
+    double value;
+
+    if (index < 0 || mqttTopics[index].parameterId == nullptr || !parseMqttNumber(data, length, value)) {
+        return;
+    }
+
+    commandsReceived++;
+}
+
+/**
+ * @brief Publish a discovery message streamed like publishStreamedMessage()
+ */
+template <typename Writer>
+static bool publishStreamed(const char* topic, Writer write) {
+    ChunkedPrint counter;
+    write(counter);
+
+    if (!mqtt.beginPublish(topic, counter.length(), true)) {
+        return false;
+    }
+
+    ChunkedPrint out(&mqtt);
+    write(out);
+
+    return out.send() && mqtt.endPublish();
+}
+
+static uint32_t elapsedMicros(const Clock::time_point start) {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+}
+
+void setUp() {
+    socket.drainRate = 0;
+    socket.stalledUntil = Clock::time_point();
+    socket.published = 0;
+    socket.publishedBytes = 0;
+    socket.maxPayload = 0;
+    machine = Machine();
+    deferred = 0;
+    memset(published, 0, sizeof(published));
+    buildTopics();
+}
+
+void tearDown() {
+}
+
+static void reportTraffic(const char* name, const double controlLoopSeconds, const double taskSeconds) {
+    constexpr uint32_t ticks = RUN_TIME / POLICY_TICK;
+    constexpr double minutes = RUN_TIME / 60000.0;
+
+    char message[200];
+    snprintf(message, sizeof(message), "%s: %.0f packets/min, %.1f kB/min, control loop %.2f us per tick, MQTT task %.2f us per tick", name, socket.published / minutes,
+             socket.publishedBytes / minutes / 1000, controlLoopSeconds * 1e6 / ticks, taskSeconds * 1e6 / ticks);
+    TEST_MESSAGE(message);
+}
+
+void test_publish_per_topic() {
+    double controlLoopSeconds = 0;
+    double taskSeconds = 0;
+    Message queued;
+
+    for (uint32_t now = 0; now < RUN_TIME; now += POLICY_TICK) {
+        machine.step(now);
+
+        const auto tickStart = Clock::now();
+        publishTick(now);
+        const auto taskStart = Clock::now();
+
+        while (outbound.receive(queued, std::chrono::milliseconds(0))) {
+            TEST_ASSERT_TRUE(sendMessage(queued));
+        }
+
+        controlLoopSeconds += std::chrono::duration<double>(taskStart - tickStart).count();
+        taskSeconds += std::chrono::duration<double>(Clock::now() - taskStart).count();
+    }
+
+    // every topic is published at least once, the measurements at the rate of the machine state and within their heartbeat
+    for (size_t i = 0; i < mqttTopicCount; i++) {
+        TEST_ASSERT_GREATER_OR_EQUAL(1, published[i]);
+        TEST_ASSERT_LESS_OR_EQUAL(RUN_TIME / intervalMQTTbrew, published[i]);
+    }
+
+    TEST_ASSERT_GREATER_OR_EQUAL(RUN_TIME / MQTT_HEARTBEAT_INTERVAL, published[mqttTopicCount - 1]);
+
+    reportTraffic("per topic", controlLoopSeconds, taskSeconds);
+}
+
+void test_publish_state_document() {
+    char document[STATE_DOCUMENT_SIZE];
+    double controlLoopSeconds = 0;
+    double taskSeconds = 0;
+    uint32_t documents = 0;
+
+    for (uint32_t now = 0; now < RUN_TIME; now += POLICY_TICK) {
+        machine.step(now);
+
+        const auto tickStart = Clock::now();
+        const bool due = buildStateDocument(now, document, sizeof(document));
+        const auto taskStart = Clock::now();
+
+        if (due) {
+            TEST_ASSERT_TRUE(sendStateDocument(document));
+            documents++;
+        }
+
+        controlLoopSeconds += std::chrono::duration<double>(taskStart - tickStart).count();
+        taskSeconds += std::chrono::duration<double>(Clock::now() - taskStart).count();
+    }
+
+    // one document whenever any value is due, it holds all of them and is larger than the packet buffer
+    TEST_ASSERT_EQUAL(documents, socket.published);
+    TEST_ASSERT_GREATER_OR_EQUAL(RUN_TIME / MQTT_HEARTBEAT_INTERVAL, documents);
+    TEST_ASSERT_GREATER_THAN(PACKET_SIZE, socket.maxPayload);
+
+    // broker CPU isn't modelled, the socket only counts what the broker has to take in
+    reportTraffic("state document", controlLoopSeconds, taskSeconds);
+}
+
+void test_commands() {
+    constexpr int rounds = 500;
+    uint32_t expected = 0;
+    commandsReceived = 0;
+
+    for (int round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < mqttTopicCount; i++) {
+            socket.deliver((topics[i] + "/set").c_str(), "93.5");
+
+            // read-only values can't be set
+            expected += mqttTopics[i].parameterId != nullptr ? 1 : 0;
+        }
+
+        socket.deliver((std::string(TOPIC_BASE) + "unknown/set").c_str(), "1");
+        socket.deliver((topics[0] + "/set").c_str(), "on");
+    }
+
+    const int commands = rounds * static_cast<int>(mqttTopicCount + 2);
+    const auto start = Clock::now();
+
+    while (socket.available() > 0) {
+        mqtt.loop();
+    }
+
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    TEST_ASSERT_EQUAL(expected, commandsReceived);
+
+    char message[100];
+    snprintf(message, sizeof(message), "commands: %.0f messages/s, %.2f us per command", commands / seconds, seconds * 1e6 / commands);
+    TEST_MESSAGE(message);
+}
+
+void test_discovery() {
+    constexpr int rounds = 50;
+    uint32_t entityMessages = 0;
+    uint32_t worst = 0;
+
+    const auto start = Clock::now();
+
+    for (int round = 0; round < rounds; round++) {
+        for (const HassioEntity& entity : hassioEntities) {
+            char topic[160];
+            formatHassioEntityTopic(topic, sizeof(topic), device, entity);
+
+            const auto publishStart = Clock::now();
+            TEST_ASSERT_TRUE(publishStreamed(topic, [&entity](Print& out) { writeHassioEntity(out, device, entity); }));
+            worst = max(worst, elapsedMicros(publishStart));
+            entityMessages++;
+        }
+    }
+
+    const double entitySeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const uint64_t entityBytes = socket.publishedBytes;
+
+    TEST_ASSERT_EQUAL(entityMessages, socket.published);
+
+    char topic[160];
+    formatHassioDeviceTopic(topic, sizeof(topic), device);
+    const auto deviceStart = Clock::now();
+
+    for (int round = 0; round < rounds; round++) {
+        TEST_ASSERT_TRUE(publishStreamed(topic, [](Print& out) { writeHassioDevice(out, device, hassioEntities, HASSIO_ENTITY_COUNT, featureEnabled); }));
+    }
+
+    const double deviceSeconds = std::chrono::duration<double>(Clock::now() - deviceStart).count();
+
+    // streamed, so the device message goes through although it is many times the packet buffer
+    TEST_ASSERT_GREATER_THAN(4 * PACKET_SIZE, socket.maxPayload);
+
+    char message[200];
+    snprintf(message, sizeof(message), "discovery: %u entity messages of %.0f B in %.1f us each (worst %u us), device message of %u B in %.1f us", static_cast<unsigned>(HASSIO_ENTITY_COUNT),
+             static_cast<double>(entityBytes) / entityMessages, entitySeconds * 1e6 / entityMessages, static_cast<unsigned>(worst), static_cast<unsigned>(socket.maxPayload), deviceSeconds * 1e6 / rounds);
+    TEST_MESSAGE(message);
+}
+
+/**
+ * @brief Blocking seen by the control loop and by the MQTT task
+ */
+struct Blocking {
+        uint32_t worstTick;    // µs, longest tick of the control loop
+        uint32_t worstPublish; // µs, longest publish of the MQTT task
+        uint32_t published;
+};
+
+/**
+ * @brief Run the control loop and the MQTT task on threads of their own, with all values republished on every tick
+ * @details A tick of 100 ms machine time is run every 10 ms, which keeps the queue full on a slow link
+ */
+static Blocking runTasks(const int ticks) {
+    std::atomic<bool> done(false);
+    std::atomic<uint32_t> worstPublish(0);
+    std::atomic<uint32_t> sent(0);
+
+    std::thread task([&] {
+        Message message;
+
+        while (!done) {
+            if (outbound.receive(message, std::chrono::milliseconds(50))) {
+                const auto start = Clock::now();
+                sendMessage(message);
+                worstPublish = max(worstPublish.load(), elapsedMicros(start));
+                sent++;
+            }
+        }
+    });
+
+    uint32_t worstTick = 0;
+
+    for (int tick = 0; tick < ticks; tick++) {
+        const uint32_t now = tick * POLICY_TICK;
+        machine.step(now);
+
+        // mqttResyncRequested, the most the control loop ever queues
+        if (nextTopic == 0) {
+            for (size_t i = 0; i < mqttTopicCount; i++) {
+                states[i].lastSent = MQTT_NEVER_SENT;
+            }
+        }
+
+        const auto start = Clock::now();
+        publishTick(now);
+        worstTick = max(worstTick, elapsedMicros(start));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    done = true;
+    task.join();
+
+    // the socket blocks the MQTT task, so it is done with what it took from the queue
+    Message left;
+
+    while (outbound.receive(left, std::chrono::milliseconds(0))) {
+    }
+
+    return {worstTick, worstPublish, sent};
+}
+
+static void reportBlocking(const char* name, const Blocking& blocking) {
+    char message[200];
+    snprintf(message, sizeof(message), "%s: %u messages, %u deferred by a full queue, worst control loop tick %u us, worst MQTT task publish %u us", name, static_cast<unsigned>(blocking.published),
+             static_cast<unsigned>(deferred), static_cast<unsigned>(blocking.worstTick), static_cast<unsigned>(blocking.worstPublish));
+    TEST_MESSAGE(message);
+}
+
+void test_slow_broker() {
+    // 20 kB/s, a weak WiFi link or a broker on a busy Raspberry Pi
+    socket.drainRate = 20;
+
+    const Blocking blocking = runTasks(50);
+
+    // the link can't keep up, the control loop defers values instead of waiting
+    TEST_ASSERT_GREATER_THAN(0, deferred);
+    TEST_ASSERT_GREATER_THAN(0, blocking.published);
+    TEST_ASSERT_LESS_THAN(blocking.worstPublish, blocking.worstTick);
+    reportBlocking("slow broker", blocking);
+}
+
+void test_stalled_broker() {
+    constexpr auto stall = std::chrono::milliseconds(200);
+
+    socket.drainRate = 20;
+
+    // fill the send buffer, then the broker stops taking data for a while
+    runTasks(5);
+    deferred = 0;
+    socket.stalledUntil = Clock::now() + stall;
+
+    const Blocking blocking = runTasks(40);
+    const uint32_t stallMicros = std::chrono::duration_cast<std::chrono::microseconds>(stall).count();
+
+    // the whole stall ends up in a single publish of the MQTT task, the control loop keeps its tick
+    TEST_ASSERT_GREATER_OR_EQUAL(stallMicros * 9 / 10, blocking.worstPublish);
+    TEST_ASSERT_LESS_THAN(stallMicros / 10, blocking.worstTick);
+    reportBlocking("stalled broker", blocking);
+}
+
+int main() {
+    mqtt.setServer("broker", 1883);
+    mqtt.setCallback(mqttCallback);
+    mqtt.setBufferSize(PACKET_SIZE);
+
+    if (!mqtt.connect(HOSTNAME)) {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_publish_per_topic);
+    RUN_TEST(test_publish_state_document);
+    RUN_TEST(test_commands);
+    RUN_TEST(test_discovery);
+    RUN_TEST(test_slow_broker);
+    RUN_TEST(test_stalled_broker);
+
+    return UNITY_END();
+}
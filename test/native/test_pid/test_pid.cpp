@@ -0,0 +1,344 @@
+/**
+ * @file test_pid.cpp
+ *
+ * @brief Checks the float PID controller used by the firmware against the double PID library it replaces
+ * @details The library is pinned in the native environment to the commit the firmware used before (PID_v1.h). Both
+ *          controllers read the time with millis(), which runs in simulated time here.
+ */
+
+#include <PID.h>
+#include <PID_v1.h>
+#include <unity.h>
+
+#include <chrono>
+#include <vector>
+
+#include "defaults.h"
+
+constexpr unsigned long WINDOW_SIZE = 1000; // ms, sample time and output range of the firmware
+constexpr int SIMULATED_SECONDS = 3600;
+constexpr int BREW_START = 1500;
+constexpr int BREW_END = 1530;
+constexpr int STEAM_START = 2400;
+constexpr int STEAM_END = 2700;
+constexpr int STANDBY_START = 3000;
+constexpr int STANDBY_END = 3100;
+
+/**
+ * @brief Single-boiler machine, lumped heat capacity with losses to the ambient and a lagging sensor
+ */
+struct Boiler {
+        double water = 20;  // °C
+        double sensor = 20; // °C
+
+        /**
+         * @param heaterMillis Heater on time in this window
+         * @param drawMlPerSecond Water drawn from the boiler and replaced with water at ambient temperature
+         */
+        void step(const double heaterMillis, const double drawMlPerSecond) {
+            constexpr double heaterWatts = 1000;
+            constexpr double heatCapacity = 1800; // J/K, water and brass
+            constexpr double loss = 0.8;          // W/K
+            constexpr double ambient = 20;
+            constexpr double sensorLag = 5;       // s
+
+            const double watts = heaterWatts * heaterMillis / WINDOW_SIZE - loss * (water - ambient) - drawMlPerSecond * 4.186 * (water - ambient);
+            water += watts / heatCapacity;
+            sensor += (water - sensor) / sensorLag;
+        }
+};
+
+/**
+ * @brief Machine phases the firmware switches the tunings and the mode for
+ */
+enum Phase {
+    kHeatUp,
+    kBrew,
+    kSteam,
+    kStandby
+};
+
+static Phase phaseAt(const int second) {
+    if (second >= BREW_START && second < BREW_END) {
+        return kBrew;
+    }
+
+    if (second >= STEAM_START && second < STEAM_END) {
+        return kSteam;
+    }
+
+    if (second >= STANDBY_START && second < STANDBY_END) {
+        return kStandby;
+    }
+
+    return kHeatUp;
+}
+
+/**
+ * @brief Controller set up, computed and retuned in the order main.cpp does it
+ * @details Pid is BasicPID<float> of the firmware or PID from the library with its double values
+ */
+template <typename Pid, typename T>
+struct Controller {
+        T temperature = 20;
+        T output = 0;
+        T setpoint = SETPOINT;
+        Pid pid;
+
+        explicit Controller(const int pOn) :
+            pid(&temperature, &output, &setpoint, AGGKP, AGGKP / AGGTN, AGGTV * AGGKP, pOn, DIRECT), pOn_(pOn) {
+            pid.SetSampleTime(WINDOW_SIZE);
+            pid.SetOutputLimits(0, WINDOW_SIZE);
+            pid.SetIntegratorLimits(0, AGGIMAX);
+            pid.SetSmoothingFactor(EMA_FACTOR);
+            pid.SetMode(AUTOMATIC);
+        }
+
+        T compute(const double input, const Phase phase, const int second) {
+            temperature = static_cast<T>(input);
+            pid.Compute();
+
+            // standby and the brew PID delay switch the controller off with the output forced to zero
+            if (phase == kStandby || (phase == kBrew && second < BREW_START + BREW_PID_DELAY)) {
+                if (pid.GetMode() == AUTOMATIC) {
+                    pid.SetMode(MANUAL);
+                    output = 0;
+                }
+            }
+            else if (pid.GetMode() == MANUAL) {
+                pid.SetMode(AUTOMATIC);
+            }
+
+            switch (phase) {
+                case kHeatUp:
+                case kStandby:
+                    setpoint = SETPOINT;
+                    pid.SetIntegratorLimits(0, AGGIMAX);
+                    pid.SetTunings(AGGKP, AGGKP / AGGTN, AGGTV * AGGKP, pOn_);
+                    break;
+
+                case kBrew:
+                    pid.SetTunings(AGGBKP, 0, AGGBTV * AGGBKP, P_ON_E);
+                    break;
+
+                case kSteam:
+                    setpoint = STEAMSETPOINT;
+                    pid.SetTunings(STEAMKP, 0, 0, P_ON_E);
+                    break;
+            }
+
+            return output;
+        }
+
+    private:
+        int pOn_;
+};
+
+using Reference = Controller<PID, double>;
+
+/**
+ * @brief Feed the controller the inputs of the closed loop of the library and return the largest output difference in ms
+ */
+template <typename T>
+static double maxOutputDifference(const int pOn) {
+    setMillis(0);
+
+    Boiler boiler;
+    Reference reference(pOn);
+    Controller<BasicPID<T>, T> controller(pOn);
+    double maxDifference = 0;
+
+    for (int second = 0; second < SIMULATED_SECONDS; second++) {
+        const Phase phase = phaseAt(second);
+        setMillis(second * WINDOW_SIZE);
+
+        const double expected = reference.compute(boiler.sensor, phase, second);
+        const double actual = controller.compute(boiler.sensor, phase, second);
+
+        maxDifference = std::max(maxDifference, std::abs(expected - actual));
+        boiler.step(expected, phase == kBrew ? 2 : 0);
+    }
+
+    return maxDifference;
+}
+
+/**
+ * @brief Run a closed loop with the given controller and return the water temperature of every second
+ */
+template <typename C>
+static std::vector<double> closedLoop(const int pOn) {
+    setMillis(0);
+
+    Boiler boiler;
+    C controller(pOn);
+    std::vector<double> temperatures;
+
+    for (int second = 0; second < SIMULATED_SECONDS; second++) {
+        const Phase phase = phaseAt(second);
+        setMillis(second * WINDOW_SIZE);
+
+        const double output = controller.compute(boiler.sensor, phase, second);
+
+        boiler.step(output, phase == kBrew ? 2 : 0);
+        temperatures.push_back(boiler.water);
+    }
+
+    return temperatures;
+}
+
+static void checkClosedLoop(const int pOn) {
+    const std::vector<double> expected = closedLoop<Reference>(pOn);
+    const std::vector<double> actual = closedLoop<Controller<BasicPID<float>, float>>(pOn);
+
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_FLOAT_WITHIN(0.01, expected[i], actual[i]);
+    }
+
+    // the simulation has to reach the setpoint and heat up again after standby, otherwise it doesn't exercise the controller
+    TEST_ASSERT_FLOAT_WITHIN(1.0, SETPOINT, expected[BREW_START - 100]);
+    TEST_ASSERT_FLOAT_WITHIN(1.0, SETPOINT, expected[SIMULATED_SECONDS - 1]);
+}
+
+template <typename T>
+static double nanosecondsPerCompute() {
+    constexpr int iterations = 1000000;
+    Controller<BasicPID<T>, T> controller(P_ON_E);
+    volatile T sink = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; i++) {
+        controller.temperature = static_cast<T>(90 + (i % 100) * 0.05);
+        controller.pid.Compute(static_cast<unsigned long>(i + 1) * WINDOW_SIZE);
+        sink = sink + controller.output;
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// the same algorithm in double has to follow the library up to rounding, a difference here is a change of behaviour and not of precision
+void test_algorithm_matches_library_on_error() {
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0, maxOutputDifference<double>(P_ON_E));
+}
+
+void test_algorithm_matches_library_on_measurement() {
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0, maxOutputDifference<double>(P_ON_M));
+}
+
+void test_output_matches_library_on_error() {
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0, maxOutputDifference<float>(P_ON_E));
+}
+
+void test_output_matches_library_on_measurement() {
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0, maxOutputDifference<float>(P_ON_M));
+}
+
+void test_closed_loop_matches_library_on_error() {
+    checkClosedLoop(P_ON_E);
+}
+
+void test_closed_loop_matches_library_on_measurement() {
+    checkClosedLoop(P_ON_M);
+}
+
+void test_parts_match_library() {
+    setMillis(0);
+
+    Reference reference(P_ON_E);
+    Controller<BasicPID<float>, float> controller(P_ON_E);
+
+    for (int second = 1; second <= 300; second++) {
+        const double input = 20 + second * 0.25;
+        setMillis(second * WINDOW_SIZE);
+        reference.compute(input, kHeatUp, second);
+        controller.compute(input, kHeatUp, second);
+
+        TEST_ASSERT_FLOAT_WITHIN(0.01, reference.pid.GetLastPPart(), controller.pid.GetLastPPart());
+        TEST_ASSERT_FLOAT_WITHIN(0.01, reference.pid.GetLastIPart(), controller.pid.GetLastIPart());
+        TEST_ASSERT_FLOAT_WITHIN(0.01, reference.pid.GetLastDPart(), controller.pid.GetLastDPart());
+        TEST_ASSERT_FLOAT_WITHIN(0.001, reference.pid.GetInputError(), controller.pid.GetInputError());
+        TEST_ASSERT_FLOAT_WITHIN(0.001, reference.pid.GetDeltaInput(), controller.pid.GetDeltaInput());
+    }
+}
+
+void test_manual_mode_keeps_output() {
+    setMillis(0);
+
+    Controller<BasicPID<float>, float> controller(P_ON_E);
+
+    controller.pid.SetMode(MANUAL);
+    controller.output = 0;
+    controller.temperature = 20;
+
+    setMillis(WINDOW_SIZE);
+    TEST_ASSERT_FALSE(controller.pid.Compute());
+    TEST_ASSERT_EQUAL_FLOAT(0, controller.output);
+
+    // switching back starts the integral sum from the current output
+    controller.temperature = SETPOINT;
+    controller.pid.SetMode(AUTOMATIC);
+    setMillis(2 * WINDOW_SIZE);
+    TEST_ASSERT_TRUE(controller.pid.Compute());
+    TEST_ASSERT_EQUAL_FLOAT(0, controller.pid.GetLastIPart());
+    TEST_ASSERT_EQUAL_FLOAT(0, controller.output);
+}
+
+// a long way below the setpoint drives the integral sum into its limits
+static void checkIntegratorLimits(const int pOn) {
+    setMillis(0);
+
+    Reference reference(pOn);
+    Controller<BasicPID<float>, float> controller(pOn);
+
+    for (int second = 1; second <= 100; second++) {
+        setMillis(second * WINDOW_SIZE);
+        reference.compute(20, kHeatUp, second);
+        controller.compute(20, kHeatUp, second);
+
+        TEST_ASSERT_FLOAT_WITHIN(0.01, reference.pid.GetLastIPart(), controller.pid.GetLastIPart());
+        TEST_ASSERT_FLOAT_WITHIN(0.01, reference.output, controller.output);
+    }
+}
+
+void test_integrator_limits_on_error() {
+    checkIntegratorLimits(P_ON_E);
+}
+
+void test_integrator_limits_on_measurement() {
+    checkIntegratorLimits(P_ON_M);
+}
+
+void test_benchmark() {
+    const double floatNs = nanosecondsPerCompute<float>();
+    const double doubleNs = nanosecondsPerCompute<double>();
+
+    // host FPUs handle both types in hardware, the cycle counts on the ESP32 come from test_pid_benchmark
+    char message[96];
+    snprintf(message, sizeof(message), "Compute(): float %.1f ns, double %.1f ns per call", floatNs, doubleNs);
+    TEST_MESSAGE(message);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_algorithm_matches_library_on_error);
+    RUN_TEST(test_algorithm_matches_library_on_measurement);
+    RUN_TEST(test_output_matches_library_on_error);
+    RUN_TEST(test_output_matches_library_on_measurement);
+    RUN_TEST(test_closed_loop_matches_library_on_error);
+    RUN_TEST(test_closed_loop_matches_library_on_measurement);
+    RUN_TEST(test_parts_match_library);
+    RUN_TEST(test_manual_mode_keeps_output);
+    RUN_TEST(test_integrator_limits_on_error);
+    RUN_TEST(test_integrator_limits_on_measurement);
+    RUN_TEST(test_benchmark);
+
+    return UNITY_END();
+}
@@ -0,0 +1,363 @@
+/**
+ * @file test_power_coordination.cpp
+ *
+ * @brief Simulates several machines on one circuit that share their heater power through a broker stand-in
+ *
+ * @details Each machine runs the PowerCoordinator of loopPowerCoordination(): it passes on the requests of the others,
+ *          limits its heater to its share and announces its demand with the payload of sendMqttPowerRequest().
+ *          The broker delivers announcements with a latency and can lose them. Time is simulated, so every run gives
+ *          the same result.
+ */
+
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "utils/PowerCoordinator.h"
+
+constexpr uint32_t STEP = 50; // ms between two runs of the control loop
+constexpr float BUDGET = 3000;
+constexpr float FALLBACK = 0.25f;
+
+/**
+ * @brief Deterministic pseudo random numbers
+ */
+struct Random {
+        uint32_t state;
+
+        uint32_t next() {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+};
+
+/**
+ * @brief Broker stand-in, delivers every announcement to all machines after a latency
+ */
+struct Broker {
+        struct Message {
+                uint32_t deliverAt;
+                std::string sender;
+                std::string payload;
+        };
+
+        uint32_t minLatency = 20; // ms
+        uint32_t maxLatency = 200;
+        uint32_t lossPercent = 0;
+        Random random{1};
+        std::deque<Message> inFlight;
+
+        void publish(const uint32_t now, const std::string& sender, const std::string& payload) {
+            if (random.next() % 100 < lossPercent) {
+                return;
+            }
+
+            const uint32_t deliverAt = now + minLatency + random.next() % (maxLatency - minLatency + 1);
+
+            // MQTT keeps the order of the messages of one client
+            for (const Message& message : inFlight) {
+                if (message.sender == sender && message.deliverAt > deliverAt) {
+                    inFlight.push_back({message.deliverAt, sender, payload});
+                    return;
+                }
+            }
+
+            inFlight.push_back({deliverAt, sender, payload});
+        }
+};
+
+/**
+ * @brief Machine with a boiler, a proportional controller and the power coordination of the firmware
+ */
+struct Machine {
+        std::string name;
+        float watts = 1200;
+        uint8_t priority = 5;
+        bool on = true;
+        bool connected = true;
+
+        double temperature = 20;
+        float setpoint = 95;
+        float demand = 0; // duty the controller asks for
+        float limit = FALLBACK;
+
+        PowerCoordinator coordinator;
+        PowerBudget::Request mailbox = {};
+        bool mailboxFull = false;
+
+        [[nodiscard]] float heaterWatts() const {
+            return on ? min(demand, limit) * watts : 0.0f;
+        }
+
+        /**
+         * @brief Request received from the broker, as handleMqttPowerRequest() parses it
+         */
+        void receive(const uint32_t now, const std::string& sender, const std::string& payload) {
+            if (!on || !connected || sender == name) {
+                return;
+            }
+
+            JsonDocument document;
+            TEST_ASSERT_TRUE(deserializeJson(document, payload) == DeserializationError::Ok);
+
+            PowerBudget::Request request = {};
+            strlcpy(request.name, sender.c_str(), sizeof(request.name));
+            request.watts = document["watts"].as<float>();
+            request.duty = document["duty"].as<float>();
+            request.priority = document["priority"].as<int>();
+
+            coordinator.receive(request, now);
+        }
+
+        void step(const uint32_t now, Broker& broker) {
+            if (!on) {
+                temperature += (20 - temperature) * 0.8 * STEP / 1000 / 1800;
+                return;
+            }
+
+            demand = constrain(static_cast<float>(setpoint - temperature) / 5, 0.0f, 1.0f);
+
+            PowerBudget::Request self = {};
+            strlcpy(self.name, name.c_str(), sizeof(self.name));
+            self.watts = watts;
+            self.duty = demand;
+            self.priority = priority;
+
+            limit = coordinator.limit(self, connected, BUDGET, FALLBACK, now);
+
+            if (coordinator.announce(self, now)) {
+                mailbox = self;
+                mailboxFull = true;
+            }
+
+            // the MQTT task keeps the latest announcement in its mailbox until it is connected
+            if (mailboxFull && connected) {
+                char payload[64];
+                snprintf(payload, sizeof(payload), R"({"watts":%.0f,"duty":%.3f,"priority":%u})", mailbox.watts, mailbox.duty, static_cast<unsigned>(mailbox.priority));
+                broker.publish(now, name, payload);
+                mailboxFull = false;
+            }
+
+            // 1800 J/K boiler losing 0.8 W/K to the room
+            temperature += (heaterWatts() - 0.8 * (temperature - 20)) * STEP / 1000 / 1800;
+        }
+};
+
+/**
+ * @brief Machines, broker and the circuit they share
+ */
+struct Circuit {
+        std::vector<Machine> machines;
+        Broker broker;
+        uint32_t now = 0;
+
+        float peakWatts = 0;
+        uint32_t overBudgetMs = 0;
+        uint32_t longestOverBudgetMs = 0;
+        uint32_t overBudgetRun = 0;
+        uint32_t trace = 2166136261u; // hash of all heater powers
+
+        explicit Circuit(const size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                machines.push_back({});
+                machines.back().name = "silvia" + std::to_string(i + 1);
+            }
+        }
+
+        void run(const uint32_t duration) {
+            for (const uint32_t end = now + duration; now < end; now += STEP) {
+                while (!broker.inFlight.empty() && broker.inFlight.front().deliverAt <= now) {
+                    const Broker::Message message = broker.inFlight.front();
+                    broker.inFlight.pop_front();
+
+                    for (Machine& machine : machines) {
+                        machine.receive(now, message.sender, message.payload);
+                    }
+                }
+
+                float total = 0;
+
+                for (Machine& machine : machines) {
+                    machine.step(now, broker);
+                    total += machine.heaterWatts();
+                    trace = (trace ^ static_cast<uint32_t>(machine.heaterWatts())) * 16777619u;
+                }
+
+                peakWatts = max(peakWatts, total);
+                overBudgetRun = total > BUDGET + 1 ? overBudgetRun + STEP : 0;
+                overBudgetMs += total > BUDGET + 1 ? STEP : 0;
+                longestOverBudgetMs = max(longestOverBudgetMs, overBudgetRun);
+            }
+        }
+
+        Machine& operator[](const size_t index) {
+            return machines[index];
+        }
+
+        [[nodiscard]] bool allAtSetpoint() const {
+            for (const Machine& machine : machines) {
+                if (machine.on && machine.temperature < machine.setpoint - 6) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        void report(const char* name) const {
+            char message[160];
+            snprintf(message, sizeof(message), "%s: peak %.0f W, over budget for %u ms in total, at most %u ms in a row", name, peakWatts, static_cast<unsigned>(overBudgetMs),
+                     static_cast<unsigned>(longestOverBudgetMs));
+            TEST_MESSAGE(message);
+        }
+};
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_heat_up_after_power_cut() {
+    // four machines of 1200 W come back at the same time, together they would draw 4800 W
+    Circuit circuit(4);
+    uint32_t heatUp = 0;
+
+    while (!circuit.allAtSetpoint() && circuit.now < 3600000) {
+        circuit.run(1000);
+        heatUp += 1000;
+    }
+
+    circuit.report("power cut");
+
+    TEST_ASSERT_TRUE(circuit.allAtSetpoint());
+    TEST_ASSERT_TRUE(circuit.peakWatts <= BUDGET + 1);
+
+    // the budget is actually used, not just split into fixed shares
+    TEST_ASSERT_LESS_THAN(4 * 4 * 60 * 1000, heatUp);
+}
+
+void test_staggered_start_and_latency() {
+    // machines come up one after another while others are still heating, announcements take up to half a second
+    Circuit circuit(5);
+    circuit.broker.maxLatency = 500;
+
+    for (Machine& machine : circuit.machines) {
+        machine.on = false;
+    }
+
+    for (size_t i = 0; i < circuit.machines.size(); i++) {
+        circuit[i].on = true;
+        circuit.run(7000);
+    }
+
+    circuit.run(30 * 60 * 1000);
+    circuit.report("staggered start");
+
+    TEST_ASSERT_TRUE(circuit.allAtSetpoint());
+
+    // a rising demand is used before the others have seen it, which may only overshoot for about one latency
+    TEST_ASSERT_LESS_OR_EQUAL(1000, circuit.longestOverBudgetMs);
+}
+
+void test_priorities() {
+    Circuit circuit(4);
+    circuit[0].priority = 9;
+
+    circuit.run(POWER_LISTEN_PERIOD + 1000);
+
+    // the machine with the higher priority gets its full power, the others share the rest
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, circuit[0].limit);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.5f, circuit[1].limit);
+
+    circuit.run(2 * 60 * 1000);
+
+    for (size_t i = 1; i < circuit.machines.size(); i++) {
+        TEST_ASSERT_TRUE(circuit[0].temperature > circuit[i].temperature + 10);
+        TEST_ASSERT_FLOAT_WITHIN(1.0f, circuit[1].temperature, circuit[i].temperature);
+    }
+}
+
+void test_switched_off_machine_frees_its_share() {
+    Circuit circuit(3);
+    circuit.run(10000);
+
+    const float limitBefore = circuit[1].limit;
+
+    circuit[0].on = false;
+    circuit.run(POWER_PEER_TIMEOUT + 2000);
+
+    TEST_ASSERT_EQUAL(1, circuit[1].coordinator.peers());
+    TEST_ASSERT_TRUE(circuit[1].limit > limitBefore);
+}
+
+void test_lost_connection_falls_back() {
+    Circuit circuit(4);
+    circuit.run(10000);
+
+    for (Machine& machine : circuit.machines) {
+        machine.connected = false;
+    }
+
+    circuit.run(1000);
+
+    for (const Machine& machine : circuit.machines) {
+        TEST_ASSERT_EQUAL_FLOAT(FALLBACK, machine.limit);
+    }
+
+    // after reconnecting the demands of the others are known again before more than the fallback is used
+    for (Machine& machine : circuit.machines) {
+        machine.connected = true;
+    }
+
+    circuit.run(POWER_LISTEN_PERIOD - STEP);
+
+    for (const Machine& machine : circuit.machines) {
+        TEST_ASSERT_TRUE(machine.limit <= FALLBACK);
+    }
+
+    circuit.run(60000);
+    TEST_ASSERT_TRUE(circuit.peakWatts <= BUDGET + 1);
+}
+
+void test_lossy_broker() {
+    Circuit circuit(4);
+    circuit.broker.lossPercent = 20;
+
+    circuit.run(30 * 60 * 1000);
+    circuit.report("lossy broker");
+
+    TEST_ASSERT_TRUE(circuit.allAtSetpoint());
+    TEST_ASSERT_LESS_OR_EQUAL(2000, circuit.longestOverBudgetMs);
+}
+
+void test_deterministic() {
+    uint32_t traces[2];
+
+    for (uint32_t& trace : traces) {
+        Circuit circuit(4);
+        circuit.broker.lossPercent = 10;
+        circuit.run(10 * 60 * 1000);
+        trace = circuit.trace;
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(traces[0], traces[1]);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_heat_up_after_power_cut);
+    RUN_TEST(test_staggered_start_and_latency);
+    RUN_TEST(test_priorities);
+    RUN_TEST(test_switched_off_machine_frees_its_share);
+    RUN_TEST(test_lost_connection_falls_back);
+    RUN_TEST(test_lossy_broker);
+    RUN_TEST(test_deterministic);
+
+    return UNITY_END();
+}
@@ -0,0 +1,225 @@
+/**
+ * @file test_response_writer.cpp
+ *
+ * @brief Checks that JSON and MessagePack responses carry the same data and compares their size and serialization time
+ */
+
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+#include <utility>
+
+#include "utils/ResponseWriter.h"
+
+/**
+ * @brief Collects the written response
+ */
+class BufferPrint : public Print {
+    public:
+        size_t write(const uint8_t c) override {
+            buffer.push_back(static_cast<char>(c));
+            return 1;
+        }
+
+        size_t write(const uint8_t* data, const size_t size) override {
+            buffer.append(reinterpret_cast<const char*>(data), size);
+            return size;
+        }
+
+        std::string buffer;
+};
+
+/**
+ * @brief Only counts the written bytes, so that the benchmark measures the serialization and not the buffer
+ */
+class CountingPrint : public Print {
+    public:
+        size_t write(uint8_t) override {
+            count++;
+            return 1;
+        }
+
+        size_t write(const uint8_t*, const size_t size) override {
+            count += size;
+            return size;
+        }
+
+        size_t count = 0;
+};
+
+constexpr int HISTORY_LENGTH = 600; // same as the web interface history
+constexpr int PARAMETER_COUNT = 5;  // default page size of /parameters
+
+/**
+ * @brief Same structure as the response of /timeseries with a full history
+ */
+static void writeTimeseries(Print& out, const ResponseWriter::Format format) {
+    static constexpr const char* seriesNames[] = {"currentTemps", "targetTemps", "heaterPowers"};
+    ResponseWriter writer(out, format);
+
+    writer.beginObject(3);
+
+    for (int series = 0; series < 3; series++) {
+        writer.key(seriesNames[series]);
+        writer.beginArray(HISTORY_LENGTH);
+
+        for (int n = 0; n < HISTORY_LENGTH; n++) {
+            writer.value(static_cast<float>(9000 + (n * 37 + series * 1000) % 1500) * 0.01f);
+        }
+
+        writer.endArray();
+    }
+
+    writer.endObject();
+}
+
+/**
+ * @brief Same structure as a page of /parameters, the elements are built with ArduinoJson like paramToJson() does
+ */
+static void writeParameters(Print& out, const ResponseWriter::Format format) {
+    ResponseWriter writer(out, format);
+
+    writer.beginObject(4);
+    writer.key("parameters");
+    writer.beginArray(PARAMETER_COUNT);
+
+    for (int i = 0; i < PARAMETER_COUNT; i++) {
+        JsonDocument doc;
+        doc["type"] = 1;
+        doc["name"] = "pid.regular.kp";
+        doc["displayName"] = "PID Kp \"regular\"";
+        doc["section"] = 1;
+        doc["position"] = 110 + i;
+        doc["hasHelpText"] = true;
+        doc["show"] = true;
+        doc["reboot"] = false;
+        doc["value"] = 62.5 + i;
+        doc["min"] = 0;
+        doc["max"] = 999;
+
+        writer.value(doc.as<JsonVariantConst>());
+    }
+
+    writer.endArray();
+    writer.key("offset");
+    writer.value(static_cast<int32_t>(0));
+    writer.key("limit");
+    writer.value(static_cast<int32_t>(PARAMETER_COUNT));
+    writer.key("returned");
+    writer.value(static_cast<int32_t>(PARAMETER_COUNT));
+    writer.endObject();
+}
+
+template <typename Writer>
+static void decodeBoth(Writer write, JsonDocument& json, JsonDocument& msgpack) {
+    BufferPrint jsonOut;
+    BufferPrint msgpackOut;
+
+    write(jsonOut, ResponseWriter::JSON);
+    write(msgpackOut, ResponseWriter::MSGPACK);
+
+    TEST_ASSERT_TRUE(deserializeJson(json, jsonOut.buffer.data(), jsonOut.buffer.size()) == DeserializationError::Ok);
+    TEST_ASSERT_TRUE(deserializeMsgPack(msgpack, msgpackOut.buffer.data(), msgpackOut.buffer.size()) == DeserializationError::Ok);
+}
+
+/**
+ * @brief Print size and serialization time of both formats
+ * @return Size of the JSON and the MessagePack response
+ */
+template <typename Writer>
+static std::pair<size_t, size_t> benchmark(const char* name, Writer write) {
+    constexpr int iterations = 200;
+    size_t bytes[2] = {};
+    double microseconds[2] = {};
+
+    for (const ResponseWriter::Format format : {ResponseWriter::JSON, ResponseWriter::MSGPACK}) {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < iterations; i++) {
+            CountingPrint out;
+            write(out, format);
+            bytes[format] = out.count;
+        }
+
+        microseconds[format] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+    }
+
+    char message[160];
+    snprintf(message, sizeof(message), "%s: JSON %zu bytes in %.1f us, MessagePack %zu bytes in %.1f us", name, bytes[ResponseWriter::JSON], microseconds[ResponseWriter::JSON], bytes[ResponseWriter::MSGPACK],
+             microseconds[ResponseWriter::MSGPACK]);
+    TEST_MESSAGE(message);
+
+    return {bytes[ResponseWriter::JSON], bytes[ResponseWriter::MSGPACK]};
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_negotiate() {
+    TEST_ASSERT_EQUAL(ResponseWriter::JSON, ResponseWriter::negotiate(""));
+    TEST_ASSERT_EQUAL(ResponseWriter::JSON, ResponseWriter::negotiate("*/*"));
+    TEST_ASSERT_EQUAL(ResponseWriter::JSON, ResponseWriter::negotiate("application/json"));
+    TEST_ASSERT_EQUAL(ResponseWriter::MSGPACK, ResponseWriter::negotiate("application/msgpack"));
+    TEST_ASSERT_EQUAL(ResponseWriter::MSGPACK, ResponseWriter::negotiate("application/vnd.msgpack, application/json;q=0.5"));
+}
+
+void test_timeseries_formats_match() {
+    JsonDocument json;
+    JsonDocument msgpack;
+    decodeBoth(writeTimeseries, json, msgpack);
+
+    for (const char* series : {"currentTemps", "targetTemps", "heaterPowers"}) {
+        const JsonArrayConst expected = json[series].as<JsonArrayConst>();
+        const JsonArrayConst actual = msgpack[series].as<JsonArrayConst>();
+
+        TEST_ASSERT_EQUAL(HISTORY_LENGTH, expected.size());
+        TEST_ASSERT_EQUAL(HISTORY_LENGTH, actual.size());
+
+        // JSON carries two decimals, MessagePack the float itself
+        for (size_t i = 0; i < expected.size(); i++) {
+            TEST_ASSERT_FLOAT_WITHIN(0.005f, actual[i].as<float>(), expected[i].as<float>());
+        }
+    }
+}
+
+void test_parameters_formats_match() {
+    JsonDocument json;
+    JsonDocument msgpack;
+    decodeBoth(writeParameters, json, msgpack);
+
+    std::string expected;
+    std::string actual;
+    serializeJson(json, expected);
+    serializeJson(msgpack, actual);
+
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), actual.c_str());
+    TEST_ASSERT_EQUAL(PARAMETER_COUNT, json["returned"].as<int>());
+    TEST_ASSERT_EQUAL_STRING("PID Kp \"regular\"", json["parameters"][0]["displayName"].as<const char*>());
+}
+
+void test_benchmark_timeseries() {
+    const auto [json, msgpack] = benchmark("/timeseries", writeTimeseries);
+
+    // the float arrays are what MessagePack was added for
+    TEST_ASSERT_LESS_THAN(json, msgpack);
+}
+
+void test_benchmark_parameters() {
+    benchmark("/parameters", writeParameters);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_negotiate);
+    RUN_TEST(test_timeseries_formats_match);
+    RUN_TEST(test_parameters_formats_match);
+    RUN_TEST(test_benchmark_timeseries);
+    RUN_TEST(test_benchmark_parameters);
+
+    return UNITY_END();
+}
@@ -0,0 +1,367 @@
+/**
+ * @file test_store_forward.cpp
+ *
+ * @brief Runs the offline buffer against a broker stand-in that goes away and comes back
+ *
+ * @details The MQTT task side is the MqttOutbox of mqttTask(): while disconnected, queued states are stored with coalescing
+ *          and shot summaries as events. After reconnecting, the buffer is flushed in batches while new messages wait in the
+ *          outbound queue. The publisher stands in for the control loop and the queues around the outbox: failed publishes and
+ *          states that didn't fit into the queue are sent again, and if messages were dropped from the buffer, everything is
+ *          published again.
+ */
+
+#include <unity.h>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <utility>
+#include <string>
+#include <vector>
+
+#include "utils/MqttOutbox.h"
+
+constexpr uint16_t TOPIC_COUNT = 20;
+constexpr size_t FLUSH_BATCH = 8;          // MQTT_FLUSH_BATCH in mqtt.h
+constexpr size_t QUEUE_LENGTH = 32;        // MQTT_OUTBOUND_QUEUE_LENGTH in mqtt.h
+constexpr uint16_t SUMMARY_TOPIC = 0xffff; // stands in for MQTT_SHOT_SUMMARY_TOPIC
+
+/**
+ * @brief Broker stand-in, records what arrives and can drop the connection after a number of publishes
+ */
+struct Broker {
+        bool connected = true;
+        int failAfter = -1; // publishes until the connection breaks, -1 for never
+
+        std::map<uint16_t, std::vector<uint32_t>> received; // sequence numbers per topic in order of arrival
+
+        bool publish(const uint16_t topic, const uint32_t sequence) {
+            if (failAfter == 0) {
+                connected = false;
+            }
+
+            if (!connected) {
+                return false;
+            }
+
+            if (failAfter > 0) {
+                failAfter--;
+            }
+
+            received[topic].push_back(sequence);
+
+            return true;
+        }
+
+        [[nodiscard]] uint32_t latest(const uint16_t topic) const {
+            const auto it = received.find(topic);
+
+            return it != received.end() ? it->second.back() : 0;
+        }
+};
+
+/**
+ * @brief Control loop, outbound queue and the MQTT task around the outbox, messages carry a sequence number as payload
+ */
+struct Publisher {
+        struct Message {
+                uint16_t topic;
+                uint32_t sequence;
+                bool coalesce;
+        };
+
+        explicit Publisher(Broker& broker, const size_t capacity, const StoreForwardBuffer::DropPolicy policy) :
+            broker(broker) {
+            outbox.begin(capacity, policy);
+        }
+
+        Broker& broker;
+        MqttOutbox outbox;
+        std::deque<Message> queue;              // outbound queue between control loop and MQTT task
+        std::map<uint16_t, uint32_t> published; // latest sequence number per state topic
+        std::set<uint16_t> unsent;              // states the control loop sends again, like a lastSent that wasn't updated
+        std::vector<uint32_t> summaries;        // all shot summaries
+        uint32_t sequence = 0;
+        int resyncs = 0;
+
+        void publishState(const uint16_t topic) {
+            published[topic] = ++sequence;
+            enqueue(topic, sequence);
+        }
+
+        void publishSummary() {
+            summaries.push_back(++sequence);
+            queue.push_back({SUMMARY_TOPIC, sequence, false});
+        }
+
+        /**
+         * @brief One iteration of the control loop and the MQTT task
+         */
+        void loop() {
+            for (const uint16_t topic : std::set<uint16_t>(std::move(unsent))) {
+                enqueue(topic, published[topic]);
+            }
+
+            bool resync;
+            const MqttOutbox::Action action = outbox.update(broker.connected, resync);
+
+            // changes that didn't fit into the buffer are only recovered by publishing everything again
+            if (resync) {
+                resyncs++;
+
+                for (const auto& [topic, latest] : published) {
+                    unsent.insert(topic);
+                }
+            }
+
+            if (action == MqttOutbox::STORE) {
+                for (const Message& message : queue) {
+                    outbox.store(message.topic, reinterpret_cast<const char*>(&message.sequence), sizeof(message.sequence), message.coalesce);
+                }
+
+                queue.clear();
+                return;
+            }
+
+            if (action == MqttOutbox::FLUSH) {
+                char payload[sizeof(uint32_t)];
+
+                // kept in the buffer, the failed publish is reported as well
+                outbox.flush(FLUSH_BATCH, payload, sizeof(payload), [this](const uint16_t topic, const char* data, const size_t length) {
+                    uint32_t sequence;
+                    TEST_ASSERT_EQUAL(sizeof(sequence), length);
+                    memcpy(&sequence, data, sizeof(sequence));
+
+                    if (!broker.publish(topic, sequence)) {
+                        reportFailed(topic);
+                        return false;
+                    }
+
+                    return true;
+                });
+
+                return;
+            }
+
+            while (!queue.empty()) {
+                const Message message = queue.front();
+                queue.pop_front();
+
+                if (!broker.publish(message.topic, message.sequence)) {
+                    reportFailed(message.topic);
+                    return;
+                }
+            }
+        }
+
+        void drain() {
+            while (!outbox.empty() || !queue.empty() || !unsent.empty()) {
+                loop();
+            }
+        }
+
+    private:
+        void enqueue(const uint16_t topic, const uint32_t payload) {
+            if (queue.size() < QUEUE_LENGTH) {
+                queue.push_back({topic, payload, true});
+            }
+            else {
+                unsent.insert(topic);
+            }
+        }
+
+        void reportFailed(const uint16_t topic) {
+            if (topic != SUMMARY_TOPIC) {
+                unsent.insert(topic);
+            }
+        }
+};
+
+/**
+ * @brief Deterministic pseudo random numbers, the same sequence on every run
+ */
+static uint32_t nextRandom() {
+    static uint32_t state = 12345;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return state;
+}
+
+/**
+ * @brief Every topic arrived in order and ends with the latest published value
+ */
+static void assertConsistent(const Publisher& publisher, const Broker& broker) {
+    for (const auto& [topic, sequences] : broker.received) {
+        for (size_t i = 1; i < sequences.size(); i++) {
+            TEST_ASSERT_TRUE_MESSAGE(sequences[i - 1] <= sequences[i], "an older value arrived after a newer one");
+        }
+    }
+
+    for (const auto& [topic, latest] : publisher.published) {
+        TEST_ASSERT_EQUAL_UINT32(latest, broker.latest(topic));
+    }
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_outage_delivers_latest_states() {
+    Broker broker;
+    Publisher publisher(broker, 1024, StoreForwardBuffer::DROP_OLDEST);
+
+    broker.connected = false;
+
+    for (int i = 0; i < 1000; i++) {
+        publisher.publishState(i % TOPIC_COUNT);
+        publisher.loop();
+    }
+
+    broker.connected = true;
+    publisher.drain();
+
+    assertConsistent(publisher, broker);
+    TEST_ASSERT_EQUAL(0, publisher.outbox.dropped());
+
+    // coalescing leaves one message per topic
+    for (uint16_t topic = 0; topic < TOPIC_COUNT; topic++) {
+        TEST_ASSERT_EQUAL(1, broker.received[topic].size());
+    }
+}
+
+void test_summaries_are_kept_in_order() {
+    Broker broker;
+    Publisher publisher(broker, 1024, StoreForwardBuffer::DROP_OLDEST);
+
+    broker.connected = false;
+
+    for (int i = 0; i < 30; i++) {
+        publisher.publishState(i % 3);
+
+        if (i % 10 == 0) {
+            publisher.publishSummary();
+        }
+
+        publisher.loop();
+    }
+
+    broker.connected = true;
+    publisher.drain();
+
+    TEST_ASSERT_TRUE(broker.received[SUMMARY_TOPIC] == publisher.summaries);
+    assertConsistent(publisher, broker);
+}
+
+void test_connection_lost_while_flushing() {
+    Broker broker;
+    Publisher publisher(broker, 1024, StoreForwardBuffer::DROP_OLDEST);
+
+    broker.connected = false;
+
+    for (uint16_t topic = 0; topic < TOPIC_COUNT; topic++) {
+        publisher.publishState(topic);
+    }
+
+    publisher.loop();
+
+    // the broker goes away again in the middle of the first batch
+    broker.connected = true;
+    broker.failAfter = FLUSH_BATCH / 2;
+    publisher.loop();
+
+    TEST_ASSERT_FALSE(broker.connected);
+    TEST_ASSERT_EQUAL(TOPIC_COUNT - FLUSH_BATCH / 2, publisher.outbox.count());
+
+    // newer values of topics that were already delivered and of topics still buffered
+    publisher.publishState(0);
+    publisher.publishState(TOPIC_COUNT - 1);
+
+    broker.connected = true;
+    broker.failAfter = -1;
+    publisher.drain();
+
+    assertConsistent(publisher, broker);
+    TEST_ASSERT_EQUAL(0, publisher.resyncs);
+}
+
+void test_overflow_requests_resync() {
+    for (const auto policy : {StoreForwardBuffer::DROP_OLDEST, StoreForwardBuffer::DROP_NEWEST}) {
+        Broker broker;
+        Publisher publisher(broker, 10 * 9, policy); // room for 10 of the 20 topics
+
+        broker.connected = false;
+
+        for (int i = 0; i < 200; i++) {
+            publisher.publishState(i % TOPIC_COUNT);
+            publisher.loop();
+        }
+
+        TEST_ASSERT_GREATER_THAN(0, publisher.outbox.dropped());
+
+        broker.connected = true;
+        publisher.drain();
+
+        TEST_ASSERT_EQUAL(1, publisher.resyncs);
+        assertConsistent(publisher, broker);
+    }
+}
+
+void test_random_outages() {
+    for (const auto policy : {StoreForwardBuffer::DROP_OLDEST, StoreForwardBuffer::DROP_NEWEST}) {
+        Broker broker;
+        Publisher publisher(broker, 128, policy);
+        uint32_t outages = 0;
+
+        for (int i = 0; i < 100000; i++) {
+            const uint32_t event = nextRandom() % 1000;
+
+            if (event < 2) {
+                outages += broker.connected ? 1 : 0;
+                broker.connected = false;
+            }
+            else if (event < 12) {
+                broker.connected = true;
+                broker.failAfter = -1;
+            }
+            else if (event < 14) {
+                // connection breaks on one of the next publishes
+                broker.failAfter = static_cast<int>(nextRandom() % 8);
+            }
+            else if (event < 16) {
+                publisher.publishSummary();
+            }
+            else if (event < 500) {
+                publisher.publishState(nextRandom() % TOPIC_COUNT);
+            }
+
+            publisher.loop();
+        }
+
+        broker.connected = true;
+        broker.failAfter = -1;
+        publisher.drain();
+
+        char message[100];
+        snprintf(message, sizeof(message), "%u outages, %u messages dropped, %d resyncs", outages, publisher.outbox.dropped(), publisher.resyncs);
+        TEST_MESSAGE(message);
+
+        TEST_ASSERT_GREATER_THAN(0, outages);
+        assertConsistent(publisher, broker);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_outage_delivers_latest_states);
+    RUN_TEST(test_summaries_are_kept_in_order);
+    RUN_TEST(test_connection_lost_while_flushing);
+    RUN_TEST(test_overflow_requests_resync);
+    RUN_TEST(test_random_outages);
+
+    return UNITY_END();
+}
@@ -0,0 +1,90 @@
+/**
+ * @file Arduino.h
+ *
+ * @brief Minimal Arduino core for the host tests, only what the tested modules and their libraries use
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "Print.h"
+#include "WString.h"
+#include "esp32-hal-timer.h"
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define IRAM_ATTR
+#define PSTR(s)                    (s)
+#define F(s)                       (s)
+#define pgm_read_byte(addr)        (*reinterpret_cast<const uint8_t*>(addr))
+#define pgm_read_byte_near(addr)   pgm_read_byte(addr)
+#define strnlen_P                  strnlen
+#define memcpy_P                   memcpy
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline std::chrono::steady_clock::time_point arduinoStartTime() {
+    static const auto start = std::chrono::steady_clock::now();
+    return start;
+}
+
+// simulated time in µs, negative while millis() and micros() follow the host clock
+inline int64_t& arduinoSimulatedMicros() {
+    static int64_t micros = -1;
+    return micros;
+}
+
+/**
+ * @brief Run code that reads the clock itself in simulated time, millis() and micros() return this time until it is set again
+ */
+inline void setMillis(const unsigned long ms) {
+    arduinoSimulatedMicros() = static_cast<int64_t>(ms) * 1000;
+}
+
+inline unsigned long millis() {
+    if (arduinoSimulatedMicros() >= 0) {
+        return static_cast<unsigned long>(arduinoSimulatedMicros() / 1000);
+    }
+
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - arduinoStartTime()).count());
+}
+
+inline unsigned long micros() {
+    if (arduinoSimulatedMicros() >= 0) {
+        return static_cast<unsigned long>(arduinoSimulatedMicros());
+    }
+
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - arduinoStartTime()).count());
+}
+
+inline void delay(const unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void yield() {
+    std::this_thread::yield();
+}
+
+inline size_t strlcpy(char* dst, const char* src, const size_t size) {
+    const size_t length = strlen(src);
+
+    if (size > 0) {
+        const size_t count = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, count);
+        dst[count] = '\0';
+    }
+
+    return length;
+}
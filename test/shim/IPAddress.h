@@ -0,0 +1,29 @@
+/**
+ * @file IPAddress.h
+ *
+ * @brief Arduino IPAddress for the host tests
+ */
+
+#pragma once
+
+#include <cstdint>
+
+class IPAddress {
+    public:
+        IPAddress() = default;
+
+        IPAddress(const uint8_t first, const uint8_t second, const uint8_t third, const uint8_t fourth) :
+            address_{first, second, third, fourth} {
+        }
+
+        uint8_t operator[](const int index) const {
+            return address_[index];
+        }
+
+        uint8_t* raw_address() {
+            return address_;
+        }
+
+    private:
+        uint8_t address_[4] = {};
+};
@@ -0,0 +1,148 @@
+/**
+ * @file Print.h
+ *
+ * @brief Arduino Print for the host tests, number formatting follows the Arduino core
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+class Print {
+    public:
+        virtual ~Print() = default;
+
+        virtual size_t write(uint8_t c) = 0;
+
+        virtual size_t write(const uint8_t* buffer, size_t size) {
+            size_t n = 0;
+
+            while (size--) {
+                n += write(*buffer++);
+            }
+
+            return n;
+        }
+
+        size_t write(const char* str) {
+            return str != nullptr ? write(reinterpret_cast<const uint8_t*>(str), strlen(str)) : 0;
+        }
+
+        size_t write(const char* buffer, const size_t size) {
+            return write(reinterpret_cast<const uint8_t*>(buffer), size);
+        }
+
+        size_t print(const char* str) {
+            return write(str);
+        }
+
+        size_t print(const char c) {
+            return write(static_cast<uint8_t>(c));
+        }
+
+        size_t print(const int number, const int base = 10) {
+            return print(static_cast<long>(number), base);
+        }
+
+        size_t print(const unsigned int number, const int base = 10) {
+            return print(static_cast<unsigned long>(number), base);
+        }
+
+        size_t print(const long number, const int base = 10) {
+            if (base == 10 && number < 0) {
+                return print('-') + printNumber(0UL - static_cast<unsigned long>(number), 10);
+            }
+
+            return printNumber(static_cast<unsigned long>(number), base);
+        }
+
+        size_t print(const unsigned long number, const int base = 10) {
+            return printNumber(number, base);
+        }
+
+        size_t print(const double number, const int digits = 2) {
+            return printFloat(number, digits);
+        }
+
+        size_t println() {
+            return write("\r\n");
+        }
+
+        size_t printf(const char* format, ...) {
+            char buffer[256];
+            va_list args;
+            va_start(args, format);
+            const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+            va_end(args);
+
+            return length > 0 ? write(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1)) : 0;
+        }
+
+        virtual void flush() {
+        }
+
+    private:
+        size_t printNumber(unsigned long number, const int base) {
+            char buffer[8 * sizeof(long) + 1];
+            char* str = &buffer[sizeof(buffer) - 1];
+            *str = '\0';
+
+            do {
+                const char digit = static_cast<char>(number % base);
+                number /= base;
+                *--str = digit < 10 ? digit + '0' : digit + 'A' - 10;
+            } while (number);
+
+            return write(str);
+        }
+
+        size_t printFloat(double number, int digits) {
+            if (std::isnan(number)) {
+                return print("nan");
+            }
+
+            if (std::isinf(number)) {
+                return print("inf");
+            }
+
+            if (number > 4294967040.0 || number < -4294967040.0) {
+                return print("ovf");
+            }
+
+            size_t n = 0;
+
+            if (number < 0.0) {
+                n += print('-');
+                number = -number;
+            }
+
+            double rounding = 0.5;
+
+            for (int i = 0; i < digits; ++i) {
+                rounding /= 10.0;
+            }
+
+            number += rounding;
+
+            const auto intPart = static_cast<unsigned long>(number);
+            double remainder = number - static_cast<double>(intPart);
+            n += print(intPart);
+
+            if (digits > 0) {
+                n += print('.');
+            }
+
+            while (digits-- > 0) {
+                remainder *= 10.0;
+                const auto digit = static_cast<unsigned int>(remainder);
+                n += print(digit);
+                remainder -= digit;
+            }
+
+            return n;
+        }
+};
@@ -0,0 +1,23 @@
+/**
+ * @file Stream.h
+ *
+ * @brief Arduino Stream for the host tests
+ */
+
+#pragma once
+
+#include "Print.h"
+
+class Stream : public Print {
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+
+        void setTimeout(const unsigned long timeout) {
+            timeout_ = timeout;
+        }
+
+    protected:
+        unsigned long timeout_ = 1000;
+};
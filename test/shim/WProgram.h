@@ -0,0 +1,9 @@
+/**
+ * @file WProgram.h
+ *
+ * @brief Pre-1.0 name of the Arduino core header, included by libraries when ARDUINO isn't defined
+ */
+
+#pragma once
+
+#include "Arduino.h"
@@ -0,0 +1,201 @@
+/**
+ * @file WString.h
+ *
+ * @brief Arduino String for the host tests, backed by std::string
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+class String {
+    public:
+        String() = default;
+
+        String(const char* str) :
+            str_(str != nullptr ? str : "") {
+        }
+
+        String(const std::string& str) :
+            str_(str) {
+        }
+
+        explicit String(const char c) :
+            str_(1, c) {
+        }
+
+        explicit String(const int number) :
+            str_(std::to_string(number)) {
+        }
+
+        explicit String(const unsigned int number) :
+            str_(std::to_string(number)) {
+        }
+
+        explicit String(const long number) :
+            str_(std::to_string(number)) {
+        }
+
+        explicit String(const unsigned long number) :
+            str_(std::to_string(number)) {
+        }
+
+        explicit String(const double number, const unsigned int decimals = 2) {
+            char buffer[48];
+            snprintf(buffer, sizeof(buffer), "%.*f", decimals, number);
+            str_ = buffer;
+        }
+
+        const char* c_str() const {
+            return str_.c_str();
+        }
+
+        unsigned int length() const {
+            return static_cast<unsigned int>(str_.length());
+        }
+
+        bool isEmpty() const {
+            return str_.empty();
+        }
+
+        bool reserve(const unsigned int size) {
+            str_.reserve(size);
+            return true;
+        }
+
+        bool concat(const char* str) {
+            str_ += str;
+            return true;
+        }
+
+        bool concat(const char* str, const unsigned int length) {
+            str_.append(str, length);
+            return true;
+        }
+
+        bool concat(const char c) {
+            str_ += c;
+            return true;
+        }
+
+        String& operator+=(const String& other) {
+            str_ += other.str_;
+            return *this;
+        }
+
+        String& operator+=(const char* str) {
+            str_ += str;
+            return *this;
+        }
+
+        String& operator+=(const char c) {
+            str_ += c;
+            return *this;
+        }
+
+        char operator[](const unsigned int index) const {
+            return index < str_.length() ? str_[index] : '\0';
+        }
+
+        char charAt(const unsigned int index) const {
+            return (*this)[index];
+        }
+
+        bool operator==(const String& other) const {
+            return str_ == other.str_;
+        }
+
+        bool operator==(const char* str) const {
+            return str_ == str;
+        }
+
+        bool operator!=(const String& other) const {
+            return str_ != other.str_;
+        }
+
+        bool operator!=(const char* str) const {
+            return str_ != str;
+        }
+
+        bool operator<(const String& other) const {
+            return str_ < other.str_;
+        }
+
+        bool equals(const String& other) const {
+            return str_ == other.str_;
+        }
+
+        bool startsWith(const String& prefix) const {
+            return str_.compare(0, prefix.str_.length(), prefix.str_) == 0;
+        }
+
+        bool endsWith(const String& suffix) const {
+            return str_.length() >= suffix.str_.length() && str_.compare(str_.length() - suffix.str_.length(), suffix.str_.length(), suffix.str_) == 0;
+        }
+
+        int indexOf(const char c, const unsigned int from = 0) const {
+            return position(str_.find(c, from));
+        }
+
+        int indexOf(const String& str, const unsigned int from = 0) const {
+            return position(str_.find(str.str_, from));
+        }
+
+        int lastIndexOf(const char c) const {
+            return position(str_.rfind(c));
+        }
+
+        String substring(const unsigned int from) const {
+            return from < str_.length() ? String(str_.substr(from)) : String();
+        }
+
+        String substring(const unsigned int from, const unsigned int to) const {
+            return from < to && from < str_.length() ? String(str_.substr(from, to - from)) : String();
+        }
+
+        long toInt() const {
+            return strtol(str_.c_str(), nullptr, 10);
+        }
+
+        float toFloat() const {
+            return strtof(str_.c_str(), nullptr);
+        }
+
+        void trim() {
+            const auto first = str_.find_first_not_of(" \t\r\n");
+
+            if (first == std::string::npos) {
+                str_.clear();
+                return;
+            }
+
+            str_ = str_.substr(first, str_.find_last_not_of(" \t\r\n") - first + 1);
+        }
+
+        void toLowerCase() {
+            for (char& c : str_) {
+                c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+            }
+        }
+
+        friend String operator+(const String& lhs, const String& rhs) {
+            return String(lhs.str_ + rhs.str_);
+        }
+
+        friend String operator+(const String& lhs, const char* rhs) {
+            return String(lhs.str_ + rhs);
+        }
+
+        friend String operator+(const char* lhs, const String& rhs) {
+            return String(lhs + rhs.str_);
+        }
+
+    private:
+        static int position(const std::string::size_type pos) {
+            return pos == std::string::npos ? -1 : static_cast<int>(pos);
+        }
+
+        std::string str_;
+};
@@ -0,0 +1,40 @@
+/**
+ * @file esp32-hal-timer.h
+ *
+ * @brief Hardware timer API of the ESP32 Arduino core for the host tests, the tests call the interrupt handler themselves
+ */
+
+#pragma once
+
+#include <cstdint>
+
+struct hw_timer_t {
+        void (*handler)();
+        uint64_t alarm;
+        bool enabled;
+};
+
+inline hw_timer_t* timerBegin(uint8_t, uint16_t, bool) {
+    static hw_timer_t timer = {};
+    return &timer;
+}
+
+inline void timerAttachInterruptFlag(hw_timer_t* timer, void (*handler)(), bool, int) {
+    timer->handler = handler;
+}
+
+inline void timerAlarmWrite(hw_timer_t* timer, const uint64_t alarm, bool) {
+    timer->alarm = alarm;
+}
+
+inline void timerAlarmEnable(hw_timer_t* timer) {
+    timer->enabled = true;
+}
+
+inline void timerAlarmDisable(hw_timer_t* timer) {
+    timer->enabled = false;
+}
+
+inline bool timerAlarmEnabled(hw_timer_t* timer) {
+    return timer->enabled;
+}
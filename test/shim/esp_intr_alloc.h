@@ -0,0 +1,9 @@
+/**
+ * @file esp_intr_alloc.h
+ *
+ * @brief Interrupt allocation flags of ESP-IDF for the host tests
+ */
+
+#pragma once
+
+#define ESP_INTR_FLAG_IRAM (1 << 10)